@@ -0,0 +1,87 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace gitfly {
+
+class Repository; // fwd
+
+// EWAH-compressed bitset (64-bit words, the layout used by git's bitmaps): a
+// marker word holds a run of clean words (all 0 or all 1) followed by a count of
+// literal words stored verbatim. Operations work on the compressed form.
+class EwahBitmap {
+public:
+  EwahBitmap() = default;
+
+  // Compress an uncompressed bitset (bit i is word i/64, bit i%64).
+  static EwahBitmap from_words(const std::vector<std::uint64_t> &plain);
+
+  [[nodiscard]] EwahBitmap operator|(const EwahBitmap &other) const;
+  // Bits set here and not in `other`.
+  [[nodiscard]] EwahBitmap and_not(const EwahBitmap &other) const;
+
+  // OR into an uncompressed bitset, growing it as needed.
+  void or_into(std::vector<std::uint64_t> &plain) const;
+  void for_each(const std::function<void(std::size_t)> &fn) const;
+  [[nodiscard]] std::size_t count() const;
+
+  // Little-endian "<word count u32><words u64...>".
+  void serialize(std::string &out) const;
+  // Parses one bitmap at `pos`, advancing it; throws std::runtime_error on bad input.
+  static EwahBitmap parse(std::string_view in, std::size_t &pos);
+
+  [[nodiscard]] bool operator==(const EwahBitmap &) const = default;
+
+private:
+  friend class EwahBuilder;
+  std::vector<std::uint64_t> words_;
+};
+
+// Reachability bitmaps for selected commits, stored in objects/pack/reach.bitmap.
+// Bit positions index an object table (every object reachable from the refs at
+// build time); a commit's bitmap has the bits of its whole closure set. Objects
+// newer than the table get positions past its end for the duration of a query.
+class BitmapIndex {
+public:
+  // Commits between stored bitmaps along a walk, besides the ref tips.
+  static constexpr std::size_t kStride = 64;
+
+  // Loads the index of `gitdir`; nullopt if there is none.
+  static std::optional<BitmapIndex> load(const std::filesystem::path &gitdir);
+
+  // Load the index and, if any of `tips` is outside it, extend it with the new
+  // history reachable from the repository's refs and write it back. Returns
+  // nullopt for shallow and partial repositories, whose closures are incomplete.
+  static std::optional<BitmapIndex> refresh(const Repository &repo,
+                                            const std::vector<std::string> &tips);
+
+  // Objects reachable from `wants` but not from `haves` (want OR ... AND-NOT have).
+  // Every have must be a commit present in the repository.
+  [[nodiscard]] std::vector<std::string> missing(const Repository &repo,
+                                                 const std::vector<std::string> &wants,
+                                                 const std::vector<std::string> &haves) const;
+
+  [[nodiscard]] bool covers(const std::string &hex) const { return position_.contains(hex); }
+  [[nodiscard]] std::size_t object_count() const { return table_.size(); }
+  [[nodiscard]] std::size_t bitmap_count() const { return bitmaps_.size(); }
+
+private:
+  class Walker;
+
+  void extend(const Repository &repo);
+  void save(const std::filesystem::path &gitdir) const;
+
+  std::vector<std::string> table_;                       // position -> hex
+  std::unordered_map<std::string, std::size_t> position_; // hex -> position
+  std::map<std::string, EwahBitmap> bitmaps_;             // commit hex -> closure
+};
+
+} // namespace gitfly
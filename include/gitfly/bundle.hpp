@@ -0,0 +1,60 @@
+#pragma once
+#include "gitfly/refs.hpp"
+
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace gitfly::bundle {
+
+// A bundle is one file holding a ref list and the objects behind it, usable as
+// a read-only remote by clone and fetch:
+//
+//   # gitfly bundle v1
+//   head <refname | hex>      what HEAD was when the bundle was made (optional)
+//   prereq <hex>              commit the reader must already have (one per line)
+//   <hex> <refname>           one per ref
+//   <empty line>
+//   NOBJ <n>, then "OBJ <hex> <size>\n" + loose-object bytes per object, DONE
+//
+// The object part uses the wire framing, so reading a bundle is one sequential
+// pass over the file.
+struct Header {
+  std::vector<RefEntry> refs;
+  std::string head;                       // refname, hex, or "" if not recorded
+  std::vector<std::string> prerequisites; // commits (40-hex) left out of the bundle
+};
+
+// Write a bundle of `refnames` from the repository at `repo_root`. Names may be
+// full ("refs/..."), "HEAD", or a branch/tag name; none means every head and tag
+// plus HEAD. History reachable from the commits in `exclude` (hex or ref names)
+// is left out and those commits become prerequisites, for incremental bundles.
+// Returns the number of objects written.
+std::size_t create(const std::filesystem::path& repo_root, const std::filesystem::path& file,
+                   const std::vector<std::string>& refnames,
+                   const std::vector<std::string>& exclude = {});
+
+// True if `path` is a regular file starting with the bundle signature.
+bool is_bundle(const std::filesystem::path& path);
+
+// Parse the header only. Throws std::runtime_error if `file` is not a bundle.
+Header read_header(const std::filesystem::path& file);
+
+// Store the bundle's objects in the repository at `repo_root` (each verified
+// against its id, ones already present skipped) and check that every ref's
+// history is complete. Refs are not touched. Throws if a prerequisite is missing.
+Header unbundle(const std::filesystem::path& repo_root, const std::filesystem::path& file);
+
+// Clone from a bundle into `dst`: its heads and tags become local refs and HEAD
+// is checked out. The bundle must not have prerequisites.
+void clone_repo(const std::filesystem::path& file, const std::filesystem::path& dst);
+
+// Unbundle into `local` and record the refs under `prefix` (default: all) as
+// remote-tracking refs of `name`, as remote::fetch_refs does. Returns them.
+std::vector<RefEntry> fetch_refs(const std::filesystem::path& local,
+                                 const std::filesystem::path& file,
+                                 const std::string& name = "origin",
+                                 const std::string& prefix = {});
+
+} // namespace gitfly::bundle
@@ -1,6 +1,9 @@
 #pragma once
 #include <filesystem>
+#include <map>
+#include <optional>
 #include <string>
+#include <string_view>
 
 namespace gitfly {
 
@@ -15,4 +18,14 @@ Identity load_identity(const std::filesystem::path& repo_root);
 // Overwrite .gitfly/config with the given identity
 void save_identity(const std::filesystem::path& repo_root, const Identity& id);
 
+// Generic "<key>: <value>" entries in .gitfly/config (same format as the identity).
+std::optional<std::string> config_get(const std::filesystem::path& repo_root,
+                                      std::string_view key);
+// Every entry at once (the first of duplicate keys wins), for readers of several
+// keys that would otherwise read the file once per key.
+std::map<std::string, std::string> config_entries(const std::filesystem::path& repo_root);
+// Replace or append `key`, keeping every other line of the file.
+void config_set(const std::filesystem::path& repo_root, std::string_view key,
+                std::string_view value);
+
 } // namespace gitfly
@@ -12,9 +12,28 @@ inline constexpr std::string_view kHeadsDir    = "heads";
 inline constexpr std::string_view kTagsDir     = "tags";
 inline constexpr std::string_view kHeadFile    = "HEAD";
 inline constexpr std::string_view kMergeHead   = "MERGE_HEAD";
+inline constexpr std::string_view kShallowFile = "shallow";
+inline constexpr std::string_view kPackDir     = "pack";        // under objects/
+inline constexpr std::string_view kClonePackManifest = "clone-cache"; // under objects/pack/
+inline constexpr std::string_view kBitmapFile  = "reach.bitmap"; // under objects/pack/
+inline constexpr std::string_view kAlternatesFile = "info/alternates"; // under objects/
+inline constexpr std::string_view kZstdDictDir = "info/zstd";          // under objects/, "<id>.dict"
+inline constexpr std::string_view kObjectIndexFile = "info/oid-index"; // under objects/ (ObjectIndex)
+inline constexpr std::string_view kAlternateIndexDir = "info/alternate-index"; // under objects/, one per alternate
+inline constexpr std::string_view kCloneResume = "CLONE_RESUME"; // checkpoint of an interrupted clone
+inline constexpr std::string_view kLockSuffix  = ".lock";     // "<ref>.lock" while a ref is updated
 inline constexpr std::string_view kDefaultBranch = "master";
 
 
+// Config keys (".gitfly/config" "<key>: <value>" lines)
+inline constexpr std::string_view kCfgPromisor      = "promisor";           // lazy-fetch remote URL
+inline constexpr std::string_view kCfgPartialFilter = "partialclonefilter"; // e.g. "blob:none"
+inline constexpr std::string_view kCfgObjectCodec   = "objectcodec";        // "zstd"; absent means zlib
+inline constexpr std::string_view kCfgCompression   = "compression";        // level for loose and packed
+inline constexpr std::string_view kCfgLooseCompression = "loosecompression"; // loose objects only
+inline constexpr std::string_view kCfgPackCompression  = "packcompression";  // clone packs only
+inline constexpr std::string_view kCfgZstdDict      = "zstddict";           // id of the dictionary in use
+
 // Git object type strings
 inline constexpr std::string_view kTypeBlob    = "blob";
 inline constexpr std::string_view kTypeTree    = "tree";
@@ -25,8 +44,10 @@ inline constexpr std::uint32_t kModeFile = 0100644; // regular file
 inline constexpr std::uint32_t kModeTree = 0040000; // directory entry in tree
 
 // ——— Object ID sizes ———
+// SHA-1, the default object format; FormatTraits in hash.hpp has the others.
 inline constexpr std::size_t kOidRawLen = 20;  // 20 bytes (SHA-1)
 inline constexpr std::size_t kOidHexLen = 40;  // 40 hex chars (SHA-1)
+inline constexpr std::string_view kZeroOid = "0000000000000000000000000000000000000000"; // "no ref" on the wire
 
 // ——— Object store fanout ———
 inline constexpr std::size_t kFanoutDirHexLen = 2; // "aa/" + "bbbb..." in .gitfly/objects
@@ -48,7 +69,7 @@ inline constexpr char kLF    = '\n';
 
 // ——— Protocol (if you want constants for your TCP demo) ———
 inline constexpr std::string_view kHelloLine   = "HELLO 1";
-inline constexpr std::string_view kOpPush      = "OP PUSH ";
+inline constexpr std::string_view kOpPush      = "OP PUSH";
 inline constexpr std::string_view kOpClone     = "OP CLONE";
 inline constexpr std::string_view kOpFetch     = "OP FETCH";
 inline constexpr std::string_view kTokNobj     = "NOBJ ";
@@ -56,6 +77,22 @@ inline constexpr std::string_view kTokObj      = "OBJ ";
 inline constexpr std::string_view kTokDone     = "DONE";
 inline constexpr std::string_view kTokOkGo     = "OKGO";
 inline constexpr std::string_view kTokOk       = "OK";
+inline constexpr std::string_view kTokDepth    = "DEPTH ";
+inline constexpr std::string_view kTokShallow  = "SHALLOW ";
+inline constexpr std::string_view kTokFilter   = "FILTER ";
+inline constexpr std::string_view kTokResume   = "RESUME ";
+inline constexpr std::string_view kTokSkip     = "SKIP ";
+inline constexpr std::string_view kOpBlobs     = "OP BLOBS";
+inline constexpr std::string_view kTokWant     = "WANT ";
+inline constexpr std::string_view kOpLsRefs    = "OP LS-REFS";
+inline constexpr std::string_view kOpFetchRefs = "OP FETCH-REFS";
+inline constexpr std::string_view kTokPrefix   = "PREFIX ";
+inline constexpr std::string_view kTokHave     = "HAVE ";
+inline constexpr std::string_view kTokUpdate   = "UPDATE ";
+inline constexpr std::string_view kTokRepo     = "REPO ";
+inline constexpr std::string_view kTokReq      = "REQ ";   // multi-request session
+inline constexpr std::string_view kTokResp     = "RESP ";
+inline constexpr std::string_view kTokBye      = "BYE";
 } // namespace gitfly::consts
 
  
\ No newline at end of file
@@ -1,5 +1,8 @@
 #pragma once
+#include <cstdint>
 #include <filesystem>
+#include <functional>
+#include <memory>
 #include <span>
 #include <string>
 #include <vector>
@@ -9,10 +12,114 @@ namespace gitfly::fs {
 bool exists(const std::filesystem::path& p);
 void ensure_parent_dir(const std::filesystem::path& p);
 
+// Codec of a compressed stream. Readers tell the two apart by the zstd frame
+// magic, so the choice only matters when writing. Git reads zlib only.
+enum class Codec : std::uint8_t { zlib, zstd };
+
+// zlib always; zstd when built with GITFLY_WITH_ZSTD.
+bool codec_available(Codec codec);
+// True if `head` starts a zstd frame.
+bool is_zstd(std::span<const std::uint8_t> head);
+
+// How to compress: `level` is on the codec's own scale (zlib 0-9, zstd 1-22).
+// `dict` (zstd only, may be empty) is a trained dictionary; frames record its id.
+struct Compression {
+  Codec codec = Codec::zlib;
+  int level = 1;
+  std::span<const std::uint8_t> dict;
+};
+
+// Supplies the zstd dictionary a frame names by id; throws if it has none.
+using ZstdDictFn = std::function<std::span<const std::uint8_t>(std::uint32_t id)>;
+
+// Train a zstd dictionary of at most `capacity` bytes on sample payloads.
+// Throws if zstd is unavailable or the samples are too few to learn from.
+std::vector<std::uint8_t> zstd_train_dictionary(const std::vector<std::vector<std::uint8_t>>& samples,
+                                                std::size_t capacity);
+// The id a dictionary's frames will carry (0 if `dict` is not a trained one).
+std::uint32_t zstd_dictionary_id(std::span<const std::uint8_t> dict);
+
 std::vector<std::uint8_t> read_file(const std::filesystem::path& p);
+// Read at most `limit` leading bytes of a file.
+std::vector<std::uint8_t> read_file_prefix(const std::filesystem::path& p, std::size_t limit);
 void write_file_atomic(const std::filesystem::path& p, std::span<const std::uint8_t> data);
+// Same, with the contents pulled from `read` a chunk at a time: it fills the
+// span it is given and returns how many bytes it stored, 0 at the end.
+void write_file_atomic(const std::filesystem::path& p,
+                       const std::function<std::size_t(std::span<std::uint8_t>)>& read);
+
+// Flush everything written to the filesystem holding `p` to stable storage:
+// one syncfs(2) on Linux, however many files are dirty; sync(2) elsewhere.
+void sync_filesystem(const std::filesystem::path& p);
+
+// How link_or_copy_file placed a file.
+enum class LinkKind { hardlink, reflink, copy, existing };
+
+// Place an immutable file (e.g. a loose object) at `dst` without duplicating its
+// bytes where possible: hardlink, else reflink (FICLONE), else a plain copy.
+// Leaves an existing `dst` untouched. Never modify a file placed this way in
+// place: a hardlinked copy shares its inode with `src`.
+LinkKind link_or_copy_file(const std::filesystem::path& src, const std::filesystem::path& dst);
+
+// Deflates a stream into a temporary file, then renames it into place, so data
+// too large to compress in memory never has to be held whole. The temporary is
+// removed if the writer is destroyed before commit().
+class ZFileWriter {
+public:
+  // The temporary is created in `dir`, which should be on the final file's filesystem.
+  explicit ZFileWriter(const std::filesystem::path& dir, const Compression& compression = {});
+  ~ZFileWriter();
+  ZFileWriter(const ZFileWriter&) = delete;
+  ZFileWriter& operator=(const ZFileWriter&) = delete;
+
+  void write(std::span<const std::uint8_t> data);
+  // Finish the stream and move it to `dst`, creating its directory as needed.
+  void commit(const std::filesystem::path& dst);
+
+private:
+  struct Impl;
+  std::unique_ptr<Impl> impl_;
+};
+
+// Inflates a compressed file (either codec) on demand, reading it in fixed-size
+// chunks, so neither the compressed nor the inflated contents are held whole.
+class ZFileReader {
+public:
+  explicit ZFileReader(const std::filesystem::path& file, ZstdDictFn dict = {});
+  ~ZFileReader();
+  ZFileReader(const ZFileReader&) = delete;
+  ZFileReader& operator=(const ZFileReader&) = delete;
+  ZFileReader(ZFileReader&&) noexcept;
+  ZFileReader& operator=(ZFileReader&&) noexcept;
+
+  // Inflate up to buf.size() bytes into `buf`; returns how many, 0 once the
+  // stream has ended. Throws on corrupt or truncated data.
+  std::size_t read(std::span<std::uint8_t> buf);
+
+private:
+  struct Impl;
+  std::unique_ptr<Impl> impl_;
+};
 
-std::vector<std::uint8_t> z_compress(std::span<const std::uint8_t> data);
-std::vector<std::uint8_t> z_decompress(std::span<const std::uint8_t> data);
+// The z_* helpers compress with zlib unless told otherwise and decompress
+// either codec; `dict` resolves the dictionaries zstd frames may name.
+std::vector<std::uint8_t> z_compress(std::span<const std::uint8_t> data,
+                                     const Compression& compression = {});
+// Compress `head` followed by `body` as one stream, without joining them first.
+std::vector<std::uint8_t> z_compress(std::span<const std::uint8_t> head,
+                                     std::span<const std::uint8_t> body,
+                                     const Compression& compression = {});
+std::vector<std::uint8_t> z_decompress(std::span<const std::uint8_t> data,
+                                       const ZstdDictFn& dict = {});
+// Inflate a complete stream piecewise, handing each inflated chunk to `fn`.
+// Throws on corrupt or truncated input.
+void z_inflate_each(std::span<const std::uint8_t> data,
+                    const std::function<void(std::span<const std::uint8_t>)> &fn,
+                    const ZstdDictFn& dict = {});
+// Inflate only the first `limit` bytes of a stream (e.g. an object header).
+// May return fewer if `data` is a prefix: zstd decodes nothing of a block until
+// the whole block is there.
+std::vector<std::uint8_t> z_decompress_prefix(std::span<const std::uint8_t> data,
+                                              std::size_t limit, const ZstdDictFn& dict = {});
 
 } // namespace gitfly::fs
@@ -15,7 +15,7 @@ class Repository; // fwd decl to avoid header cycle
 
 struct IndexEntry {
   std::uint32_t mode;  // e.g., gitfly::consts::kModeFile
-  oid           oid;   // blob id (20 bytes)
+  gitfly::oid   oid;   // blob id (20 bytes); qualified, as the member hides the type
   std::string   path;  // "dir/file", UTF-8, no leading '/'
 };
 
@@ -29,12 +29,20 @@ public:
   // Overwrite .gitfly/index with current entries
   void save() const;
 
-  // Read file at working-dir `wd/relpath`, write blob via repo, add/replace an entry
+  // Stream file at working-dir `wd/relpath` into a blob via repo, add/replace an entry
   void add_path(const std::filesystem::path& wd,
                 std::string_view relpath, 
                 const Repository& repo,
                 std::uint32_t mode = gitfly::consts::kModeFile);
 
+  // add_path for many files at once: blob ids of small files are computed in
+  // one batch (see sha1_many), large ones are streamed, and the entries are
+  // sorted once at the end.
+  void add_paths(const std::filesystem::path& wd,
+                 const std::vector<std::string>& relpaths,
+                 const Repository& repo,
+                 std::uint32_t mode = gitfly::consts::kModeFile);
+
   // Remove a path from index (no error if absent)
   void remove_path(std::string_view relpath);
 
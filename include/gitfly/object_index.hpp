@@ -0,0 +1,68 @@
+#pragma once
+#include "gitfly/hash.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <span>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace gitfly {
+
+// The ids of every loose object in one objects directory, held in memory so
+// that asking about an absent object does not touch the disk. A Bloom filter
+// answers most misses; the rest are settled by a binary search of the sorted
+// ids. Bulk imports and incoming transfers mostly ask about objects that are
+// not there yet, which is what this is for.
+//
+// Saved (by default as objects/info/oid-index) along with each fan-out
+// directory's mtime; opening it re-reads only the directories that changed
+// since, and rebuilds it from a full scan when it is missing or unreadable. It
+// is a cache: deleting it is always safe. It is a snapshot as of opening plus
+// what add() records, so objects other processes store meanwhile are not seen.
+// Safe to use from several threads at once.
+class ObjectIndex {
+public:
+  // Index of `objects_dir`, whose objects are named in `format`, saved in
+  // `file` (empty: objects_dir/info/oid-index). Writes the refreshed index
+  // back; failing to is ignored.
+  ObjectIndex(std::filesystem::path objects_dir, ObjectFormat format,
+              std::filesystem::path file = {});
+  ObjectIndex(const ObjectIndex&) = delete;
+  ObjectIndex& operator=(const ObjectIndex&) = delete;
+
+  // `id` is a raw id of the index's format; anything else is never contained.
+  bool contains(std::span<const std::uint8_t> id) const;
+  // Record an object stored since opening; false if it was already known.
+  bool add(std::span<const std::uint8_t> id);
+  std::size_t size() const;
+
+  // Fan-out directories re-read when opening (256 for a fresh build).
+  std::size_t rescanned() const { return rescanned_; }
+
+private:
+  using Fanout = std::array<std::uint32_t, 257>; // ids_[fan[b]..fan[b+1]) start with byte b
+
+  bool load(std::array<std::int64_t, 256>& mtimes);
+  void save(const std::array<std::int64_t, 256>& mtimes) const;
+  void build_bloom();
+  bool maybe(std::span<const std::uint8_t> id) const;
+  void set_bits(std::span<const std::uint8_t> id);
+  bool in_table(std::span<const std::uint8_t> id) const;
+
+  std::filesystem::path dir_;
+  std::filesystem::path file_;
+  std::size_t width_;                       // bytes per id
+  std::vector<std::uint8_t> ids_;           // sorted, width_ bytes each
+  Fanout fan_{};
+  std::vector<std::uint64_t> bloom_;        // power-of-two number of bits
+  std::unordered_set<std::string> added_;   // raw ids recorded by add()
+  std::size_t rescanned_ = 0;
+  mutable std::mutex mu_;                   // guards bloom_ and added_
+};
+
+} // namespace gitfly
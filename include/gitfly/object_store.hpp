@@ -1,33 +1,209 @@
 #pragma once
+#include "gitfly/fs.hpp"
 #include "gitfly/hash.hpp"
 #include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <vector>
 
 namespace gitfly {
 
+class ObjectIndex; // fwd
+
 struct Object {
   std::string type;                  // "blob" | "tree" | "commit" | etc.
   std::vector<std::uint8_t> data;    // payload bytes (no header)
 };
 
+// A stored object's payload, inflated as it is read (see ObjectStore::open_stream).
+class ObjectStream {
+public:
+  const std::string& type() const { return type_; }
+  std::uint64_t size() const { return size_; }
+
+  // Fill up to buf.size() payload bytes; returns how many, 0 at the end. Throws
+  // if the payload turns out longer or shorter than its header declared.
+  std::size_t read(std::span<std::uint8_t> buf);
+
+private:
+  friend class ObjectStore;
+  ObjectStream(const std::filesystem::path& file, fs::ZstdDictFn dict);
+
+  fs::ZFileReader z_;
+  std::string type_;
+  std::uint64_t size_ = 0;
+  std::uint64_t left_ = 0;                // payload bytes not yet returned
+  std::vector<std::uint8_t> pending_;     // payload inflated along with the header
+};
+
 class ObjectStore {
 public:
-  explicit ObjectStore(std::filesystem::path gitdir)
-    : gitdir_(std::move(gitdir)) {}
+  // `format` decides how write() names objects and which hex ids are well
+  // formed. Repositories are SHA-1; a SHA-256 store is only usable on its own.
+  explicit ObjectStore(std::filesystem::path gitdir, ObjectFormat format = ObjectFormat::sha1)
+    : gitdir_(std::move(gitdir)), format_(format) {}
 
-  // Read and decompress object identified by 40-hex; returns type and payload.
+  ObjectFormat format() const { return format_; }
+
+  // How written objects are compressed, from the repository config:
+  //   objectcodec       "zstd", for repositories git never reads (default zlib)
+  //   compression       level for loose objects and clone packs
+  //   loosecompression  level for loose objects (default zlib 1, zstd 3)
+  //   packcompression   zlib level objects are recompressed to when packed
+  //                     for clones (default: packed as stored)
+  //   zstddict          dictionary for small zstd objects (train_zstd_dictionary)
+  // Throws on values out of the codec's range or a codec this build lacks.
+  fs::Codec codec() const;
+  // Settings for one loose object of `payload_size` bytes.
+  fs::Compression loose_compression(std::uint64_t payload_size) const;
+  std::optional<int> pack_compression() const;
+
+  // Train a zstd dictionary on the small objects stored so far and use it for
+  // small objects written from now on. Objects already written keep theirs;
+  // every dictionary stays in objects/info/zstd/ for reading them. Returns its
+  // id. Throws unless the codec is zstd and there are enough samples.
+  std::uint32_t train_zstd_dictionary() const;
+
+  // Read and decompress object identified by its hex id; returns type and payload.
   Object read(std::string_view hex_oid) const;
 
-  // Write object with given type/payload. Returns 40-hex id.
+  // Write object with given type/payload. Returns its hex id in format().
   std::string write(std::string_view type, std::span<const std::uint8_t> payload) const;
 
-  // Get filesystem path for a binary oid.
-  std::filesystem::path path_for_oid(const oid& object_id) const;
+  // Same, for a payload whose id the caller already computed (e.g. with
+  // hash_objects over a batch). `id` must be the object's real id.
+  void write_hashed(const oid &id, std::string_view type,
+                    std::span<const std::uint8_t> payload) const;
+
+  // Fills the span it is given from the payload source and returns how many
+  // bytes it stored there; 0 means the source is exhausted.
+  using Reader = std::function<std::size_t(std::span<std::uint8_t>)>;
+
+  // Same as write(), for a `size`-byte payload pulled from `read`. The payload is
+  // hashed and deflated to a temporary file in fixed-size chunks, so memory use
+  // does not grow with `size`. Throws if `read` yields more or fewer bytes.
+  std::string write_stream(std::string_view type, std::uint64_t size, const Reader& read) const;
+
+  // Open an object for reading in chunks, so e.g. a checkout can copy a large
+  // blob into its file without holding it in memory.
+  ObjectStream open_stream(std::string_view hex_oid) const;
+
+  // Make every object written so far durable. Writes do not sync one by one;
+  // call this once per batch, before the ref update that publishes it.
+  void sync() const;
+
+  // Type and payload size of an object, inflating only its header.
+  struct Header {
+    std::string type;
+    std::size_t size = 0;
+  };
+  Header read_header(std::string_view hex_oid) const;
+
+  // True if the object identified by hex is present in the store.
+  bool exists(std::string_view hex_oid) const;
+
+  // From now on, answer exists() and the "already stored?" check of every write
+  // from an ObjectIndex of this store and one of each alternate, opened here,
+  // rather than from the filesystem. For bulk work (imports, transfers) that
+  // asks mostly about objects not there yet. Objects other processes add
+  // meanwhile are not seen. Copies made afterwards share the indexes. The
+  // alternates' indexes are kept under this store's objects/info, never in
+  // the alternates themselves.
+  void load_index() const;
+
+  // Note an object placed without write() (e.g. a file copied in) in the
+  // loaded index. Returns whether it was new to the store, so that of several
+  // threads about to store one object only one goes ahead; without an index,
+  // whether it is missing on disk.
+  bool record(std::string_view hex_oid) const;
+
+  // Inflate a loose object file image, validate its "<type> <size>\0" header and
+  // return the id (of format F) it hashes to. Throws on corrupt zlib data or a bad header,
+  // and on content that is part of a SHA-1 collision attack (see Sha1dcHasher).
+  template <ObjectFormat F = ObjectFormat::sha1>
+  static basic_oid<F> hash_loose(std::span<const std::uint8_t> compressed,
+                                 const fs::ZstdDictFn& dict = {});
+
+  // Same as hash_loose(), for a loose-object image in `file`, which is read and
+  // inflated in chunks rather than held in memory.
+  template <ObjectFormat F = ObjectFormat::sha1>
+  static basic_oid<F> hash_loose_file(const std::filesystem::path& file,
+                                      const fs::ZstdDictFn& dict = {});
+
+  // An object named `id` is already stored; throw unless the loose-object image
+  // `compressed` holds the same content. Two contents under one name can only
+  // be a hash collision, so untrusted input is checked before it is skipped.
+  void check_collision(const oid& id, std::span<const std::uint8_t> compressed) const;
+  // Same, for a loose-object image in `file`.
+  void check_collision(const oid& id, const std::filesystem::path& file) const;
+
+  // Get filesystem path for a binary id.
+  template <std::size_t N>
+  std::filesystem::path path_for_oid(const std::array<std::uint8_t, N>& object_id) const {
+    return path_for_hex(to_hex(object_id));
+  }
+
+  // Where the object actually lives: this store's own file if present, else the
+  // first alternate holding it. Falls back to path_for_oid() when nobody has it.
+  template <std::size_t N>
+  std::filesystem::path locate(const std::array<std::uint8_t, N>& object_id) const {
+    return locate_hex(to_hex(object_id));
+  }
+
+  // Other object directories consulted for objects missing here, listed one
+  // per line in objects/info/alternates (relative entries are relative to this
+  // objects dir). Chains are followed a few levels deep.
+  const std::vector<std::filesystem::path>& alternates() const;
+
+  // Every object id (hex in format()) held here or in an alternate, sorted.
+  std::vector<std::string> list() const;
+
+  // Record `objects_dir` (another repository's .gitfly/objects) as an alternate.
+  void add_alternate(const std::filesystem::path& objects_dir) const;
 
 private:
+  struct Settings {
+    fs::Codec codec = fs::Codec::zlib;
+    int loose_level = 1;
+    std::optional<int> pack_level;
+    std::uint32_t dict_id = 0; // 0: none
+  };
+  using DictCache = std::map<std::uint32_t, std::vector<std::uint8_t>>;
+
+  const Settings& settings() const;
+  // Resolves dictionary ids for readers; usable after this store is gone.
+  fs::ZstdDictFn dictionaries() const;
+  std::filesystem::path path_for_hex(std::string_view hex) const;
+  std::filesystem::path locate_hex(std::string_view hex) const;
+  // exists() for a well-formed id: from the indexes when loaded, else on disk.
+  bool stored(std::string_view hex) const;
+  // Add an object just stored here to the loaded index, if any; false if it
+  // was already known.
+  bool remember(std::string_view hex) const;
+  template <ObjectFormat F>
+  std::string write_as(std::string_view type, std::span<const std::uint8_t> payload) const;
+  template <ObjectFormat F>
+  std::string write_stream_as(std::string_view type, std::uint64_t size, const Reader& read) const;
+
   std::filesystem::path gitdir_;
+  ObjectFormat format_;
+  mutable std::optional<std::vector<std::filesystem::path>> alternates_; // loaded on first miss
+  mutable std::optional<Settings> settings_;                              // loaded on first write
+  mutable std::shared_ptr<DictCache> dicts_ = std::make_shared<DictCache>();
+  mutable std::vector<std::shared_ptr<ObjectIndex>> indexes_; // this store's first; see load_index()
 };
 
+extern template oid ObjectStore::hash_loose<ObjectFormat::sha1>(std::span<const std::uint8_t>,
+                                                                const fs::ZstdDictFn&);
+extern template oid256 ObjectStore::hash_loose<ObjectFormat::sha256>(std::span<const std::uint8_t>,
+                                                                     const fs::ZstdDictFn&);
+extern template oid ObjectStore::hash_loose_file<ObjectFormat::sha1>(const std::filesystem::path&,
+                                                                     const fs::ZstdDictFn&);
+extern template oid256 ObjectStore::hash_loose_file<ObjectFormat::sha256>(
+    const std::filesystem::path&, const fs::ZstdDictFn&);
+
 } // namespace gitfly
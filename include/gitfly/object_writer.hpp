@@ -0,0 +1,49 @@
+#pragma once
+#include "gitfly/hash.hpp"
+#include "gitfly/object_store.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace gitfly {
+
+// Writes loose objects in the background: callers hand objects over and move on
+// while a small pool compresses and stores them. Nothing is synced per object;
+// flush() waits for the batch and makes all of it durable with one filesystem
+// sync, to be called before the ref update that publishes the objects.
+// Objects the store already holds are skipped. Bulk writers should call
+// load_index() on the store before making the writer: that check then stays off
+// the disk, and objects queued before are skipped too. Otherwise each write
+// looks for the object's file, which is cheaper for a handful of objects.
+// Everything but flush() may be called from several threads at once.
+class ObjectWriter {
+public:
+  // `threads` 0 picks a pool size from the core count.
+  explicit ObjectWriter(ObjectStore store, unsigned threads = 0);
+  // Waits for queued writes, but neither syncs them nor reports their errors;
+  // that is flush()'s job.
+  ~ObjectWriter();
+  ObjectWriter(const ObjectWriter&) = delete;
+  ObjectWriter& operator=(const ObjectWriter&) = delete;
+
+  // Queue an object; its hex id (in the store's format) is returned at once.
+  std::string write(std::string_view type, std::vector<std::uint8_t> payload);
+  // Same, for an object whose SHA-1 id the caller already computed.
+  void write_hashed(const oid& id, std::string_view type, std::vector<std::uint8_t> payload);
+  // Queue a loose-object image that is already compressed (e.g. received over
+  // the wire and verified) to be stored as `id`.
+  void write_loose(const oid& id, std::vector<std::uint8_t> compressed);
+
+  // Wait until everything queued is written, then sync it. Throws the first
+  // error any write hit.
+  void flush();
+
+private:
+  struct Impl;
+  std::unique_ptr<Impl> impl_;
+};
+
+} // namespace gitfly
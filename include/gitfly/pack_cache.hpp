@@ -0,0 +1,67 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace gitfly {
+
+class ObjectStore; // fwd
+
+// Server-side cache of the full-clone object stream. Objects are stored in
+// objects/pack/ as "packs" that already hold the wire framing
+// ("OBJ <hex> <size>\n" + loose-object bytes per record), so serving a clone is
+// a sequential read of a few files. Each pack has a text index ("<hex> <offset>"
+// per record) and objects/pack/clone-cache lists the packs in stream order
+// together with the HEAD tip they were built for.
+//
+// When the tip moves, only objects missing from the existing packs go into a
+// new incremental pack; after kMaxPacks layers, or once the increments outgrow
+// the base, everything is rewritten as one pack. Not thread-safe.
+class ClonePackCache {
+public:
+  static constexpr std::size_t kMaxPacks = 8;
+
+  explicit ClonePackCache(std::filesystem::path gitdir);
+
+  // A contiguous byte range of a pack file to send as-is.
+  struct Segment {
+    std::filesystem::path file;
+    std::uint64_t offset = 0;
+    std::uint64_t length = 0;
+  };
+
+  struct Stream {
+    std::size_t objects = 0;       // records covered by `segments`
+    std::size_t skipped = 0;       // leading records left out for a resume
+    std::vector<Segment> segments; // in stream order
+  };
+
+  // Bring the cache up to date for `tip` (packing any objects of `store` not yet
+  // cached) and describe the stream. If the record at position `skip - 1` is
+  // `skip_last`, the first `skip` records are left out; otherwise nothing is.
+  Stream prepare(const std::string &tip, const ObjectStore &store, std::size_t skip = 0,
+                 std::string_view skip_last = {});
+
+private:
+  struct Pack {
+    std::string name;
+    std::size_t objects = 0;
+    std::uint64_t bytes = 0;
+  };
+
+  std::filesystem::path dir() const;
+  std::filesystem::path manifest() const;
+  void load();
+  void save() const;
+  std::vector<std::pair<std::string, std::uint64_t>> read_index(const Pack &pack) const;
+  Pack write_pack(const ObjectStore &store, const std::vector<std::string> &hexes);
+
+  std::filesystem::path gitdir_;
+  std::string tip_;
+  std::vector<Pack> packs_;
+};
+
+} // namespace gitfly
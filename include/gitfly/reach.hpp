@@ -0,0 +1,66 @@
+#pragma once
+#include <cstddef>
+#include <optional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace gitfly {
+
+class Repository;  // fwd
+class BitmapIndex; // fwd
+
+namespace reach {
+
+// Collect the 40-hex ids of every object reachable from `tips` (commits, their
+// trees and blobs), in discovery order. Commits listed in `stop` are treated as
+// already present on the other side and are not entered; the repository's own
+// shallow commits are entered but their parents are not. In a partial clone
+// (promisor remote configured) missing blobs are skipped rather than an error.
+// Throws std::runtime_error naming the first object missing from the store.
+auto collect_objects(const Repository &repo, const std::vector<std::string> &tips,
+                     const std::set<std::string> &stop = {}) -> std::vector<std::string>;
+
+// Partial-clone blob filter: "blob:none" or "blob:limit=<bytes>[k|m|g]".
+// Blobs whose size is >= limit are left out (blob:none is limit 0).
+struct BlobFilter {
+  std::optional<std::size_t> limit; // nullopt = send every blob
+
+  [[nodiscard]] auto active() const -> bool { return limit.has_value(); }
+  // Throws std::runtime_error on an unknown spec; "" parses to an inactive filter.
+  static auto parse(std::string_view spec) -> BlobFilter;
+};
+
+struct TransferOptions {
+  std::size_t depth = 0; // generations from a tip to include (a tip is 1); 0 = all
+  BlobFilter filter;
+  std::set<std::string> have; // commits the receiver already has; not entered
+  // The receiver's own shallow commits: it has them but not their parents. When
+  // non-empty, what it has is walked down to them, so a deeper fetch sends the
+  // history below its boundary. Not meant to be listed in `have` as well.
+  std::set<std::string> shallow;
+  // With no depth, filter or receiver boundary: answer "wants minus haves" from
+  // reachability bitmaps, leaving out everything reachable from a have, not
+  // just the commits.
+  const BitmapIndex *bitmaps = nullptr;
+};
+
+struct TransferPlan {
+  std::vector<std::string> objects; // commits within depth + their trees/blobs
+  std::vector<std::string> shallow; // included commits whose parents were cut off
+};
+
+// Like collect_objects, but honours depth and blob-filter limits, walking commits
+// breadth-first so each is first reached at its smallest generation.
+auto plan_transfer(const Repository &repo, const std::vector<std::string> &tips,
+                   const TransferOptions &opts) -> TransferPlan;
+
+// Verify that every object reachable from `tip` exists, without descending into
+// commits listed in `stop` (e.g. the previous, already-complete ref value).
+void check_connected(const Repository &repo, const std::string &tip,
+                     const std::set<std::string> &stop = {});
+
+} // namespace reach
+
+} // namespace gitfly
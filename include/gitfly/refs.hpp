@@ -2,6 +2,8 @@
 #include <filesystem>
 #include <optional>
 #include <string>
+#include <string_view>
+#include <vector>
 
 namespace gitfly {
 
@@ -19,8 +21,45 @@ void set_HEAD_symbolic(const std::filesystem::path& repo_root, const std::string
 std::optional<std::string> read_ref(const std::filesystem::path& repo_root, const std::string& refname);
 
 // Overwrite/create a ref with the given 40-hex OID (adds trailing newline on disk).
+// Takes the ref's lock like update_refs, but does not check the old value.
 void update_ref(const std::filesystem::path& repo_root, const std::string& refname, const std::string& hex_oid);
 
+// A name update_refs accepts: under refs/, no "..", not a lock file.
+bool is_valid_ref_name(std::string_view name);
+
+// One compare-and-swap ref update. `old_oid`: nullopt = do not check, "" = the
+// ref must not exist, else its current value. `new_oid` "" deletes the ref.
+struct RefUpdate {
+  std::string name;
+  std::optional<std::string> old_oid;
+  std::string new_oid;
+};
+
+// Apply every update or none: lock each ref (creating "<ref>.lock" exclusively,
+// in name order), compare its current value with old_oid, then move the new
+// values into place. Throws std::runtime_error naming the first ref that is
+// already locked or whose value is stale; nothing is changed in that case.
+void update_refs(const std::filesystem::path& repo_root, const std::vector<RefUpdate>& updates);
+
 void set_HEAD_detached(const std::filesystem::path& repo_root, std::string_view hex_oid);
 
+struct RefEntry {
+  std::string name; // full name, e.g. "refs/heads/master"
+  std::string oid;  // 40-hex
+};
+
+// All refs whose full name starts with `prefix`, sorted by name. Lock files and
+// files that do not hold a 40-hex id (e.g. leftover temporaries) are skipped.
+std::vector<RefEntry> list_refs(const std::filesystem::path& repo_root,
+                                std::string_view prefix = "refs/");
+
+// Local name a fetched remote ref is stored under: refs/heads/<b> maps to
+// refs/remotes/<remote>/<b>, refs/tags/<t> to itself; anything else to nullopt.
+std::optional<std::string> tracking_ref(std::string_view remote_ref, std::string_view remote);
+
+// Store fetched remote refs under their tracking names. A local tag that
+// already points elsewhere is left alone. Returns the number of refs written.
+std::size_t update_tracking_refs(const std::filesystem::path& repo_root, std::string_view remote,
+                                 const std::vector<RefEntry>& remote_refs);
+
 } // namespace gitfly
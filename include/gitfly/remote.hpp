@@ -1,6 +1,10 @@
 #pragma once
+#include <cstddef>
+#include "gitfly/refs.hpp"
+
 #include <filesystem>
 #include <string>
+#include <vector>
 
 namespace gitfly::remote {
 
@@ -10,7 +14,21 @@ struct FetchResult {
 };
  
 // Clone a repository at `src` into directory `dst` (created if missing).
-void clone_repo(const std::filesystem::path& src, const std::filesystem::path& dst);
+// depth > 0 makes a shallow clone of HEAD's branch: only commits within `depth`
+// generations of the tip (plus their trees/blobs) are copied.
+// A non-empty `filter` ("blob:none", "blob:limit=<size>") makes a partial clone:
+// filtered blobs are left behind and `src` is recorded as the promisor remote.
+// `shared` copies no objects at all: `src`'s object directory becomes an
+// alternate of `dst` (src must then outlive the clone and never drop objects).
+// A non-empty `reference` names a local repository whose objects are used as an
+// alternate, so only objects it lacks are copied.
+void clone_repo(const std::filesystem::path& src, const std::filesystem::path& dst,
+                std::size_t depth = 0, const std::string& filter = {},
+                bool shared = false, const std::filesystem::path& reference = {});
+
+// Absolute .gitfly/objects directory of `reference` for use as an alternate.
+// Throws if `reference` is not a gitfly repository.
+std::filesystem::path reference_objects_dir(const std::filesystem::path& reference);
 
 // Push current branch from `local` repo into `remote` repo (fast-forward only).
 // Branch name must be provided; remote ref is `refs/heads/<branch>`.
@@ -18,10 +36,32 @@ void push_branch(const std::filesystem::path& local,
                  const std::filesystem::path& remote,
                  const std::string& branch);
 
+// Push local refs (full names) to the same names in `remote`, all or none.
+// Branches must fast-forward; the remote refs are compare-and-swapped against
+// the values read before the objects were copied.
+void push_refs(const std::filesystem::path& local,
+               const std::filesystem::path& remote,
+               const std::vector<std::string>& refnames);
+
 // Fetch remote HEAD (branch+tip) into local repo as refs/remotes/<name>/<branch>.
-// Returns the advertised branch name and tip.
+// Returns the advertised branch name and tip. depth > 0 limits the transferred
+// history and extends the local shallow boundary accordingly.
 FetchResult fetch_head(const std::filesystem::path& local,
                        const std::filesystem::path& remote,
-                       const std::string& name = "origin");
+                       const std::string& name = "origin",
+                       std::size_t depth = 0);
+
+// Fetch every head and tag under `prefix` (default: all) from `remote`. Heads
+// land in refs/remotes/<name>/*, tags in refs/tags/*. Returns the remote refs.
+std::vector<RefEntry> fetch_refs(const std::filesystem::path& local,
+                                 const std::filesystem::path& remote,
+                                 const std::string& name = "origin",
+                                 const std::string& prefix = {},
+                                 std::size_t depth = 0);
+
+// Copy specific objects (e.g. blobs a partial clone omitted) from `remote`.
+void fetch_objects(const std::filesystem::path& local,
+                   const std::filesystem::path& remote,
+                   const std::vector<std::string>& hexes);
 
 } // namespace gitfly::remote
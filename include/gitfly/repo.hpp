@@ -2,9 +2,11 @@
 #include "gitfly/config.hpp"
 #include "gitfly/consts.hpp"
 #include "gitfly/hash.hpp"
+#include "gitfly/object_store.hpp"
 
 #include <cstdint>
 #include <filesystem>
+#include <set>
 #include <span>
 #include <string>
 #include <string_view>
@@ -41,19 +43,36 @@ public:
     return git_dir() / consts::kHeadFile;
   }
   [[nodiscard]] auto config_file() const -> std::filesystem::path { return git_dir() / "config"; }
+  [[nodiscard]] auto shallow_file() const -> std::filesystem::path {
+    return git_dir() / consts::kShallowFile;
+  }
   
   // Milestone 1
   // Initialize a new repo structure under root_.
   // Fails if .gitfly already exists (to avoid clobber).
+  // `codec` is recorded in the config; the default (zlib) records nothing.
   void init(const Identity &identity = Identity{.name = "Your Name",
-                                                .email = "you@example.com"}) const;
+                                                .email = "you@example.com"},
+            fs::Codec codec = fs::Codec::zlib) const;
 
   // Convenience: does .gitfly exist?
   [[nodiscard]] auto is_initialized() const -> bool;
 
+  // Throws unless objects are also zlib-compressed: transfers copy loose
+  // object files as they are, so both sides must store them the way git does.
+  void require_portable_objects() const;
+
   // Object plumbing
   [[nodiscard]] auto write_blob(std::span<const std::uint8_t> bytes) const -> std::string;
+  // Same for a file's contents, streamed from disk rather than loaded whole.
+  [[nodiscard]] auto write_blob_file(const std::filesystem::path &file) const -> std::string;
+  // In a partial clone a blob missing locally is fetched from the promisor remote first.
   std::vector<std::uint8_t> read_blob(std::string_view hex_oid) const;
+  // Same, as a stream for copying a blob out without holding it whole.
+  ObjectStream open_blob(std::string_view hex_oid) const;
+  // Fetch, in one request, whichever of these blobs a partial clone is missing.
+  // No-op when no promisor remote is configured.
+  void prefetch_blobs(const std::vector<std::string> &hex_oids) const;
 
   [[nodiscard]] auto write_tree(const std::vector<TreeEntry> &entries) const -> std::string;
   std::vector<TreeEntry> read_tree(std::string_view hex_oid) const;
@@ -74,8 +93,17 @@ public:
   // Read and parse a commit object into headers + message.
   [[nodiscard]] auto read_commit(std::string_view commit_hex) const -> CommitInfo;
 
+  // Shallow boundary recorded by a depth-limited clone/fetch: commits whose parents
+  // were not transferred. History walks treat them as root commits.
+  [[nodiscard]] auto shallow_commits() const -> std::set<std::string>;
+  // Record the boundary of a transfer: `hexes` join the shallow commits, and
+  // every shallow commit is then kept only while one of its parents is actually
+  // missing locally. A deeper fetch thus moves the boundary down, and one that
+  // brings the rest of the history removes the shallow file.
+  void update_shallow_commits(const std::vector<std::string> &hexes) const;
+
   // Graph query: is `ancestor_hex` an ancestor of `descendant_hex`?
-  // Includes equality (a commit is an ancestor of itself).
+  // Includes equality (a commit is an ancestor of itself). Stops at shallow commits.
   [[nodiscard]] auto is_commit_ancestor(std::string_view ancestor_hex,
                                         std::string_view descendant_hex) const -> bool;
 
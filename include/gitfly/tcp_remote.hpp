@@ -1,21 +1,142 @@
 #pragma once
+#include "gitfly/refs.hpp"
+#include "gitfly/wire.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace gitfly::tcpremote {
 
 struct FetchResult { std::string branch; std::string tip; };
 
+// Snapshot of a transfer, handed to SessionOptions::progress. Phases are
+// "connect", "negotiate", "objects", "checkout" (clone only) and finally "done".
+struct TransferStats {
+  std::string phase;                 // phase in progress
+  std::size_t objects = 0;           // objects sent/received so far
+  std::size_t objects_total = 0;     // announced count, 0 until known
+  wire::Counters bytes;              // socket vs. protocol byte counts
+  double elapsed = 0;                // seconds since the session started
+  std::vector<std::pair<std::string, double>> phases; // finished phases, seconds
+
+  // Socket throughput in bytes per second, both directions.
+  double rate() const {
+    return elapsed > 0 ? static_cast<double>(bytes.wire_in + bytes.wire_out) / elapsed : 0;
+  }
+};
+
+using ProgressFn = std::function<void(const TransferStats&)>;
+
+struct SessionOptions {
+  bool compress = false; // ask the server for a zlib-compressed stream
+  ProgressFn progress{}; // called on phase changes and periodically while objects flow
+  std::string repo;      // repository below a multi-repo server's root; "" = the root
+};
+
+// "tcp://<host>[:<port>][/<repo path>]"
+struct Endpoint {
+  std::string host;
+  int port = 0;
+  std::string repo; // without the leading '/'
+};
+
+// Throws std::runtime_error unless `url` starts with "tcp://".
+Endpoint parse_url(std::string_view url);
+
 // Client-side helpers for talking to `gitfly serve` over TCP.
 void push_branch(const std::string& host, int port,
                  const std::string& repo_root,
-                 const std::string& branch);
+                 const std::string& branch,
+                 const SessionOptions& session = {});
 
+// Push local refs (full names, e.g. "refs/heads/main") to the same names on the
+// server, all or none. Each update carries the advertised old value, so the
+// server rejects it, before any upload, if another push got there first.
+// Branches must fast-forward.
+void push_refs(const std::string& host, int port,
+               const std::string& repo_root,
+               const std::vector<std::string>& refnames,
+               const SessionOptions& session = {});
+
+// depth > 0 requests a shallow clone and a non-empty filter a partial clone
+// (see remote::clone_repo); the server is then recorded as promisor remote.
+// A non-empty `reference` local repository becomes an alternate; received
+// objects it already holds are not stored again.
 void clone_repo(const std::string& host, int port,
-                const std::string& dest_root);
+                const std::string& dest_root,
+                std::size_t depth = 0,
+                const std::string& filter = {},
+                const SessionOptions& session = {},
+                const std::string& reference = {});
 
 // Fetch remote HEAD into local repo as refs/remotes/<name>/<branch>.
 FetchResult fetch_head(const std::string& host, int port,
                        const std::string& local_root,
-                       const std::string& name = "origin");
+                       const std::string& name = "origin",
+                       std::size_t depth = 0,
+                       const SessionOptions& session = {});
+
+// List the server's refs, optionally only those under `prefix`.
+std::vector<RefEntry> ls_refs(const std::string& host, int port,
+                              const std::string& prefix = {},
+                              const SessionOptions& session = {});
+
+// Fetch every head and tag under `prefix` (default: all) over one connection
+// with a single object transfer, negotiated against the local ref tips.
+// Heads land in refs/remotes/<name>/*, tags in refs/tags/*. Returns the
+// advertised refs.
+std::vector<RefEntry> fetch_refs(const std::string& host, int port,
+                                 const std::string& local_root,
+                                 const std::string& name = "origin",
+                                 const std::string& prefix = {},
+                                 std::size_t depth = 0,
+                                 const SessionOptions& session = {});
+
+// Download specific objects (e.g. blobs a partial clone omitted) in one request.
+void fetch_objects(const std::string& host, int port,
+                   const std::string& local_root,
+                   const std::vector<std::string>& hexes,
+                   const SessionOptions& session = {});
+
+// One connection carrying several requests. Each call only queues its request
+// and returns its id; requests go out together on the next wait() and the
+// server answers them in order, so a batch costs one round trip instead of one
+// connection each. Response handlers run inside wait(), in request order, or
+// inside a later call once the requests the server has yet to read grow large
+// enough that it could stop reading them. Needs a server that accepts the
+// "multi" capability.
+class Client {
+public:
+  using RefsFn = std::function<void(std::vector<RefEntry>)>;
+
+  Client(const std::string& host, int port, const SessionOptions& session = {});
+  ~Client(); // waits for outstanding requests, then ends the session
+  Client(const Client&) = delete;
+  Client& operator=(const Client&) = delete;
+
+  std::uint64_t ls_refs(const std::string& prefix, RefsFn on_refs);
+  // As tcpremote::fetch_refs; `on_refs` gets the advertised refs.
+  std::uint64_t fetch_refs(const std::string& local_root, const std::string& name = "origin",
+                           const std::string& prefix = {}, std::size_t depth = 0,
+                           RefsFn on_refs = {});
+  std::uint64_t fetch_objects(const std::string& local_root,
+                              const std::vector<std::string>& hexes);
+
+  // Read responses up to and including request `id` (default: all).
+  void wait(std::uint64_t id = std::numeric_limits<std::uint64_t>::max());
+
+  // Interactive, so it drains the queue first and returns when done.
+  void push_refs(const std::string& repo_root, const std::vector<std::string>& refnames);
+
+private:
+  struct Impl;
+  std::unique_ptr<Impl> impl_;
+};
 
 } // namespace gitfly::tcpremote
@@ -1,4 +1,7 @@
 #pragma once
+#include "gitfly/hash.hpp"
+
+#include <filesystem>
 #include <string>
 #include <string_view>
 #include <span>
@@ -7,10 +10,14 @@ namespace gitfly {
 
 // Validate 40-char lowercase/uppercase hex
 auto looks_hex40(std::string_view str) -> bool;
+// Same for an object id of `format` (40 or 64 hex chars)
+auto looks_hex_oid(std::string_view str, ObjectFormat format) -> bool;
 
 // Compute the Git blob object id for raw bytes without writing to the object store.
 // Hashes header "blob <size>\0" + data and returns 40-hex.
 auto compute_blob_hex_oid(std::span<const std::uint8_t> bytes) -> std::string;
+// Same for a file's contents, hashed in chunks as they are read.
+auto compute_file_blob_hex_oid(const std::filesystem::path& file) -> std::string;
 
 // String helpers
 namespace strutil {
@@ -0,0 +1,110 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace gitfly::wire {
+
+// Capability names exchanged in the HELLO line.
+inline constexpr std::string_view kCapZlib = "zlib"; // deflate the whole stream
+inline constexpr std::string_view kCapMulti = "multi"; // many tagged requests per connection
+
+// Byte counters for one connection. `wire_*` is what crossed the socket,
+// `payload_*` what the protocol wrote/read before stream compression.
+struct Counters {
+  std::uint64_t wire_in = 0;
+  std::uint64_t wire_out = 0;
+  std::uint64_t payload_in = 0;
+  std::uint64_t payload_out = 0;
+};
+
+// Hard caps on what a peer can make this side buffer or accept; exceeding one
+// throws std::runtime_error and ends the connection. Object payloads are already
+// length-prefixed by their "OBJ <hex> <size>" header, so these bound the prefix
+// values themselves rather than adding another layer of framing.
+struct Limits {
+  std::size_t max_line = 64 * 1024;                   // one protocol line, newline included
+  std::uint64_t max_object = std::uint64_t{4} << 30;  // loose bytes of one object
+  std::uint64_t max_objects = std::uint64_t{1} << 28; // count announced by one NOBJ
+  std::uint64_t max_session = 0;                      // payload bytes read in total; 0 = no cap
+};
+
+// Received objects larger than this are spooled to disk as they arrive rather
+// than held in memory, by `gitfly serve` and the tcpremote client alike, so a
+// connection's footprint does not grow with Limits::max_object.
+inline constexpr std::uint64_t kSpoolObjectBytes = std::uint64_t{8} << 20;
+
+// Buffered, optionally deflate-compressed line/byte stream over a socket shared
+// by `gitfly serve` and the tcpremote client. Writes are buffered until flush()
+// or the next read, so a request/response exchange costs one send per side.
+// Does not own the descriptor.
+class Conn {
+public:
+  explicit Conn(int fd);
+  ~Conn();
+  Conn(const Conn &) = delete;
+  Conn &operator=(const Conn &) = delete;
+
+  void write(const void *buf, std::size_t n);
+  void write_line(std::string_view s);
+  void flush();
+
+  // Throws std::runtime_error if the peer closes before enough bytes arrive.
+  void read_exact(void *dst, std::size_t n);
+  // Throws once a line exceeds limits().max_line without a newline.
+  std::string read_line();
+  // Read an n-byte payload into `out`, growing it as the bytes actually arrive,
+  // so a bogus size costs no more memory than the peer really sends.
+  void read_payload(std::vector<std::uint8_t> &out, std::size_t n);
+
+  // Send "OBJ <hex> <size>" and the contents of the loose object `file`,
+  // streamed in chunks rather than read into memory first.
+  void write_object(std::string_view hex, const std::filesystem::path &file);
+
+  void set_limits(const Limits &limits) { limits_ = limits; }
+  const Limits &limits() const { return limits_; }
+
+  // Switch both directions to a zlib stream. Pending output is flushed first;
+  // bytes already read ahead are treated as compressed input.
+  void enable_compression();
+  bool compressed() const { return z_ != nullptr; }
+
+  const Counters &counters() const { return counters_; }
+
+private:
+  struct Zlib;
+
+  void send_raw(const std::uint8_t *p, std::size_t n);
+  void drain_out(bool sync);
+  bool fill(); // append more plaintext to in_; false on EOF
+  void charge_in(std::size_t n); // count payload read, enforcing max_session
+
+  int fd_;
+  std::vector<std::uint8_t> out_;
+  std::vector<std::uint8_t> in_;
+  std::size_t in_pos_ = 0;
+  std::unique_ptr<Zlib> z_;
+  Counters counters_;
+  Limits limits_;
+};
+
+// "HELLO 1" plus any capabilities, e.g. "HELLO 1 zlib".
+std::string hello_line(const std::vector<std::string_view> &caps);
+// Capabilities listed on a HELLO line.
+std::vector<std::string> parse_hello(std::string_view line);
+
+// "NOBJ <n>" -> n. Throws on a malformed line or n > limits.max_objects.
+std::uint64_t parse_nobj(std::string_view line, const Limits &limits);
+
+struct ObjHeader {
+  std::string hex;
+  std::size_t size = 0;
+};
+// "OBJ <40-hex> <size>". Throws on a malformed line or size > limits.max_object.
+ObjHeader parse_obj(std::string_view line, const Limits &limits);
+
+} // namespace gitfly::wire
@@ -0,0 +1,532 @@
+#include "gitfly/bitmap.hpp"
+
+#include "gitfly/config.hpp"
+#include "gitfly/consts.hpp"
+#include "gitfly/fs.hpp"
+#include "gitfly/hash.hpp"
+#include "gitfly/refs.hpp"
+#include "gitfly/repo.hpp"
+#include "gitfly/util.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <limits>
+#include <set>
+#include <stdexcept>
+
+namespace stdfs = std::filesystem;
+
+namespace gitfly {
+
+namespace {
+
+// Marker word: bit 0 = running bit, bits 1..32 = clean-word run length,
+// bits 33..63 = number of literal words that follow.
+constexpr std::uint64_t kMaxRun = (std::uint64_t{1} << 32U) - 1;
+constexpr std::uint64_t kMaxLiterals = (std::uint64_t{1} << 31U) - 1;
+constexpr std::uint64_t kOnes = ~std::uint64_t{0};
+
+constexpr bool rlw_bit(std::uint64_t w) { return (w & 1U) != 0; }
+constexpr std::uint64_t rlw_run(std::uint64_t w) { return (w >> 1U) & kMaxRun; }
+constexpr std::uint64_t rlw_literals(std::uint64_t w) { return w >> 33U; }
+constexpr std::uint64_t make_rlw(bool bit, std::uint64_t run, std::uint64_t literals) {
+  return (bit ? 1U : 0U) | (run << 1U) | (literals << 33U);
+}
+
+// Reads a compressed bitmap one uncompressed word (or one clean run) at a time.
+// Past the end it behaves as an endless run of zero words.
+class Cursor {
+public:
+  explicit Cursor(const std::vector<std::uint64_t> &words) : w_(words) { settle(); }
+
+  [[nodiscard]] bool end() const { return run_ == 0 && literals_ == 0; }
+  // Clean words left in the current run (0 while on literals).
+  [[nodiscard]] std::uint64_t run() const {
+    return end() ? std::numeric_limits<std::uint64_t>::max() : run_;
+  }
+  [[nodiscard]] std::uint64_t fill() const { return run_bit_ ? kOnes : 0; }
+
+  void skip(std::uint64_t n) {
+    if (end())
+      return;
+    run_ -= n;
+    settle();
+  }
+
+  std::uint64_t next() {
+    if (end())
+      return 0;
+    std::uint64_t v = 0;
+    if (run_ != 0) {
+      v = fill();
+      --run_;
+    } else {
+      v = w_[pos_++];
+      --literals_;
+    }
+    settle();
+    return v;
+  }
+
+private:
+  void settle() {
+    while (run_ == 0 && literals_ == 0 && pos_ < w_.size()) {
+      const auto m = w_[pos_++];
+      run_bit_ = rlw_bit(m);
+      run_ = rlw_run(m);
+      literals_ = rlw_literals(m);
+      if (literals_ > w_.size() - pos_)
+        throw std::runtime_error("corrupt EWAH bitmap");
+    }
+    if (end())
+      run_bit_ = false;
+  }
+
+  const std::vector<std::uint64_t> &w_;
+  std::size_t pos_ = 0;
+  std::uint64_t run_ = 0;
+  std::uint64_t literals_ = 0;
+  bool run_bit_ = false;
+};
+
+// Calls run(first_word, count, bit) for clean runs and lit(word_index, word) for
+// literal words, in order.
+template <class Run, class Lit>
+void scan(const std::vector<std::uint64_t> &w, Run &&run, Lit &&lit) {
+  std::size_t idx = 0;
+  for (std::size_t p = 0; p < w.size();) {
+    const auto m = w[p++];
+    if (rlw_run(m) != 0)
+      run(idx, rlw_run(m), rlw_bit(m));
+    idx += rlw_run(m);
+    for (std::uint64_t i = 0; i < rlw_literals(m); ++i)
+      lit(idx++, w[p++]);
+  }
+}
+
+void put_u32(std::string &out, std::uint32_t v) {
+  for (int i = 0; i < 4; ++i)
+    out.push_back(static_cast<char>((v >> (8 * i)) & 0xffU));
+}
+
+void put_u64(std::string &out, std::uint64_t v) {
+  for (int i = 0; i < 8; ++i)
+    out.push_back(static_cast<char>((v >> (8 * i)) & 0xffU));
+}
+
+std::uint64_t get_le(std::string_view in, std::size_t &pos, int bytes) {
+  if (pos > in.size() || in.size() - pos < static_cast<std::size_t>(bytes))
+    throw std::runtime_error("truncated bitmap data");
+  std::uint64_t v = 0;
+  for (int i = 0; i < bytes; ++i)
+    v |= std::uint64_t{static_cast<unsigned char>(in[pos + i])} << (8 * i);
+  pos += static_cast<std::size_t>(bytes);
+  return v;
+}
+
+} // namespace
+
+// Appends words, merging clean words into runs.
+class EwahBuilder {
+public:
+  void add_clean(bool bit, std::uint64_t n) {
+    auto &w = out_.words_;
+    while (n != 0) {
+      if (rlw_ == kNone || rlw_literals(w[rlw_]) != 0 || rlw_run(w[rlw_]) == kMaxRun ||
+          (rlw_run(w[rlw_]) != 0 && rlw_bit(w[rlw_]) != bit)) {
+        w.push_back(make_rlw(bit, 0, 0));
+        rlw_ = w.size() - 1;
+      }
+      const auto have = rlw_run(w[rlw_]);
+      const auto take = std::min(n, kMaxRun - have);
+      w[rlw_] = make_rlw(bit, have + take, 0);
+      n -= take;
+    }
+  }
+
+  void add_word(std::uint64_t v) {
+    if (v == 0 || v == kOnes) {
+      add_clean(v != 0, 1);
+      return;
+    }
+    auto &w = out_.words_;
+    if (rlw_ == kNone || rlw_literals(w[rlw_]) == kMaxLiterals) {
+      w.push_back(make_rlw(false, 0, 0));
+      rlw_ = w.size() - 1;
+    }
+    const auto m = w[rlw_];
+    w[rlw_] = make_rlw(rlw_bit(m), rlw_run(m), rlw_literals(m) + 1);
+    w.push_back(v);
+  }
+
+  // Trailing zero words carry no information; drop them so equal sets compare equal.
+  EwahBitmap finish() {
+    auto &w = out_.words_;
+    if (rlw_ != kNone && rlw_literals(w[rlw_]) == 0 && !rlw_bit(w[rlw_]))
+      w.pop_back();
+    return std::move(out_);
+  }
+
+private:
+  static constexpr std::size_t kNone = static_cast<std::size_t>(-1);
+  EwahBitmap out_;
+  std::size_t rlw_ = kNone;
+};
+
+namespace {
+
+// Word-wise f(a, b) over two compressed bitmaps; f must map clean words to clean
+// words. With `a_bounds`, stop once `a` is exhausted (f(0, x) == 0).
+template <class F>
+EwahBitmap combine(const std::vector<std::uint64_t> &a, const std::vector<std::uint64_t> &b,
+                   bool a_bounds, F f) {
+  Cursor ca(a), cb(b);
+  EwahBuilder out;
+  while (!(ca.end() && (cb.end() || a_bounds))) {
+    const auto ra = ca.run(), rb = cb.run();
+    if (ra != 0 && rb != 0) {
+      const auto n = std::min(ra, rb);
+      out.add_clean(f(ca.fill(), cb.fill()) != 0, n);
+      ca.skip(n);
+      cb.skip(n);
+    } else {
+      const auto wa = ca.next();
+      out.add_word(f(wa, cb.next()));
+    }
+  }
+  return out.finish();
+}
+
+} // namespace
+
+EwahBitmap EwahBitmap::from_words(const std::vector<std::uint64_t> &plain) {
+  EwahBuilder out;
+  for (const auto w : plain)
+    out.add_word(w);
+  return out.finish();
+}
+
+EwahBitmap EwahBitmap::operator|(const EwahBitmap &other) const {
+  return combine(words_, other.words_, false,
+                 [](std::uint64_t a, std::uint64_t b) { return a | b; });
+}
+
+EwahBitmap EwahBitmap::and_not(const EwahBitmap &other) const {
+  return combine(words_, other.words_, true,
+                 [](std::uint64_t a, std::uint64_t b) { return a & ~b; });
+}
+
+void EwahBitmap::or_into(std::vector<std::uint64_t> &plain) const {
+  auto grow = [&](std::size_t n) {
+    if (plain.size() < n)
+      plain.resize(n, 0);
+  };
+  scan(
+      words_,
+      [&](std::size_t first, std::uint64_t n, bool bit) {
+        if (!bit)
+          return;
+        grow(first + n);
+        std::fill_n(plain.begin() + static_cast<std::ptrdiff_t>(first), n, kOnes);
+      },
+      [&](std::size_t idx, std::uint64_t w) {
+        grow(idx + 1);
+        plain[idx] |= w;
+      });
+}
+
+void EwahBitmap::for_each(const std::function<void(std::size_t)> &fn) const {
+  scan(
+      words_,
+      [&](std::size_t first, std::uint64_t n, bool bit) {
+        if (!bit)
+          return;
+        for (std::size_t i = first * 64; i < (first + n) * 64; ++i)
+          fn(i);
+      },
+      [&](std::size_t idx, std::uint64_t w) {
+        for (; w != 0; w &= w - 1)
+          fn(idx * 64 + static_cast<std::size_t>(std::countr_zero(w)));
+      });
+}
+
+std::size_t EwahBitmap::count() const {
+  std::size_t n = 0;
+  scan(
+      words_, [&](std::size_t, std::uint64_t len, bool bit) { n += bit ? len * 64 : 0; },
+      [&](std::size_t, std::uint64_t w) { n += static_cast<std::size_t>(std::popcount(w)); });
+  return n;
+}
+
+void EwahBitmap::serialize(std::string &out) const {
+  put_u32(out, static_cast<std::uint32_t>(words_.size()));
+  for (const auto w : words_)
+    put_u64(out, w);
+}
+
+EwahBitmap EwahBitmap::parse(std::string_view in, std::size_t &pos) {
+  const auto n = get_le(in, pos, 4);
+  if (n > (in.size() - pos) / 8)
+    throw std::runtime_error("truncated bitmap data");
+  EwahBitmap out;
+  out.words_.reserve(n);
+  for (std::uint64_t i = 0; i < n; ++i)
+    out.words_.push_back(get_le(in, pos, 8));
+  (void)Cursor(out.words_); // validates the first marker; walks validate the rest
+  return out;
+}
+
+// Computes closures as uncompressed bitsets, cutting the walk short at commits
+// with a stored bitmap. Objects outside the table get positions past its end.
+class BitmapIndex::Walker {
+public:
+  Walker(const BitmapIndex &idx, const Repository &repo) : idx_(idx), repo_(repo) {}
+
+  std::vector<std::uint64_t> reach(const std::vector<std::string> &commits) {
+    std::vector<std::uint64_t> bits;
+    std::vector<std::string> stack(commits.rbegin(), commits.rend());
+    while (!stack.empty()) {
+      const auto cur = std::move(stack.back());
+      stack.pop_back();
+      const auto pos = position(cur);
+      if (test(bits, pos))
+        continue;
+      if (const auto it = idx_.bitmaps_.find(cur); it != idx_.bitmaps_.end()) {
+        it->second.or_into(bits);
+        continue;
+      }
+      set(bits, pos);
+      const auto info = repo_.read_commit(cur);
+      walk_tree(bits, info.tree_hex);
+      for (auto it = info.parents.rbegin(); it != info.parents.rend(); ++it)
+        stack.push_back(*it);
+    }
+    return bits;
+  }
+
+  [[nodiscard]] const std::string &name(std::size_t pos) const {
+    return pos < idx_.table_.size() ? idx_.table_[pos] : extra_[pos - idx_.table_.size()];
+  }
+
+private:
+  std::size_t position(const std::string &hex) {
+    if (const auto it = idx_.position_.find(hex); it != idx_.position_.end())
+      return it->second;
+    const auto [it, fresh] = extra_pos_.emplace(hex, idx_.table_.size() + extra_.size());
+    if (fresh)
+      extra_.push_back(hex);
+    return it->second;
+  }
+
+  static bool test(const std::vector<std::uint64_t> &bits, std::size_t pos) {
+    return pos / 64 < bits.size() && ((bits[pos / 64] >> (pos % 64)) & 1U) != 0;
+  }
+
+  static void set(std::vector<std::uint64_t> &bits, std::size_t pos) {
+    if (bits.size() <= pos / 64)
+      bits.resize(pos / 64 + 1, 0);
+    bits[pos / 64] |= std::uint64_t{1} << (pos % 64);
+  }
+
+  void walk_tree(std::vector<std::uint64_t> &bits, const std::string &tree_hex) {
+    const auto pos = position(tree_hex);
+    if (test(bits, pos))
+      return;
+    set(bits, pos);
+    for (const auto &e : repo_.read_tree(tree_hex)) {
+      const auto hex = to_hex(e.id);
+      if (e.mode == consts::kModeTree)
+        walk_tree(bits, hex);
+      else
+        set(bits, position(hex));
+    }
+  }
+
+  const BitmapIndex &idx_;
+  const Repository &repo_;
+  std::unordered_map<std::string, std::size_t> extra_pos_;
+  std::vector<std::string> extra_;
+};
+
+namespace {
+
+constexpr std::string_view kMagic = "GFBM";
+constexpr std::uint32_t kVersion = 1;
+
+stdfs::path bitmap_path(const stdfs::path &gitdir) {
+  return gitdir / consts::kObjectsDir / consts::kPackDir / consts::kBitmapFile;
+}
+
+void put_oid(std::string &out, const std::string &hex) {
+  oid id{};
+  if (!from_hex(hex, id))
+    throw std::runtime_error("bad object id " + hex);
+  out.append(reinterpret_cast<const char *>(id.data()), id.size());
+}
+
+std::string get_oid(std::string_view in, std::size_t &pos) {
+  if (in.size() - pos < consts::kOidRawLen)
+    throw std::runtime_error("truncated bitmap data");
+  oid id{};
+  std::memcpy(id.data(), in.data() + pos, id.size());
+  pos += id.size();
+  return to_hex(id);
+}
+
+// Every ref tip plus a detached HEAD.
+std::vector<std::string> ref_tips(const Repository &repo) {
+  std::vector<std::string> tips;
+  for (const auto &r : list_refs(repo.root()))
+    tips.push_back(r.oid);
+  if (auto head = read_HEAD(repo.root())) {
+    while (!head->empty() && (head->back() == '\n' || head->back() == '\r'))
+      head->pop_back();
+    if (looks_hex40(*head))
+      tips.push_back(*head);
+  }
+  return tips;
+}
+
+} // namespace
+
+std::optional<BitmapIndex> BitmapIndex::load(const stdfs::path &gitdir) {
+  const auto file = bitmap_path(gitdir);
+  if (!fs::exists(file))
+    return std::nullopt;
+  const auto bytes = fs::read_file(file);
+  const std::string_view in(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+  if (in.size() < kMagic.size() + consts::kOidRawLen || !in.starts_with(kMagic))
+    throw std::runtime_error("not a bitmap index: " + file.string());
+  const auto body = in.substr(0, in.size() - consts::kOidRawLen);
+  const auto sum = sha1(body);
+  if (std::memcmp(sum.data(), in.data() + body.size(), sum.size()) != 0)
+    throw std::runtime_error("bitmap index checksum mismatch: " + file.string());
+
+  std::size_t pos = kMagic.size();
+  if (get_le(body, pos, 4) != kVersion)
+    throw std::runtime_error("unsupported bitmap index version: " + file.string());
+  BitmapIndex idx;
+  const auto objects = get_le(body, pos, 4);
+  idx.table_.reserve(objects);
+  for (std::uint64_t i = 0; i < objects; ++i) {
+    auto hex = get_oid(body, pos);
+    idx.position_.emplace(hex, i);
+    idx.table_.push_back(std::move(hex));
+  }
+  const auto commits = get_le(body, pos, 4);
+  for (std::uint64_t i = 0; i < commits; ++i) {
+    auto hex = get_oid(body, pos);
+    idx.bitmaps_.emplace(std::move(hex), EwahBitmap::parse(body, pos));
+  }
+  if (pos != body.size())
+    throw std::runtime_error("trailing data in bitmap index: " + file.string());
+  return idx;
+}
+
+void BitmapIndex::save(const stdfs::path &gitdir) const {
+  std::string out(kMagic);
+  put_u32(out, kVersion);
+  put_u32(out, static_cast<std::uint32_t>(table_.size()));
+  for (const auto &hex : table_)
+    put_oid(out, hex);
+  put_u32(out, static_cast<std::uint32_t>(bitmaps_.size()));
+  for (const auto &[hex, bm] : bitmaps_) {
+    put_oid(out, hex);
+    bm.serialize(out);
+  }
+  const auto sum = sha1(out);
+  out.append(reinterpret_cast<const char *>(sum.data()), sum.size());
+  const auto file = bitmap_path(gitdir);
+  stdfs::create_directories(file.parent_path());
+  fs::write_file_atomic(file, std::span<const std::uint8_t>(
+                                  reinterpret_cast<const std::uint8_t *>(out.data()), out.size()));
+}
+
+void BitmapIndex::extend(const Repository &repo) {
+  const auto tips = ref_tips(repo);
+  const std::set<std::string> tip_set(tips.begin(), tips.end());
+
+  // Commits outside the table, parents before children. Everything reachable
+  // from a commit in the table is in the table too, so the walk stops there.
+  std::vector<std::string> order;
+  std::set<std::string> visited;
+  std::vector<std::pair<std::string, bool>> stack;
+  for (const auto &t : tips)
+    stack.emplace_back(t, false);
+  while (!stack.empty()) {
+    auto [cur, expanded] = std::move(stack.back());
+    stack.pop_back();
+    if (expanded) {
+      order.push_back(std::move(cur));
+      continue;
+    }
+    if (covers(cur) || !visited.insert(cur).second)
+      continue;
+    const auto parents = repo.read_commit(cur).parents;
+    stack.emplace_back(cur, true);
+    for (auto it = parents.rbegin(); it != parents.rend(); ++it)
+      if (!covers(*it) && !visited.contains(*it))
+        stack.emplace_back(*it, false);
+  }
+
+  auto add = [&](const std::string &hex) {
+    if (position_.emplace(hex, table_.size()).second) {
+      table_.push_back(hex);
+      return true;
+    }
+    return false;
+  };
+  std::function<void(const std::string &)> add_tree = [&](const std::string &tree_hex) {
+    if (!add(tree_hex))
+      return; // already in the table, with everything below it
+    for (const auto &e : repo.read_tree(tree_hex)) {
+      const auto hex = to_hex(e.id);
+      if (e.mode == consts::kModeTree)
+        add_tree(hex);
+      else
+        add(hex);
+    }
+  };
+  for (const auto &c : order) {
+    add(c);
+    add_tree(repo.read_commit(c).tree_hex);
+  }
+
+  // Oldest first, so each new bitmap can reuse the ones below it.
+  Walker walker(*this, repo);
+  for (std::size_t i = 0; i < order.size(); ++i) {
+    if ((i + 1) % kStride == 0 || tip_set.contains(order[i]))
+      bitmaps_.emplace(order[i], EwahBitmap::from_words(walker.reach({order[i]})));
+  }
+}
+
+std::optional<BitmapIndex> BitmapIndex::refresh(const Repository &repo,
+                                                const std::vector<std::string> &tips) {
+  if (!repo.shallow_commits().empty() || config_get(repo.root(), consts::kCfgPromisor))
+    return std::nullopt;
+  BitmapIndex idx;
+  try {
+    idx = load(repo.git_dir()).value_or(BitmapIndex{});
+  } catch (const std::runtime_error &) {
+    idx = BitmapIndex{}; // a damaged index is only a cache: rebuild it
+  }
+  if (std::ranges::all_of(tips, [&](const std::string &t) { return idx.covers(t); }))
+    return idx;
+  idx.extend(repo);
+  idx.save(repo.git_dir());
+  return idx;
+}
+
+std::vector<std::string> BitmapIndex::missing(const Repository &repo,
+                                              const std::vector<std::string> &wants,
+                                              const std::vector<std::string> &haves) const {
+  Walker walker(*this, repo);
+  const auto want = EwahBitmap::from_words(walker.reach(wants));
+  const auto have = EwahBitmap::from_words(walker.reach(haves));
+  std::vector<std::string> out;
+  want.and_not(have).for_each([&](std::size_t pos) { out.push_back(walker.name(pos)); });
+  return out;
+}
+
+} // namespace gitfly
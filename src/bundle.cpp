@@ -0,0 +1,317 @@
+#include "gitfly/bundle.hpp"
+
+#include "gitfly/config.hpp"
+#include "gitfly/consts.hpp"
+#include "gitfly/fs.hpp"
+#include "gitfly/hash.hpp"
+#include "gitfly/object_store.hpp"
+#include "gitfly/object_writer.hpp"
+#include "gitfly/reach.hpp"
+#include "gitfly/repo.hpp"
+#include "gitfly/util.hpp"
+#include "gitfly/wire.hpp"
+#include "gitfly/worktree.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <set>
+#include <stdexcept>
+
+namespace stdfs = std::filesystem;
+
+namespace gitfly::bundle {
+
+namespace {
+
+constexpr std::string_view kSignature = "# gitfly bundle v1";
+constexpr std::string_view kHeadPrefix = "head ";
+constexpr std::string_view kPrereqPrefix = "prereq ";
+
+// "HEAD", a full ref name, or a branch/tag name -> (full name, hex).
+RefEntry resolve_ref(const stdfs::path &root, const std::string &name) {
+  if (name == consts::kHeadFile) {
+    const auto head = read_HEAD(root);
+    std::string s = head.value_or("");
+    strutil::rstrip_newlines(s);
+    if (s.starts_with(consts::kRefPrefix)) {
+      return resolve_ref(root, s.substr(consts::kRefPrefix.size()));
+    }
+    if (!looks_hex40(s)) {
+      throw std::runtime_error("HEAD does not point at a commit");
+    }
+    return RefEntry{.name = std::string(consts::kHeadFile), .oid = s};
+  }
+  std::vector<std::string> candidates{name};
+  if (!name.starts_with("refs/")) {
+    candidates = {heads_ref(name), "refs/tags/" + name};
+  }
+  for (const auto &full : candidates) {
+    if (auto tip = read_ref(root, full)) {
+      return RefEntry{.name = full, .oid = *tip};
+    }
+  }
+  throw std::runtime_error("no such ref: " + name);
+}
+
+// Parses the header, leaving `in` at the object part.
+Header parse_header(std::istream &in, const stdfs::path &file) {
+  std::string line;
+  if (!std::getline(in, line) || line != kSignature) {
+    throw std::runtime_error("not a gitfly bundle: " + file.string());
+  }
+  Header h;
+  while (std::getline(in, line) && !line.empty()) {
+    if (line.starts_with(kHeadPrefix)) {
+      h.head = line.substr(kHeadPrefix.size());
+    } else if (line.starts_with(kPrereqPrefix)) {
+      h.prerequisites.push_back(line.substr(kPrereqPrefix.size()));
+    } else {
+      const auto sp = line.find(' ');
+      RefEntry ref{.name = line.substr(sp + 1), .oid = line.substr(0, sp)};
+      if (sp == std::string::npos || !looks_hex40(ref.oid) || !is_valid_ref_name(ref.name)) {
+        throw std::runtime_error("corrupt bundle header line: " + line);
+      }
+      h.refs.push_back(std::move(ref));
+    }
+  }
+  if (!in) {
+    throw std::runtime_error("truncated bundle: " + file.string());
+  }
+  return h;
+}
+
+} // namespace
+
+std::size_t create(const stdfs::path &repo_root, const stdfs::path &file,
+                   const std::vector<std::string> &refnames,
+                   const std::vector<std::string> &exclude) {
+  const Repository repo{repo_root};
+  if (!repo.is_initialized()) {
+    throw std::runtime_error("not a gitfly repository: " + repo_root.string());
+  }
+  repo.require_portable_objects();
+  // Their closures are incomplete, so a reader could not check the result.
+  if (!repo.shallow_commits().empty() || config_get(repo_root, consts::kCfgPromisor)) {
+    throw std::runtime_error("cannot bundle a shallow or partial repository");
+  }
+
+  Header h;
+  std::vector<std::string> tips;
+  const bool all = refnames.empty();
+  if (all) {
+    h.refs = list_refs(repo_root, "refs/heads/");
+    const auto tags = list_refs(repo_root, "refs/tags/");
+    h.refs.insert(h.refs.end(), tags.begin(), tags.end());
+  }
+  for (const auto &name : refnames) {
+    auto ref = resolve_ref(repo_root, name);
+    if (ref.name == consts::kHeadFile) {
+      tips.push_back(ref.oid); // detached HEAD: recorded in the "head" line only
+    } else {
+      h.refs.push_back(std::move(ref));
+    }
+  }
+  if (auto head = read_HEAD(repo_root)) {
+    strutil::rstrip_newlines(*head);
+    if (head->starts_with(consts::kRefPrefix)) {
+      h.head = head->substr(consts::kRefPrefix.size());
+    } else if (looks_hex40(*head) && (all || !tips.empty())) {
+      h.head = *head;
+      tips.push_back(*head);
+    }
+  }
+  if (h.refs.empty() && tips.empty()) {
+    throw std::runtime_error("nothing to bundle");
+  }
+
+  std::set<std::string> stop;
+  for (const auto &rev : exclude) {
+    const std::string hex = looks_hex40(rev) ? rev : resolve_ref(repo_root, rev).oid;
+    if (repo.read_commit(hex).tree_hex.empty()) {
+      throw std::runtime_error("not a commit: " + rev);
+    }
+    if (stop.insert(hex).second) {
+      h.prerequisites.push_back(hex);
+    }
+  }
+  for (const auto &ref : h.refs) {
+    tips.push_back(ref.oid);
+  }
+  // Trees and blobs of the prerequisite commits themselves are on the reader's
+  // side too; leaving them out keeps unchanged files out of incremental bundles.
+  std::set<std::string> edge;
+  for (const auto &hex : h.prerequisites) {
+    const auto parents = repo.read_commit(hex).parents;
+    for (auto &obj : reach::collect_objects(repo, {hex}, {parents.begin(), parents.end()})) {
+      edge.insert(std::move(obj));
+    }
+  }
+  std::vector<std::string> objects;
+  for (auto &obj : reach::collect_objects(repo, tips, stop)) {
+    if (!edge.contains(obj)) {
+      objects.push_back(std::move(obj));
+    }
+  }
+
+  std::string header(kSignature);
+  header += '\n';
+  if (!h.head.empty()) {
+    header += std::string(kHeadPrefix) + h.head + "\n";
+  }
+  for (const auto &hex : h.prerequisites) {
+    header += std::string(kPrereqPrefix) + hex + "\n";
+  }
+  for (const auto &ref : h.refs) {
+    header += ref.oid + " " + ref.name + "\n";
+  }
+  header += "\n" + std::string(consts::kTokNobj) + std::to_string(objects.size()) + "\n";
+
+  auto tmp = file;
+  tmp += ".tmp";
+  {
+    std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+    if (!out) {
+      throw std::runtime_error("cannot create bundle " + file.string());
+    }
+    out.write(header.data(), static_cast<std::streamsize>(header.size()));
+    const ObjectStore store{repo.git_dir()};
+    for (const auto &hex : objects) {
+      oid id{};
+      if (!from_hex(hex, id)) {
+        throw std::runtime_error("bad object id " + hex);
+      }
+      const auto data = fs::read_file(store.locate(id));
+      out << consts::kTokObj << hex << ' ' << data.size() << '\n';
+      out.write(reinterpret_cast<const char *>(data.data()),
+                static_cast<std::streamsize>(data.size()));
+    }
+    out << consts::kTokDone << '\n';
+    out.flush();
+    if (!out) {
+      throw std::runtime_error("writing bundle failed: " + file.string());
+    }
+  }
+  stdfs::rename(tmp, file);
+  return objects.size();
+}
+
+bool is_bundle(const stdfs::path &path) {
+  std::error_code ec;
+  if (!stdfs::is_regular_file(path, ec)) {
+    return false;
+  }
+  std::ifstream in(path, std::ios::binary);
+  std::string line;
+  return std::getline(in, line) && line == kSignature;
+}
+
+Header read_header(const stdfs::path &file) {
+  std::ifstream in(file, std::ios::binary);
+  return parse_header(in, file);
+}
+
+Header unbundle(const stdfs::path &repo_root, const stdfs::path &file) {
+  const Repository repo{repo_root};
+  repo.require_portable_objects();
+  const ObjectStore store{repo.git_dir()};
+  std::ifstream in(file, std::ios::binary);
+  const Header h = parse_header(in, file);
+  store.load_index(); // shared with the writer below; most objects are new here
+  for (const auto &hex : h.prerequisites) {
+    if (!store.exists(hex)) {
+      throw std::runtime_error("bundle requires commit " + hex + ", which is missing here");
+    }
+  }
+
+  // Same framing and limits as the wire; a record also cannot outsize the file.
+  wire::Limits limits;
+  limits.max_object = std::min<std::uint64_t>(limits.max_object, stdfs::file_size(file));
+  std::string line;
+  std::getline(in, line);
+  const auto n = wire::parse_nobj(line, limits);
+  ObjectWriter writer{store};
+  std::vector<std::uint8_t> buf;
+  for (std::uint64_t i = 0; i < n; ++i) {
+    std::getline(in, line);
+    const auto [hex, size] = wire::parse_obj(line, limits);
+    oid expected{};
+    if (!from_hex(hex, expected)) {
+      throw std::runtime_error("corrupt bundle: bad object id " + hex);
+    }
+    buf.resize(size);
+    if (!in.read(reinterpret_cast<char *>(buf.data()), static_cast<std::streamsize>(size))) {
+      throw std::runtime_error("truncated bundle: " + file.string());
+    }
+    if (ObjectStore::hash_loose(buf) != expected) {
+      throw std::runtime_error("bundle object " + hex + " does not match its id");
+    }
+    if (store.exists(hex)) {
+      store.check_collision(expected, buf);
+      continue;
+    }
+    writer.write_loose(expected, std::move(buf));
+  }
+  if (!std::getline(in, line) || line != consts::kTokDone) {
+    throw std::runtime_error("truncated bundle: " + file.string());
+  }
+  writer.flush();
+
+  const std::set<std::string> stop(h.prerequisites.begin(), h.prerequisites.end());
+  for (const auto &ref : h.refs) {
+    reach::check_connected(repo, ref.oid, stop);
+  }
+  return h;
+}
+
+void clone_repo(const stdfs::path &file, const stdfs::path &dst) {
+  if (!read_header(file).prerequisites.empty()) {
+    throw std::runtime_error("bundle is incremental; fetch it into an existing clone");
+  }
+  const Repository repo{dst};
+  stdfs::create_directories(repo.objects_dir());
+  stdfs::create_directories(repo.heads_dir());
+  stdfs::create_directories(repo.tags_dir());
+  const Header h = unbundle(dst, file);
+
+  std::string tip;
+  for (const auto &ref : h.refs) {
+    if (ref.name.starts_with("refs/heads/") || ref.name.starts_with("refs/tags/")) {
+      update_ref(dst, ref.name, ref.oid);
+    }
+    if (ref.name == h.head) {
+      tip = ref.oid;
+    }
+  }
+  if (!tip.empty()) {
+    set_HEAD_symbolic(dst, h.head);
+  } else if (looks_hex40(h.head) && ObjectStore{repo.git_dir()}.exists(h.head)) {
+    tip = h.head;
+    set_HEAD_detached(dst, tip);
+  } else {
+    set_HEAD_symbolic(dst, heads_ref(consts::kDefaultBranch));
+    return; // HEAD's branch was not bundled; nothing to check out
+  }
+
+  const auto info = repo.read_commit(tip);
+  const auto snapshot = worktree::tree_to_map(repo, info.tree_hex);
+  worktree::apply_snapshot(repo, snapshot);
+  worktree::write_index_snapshot(repo, snapshot);
+}
+
+std::vector<RefEntry> fetch_refs(const stdfs::path &local, const stdfs::path &file,
+                                 const std::string &name, const std::string &prefix) {
+  if (!Repository{local}.is_initialized()) {
+    throw std::runtime_error("not a gitfly repository: " + local.string());
+  }
+  const Header h = unbundle(local, file);
+  std::vector<RefEntry> refs;
+  for (const auto &ref : h.refs) {
+    if (ref.name.starts_with(prefix)) {
+      refs.push_back(ref);
+    }
+  }
+  update_tracking_refs(local, name, refs);
+  return refs;
+}
+
+} // namespace gitfly::bundle
@@ -5,21 +5,19 @@
 #include <algorithm>
 #include <filesystem>
 #include <iostream>
+#include <string>
 #include <vector>
 
 namespace fs = std::filesystem;
 
-// Add a single filesystem path if it is a regular file.
-static auto add_one(gitfly::Index &idx, const gitfly::Repository &repo, const fs::path &root,
-                    const fs::path &relpath) -> bool {
+// Queue a single filesystem path if it is a regular file.
+static void collect_one(std::vector<std::string> &out, const fs::path &root,
+                        const fs::path &relpath) {
   if (const fs::path abs = root / relpath; !fs::exists(abs) || !fs::is_regular_file(abs)) {
     std::cerr << "add: skipping non-regular file: " << relpath << "\n";
-    return false;
+    return;
   }
-  const auto rel = relpath.generic_string();
-  idx.add_path(root, rel, repo, gitfly::consts::kModeFile);
-  std::cout << "added: " << rel << "\n";
-  return true;
+  out.push_back(relpath.generic_string());
 }
 
 int cmd_add(int argc, char **argv) {
@@ -48,13 +46,18 @@ int cmd_add(int argc, char **argv) {
   gitfly::Index idx{root};
   try {
     idx.load();
-    bool any = false;
+    std::vector<std::string> rels;
     for (const auto &path : paths) {
-      any = add_one(idx, repo, root, path) || any;
+      collect_one(rels, root, path);
     }
-    if (any) {
+    if (!rels.empty()) {
+      // One batch: blob ids are hashed together rather than file by file.
+      idx.add_paths(root, rels, repo, gitfly::consts::kModeFile);
       idx.save();
     }
+    for (const auto &rel : rels) {
+      std::cout << "added: " << rel << "\n";
+    }
     return 0;
   } catch (const std::exception &e) {
     std::cerr << "add: " << e.what() << "\n";
@@ -0,0 +1,52 @@
+#include "gitfly/bundle.hpp"
+
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// gitfly bundle create <file> [<ref>...] [^<rev>...]
+// gitfly bundle unbundle <file>
+// gitfly bundle list-heads <file>
+int cmd_bundle(int argc, char **argv) {
+  if (argc < 3) {
+    std::cerr << "usage: gitfly bundle create <file> [<ref>...] [^<exclude>...]\n"
+                 "       gitfly bundle unbundle <file>\n"
+                 "       gitfly bundle list-heads <file>\n";
+    return 2;
+  }
+  const std::string sub = argv[1];
+  const std::filesystem::path file = argv[2];
+  const std::filesystem::path root = std::filesystem::current_path();
+  try {
+    if (sub == "create") {
+      std::vector<std::string> refs;
+      std::vector<std::string> exclude;
+      for (int i = 3; i < argc; ++i) {
+        const std::string a = argv[i];
+        if (a.size() > 1 && a[0] == '^')
+          exclude.push_back(a.substr(1));
+        else
+          refs.push_back(a);
+      }
+      const auto n = gitfly::bundle::create(root, file, refs, exclude);
+      std::cout << "Wrote " << n << " objects to " << file.string() << "\n";
+      return 0;
+    }
+    gitfly::bundle::Header h;
+    if (sub == "unbundle")
+      h = gitfly::bundle::unbundle(root, file);
+    else if (sub == "list-heads")
+      h = gitfly::bundle::read_header(file);
+    else {
+      std::cerr << "bundle: unknown subcommand '" << sub << "'\n";
+      return 2;
+    }
+    for (const auto &ref : h.refs)
+      std::cout << ref.oid << " " << ref.name << "\n";
+    return 0;
+  } catch (const std::exception &e) {
+    std::cerr << "bundle: " << e.what() << "\n";
+    return 1;
+  }
+}
@@ -1,31 +1,69 @@
+#include "gitfly/bundle.hpp"
 #include "gitfly/remote.hpp"
 #include "gitfly/tcp_remote.hpp"
 #include "gitfly/consts.hpp"
+#include "cli/progress.hpp"
 
 #include <filesystem>
 #include <iostream>
+#include <stdexcept>
 #include <string>
+#include <vector>
 
 int cmd_clone(int argc, char **argv) {
-  if (argc < 3) {
-    std::cerr << "usage: gitfly clone <src> <dest>\n";
+  std::size_t depth = 0;
+  std::string filter;
+  bool shared = false;
+  std::string reference;
+  gitfly::tcpremote::SessionOptions session;
+  std::vector<std::string> args;
+  for (int i = 1; i < argc; ++i) {
+    const std::string a = argv[i];
+    if (a == "--depth" && i + 1 < argc) {
+      depth = std::stoull(argv[++i]);
+    } else if (a.rfind("--filter=", 0) == 0) {
+      filter = a.substr(9);
+    } else if (a == "--filter" && i + 1 < argc) {
+      filter = argv[++i];
+    } else if (a == "--shared") {
+      shared = true;
+    } else if (a == "--reference" && i + 1 < argc) {
+      reference = argv[++i];
+    } else if (a == "--compress") {
+      session.compress = true;
+    } else if (a == "--progress") {
+      session.progress = gitfly::cli::stderr_progress();
+    } else {
+      args.push_back(a);
+    }
+  }
+  if (args.size() < 2) {
+    std::cerr << "usage: gitfly clone [--depth <n>] [--filter=<spec>] [--shared] [--reference <repo>] "
+                 "[--compress] [--progress] <src> <dest>\n";
     return 2;
   }
   try {
-    if (const std::string src = argv[1]; src.rfind("tcp://", 0) == 0) {
-      // parse tcp://host:port
-      auto rest = src.substr(6);
-      const auto colon = rest.find(':');
-      const std::string host = rest.substr(0, colon);
-      const int port = colon == std::string::npos ? gitfly::consts::portNumber : std::stoi(rest.substr(colon + 1));
-      gitfly::tcpremote::clone_repo(host, port, argv[2]);
+    if (const std::string &src = args[0]; src.rfind("tcp://", 0) == 0) {
+      const auto ep = gitfly::tcpremote::parse_url(src);
+      if (shared)
+        throw std::runtime_error("--shared needs a local source; use --reference");
+      session.repo = ep.repo;
+      gitfly::tcpremote::clone_repo(ep.host, ep.port, args[1], depth, filter, session, reference);
+    } else if (gitfly::bundle::is_bundle(src)) {
+      if (depth > 0 || !filter.empty() || shared || !reference.empty())
+        throw std::runtime_error("cloning a bundle takes no --depth, --filter, --shared or --reference");
+      gitfly::bundle::clone_repo(src, args[1]);
     } else {
-      gitfly::remote::clone_repo(argv[1], argv[2]);
+      gitfly::remote::clone_repo(args[0], args[1], depth, filter, shared, reference);
     }
-    std::cout << "Cloned into '" << argv[2] << "'\n";
+    std::cout << "Cloned into '" << args[1] << "'\n";
     return 0;
   } catch (const std::exception &e) {
     std::cerr << "clone: " << e.what() << "\n";
+    const auto resume = std::filesystem::path(args[1]) / gitfly::consts::kGitDir /
+                        gitfly::consts::kCloneResume;
+    if (std::filesystem::exists(resume))
+      std::cerr << "clone: progress saved; re-run the same command to resume\n";
     return 1;
   }
 }
@@ -19,9 +19,26 @@ static std::vector<std::string> read_working_lines(const std::filesystem::path &
 
 static std::vector<std::string> read_blob_lines(const gitfly::Repository &repo,
                                                 const std::string &hex) {
-  auto bytes = repo.read_blob(hex);
-  return gitfly::diff::split_lines(
-      std::string_view(reinterpret_cast<const char *>(bytes.data()), bytes.size()));
+  // Split as the blob inflates (as diff::split_lines would), so only the lines
+  // are held, not the blob as well.
+  auto blob = repo.open_blob(hex);
+  std::vector<std::string> out;
+  std::string cur;
+  std::vector<std::uint8_t> buf(64 * 1024);
+  while (const std::size_t n = blob.read(buf)) {
+    for (std::size_t i = 0; i < n; ++i) {
+      const char c = static_cast<char>(buf[i]);
+      if (c == '\n') {
+        out.push_back(std::move(cur));
+        cur.clear();
+      } else if (c != '\r') {
+        cur.push_back(c);
+      }
+    }
+  }
+  if (!cur.empty())
+    out.push_back(std::move(cur));
+  return out;
 }
 
 int cmd_diff(int argc, char **argv) {
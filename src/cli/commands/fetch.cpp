@@ -1,31 +1,80 @@
+#include "gitfly/bundle.hpp"
 #include "gitfly/consts.hpp"
 #include "gitfly/remote.hpp"
 #include "gitfly/tcp_remote.hpp"
+#include "cli/progress.hpp"
 
 #include <filesystem>
 #include <iostream>
+#include <stdexcept>
 #include <string>
+#include <vector>
 
 int cmd_fetch(int argc, char **argv) {
-  if (argc < 2) {
-    std::cerr << "usage: gitfly fetch <remote> [<name>]\n";
+  std::size_t depth = 0;
+  bool all = false;
+  std::string prefix;
+  gitfly::tcpremote::SessionOptions session;
+  std::vector<std::string> args;
+  for (int i = 1; i < argc; ++i) {
+    const std::string a = argv[i];
+    if (a == "--depth" && i + 1 < argc) {
+      depth = std::stoull(argv[++i]);
+    } else if (a == "--all") {
+      all = true;
+    } else if (a == "--prefix" && i + 1 < argc) {
+      all = true;
+      prefix = argv[++i];
+    } else if (a == "--compress") {
+      session.compress = true;
+    } else if (a == "--progress") {
+      session.progress = gitfly::cli::stderr_progress();
+    } else {
+      args.push_back(a);
+    }
+  }
+  if (args.empty()) {
+    std::cerr << "usage: gitfly fetch [--all | --prefix <refs/...>] [--depth <n>] [--compress] "
+                 "[--progress] <remote> [<name>]\n";
     return 2;
   }
-  std::string remote = argv[1];
-  std::string name = (argc >= 3 ? argv[2] : std::string("origin"));
+  std::string remote = args[0];
+  std::string name = (args.size() >= 2 ? args[1] : std::string("origin"));
   std::filesystem::path local = std::filesystem::current_path();
   try {
+    // A bundle has no HEAD to follow; all of its refs (or those under --prefix) are fetched.
+    if (gitfly::bundle::is_bundle(remote)) {
+      if (depth > 0)
+        throw std::runtime_error("--depth does not apply to a bundle");
+      const auto refs = gitfly::bundle::fetch_refs(local, remote, name, prefix);
+      for (const auto &ref : refs)
+        std::cout << ref.oid.substr(0, 7) << " " << ref.name << "\n";
+      std::cout << "Fetched " << refs.size() << " refs\n";
+      return 0;
+    }
+    if (all) {
+      std::vector<gitfly::RefEntry> refs;
+      if (remote.rfind("tcp://", 0) == 0) {
+        const auto ep = gitfly::tcpremote::parse_url(remote);
+        session.repo = ep.repo;
+        refs = gitfly::tcpremote::fetch_refs(ep.host, ep.port, local.string(), name, prefix, depth, session);
+      } else {
+        refs = gitfly::remote::fetch_refs(local, remote, name, prefix, depth);
+      }
+      for (const auto &ref : refs)
+        std::cout << ref.oid.substr(0, 7) << " " << ref.name << "\n";
+      std::cout << "Fetched " << refs.size() << " refs\n";
+      return 0;
+    }
     gitfly::remote::FetchResult res;
     if (remote.rfind("tcp://", 0) == 0) {
-      auto rest = remote.substr(6); // strip "tcp://"
-      auto colon = rest.find(':');
-      std::string host = rest.substr(0, colon);
-      int port = colon == std::string::npos ? gitfly::consts::portNumber : std::stoi(rest.substr(colon + 1));
-      auto tres = gitfly::tcpremote::fetch_head(host, port, local.string(), name);
+      const auto ep = gitfly::tcpremote::parse_url(remote);
+      session.repo = ep.repo;
+      auto tres = gitfly::tcpremote::fetch_head(ep.host, ep.port, local.string(), name, depth, session);
       res.branch = std::move(tres.branch);
       res.tip = std::move(tres.tip);
     } else {
-      res = gitfly::remote::fetch_head(local, remote, name);
+      res = gitfly::remote::fetch_head(local, remote, name, depth);
     }
     std::cout << "Fetched: " << (res.branch.empty() ? "(none)" : res.branch) << " "
               << (res.tip.empty() ? "(no tip)" : res.tip) << "\n";
@@ -3,13 +3,24 @@
 
 #include <filesystem>
 #include <iostream>
+#include <string_view>
 
-int cmd_init(int /*argc*/, char ** /*argv*/) {
+// gitfly init [--object-codec=zlib|zstd]
+int cmd_init(int argc, char **argv) {
   try {
+    gitfly::fs::Codec codec = gitfly::fs::Codec::zlib;
+    for (int i = 1; i < argc; ++i) {
+      const std::string_view a = argv[i];
+      if (a != "--object-codec=zlib" && a != "--object-codec=zstd") {
+        std::cerr << "usage: gitfly init [--object-codec=zlib|zstd]\n";
+        return 2;
+      }
+      codec = a.ends_with("zstd") ? gitfly::fs::Codec::zstd : gitfly::fs::Codec::zlib;
+    }
     const std::filesystem::path root = std::filesystem::current_path();
     const gitfly::Repository repo{root};
     // pick any default identity (you can wire a config command later)
-    repo.init(gitfly::Identity{.name = "Your Name", .email = "you@example.com"});
+    repo.init(gitfly::Identity{.name = "Your Name", .email = "you@example.com"}, codec);
     std::cout << "Initialized empty gitfly repository in " << (root / ".gitfly") << "\n";
     return 0;
   } catch (const std::exception &e) {
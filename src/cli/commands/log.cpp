@@ -36,7 +36,8 @@ int cmd_log(int /*argc*/, char ** /*argv*/) {
         commit_hex.pop_back();
     }
 
-    // Walk parents
+    // Walk parents (history ends at the shallow boundary of a --depth clone)
+    const auto shallow = repo.shallow_commits();
     while (!commit_hex.empty()) {
       auto info = repo.read_commit(commit_hex);
       std::string parent = info.parents.empty() ? std::string() : info.parents.front();
@@ -52,6 +53,8 @@ int cmd_log(int /*argc*/, char ** /*argv*/) {
       if (!subject.empty())
         std::cout << "    " << subject << "\n";
       std::cout << "\n";
+      if (shallow.contains(commit_hex))
+        break;
       if (parent.size() == gitfly::consts::kOidHexLen)
         commit_hex = parent;
       else
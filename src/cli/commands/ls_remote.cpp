@@ -0,0 +1,46 @@
+#include "gitfly/consts.hpp"
+#include "gitfly/refs.hpp"
+#include "gitfly/tcp_remote.hpp"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+int cmd_ls_remote(int argc, char **argv) {
+  if (argc < 2) {
+    std::cerr << "usage: gitfly ls-remote <remote> [<prefix>...]\n";
+    return 2;
+  }
+  const std::string remote = argv[1];
+  std::vector<std::string> prefixes(argv + 2, argv + argc);
+  if (prefixes.empty())
+    prefixes.emplace_back();
+  try {
+    std::vector<gitfly::RefEntry> refs;
+    auto collect = [&refs](std::vector<gitfly::RefEntry> got) {
+      refs.insert(refs.end(), got.begin(), got.end());
+    };
+    if (remote.rfind("tcp://", 0) == 0) {
+      const auto ep = gitfly::tcpremote::parse_url(remote);
+      const gitfly::tcpremote::SessionOptions opts{.repo = ep.repo};
+      if (prefixes.size() == 1) {
+        refs = gitfly::tcpremote::ls_refs(ep.host, ep.port, prefixes.front(), opts);
+      } else {
+        // One connection, all listings requested before the first is read.
+        gitfly::tcpremote::Client client{ep.host, ep.port, opts};
+        for (const auto &prefix : prefixes)
+          client.ls_refs(prefix, collect);
+        client.wait();
+      }
+    } else {
+      for (const auto &prefix : prefixes)
+        collect(gitfly::list_refs(remote, prefix.empty() ? "refs/" : prefix));
+    }
+    for (const auto &ref : refs)
+      std::cout << ref.oid << "\t" << ref.name << "\n";
+    return 0;
+  } catch (const std::exception &e) {
+    std::cerr << "ls-remote: " << e.what() << "\n";
+    return 1;
+  }
+}
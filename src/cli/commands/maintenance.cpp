@@ -0,0 +1,27 @@
+#include "gitfly/object_store.hpp"
+#include "gitfly/repo.hpp"
+
+#include <filesystem>
+#include <iostream>
+#include <string_view>
+
+// gitfly maintenance train-zstd-dict
+int cmd_maintenance(int argc, char **argv) {
+  if (argc != 2 || std::string_view{argv[1]} != "train-zstd-dict") {
+    std::cerr << "usage: gitfly maintenance train-zstd-dict\n";
+    return 2;
+  }
+  try {
+    const gitfly::Repository repo{std::filesystem::current_path()};
+    if (!repo.is_initialized()) {
+      std::cerr << "maintenance: not a gitfly repository\n";
+      return 1;
+    }
+    const auto id = gitfly::ObjectStore{repo.git_dir()}.train_zstd_dictionary();
+    std::cout << "Trained zstd dictionary " << id << "\n";
+    return 0;
+  } catch (const std::exception &e) {
+    std::cerr << "maintenance: " << e.what() << "\n";
+    return 1;
+  }
+}
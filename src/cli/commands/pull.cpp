@@ -1,7 +1,6 @@
 #include <filesystem>
 #include <iostream>
 #include <string>
-#include <set>
 
 #include "gitfly/repo.hpp"
 #include "gitfly/refs.hpp"
@@ -9,18 +8,6 @@
 #include "gitfly/tcp_remote.hpp"
 #include "gitfly/worktree.hpp"
 
-static bool is_ancestor(const gitfly::Repository& repo, const std::string& anc, const std::string& desc) {
-  if (anc == desc) return true;
-  std::vector<std::string> st{desc};
-  std::set<std::string> seen;
-  while (!st.empty()) {
-    auto cur = st.back(); st.pop_back();
-    if (!seen.insert(cur).second) continue;
-    auto info = repo.read_commit(cur);
-    for (auto& p : info.parents) { if (p==anc) return true; st.push_back(p);} }
-  return false;
-}
-
 int cmd_pull(int argc, char** argv) {
   if (argc < 2) {
     std::cerr << "usage: gitfly pull <remote> [<name>]\n";
@@ -40,11 +27,9 @@ int cmd_pull(int argc, char** argv) {
   try {
     gitfly::remote::FetchResult fres;
     if (remote.rfind("tcp://", 0) == 0) {
-      auto rest = remote.substr(6);
-      auto colon = rest.find(':');
-      std::string host = rest.substr(0, colon);
-      int port = colon==std::string::npos ? gitfly::consts::portNumber : std::stoi(rest.substr(colon+1));
-      auto tres = gitfly::tcpremote::fetch_head(host, port, repo.root().string(), name);
+      const auto ep = gitfly::tcpremote::parse_url(remote);
+      auto tres = gitfly::tcpremote::fetch_head(ep.host, ep.port, repo.root().string(), name, 0,
+                                                gitfly::tcpremote::SessionOptions{.repo = ep.repo});
       fres.branch = std::move(tres.branch); fres.tip = std::move(tres.tip);
     } else {
       fres = gitfly::remote::fetch_head(repo.root(), remote, name);
@@ -53,7 +38,7 @@ int cmd_pull(int argc, char** argv) {
     // Fast-forward or merge
     auto local_tip = gitfly::read_ref(repo.root(), rn);
     if (!local_tip) { std::cerr << "pull: current branch has no tip\n"; return 1; }
-    if (is_ancestor(repo, *local_tip, fres.tip)) {
+    if (repo.is_commit_ancestor(*local_tip, fres.tip)) {
       // FF: materialize and update ref
       auto info = repo.read_commit(fres.tip);
       auto tgt  = gitfly::worktree::tree_to_map(repo, info.tree_hex);
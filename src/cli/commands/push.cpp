@@ -2,22 +2,36 @@
 #include "gitfly/remote.hpp"
 #include "gitfly/repo.hpp"
 #include "gitfly/tcp_remote.hpp"
+#include "cli/progress.hpp"
 
 #include <filesystem>
 #include <iostream>
 #include <string>
+#include <vector>
 
 int cmd_push(int argc, char **argv) {
-  if (argc < 2) {
-    std::cerr << "usage: gitfly push <remote-path> [<branch>]\n";
+  gitfly::tcpremote::SessionOptions session;
+  std::vector<std::string> args;
+  for (int i = 1; i < argc; ++i) {
+    const std::string a = argv[i];
+    if (a == "--compress")
+      session.compress = true;
+    else if (a == "--progress")
+      session.progress = gitfly::cli::stderr_progress();
+    else
+      args.push_back(a);
+  }
+  if (args.empty()) {
+    std::cerr << "usage: gitfly push [--compress] [--progress] <remote-path> [<branch>|<ref>...]\n";
     return 2;
   }
-  std::string remote = argv[1];
-  std::string branch;
+  std::string remote = args[0];
   gitfly::Repository repo{std::filesystem::current_path()};
-  if (argc >= 3)
-    branch = argv[2];
-  else {
+  // Branch names or full ref names; several are pushed together, all or none.
+  std::vector<std::string> refs;
+  for (std::size_t i = 1; i < args.size(); ++i)
+    refs.push_back(args[i].rfind("refs/", 0) == 0 ? args[i] : gitfly::heads_ref(args[i]));
+  if (refs.empty()) {
     auto head_txt = gitfly::read_HEAD(repo.root());
     if (!head_txt || head_txt->rfind("ref:", 0) != 0) {
       std::cerr << "push: detached HEAD; specify branch\n";
@@ -26,20 +40,20 @@ int cmd_push(int argc, char **argv) {
     std::string rn = head_txt->substr(gitfly::consts::kRefPrefix.size());
     while (!rn.empty() && (rn.back() == '\n' || rn.back() == '\r'))
       rn.pop_back();
-    const std::string prefix = "refs/heads/";
-    branch = rn.rfind(prefix, 0) == 0 ? rn.substr(prefix.size()) : rn;
+    refs.push_back(rn);
   }
   try {
     if (remote.rfind("tcp://", 0) == 0) {
-      auto rest = remote.substr(6);
-      auto colon = rest.find(':');
-      std::string host = rest.substr(0, colon);
-      int port = colon == std::string::npos ? gitfly::consts::portNumber : std::stoi(rest.substr(colon + 1));
-      gitfly::tcpremote::push_branch(host, port, repo.root().string(), branch);
+      const auto ep = gitfly::tcpremote::parse_url(remote);
+      session.repo = ep.repo;
+      gitfly::tcpremote::push_refs(ep.host, ep.port, repo.root().string(), refs, session);
     } else {
-      gitfly::remote::push_branch(repo.root(), remote, branch);
+      gitfly::remote::push_refs(repo.root(), remote, refs);
     }
-    std::cout << "Pushed to '" << branch << "' at " << remote << "\n";
+    const std::string prefix = "refs/heads/";
+    for (const auto &ref : refs)
+      std::cout << "Pushed to '" << (ref.rfind(prefix, 0) == 0 ? ref.substr(prefix.size()) : ref)
+                << "' at " << remote << "\n";
     return 0;
   } catch (const std::exception &e) {
     std::cerr << "push: " << e.what() << "\n";
@@ -1,107 +1,460 @@
+#include "gitfly/bitmap.hpp"
 #include "gitfly/consts.hpp"
 #include "gitfly/fs.hpp"
+#include "gitfly/object_store.hpp"
+#include "gitfly/object_writer.hpp"
+#include "gitfly/pack_cache.hpp"
+#include "gitfly/reach.hpp"
 #include "gitfly/refs.hpp"
 #include "gitfly/repo.hpp"
+#include "gitfly/util.hpp"
+#include "gitfly/wire.hpp"
 
 #include <algorithm>
 #include <arpa/inet.h>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
 #include <filesystem>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <netinet/in.h>
+#include <optional>
+#include <semaphore>
 #include <set>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <thread>
 #include <unistd.h>
 #include <vector>
 
 namespace fs = std::filesystem;
 
-static void write_all(int fd, const void *buf, size_t n) {
-  const char *p = static_cast<const char *>(buf);
-  while (n) {
-    ssize_t w = ::send(fd, p, n, 0);
-    if (w <= 0)
-      throw std::runtime_error("send failed");
-    p += w;
-    n -= static_cast<size_t>(w);
+// Connections served at once; further clients wait in the listen backlog.
+static constexpr std::ptrdiff_t kMaxClients = 64;
+
+// Per connection: bytes a client may upload in total, and bytes of received
+// objects waiting for the verifier. Together with wire::Limits they bound what
+// one client can make the server hold.
+static constexpr std::uint64_t kMaxSessionBytes = std::uint64_t{16} << 30;
+static constexpr std::size_t kVerifyQueueBytes = std::size_t{64} << 20;
+// A pack file held open for every connection streaming from it. The handle
+// stays readable even after the cache replaces and deletes the file.
+struct PackFile {
+  explicit PackFile(const fs::path &path) : fd(::open(path.c_str(), O_RDONLY | O_CLOEXEC)) {
+    struct stat st{};
+    if (fd < 0 || ::fstat(fd, &st) != 0)
+      throw std::runtime_error("open " + path.string() + ": " + std::strerror(errno));
+    ino = st.st_ino;
+  }
+  ~PackFile() { ::close(fd); }
+  PackFile(const PackFile &) = delete;
+  PackFile &operator=(const PackFile &) = delete;
+
+  int fd = -1;
+  ino_t ino = 0;
+};
+
+// A repository served by this process, shared by all connections to it.
+struct HostedRepo {
+  explicit HostedRepo(const fs::path &root) : repo(root) {}
+
+  gitfly::Repository repo;
+  std::mutex mu; // guards the on-disk clone pack cache and the members below
+  std::shared_ptr<const gitfly::BitmapIndex> bitmaps;
+  std::map<fs::path, std::shared_ptr<PackFile>> packs;
+
+  // Open handle for `path`, reused while it still names the same file. Needs `mu`.
+  std::shared_ptr<PackFile> pack_file(const fs::path &path) {
+    auto &slot = packs[path];
+    struct stat st{};
+    if (!slot || ::stat(path.c_str(), &st) != 0 || st.st_ino != slot->ino)
+      slot = std::make_shared<PackFile>(path);
+    return slot;
+  }
+};
+
+// The repositories under one directory, opened on first use.
+class RepoHost {
+public:
+  explicit RepoHost(fs::path root) : root_(std::move(root)) {}
+
+  // The repository at `rel` below the root ("" = the root itself); nullptr if
+  // there is none or `rel` tries to leave the root.
+  std::shared_ptr<HostedRepo> open(std::string_view rel) {
+    while (rel.ends_with('/'))
+      rel.remove_suffix(1);
+    const fs::path sub{std::string(rel)};
+    if (sub.is_absolute() || std::ranges::any_of(sub, [](const fs::path &p) { return p == ".."; }))
+      return nullptr;
+    const auto dir = (root_ / sub).lexically_normal();
+    std::lock_guard lk(mu_);
+    if (const auto it = repos_.find(dir); it != repos_.end())
+      return it->second;
+    // The wire protocol carries zlib objects only.
+    if (const gitfly::Repository repo{dir};
+        !repo.is_initialized() ||
+        gitfly::ObjectStore{repo.git_dir()}.codec() != gitfly::fs::Codec::zlib)
+      return nullptr;
+    return repos_[dir] = std::make_shared<HostedRepo>(dir);
+  }
+
+private:
+  fs::path root_;
+  std::mutex mu_;
+  std::map<fs::path, std::shared_ptr<HostedRepo>> repos_;
+};
+
+// Send exactly the listed objects (e.g. a depth-limited walk) in the same framing.
+static void send_objects(gitfly::wire::Conn &conn, const gitfly::Repository &repo,
+                         const std::vector<std::string> &hexes) {
+  const gitfly::ObjectStore store{repo.git_dir()};
+  conn.write_line(std::string("NOBJ ") + std::to_string(hexes.size()));
+  for (const auto &hex : hexes) {
+    gitfly::oid id{};
+    if (!gitfly::from_hex(hex, id))
+      throw std::runtime_error("bad object id " + hex);
+    conn.write_object(hex, store.locate(id));
   }
+  conn.write_line("DONE");
 }
 
-static void write_line(int fd, const std::string &s) {
-  std::string t = s;
-  t += "\n";
-  write_all(fd, t.data(), t.size());
+// Parse the optional " RESUME <tip> <last> <count>" suffix of an OP CLONE line:
+// an interrupted clone of <tip> stored the first <count> objects of the stream,
+// the last of them being <last>.
+struct ResumeToken {
+  std::string tip;
+  std::string last;
+  std::size_t count = 0;
+};
+
+static std::optional<ResumeToken> parse_resume(std::string_view op) {
+  const auto pos = op.find(gitfly::consts::kTokResume);
+  if (pos == std::string_view::npos)
+    return std::nullopt;
+  std::istringstream is(std::string(op.substr(pos + gitfly::consts::kTokResume.size())));
+  ResumeToken tok;
+  if (!(is >> tok.tip >> tok.last >> tok.count))
+    throw std::runtime_error("bad RESUME");
+  return tok;
 }
 
-static std::string read_line(int fd) {
-  std::string s;
-  char c;
-  while (true) {
-    ssize_t r = ::recv(fd, &c, 1, 0);
-    if (r <= 0)
-      throw std::runtime_error("recv failed");
-    if (c == '\n')
-      break;
-    s.push_back(c);
-  }
-  return s;
+// Send a cached clone stream: the pack segments already hold the OBJ framing.
+// `files[i]` is the open handle for `stream.segments[i]`.
+static void send_pack_stream(gitfly::wire::Conn &conn,
+                             const gitfly::ClonePackCache::Stream &stream,
+                             const std::vector<std::shared_ptr<PackFile>> &files) {
+  conn.write_line(std::string(gitfly::consts::kTokNobj) + std::to_string(stream.objects));
+  std::vector<char> buf(1 << 20);
+  for (std::size_t i = 0; i < stream.segments.size(); ++i) {
+    const auto &seg = stream.segments[i];
+    auto off = static_cast<off_t>(seg.offset);
+    for (std::uint64_t left = seg.length; left != 0;) {
+      const auto n = ::pread(files[i]->fd, buf.data(), std::min<std::uint64_t>(left, buf.size()), off);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        throw std::runtime_error("short read from " + seg.file.string());
+      conn.write(buf.data(), static_cast<std::size_t>(n));
+      left -= static_cast<std::uint64_t>(n);
+      off += n;
+    }
+  }
+  conn.write_line(gitfly::consts::kTokDone);
 }
 
-static void send_all_objects(int fd, const fs::path &objects_dir) {
-  std::vector<fs::path> files;
-  for (auto it = fs::recursive_directory_iterator(objects_dir);
-       it != fs::recursive_directory_iterator(); ++it) {
-    if (!it->is_regular_file())
-      continue;
-    files.push_back(it->path());
-  }
-  write_line(fd, std::string("NOBJ ") + std::to_string(files.size()));
-  for (auto &p : files) {
-    const auto rel = fs::relative(p, objects_dir).generic_string();
-    std::string hex = rel;
-    hex.erase(std::ranges::remove(hex, '/').begin(), hex.end());
-    auto data = gitfly::fs::read_file(p);
-    write_line(fd, std::string("OBJ ") + hex + " " + std::to_string(data.size()));
-    write_all(fd, data.data(), data.size());
-  }
-  write_line(fd, "DONE");
+// The word following `token` on an op line, or "" if the token is absent.
+static std::string_view option_value(std::string_view op, std::string_view token) {
+  const auto pos = op.find(token);
+  if (pos == std::string_view::npos)
+    return {};
+  const auto value = op.substr(pos + token.size());
+  return value.substr(0, value.find(' '));
+}
+
+// Parse the optional " DEPTH <n>" / " FILTER <spec>" suffixes of an OP CLONE /
+// OP FETCH / OP FETCH-REFS line.
+static gitfly::reach::TransferOptions parse_transfer_options(std::string_view op) {
+  gitfly::reach::TransferOptions opts;
+  if (const auto depth = option_value(op, gitfly::consts::kTokDepth); !depth.empty())
+    opts.depth = std::stoull(std::string(depth));
+  opts.filter = gitfly::reach::BlobFilter::parse(option_value(op, gitfly::consts::kTokFilter));
+  return opts;
 }
 
-static void recv_objects_into(int fd, const fs::path &objects_dir) {
-  auto nline = read_line(fd);
-  if (nline.rfind("NOBJ ", 0) != 0)
-    throw std::runtime_error("bad NOBJ");
-  size_t n = std::stoull(nline.substr(gitfly::consts::kRefPrefix.size()));
-  for (size_t i = 0; i < n; ++i) {
-    auto oline = read_line(fd);
-    if (oline.rfind("OBJ ", 0) != 0)
-      throw std::runtime_error("bad OBJ");
-    std::istringstream is(oline.substr(4));
-    std::string hex;
-    size_t sz;
-    is >> hex >> sz;
-    std::vector<std::uint8_t> buf(sz);
-    size_t got = 0;
-    while (got < sz) {
-      ssize_t r = ::recv(fd, buf.data() + got, sz - got, 0);
-      if (r <= 0)
-        throw std::runtime_error("recv obj failed");
-      got += static_cast<size_t>(r);
-    }
-    fs::path dir = objects_dir / hex.substr(0, 2);
-    fs::create_directories(dir);
-    gitfly::fs::write_file_atomic(dir / hex.substr(2), buf);
-  }
-  auto done = read_line(fd);
-  (void)done;
+// "REF <name> <oid>" for every ref under `prefix`, then "DONE". Returns the
+// advertised tips.
+static std::vector<std::string> advertise_refs(gitfly::wire::Conn &conn,
+                                               const gitfly::Repository &repo,
+                                               std::string_view prefix) {
+  std::vector<std::string> tips;
+  for (const auto &ref : gitfly::list_refs(repo.root(), prefix.empty() ? "refs/" : prefix)) {
+    conn.write_line(std::string("REF ") + ref.name + " " + ref.oid);
+    tips.push_back(ref.oid);
+  }
+  conn.write_line(gitfly::consts::kTokDone);
+  std::ranges::sort(tips);
+  tips.erase(std::unique(tips.begin(), tips.end()), tips.end());
+  return tips;
 }
 
-static void handle_client(int cfd, gitfly::Repository &repo) {
-  auto hello = read_line(cfd);
-  (void)hello;
-  auto op = read_line(cfd);
-  if (op.rfind("OP CLONE", 0) == 0 || op.rfind("OP FETCH", 0) == 0) {
+// One received object, handed from the network thread to the verifier.
+struct IncomingObject {
+  std::string hex;
+  std::vector<std::uint8_t> data; // loose-object image (zlib-compressed)
+  fs::path spooled;               // or the file holding it, for large objects
+};
+
+// Bounded single-producer/single-consumer queue between the receive loop and
+// the verifier thread, so inflating + hashing overlaps with network reads.
+// Bounded in objects and in bytes; a single object larger than the byte budget
+// is still admitted once the queue is empty.
+class VerifyQueue {
+public:
+  VerifyQueue(std::size_t capacity, std::size_t max_bytes)
+      : capacity_(capacity), max_bytes_(max_bytes) {}
+
+  void push(IncomingObject obj) {
+    std::unique_lock lk(mu_);
+    not_full_.wait(lk, [&] {
+      return closed_ || items_.empty() ||
+             (items_.size() < capacity_ && bytes_ + obj.data.size() <= max_bytes_);
+    });
+    if (closed_)
+      return; // verifier gave up; drop the rest
+    bytes_ += obj.data.size();
+    items_.push_back(std::move(obj));
+    not_empty_.notify_one();
+  }
+
+  std::optional<IncomingObject> pop() {
+    std::unique_lock lk(mu_);
+    not_empty_.wait(lk, [&] { return !items_.empty() || closed_; });
+    if (items_.empty())
+      return std::nullopt;
+    IncomingObject obj = std::move(items_.front());
+    items_.pop_front();
+    bytes_ -= obj.data.size();
+    not_full_.notify_one();
+    return obj;
+  }
+
+  void close() {
+    std::lock_guard lk(mu_);
+    closed_ = true;
+    not_empty_.notify_all();
+    not_full_.notify_all();
+  }
+
+private:
+  std::size_t capacity_;
+  std::size_t max_bytes_;
+  std::size_t bytes_ = 0;
+  std::deque<IncomingObject> items_;
+  bool closed_ = false;
+  std::mutex mu_;
+  std::condition_variable not_empty_;
+  std::condition_variable not_full_;
+};
+
+// Where a push's objects wait until every check on it has passed: a repository
+// skeleton under the live .gitfly/ whose objects dir has the live one as an
+// alternate, so the checks see old and new history together. A rejected push is
+// dropped with the directory; an accepted one is moved into the live store.
+class Quarantine {
+public:
+  explicit Quarantine(const gitfly::Repository &live)
+      : live_(live), repo_(live.git_dir() / next_name()) {
+    std::filesystem::create_directories(repo_.objects_dir());
+    // The checks read the promisor setting and the shallow boundary too
+    for (const auto &[from, to] : {std::pair{live.config_file(), repo_.config_file()},
+                                   std::pair{live.shallow_file(), repo_.shallow_file()}}) {
+      if (std::filesystem::exists(from))
+        std::filesystem::copy_file(from, to);
+    }
+    gitfly::ObjectStore{repo_.git_dir()}.add_alternate(live.objects_dir());
+  }
+  ~Quarantine() {
+    std::error_code ec;
+    std::filesystem::remove_all(repo_.root(), ec);
+  }
+  Quarantine(const Quarantine &) = delete;
+  Quarantine &operator=(const Quarantine &) = delete;
+
+  const gitfly::Repository &repo() const { return repo_; }
+
+  // Move the received objects into the live store and make the renames durable.
+  void publish() const {
+    bool moved = false;
+    for (const auto &fan : std::filesystem::directory_iterator(repo_.objects_dir())) {
+      if (fan.path().filename().string().size() != 2 || !fan.is_directory())
+        continue; // info/
+      const auto dst_dir = live_.objects_dir() / fan.path().filename();
+      std::filesystem::create_directories(dst_dir);
+      for (const auto &f : std::filesystem::directory_iterator(fan.path())) {
+        // Another push may have stored the same object meanwhile
+        if (const auto dst = dst_dir / f.path().filename(); !std::filesystem::exists(dst)) {
+          std::filesystem::rename(f.path(), dst);
+          moved = true;
+        }
+      }
+    }
+    if (moved)
+      gitfly::ObjectStore{live_.git_dir()}.sync();
+  }
+
+private:
+  static std::string next_name() {
+    static std::atomic<unsigned> seq{0};
+    return "incoming-" + std::to_string(::getpid()) + "-" + std::to_string(seq++);
+  }
+
+  const gitfly::Repository &live_;
+  gitfly::Repository repo_;
+};
+
+// Receive a NOBJ/OBJ.../DONE stream. Every object is inflated and hashed on a
+// verifier thread before it is written; an object whose content does not hash
+// to its advertised name is rejected. Returns an error message, empty on success.
+static std::string recv_objects_verified(gitfly::wire::Conn &conn, const gitfly::Repository &repo) {
+  const auto n = gitfly::wire::parse_nobj(conn.read_line(), conn.limits());
+
+  const gitfly::ObjectStore store{repo.git_dir()};
+  store.load_index(); // shared with the writer; a push brings mostly new objects
+  const fs::path store_dir = repo.objects_dir();
+  gitfly::ObjectWriter writer{store};
+  VerifyQueue queue{64, kVerifyQueueBytes};
+  std::string error; // written by the verifier only, read after join
+  std::thread verifier([&] {
+    while (auto obj = queue.pop()) {
+      try {
+        gitfly::oid expected{};
+        if (!gitfly::from_hex(obj->hex, expected))
+          throw std::runtime_error("bad object name " + obj->hex);
+        if (!obj->spooled.empty()) {
+          // Verified from disk; the file is moved into place as is
+          if (gitfly::ObjectStore::hash_loose_file(obj->spooled) != expected)
+            throw std::runtime_error("hash mismatch");
+          if (store.record(obj->hex)) {
+            const auto dst = store.path_for_oid(expected);
+            fs::create_directories(dst.parent_path());
+            fs::rename(obj->spooled, dst);
+          } else {
+            store.check_collision(expected, obj->spooled);
+            fs::remove(obj->spooled);
+          }
+          continue;
+        }
+        if (gitfly::ObjectStore::hash_loose(obj->data) != expected)
+          throw std::runtime_error("hash mismatch");
+        if (!store.exists(obj->hex))
+          writer.write_loose(expected, std::move(obj->data));
+        else
+          store.check_collision(expected, obj->data);
+      } catch (const std::exception &e) {
+        error = "object " + obj->hex + " failed verification: " + e.what();
+        queue.close();
+        return;
+      }
+    }
+  });
+
+  try {
+    for (std::uint64_t i = 0; i < n; ++i) {
+      auto [hex, size] = gitfly::wire::parse_obj(conn.read_line(), conn.limits());
+      IncomingObject obj{.hex = std::move(hex), .data = {}, .spooled = {}};
+      if (size > gitfly::wire::kSpoolObjectBytes) {
+        // Named outside the fan-out directories, so nothing mistakes it for an object
+        obj.spooled = store_dir / ("spool-" + std::to_string(i));
+        std::uint64_t left = size;
+        gitfly::fs::write_file_atomic(obj.spooled, [&](std::span<std::uint8_t> buf) {
+          const auto n = static_cast<std::size_t>(std::min<std::uint64_t>(left, buf.size()));
+          conn.read_exact(buf.data(), n);
+          left -= n;
+          return n;
+        });
+      } else {
+        conn.read_payload(obj.data, size);
+      }
+      queue.push(std::move(obj));
+    }
+    if (conn.read_line() != gitfly::consts::kTokDone)
+      throw std::runtime_error("expected DONE after objects");
+  } catch (...) {
+    queue.close();
+    verifier.join();
+    throw;
+  }
+  queue.close();
+  verifier.join();
+  if (error.empty()) {
+    // One sync for the whole push, before the caller publishes it in refs
+    try {
+      writer.flush();
+    } catch (const std::exception &e) {
+      error = std::string("cannot store objects: ") + e.what();
+    }
+  }
+  return error;
+}
+
+// Answer one request (the op line has been read) against `hosted`.
+static void serve_request(gitfly::wire::Conn &conn, const std::shared_ptr<HostedRepo> &hosted,
+                          const std::string &op) {
+  const auto &repo = hosted->repo;
+  if (op.rfind(gitfly::consts::kOpLsRefs, 0) == 0) {
+    // "OP LS-REFS [<prefix>]"
+    std::string_view prefix = op;
+    prefix.remove_prefix(gitfly::consts::kOpLsRefs.size());
+    while (prefix.starts_with(' '))
+      prefix.remove_prefix(1);
+    (void)advertise_refs(conn, repo, prefix);
+  } else if (op.rfind(gitfly::consts::kOpFetchRefs, 0) == 0) {
+    // Advertise every ref under PREFIX, take the client's HAVE and SHALLOW
+    // lines, then send one object stream covering all advertised tips.
+    const auto tips = advertise_refs(conn, repo, option_value(op, gitfly::consts::kTokPrefix));
+    auto opts = parse_transfer_options(op);
+    const gitfly::ObjectStore store{repo.git_dir()};
+    for (auto line = conn.read_line(); line != gitfly::consts::kTokDone; line = conn.read_line()) {
+      std::set<std::string> *into = nullptr;
+      if (line.starts_with(gitfly::consts::kTokHave))
+        into = &opts.have;
+      else if (line.starts_with(gitfly::consts::kTokShallow))
+        into = &opts.shallow;
+      else
+        throw std::runtime_error("bad HAVE");
+      auto hex = line.substr(line.find(' ') + 1);
+      if (store.exists(hex))
+        into->insert(std::move(hex));
+    }
+    // Full-history requests from complete clients are answered from the
+    // reachability bitmaps, which are extended here first if a tip is newer.
+    std::shared_ptr<const gitfly::BitmapIndex> bitmaps;
+    if (opts.depth == 0 && !opts.filter.active() && opts.shallow.empty()) {
+      std::lock_guard lk(hosted->mu);
+      auto &cached = hosted->bitmaps;
+      if (!cached || !std::ranges::all_of(tips, [&](const auto &t) { return cached->covers(t); })) {
+        if (auto idx = gitfly::BitmapIndex::refresh(repo, tips))
+          cached = std::make_shared<const gitfly::BitmapIndex>(std::move(*idx));
+      }
+      bitmaps = cached; // keeps this version alive if another client refreshes it
+      opts.bitmaps = bitmaps.get();
+    }
+    auto plan = gitfly::reach::plan_transfer(repo, tips, opts);
+    for (const auto &hex : plan.shallow)
+      conn.write_line(std::string(gitfly::consts::kTokShallow) + hex);
+    std::ranges::sort(plan.objects);
+    send_objects(conn, repo, plan.objects);
+  } else if (op.rfind(gitfly::consts::kOpClone, 0) == 0 ||
+             op.rfind(gitfly::consts::kOpFetch, 0) == 0) {
     // advertise current branch + tip
     auto head_txt = gitfly::read_HEAD(repo.root());
     std::string branch = "DETACHED", tip;
@@ -120,60 +473,192 @@ static void handle_client(int cfd, gitfly::Repository &repo) {
         branch = "DETACHED";
       }
     }
-    write_line(cfd, std::string("REF ") + branch + " " + tip);
-    send_all_objects(cfd, repo.objects_dir());
-  } else if (op.rfind("OP PUSH ", 0) == 0) {
-    std::string branch = op.substr(8);
-    auto nline = read_line(cfd);
-    if (nline.rfind("NEW ", 0) != 0)
-      throw std::runtime_error("bad NEW");
-    std::string new_oid = nline.substr(4);
-    write_line(cfd, "OKGO");
-    recv_objects_into(cfd, repo.objects_dir());
-    // fast-forward check
-    auto cur_tip = gitfly::read_ref(repo.root(), gitfly::heads_ref(branch));
-    if (cur_tip) {
-      // reuse merge helper by creating a temporary repository instance
-      auto is_ancestor = [&](const std::string &anc, const std::string &desc) {
-        if (anc == desc)
-          return true;
-        std::vector<std::string> st{desc};
-        std::set<std::string> seen;
-        while (!st.empty()) {
-          auto cur = st.back();
-          st.pop_back();
-          if (!seen.insert(cur).second)
-            continue;
-          auto info = repo.read_commit(cur);
-          for (auto &p : info.parents) {
-            if (p == anc)
-              return true;
-            st.push_back(p);
-          }
-        }
-        return false;
-      };
-      if (!is_ancestor(*cur_tip, new_oid)) {
-        write_line(cfd, "ERR non-fast-forward");
+    conn.write_line(std::string("REF ") + branch + " " + tip);
+    // A resume token only holds against the same tip and the same stream order;
+    // when honoured, "SKIP <n>" tells the client how many objects are left out.
+    auto resume = parse_resume(op);
+    if (resume && resume->tip != tip)
+      resume.reset();
+    const gitfly::ObjectStore store{repo.git_dir()};
+    if (const auto opts = parse_transfer_options(op);
+        (opts.depth > 0 || opts.filter.active()) && !tip.empty()) {
+      auto plan = gitfly::reach::plan_transfer(repo, {tip}, opts);
+      for (const auto &hex : plan.shallow)
+        conn.write_line(std::string(gitfly::consts::kTokShallow) + hex);
+      auto &objects = plan.objects;
+      std::ranges::sort(objects);
+      if (resume && resume->count > 0 && resume->count <= objects.size() &&
+          objects[resume->count - 1] == resume->last) {
+        conn.write_line(std::string(gitfly::consts::kTokSkip) + std::to_string(resume->count));
+        objects.erase(objects.begin(), objects.begin() + static_cast<std::ptrdiff_t>(resume->count));
+      }
+      send_objects(conn, repo, objects);
+    } else if (tip.empty()) {
+      send_objects(conn, repo, store.list());
+    } else {
+      // Full transfer: stream the cached packs for this tip (built on first use).
+      // Only preparing the cache is serialised; streaming uses open handles.
+      gitfly::ClonePackCache::Stream stream;
+      std::vector<std::shared_ptr<PackFile>> files;
+      {
+        std::lock_guard lk(hosted->mu);
+        gitfly::ClonePackCache cache{repo.git_dir()};
+        stream = resume ? cache.prepare(tip, store, resume->count, resume->last)
+                        : cache.prepare(tip, store);
+        for (const auto &seg : stream.segments)
+          files.push_back(hosted->pack_file(seg.file));
+      }
+      if (stream.skipped != 0)
+        conn.write_line(std::string(gitfly::consts::kTokSkip) + std::to_string(stream.skipped));
+      send_pack_stream(conn, stream, files);
+    }
+  } else if (op == gitfly::consts::kOpBlobs) {
+    // Lazy fetch from a partial clone: "WANT <hex>"... "DONE"
+    std::vector<std::string> wants;
+    for (auto line = conn.read_line(); line != gitfly::consts::kTokDone; line = conn.read_line()) {
+      if (line.rfind(gitfly::consts::kTokWant, 0) != 0)
+        throw std::runtime_error("bad WANT");
+      wants.push_back(line.substr(gitfly::consts::kTokWant.size()));
+    }
+    const gitfly::ObjectStore store{repo.git_dir()};
+    for (const auto &hex : wants) {
+      if (!store.exists(hex)) {
+        conn.write_line("ERR missing object " + hex);
+        return;
+      }
+    }
+    send_objects(conn, repo, wants);
+  } else if (op == gitfly::consts::kOpPush) {
+    // Advertise the refs, then take "UPDATE <old> <new> <ref>" lines (zero id =
+    // no ref). A stale <old> is refused before any objects are uploaded, and the
+    // final update is a compare-and-swap of all refs at once, so a push that
+    // raced with this one fails instead of being overwritten.
+    (void)advertise_refs(conn, repo, "refs/");
+    std::vector<gitfly::RefUpdate> updates;
+    for (auto line = conn.read_line(); line != gitfly::consts::kTokDone; line = conn.read_line()) {
+      if (line.rfind(gitfly::consts::kTokUpdate, 0) != 0)
+        throw std::runtime_error("bad UPDATE");
+      std::istringstream is(line.substr(gitfly::consts::kTokUpdate.size()));
+      std::string old_oid, new_oid, name;
+      if (!(is >> old_oid >> new_oid >> name) || !gitfly::looks_hex40(old_oid) ||
+          !gitfly::looks_hex40(new_oid) || !gitfly::is_valid_ref_name(name))
+        throw std::runtime_error("bad UPDATE");
+      auto none = [](std::string hex) { return hex == gitfly::consts::kZeroOid ? std::string{} : hex; };
+      updates.push_back(gitfly::RefUpdate{
+          .name = std::move(name), .old_oid = none(old_oid), .new_oid = none(new_oid)});
+    }
+    for (const auto &u : updates) {
+      if (gitfly::read_ref(repo.root(), u.name).value_or("") != *u.old_oid) {
+        conn.write_line("ERR stale " + u.name);
         return;
       }
     }
-    gitfly::update_ref(repo.root(), gitfly::heads_ref(branch), new_oid);
-    write_line(cfd, "OK");
+    conn.write_line(gitfly::consts::kTokOkGo);
+    const Quarantine quarantine{repo};
+    if (auto err = recv_objects_verified(conn, quarantine.repo()); !err.empty()) {
+      conn.write_line("ERR " + err);
+      return;
+    }
+    // Every ref tip was complete before this push; only new history needs checking.
+    std::set<std::string> complete;
+    for (const auto &ref : gitfly::list_refs(repo.root()))
+      complete.insert(ref.oid);
+    for (const auto &u : updates) {
+      if (u.new_oid.empty())
+        continue;
+      try {
+        gitfly::reach::check_connected(quarantine.repo(), u.new_oid, complete);
+      } catch (const std::exception &e) {
+        conn.write_line(std::string("ERR connectivity: ") + e.what());
+        return;
+      }
+      if (u.name.starts_with("refs/heads/") && !u.old_oid->empty() &&
+          !quarantine.repo().is_commit_ancestor(*u.old_oid, u.new_oid)) {
+        conn.write_line("ERR non-fast-forward " + u.name);
+        return;
+      }
+    }
+    try {
+      quarantine.publish();
+      gitfly::update_refs(repo.root(), updates);
+    } catch (const std::runtime_error &e) {
+      conn.write_line(std::string("ERR ") + e.what());
+      return;
+    }
+    conn.write_line(gitfly::consts::kTokOk);
   } else {
-    write_line(cfd, "ERR unknown op");
+    conn.write_line("ERR unknown op");
+  }
+}
+
+static void handle_client(gitfly::wire::Conn &conn, RepoHost &host) {
+  // "HELLO 1 [caps...]": a client that lists capabilities gets the accepted
+  // subset echoed back; a bare "HELLO 1" gets no reply (older clients).
+  const auto caps = gitfly::wire::parse_hello(conn.read_line());
+  bool compress = false;
+  bool multi = false;
+  if (!caps.empty()) {
+    std::vector<std::string_view> accepted;
+    if (std::ranges::find(caps, gitfly::wire::kCapZlib) != caps.end()) {
+      accepted.push_back(gitfly::wire::kCapZlib);
+      compress = true;
+    }
+    if (std::ranges::find(caps, gitfly::wire::kCapMulti) != caps.end()) {
+      accepted.push_back(gitfly::wire::kCapMulti);
+      multi = true;
+    }
+    conn.write_line(gitfly::wire::hello_line(accepted));
+  }
+  if (compress)
+    conn.enable_compression();
+  // "REPO <path>" picks a repository below the served root; without it the
+  // root itself is served.
+  auto op = conn.read_line();
+  std::string rel;
+  if (op.rfind(gitfly::consts::kTokRepo, 0) == 0) {
+    rel = op.substr(gitfly::consts::kTokRepo.size());
+    op = conn.read_line();
+  }
+  const auto hosted = host.open(rel);
+  if (!hosted) {
+    conn.write_line("ERR no such repository: " + (rel.empty() ? std::string("/") : rel));
+    return;
+  }
+  if (!multi) {
+    serve_request(conn, hosted, op);
+    return;
+  }
+  // Multi-request session: "REQ <id>" + request, answered in order with
+  // "RESP <id>" + response, until "BYE". Requests may arrive before earlier
+  // responses have been read; they simply wait in the socket buffer.
+  for (; op != gitfly::consts::kTokBye; op = conn.read_line()) {
+    if (op.rfind(gitfly::consts::kTokReq, 0) != 0)
+      throw std::runtime_error("expected REQ <id>");
+    conn.write_line(std::string(gitfly::consts::kTokResp) + op.substr(gitfly::consts::kTokReq.size()));
+    serve_request(conn, hosted, conn.read_line());
   }
 }
 
 auto cmd_serve(int argc, char **argv) -> int {
+  // gitfly serve [--root <dir>] [<port>]: with --root, every repository below
+  // <dir> is served, selected by the path in the client's URL.
   int port = gitfly::consts::portNumber;
-  if (argc >= 2)
-    port = std::stoi(argv[1]);
-  gitfly::Repository repo{std::filesystem::current_path()};
-  if (!repo.is_initialized()) {
-    std::cerr << "serve: not a gitfly repo\n";
+  fs::path root = fs::current_path();
+  bool tree = false;
+  for (int i = 1; i < argc; ++i) {
+    const std::string a = argv[i];
+    if (a == "--root" && i + 1 < argc) {
+      root = fs::absolute(argv[++i]);
+      tree = true;
+    } else {
+      port = std::stoi(a);
+    }
+  }
+  if (!tree && !gitfly::Repository{root}.is_initialized()) {
+    std::cerr << "serve: not a gitfly repo (use --root <dir> to serve a tree of repos)\n";
     return 1;
   }
+  RepoHost host{root};
 
   int sfd = ::socket(AF_INET6, SOCK_STREAM, 0);
   if (sfd == -1) {
@@ -196,18 +681,30 @@ auto cmd_serve(int argc, char **argv) -> int {
     close(sfd);
     return 1;
   }
-  std::cout << "gitfly serve listening on port " << port << " (Ctrl+C to stop)\n";
+  std::cout << "gitfly serve listening on port " << port;
+  if (tree)
+    std::cout << " for repositories under " << root.string();
+  std::cout << " (Ctrl+C to stop)" << std::endl;
+  std::counting_semaphore<kMaxClients> slots{kMaxClients};
   while (true) {
+    slots.acquire();
     int cfd = accept(sfd, nullptr, nullptr);
     if (cfd < 0) {
       perror("accept");
+      slots.release();
       continue;
     }
-    try {
-      handle_client(cfd, repo);
-    } catch (const std::exception &e) {
-      std::cerr << "serve: " << e.what() << "\n";
-    }
-    ::close(cfd);
+    std::thread([cfd, &host, &slots] {
+      try {
+        gitfly::wire::Conn conn{cfd};
+        conn.set_limits(gitfly::wire::Limits{.max_session = kMaxSessionBytes});
+        handle_client(conn, host);
+        conn.flush();
+      } catch (const std::exception &e) {
+        std::cerr << "serve: " << e.what() << "\n";
+      }
+      ::close(cfd);
+      slots.release();
+    }).detach();
   }
 }
@@ -0,0 +1,35 @@
+#pragma once
+#include "gitfly/tcp_remote.hpp"
+
+#include <cstdio>
+#include <string>
+
+namespace gitfly::cli {
+
+// Progress reporter for --progress: a live object counter on stderr while
+// objects flow, then a one-line summary with byte counts and phase timings.
+inline tcpremote::ProgressFn stderr_progress() {
+  return [](const tcpremote::TransferStats &st) {
+    constexpr double kMiB = 1024.0 * 1024.0;
+    if (st.phase == "objects" && st.objects_total != 0) {
+      std::fprintf(stderr, "\rObjects: %3zu%% (%zu/%zu), %.2f MiB | %.2f MiB/s",
+                   st.objects * 100 / st.objects_total, st.objects, st.objects_total,
+                   static_cast<double>(st.bytes.wire_in + st.bytes.wire_out) / kMiB,
+                   st.rate() / kMiB);
+    } else if (st.phase == "done") {
+      if (st.objects_total != 0)
+        std::fprintf(stderr, "\rObjects: 100%% (%zu/%zu), done.%20s\n", st.objects, st.objects_total, "");
+      std::string phases;
+      for (const auto &[name, secs] : st.phases)
+        phases += " " + name + "=" + std::to_string(secs) + "s";
+      std::fprintf(stderr,
+                   "%zu objects, %llu bytes on the wire (%llu payload) in %.3fs, %.2f MiB/s;%s\n",
+                   st.objects,
+                   static_cast<unsigned long long>(st.bytes.wire_in + st.bytes.wire_out),
+                   static_cast<unsigned long long>(st.bytes.payload_in + st.bytes.payload_out),
+                   st.elapsed, st.rate() / kMiB, phases.c_str());
+    }
+  };
+}
+
+} // namespace gitfly::cli
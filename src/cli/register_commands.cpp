@@ -13,12 +13,15 @@ int cmd_clone(int, char **);
 int cmd_push(int, char **);
 int cmd_serve(int, char **);
 int cmd_fetch(int, char **);
+int cmd_ls_remote(int, char **);
 int cmd_pull(int, char **);
+int cmd_bundle(int, char **);
+int cmd_maintenance(int, char **);
 
 namespace gitfly::cli {
 
 void register_all_commands() {
-  register_command("init", ::cmd_init, "Initialize a new repository");
+  register_command("init", ::cmd_init, "Initialize a new repository: gitfly init [--object-codec=zlib|zstd]");
   register_command("add", ::cmd_add, "Add file(s) to the index: gitfly add <path>...");
   register_command("commit", ::cmd_commit, "Commit staged changes: gitfly commit -m <message>");
   register_command("status", ::cmd_status, "Show staged/unstaged/untracked changes");
@@ -28,12 +31,19 @@ void register_all_commands() {
   register_command("log", ::cmd_log, "Show commit log from HEAD");
   register_command("merge", ::cmd_merge, "Merge branch into current: gitfly merge <name>");
   register_command("diff", ::cmd_diff, "Show diffs (working vs index or --cached)");
-  register_command("clone", ::cmd_clone, "Clone a repository: gitfly clone <src> <dest>");
+  register_command("clone", ::cmd_clone, "Clone a repository: gitfly clone [--depth <n>] [--filter=blob:none|blob:limit=<n>] "
+                   "[--shared] [--reference <repo>] [--compress] [--progress] <src> <dest>");
   register_command("push", ::cmd_push,
-                   "Push current branch to local path: gitfly push <path> [branch]");
+                   "Push current branch to local path: gitfly push [--compress] [--progress] <path> [branch]");
   register_command("serve", ::cmd_serve, "Serve this repo over TCP: gitfly serve [port]");
-  register_command("fetch", ::cmd_fetch, "Fetch from remote: gitfly fetch <remote> [name]");
+  register_command("fetch", ::cmd_fetch, "Fetch from remote: gitfly fetch [--all | --prefix <refs/...>] "
+                   "[--depth <n>] [--compress] [--progress] <remote> [name]");
+  register_command("ls-remote", ::cmd_ls_remote, "List remote refs: gitfly ls-remote <remote> [prefix...]");
   register_command("pull", ::cmd_pull, "Fetch + integrate: gitfly pull <remote> [name]");
+  register_command("bundle", ::cmd_bundle, "Pack refs and objects into one file: gitfly bundle "
+                   "create <file> [<ref>...] [^<exclude>...] | unbundle <file> | list-heads <file>");
+  register_command("maintenance", ::cmd_maintenance,
+                   "Repository upkeep: gitfly maintenance train-zstd-dict");
 }
 
 } // namespace gitfly::cli
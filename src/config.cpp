@@ -62,4 +62,66 @@ void save_identity(const std::filesystem::path &repo_root, const Identity &id) {
   fs::write_file_atomic(path, std::span(data, s.size()));
 }
 
+std::optional<std::string> config_get(const std::filesystem::path &repo_root,
+                                      std::string_view key) {
+  const auto path = cfg_path(repo_root);
+  if (!fs::exists(path))
+    return std::nullopt;
+
+  const auto bytes = fs::read_file(path);
+  std::istringstream iss(std::string(bytes.begin(), bytes.end()));
+  std::string line;
+  while (std::getline(iss, line)) {
+    std::string_view sv{line};
+    if (sv.size() > key.size() && sv.starts_with(key) && sv[key.size()] == ':')
+      return trim(sv.substr(key.size() + 1));
+  }
+  return std::nullopt;
+}
+
+std::map<std::string, std::string> config_entries(const std::filesystem::path &repo_root) {
+  std::map<std::string, std::string> out;
+  const auto path = cfg_path(repo_root);
+  if (!fs::exists(path))
+    return out;
+
+  const auto bytes = fs::read_file(path);
+  std::istringstream iss(std::string(bytes.begin(), bytes.end()));
+  std::string line;
+  while (std::getline(iss, line)) {
+    const std::string_view sv{line};
+    if (const auto colon = sv.find(':'); colon != 0 && colon != std::string_view::npos)
+      out.emplace(sv.substr(0, colon), trim(sv.substr(colon + 1)));
+  }
+  return out;
+}
+
+void config_set(const std::filesystem::path &repo_root, std::string_view key,
+                std::string_view value) {
+  const auto path = cfg_path(repo_root);
+  std::ostringstream os;
+  bool replaced = false;
+  if (fs::exists(path)) {
+    const auto bytes = fs::read_file(path);
+    std::istringstream iss(std::string(bytes.begin(), bytes.end()));
+    std::string line;
+    while (std::getline(iss, line)) {
+      std::string_view sv{line};
+      if (sv.size() > key.size() && sv.starts_with(key) && sv[key.size()] == ':') {
+        if (!replaced)
+          os << key << ": " << value << '\n';
+        replaced = true;
+      } else {
+        os << line << '\n';
+      }
+    }
+  }
+  if (!replaced)
+    os << key << ": " << value << '\n';
+
+  const std::string s = os.str();
+  const auto *data = reinterpret_cast<const std::uint8_t *>(s.data());
+  fs::write_file_atomic(path, std::span(data, s.size()));
+}
+
 } // namespace gitfly
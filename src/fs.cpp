@@ -1,9 +1,22 @@
 #include "gitfly/fs.hpp"
 
 #include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
 #include <fstream>
 #include <stdexcept>
+#include <sys/ioctl.h>
+#include <unistd.h>
 #include <zlib.h>
+#ifdef GITFLY_HAVE_ZSTD
+#include <zdict.h>
+#include <zstd.h>
+#endif
+#if __has_include(<linux/fs.h>)
+#include <linux/fs.h>
+#endif
 
 namespace gitfly::fs {
 
@@ -33,10 +46,46 @@ std::vector<std::uint8_t> read_file(const std::filesystem::path &p) {
   return buf;
 }
 
+std::vector<std::uint8_t> read_file_prefix(const std::filesystem::path &p, std::size_t limit) {
+  std::ifstream ifs(p, std::ios::binary);
+  if (!ifs) {
+    throw std::runtime_error("open for read failed: " + p.string());
+  }
+  std::vector<std::uint8_t> buf(limit);
+  ifs.read(reinterpret_cast<char *>(buf.data()), static_cast<std::streamsize>(limit));
+  buf.resize(static_cast<std::size_t>(ifs.gcount()));
+  return buf;
+}
+
+namespace {
+
+// Unique per writer, so concurrent writers of the same file (two pushes
+// carrying one object) never share a temporary.
+std::filesystem::path temp_name(std::filesystem::path p) {
+  static std::atomic<std::uint64_t> seq{0};
+  p += ".tmp" + std::to_string(::getpid()) + "." + std::to_string(seq++);
+  return p;
+}
+
+// rename(), replacing `dst`; `tmp` is removed if that fails.
+void rename_into_place(const std::filesystem::path &tmp, const std::filesystem::path &dst) {
+  std::error_code ec;
+  std::filesystem::rename(tmp, dst, ec);
+  if (ec) {
+    std::filesystem::remove(dst, ec);
+    std::filesystem::rename(tmp, dst, ec);
+    if (ec) {
+      std::filesystem::remove(tmp);
+      throw std::runtime_error("atomic replace failed: " + dst.string() + ": " + ec.message());
+    }
+  }
+}
+
+} // namespace
+
 void write_file_atomic(const std::filesystem::path &p, std::span<const std::uint8_t> data) {
   ensure_parent_dir(p);
-  auto tmp = p;
-  tmp += ".tmp";
+  const auto tmp = temp_name(p);
   {
     std::ofstream ofs(tmp, std::ios::binary | std::ios::trunc);
     if (!ofs) {
@@ -50,30 +99,605 @@ void write_file_atomic(const std::filesystem::path &p, std::span<const std::uint
     if (!ofs)
       throw std::runtime_error("flush temp failed: " + tmp.string());
   }
+  rename_into_place(tmp, p);
+}
+
+void write_file_atomic(const std::filesystem::path &p,
+                       const std::function<std::size_t(std::span<std::uint8_t>)> &read) {
+  ensure_parent_dir(p);
+  const auto tmp = temp_name(p);
+  try {
+    std::ofstream ofs(tmp, std::ios::binary | std::ios::trunc);
+    if (!ofs) {
+      throw std::runtime_error("open temp for write failed: " + tmp.string());
+    }
+    std::vector<std::uint8_t> buf(64 * 1024);
+    while (const std::size_t n = read(buf)) {
+      ofs.write(reinterpret_cast<const char *>(buf.data()), static_cast<std::streamsize>(n));
+    }
+    ofs.flush();
+    if (!ofs)
+      throw std::runtime_error("flush temp failed: " + tmp.string());
+  } catch (...) {
+    std::error_code ec;
+    std::filesystem::remove(tmp, ec);
+    throw;
+  }
+  rename_into_place(tmp, p);
+}
+
+void sync_filesystem(const std::filesystem::path &p) {
+  const int fd = ::open(p.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    throw std::runtime_error("open " + p.string() + ": " + std::strerror(errno));
+#ifdef __linux__
+  const int rc = ::syncfs(fd);
+#else
+  ::sync();
+  const int rc = 0;
+#endif
+  const int err = errno;
+  ::close(fd);
+  if (rc != 0)
+    throw std::runtime_error("syncfs " + p.string() + ": " + std::strerror(err));
+}
+
+namespace {
+
+// Copy-on-write clone of `src` into a new file `dst` (btrfs, XFS, ...).
+bool reflink_file(const std::filesystem::path &src, const std::filesystem::path &dst) {
+#ifdef FICLONE
+  const int in = ::open(src.c_str(), O_RDONLY | O_CLOEXEC);
+  if (in < 0)
+    return false;
+  const int out = ::open(dst.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0444);
+  if (out < 0) {
+    ::close(in);
+    return false;
+  }
+  const bool ok = ::ioctl(out, FICLONE, in) == 0;
+  ::close(in);
+  ::close(out);
+  if (!ok)
+    ::unlink(dst.c_str());
+  return ok;
+#else
+  (void)src;
+  (void)dst;
+  return false;
+#endif
+}
+
+} // namespace
+
+LinkKind link_or_copy_file(const std::filesystem::path &src, const std::filesystem::path &dst) {
+  ensure_parent_dir(dst);
+  if (::link(src.c_str(), dst.c_str()) == 0)
+    return LinkKind::hardlink;
+  if (errno == EEXIST)
+    return LinkKind::existing;
+  // Cross-device (EXDEV) or a filesystem without hardlinks: go through a
+  // temporary so a concurrent reader never sees a partial object. The name is
+  // this writer's own, so two placing the same object never share it.
+  const auto tmp = temp_name(dst);
   std::error_code ec;
-  std::filesystem::rename(tmp, p, ec);
-  if (ec) {
-    std::filesystem::remove(p, ec);
-    std::filesystem::rename(tmp, p, ec);
+  LinkKind kind = LinkKind::reflink;
+  if (!reflink_file(src, tmp)) {
+    kind = LinkKind::copy;
+    std::filesystem::copy_file(src, tmp, ec);
     if (ec) {
-      std::filesystem::remove(tmp);
-      throw std::runtime_error("atomic replace failed: " + p.string() + ": " + ec.message());
+      std::error_code ignored;
+      std::filesystem::remove(tmp, ignored);
+      throw std::runtime_error("copy object failed: " + dst.string() + ": " + ec.message());
+    }
+  }
+  std::filesystem::rename(tmp, dst, ec);
+  if (ec) {
+    std::filesystem::remove(tmp);
+    throw std::runtime_error("place object failed: " + dst.string() + ": " + ec.message());
+  }
+  return kind;
+}
+
+namespace {
+
+constexpr std::uint8_t kZstdMagic[4] = {0x28, 0xB5, 0x2F, 0xFD};
+
+// zlib's avail_in/avail_out are 32-bit; larger buffers go through in pieces.
+constexpr std::size_t kZlibMaxIo = std::size_t{1} << 30;
+
+#ifdef GITFLY_HAVE_ZSTD
+struct ZstdCCtxFree {
+  void operator()(ZSTD_CCtx *c) const { ZSTD_freeCCtx(c); }
+};
+struct ZstdDCtxFree {
+  void operator()(ZSTD_DCtx *d) const { ZSTD_freeDCtx(d); }
+};
+using ZstdCCtx = std::unique_ptr<ZSTD_CCtx, ZstdCCtxFree>;
+using ZstdDCtx = std::unique_ptr<ZSTD_DCtx, ZstdDCtxFree>;
+
+std::size_t zstd_check(std::size_t rc, const char *what) {
+  if (ZSTD_isError(rc))
+    throw std::runtime_error(std::string("zstd ") + what + " failed: " + ZSTD_getErrorName(rc));
+  return rc;
+}
+
+ZstdCCtx zstd_cctx(const Compression &c) {
+  ZstdCCtx cctx(ZSTD_createCCtx());
+  if (!cctx)
+    throw std::runtime_error("zstd: cannot allocate a compression context");
+  zstd_check(ZSTD_CCtx_setParameter(cctx.get(), ZSTD_c_compressionLevel, c.level), "setup");
+  if (!c.dict.empty())
+    zstd_check(ZSTD_CCtx_loadDictionary(cctx.get(), c.dict.data(), c.dict.size()), "setup");
+  return cctx;
+}
+
+// A decompression context for the frame that starts at `head`, loaded with the
+// dictionary the frame names, if any.
+ZstdDCtx zstd_dctx(std::span<const std::uint8_t> head, const ZstdDictFn &dict) {
+  ZstdDCtx dctx(ZSTD_createDCtx());
+  if (!dctx)
+    throw std::runtime_error("zstd: cannot allocate a decompression context");
+  if (const unsigned id = ZSTD_getDictID_fromFrame(head.data(), head.size()); id != 0) {
+    if (!dict)
+      throw std::runtime_error("zstd frame needs dictionary " + std::to_string(id));
+    const auto d = dict(id);
+    zstd_check(ZSTD_DCtx_loadDictionary(dctx.get(), d.data(), d.size()), "setup");
+  }
+  return dctx;
+}
+
+std::vector<std::uint8_t> zstd_compress(std::span<const std::uint8_t> head,
+                                        std::span<const std::uint8_t> body,
+                                        const Compression &c) {
+  const auto cctx = zstd_cctx(c);
+  zstd_check(ZSTD_CCtx_setPledgedSrcSize(cctx.get(), head.size() + body.size()), "setup");
+  std::vector<std::uint8_t> out(ZSTD_compressBound(head.size() + body.size()));
+  ZSTD_outBuffer o{out.data(), out.size(), 0};
+  ZSTD_inBuffer h{head.data(), head.size(), 0};
+  while (h.pos < h.size)
+    zstd_check(ZSTD_compressStream2(cctx.get(), &o, &h, ZSTD_e_continue), "compress");
+  ZSTD_inBuffer b{body.data(), body.size(), 0};
+  // `out` holds the bound, so the frame always ends; the check guards a loop forever.
+  while (zstd_check(ZSTD_compressStream2(cctx.get(), &o, &b, ZSTD_e_end), "compress") != 0) {
+    if (o.pos == o.size)
+      throw std::runtime_error("zstd compress failed: output exceeds its bound");
+  }
+  out.resize(o.pos);
+  return out;
+}
+
+// Decompress one zstd frame piecewise, handing each chunk to `fn` until it
+// returns false. Data that ends mid-frame is an error unless `partial`.
+void zstd_each(std::span<const std::uint8_t> data,
+               const std::function<bool(std::span<const std::uint8_t>)> &fn,
+               const ZstdDictFn &dict, bool partial) {
+  const auto dctx = zstd_dctx(data, dict);
+  ZSTD_inBuffer in{data.data(), data.size(), 0};
+  std::uint8_t buf[64 * 1024];
+  for (;;) {
+    ZSTD_outBuffer o{buf, sizeof(buf), 0};
+    const std::size_t rc = zstd_check(ZSTD_decompressStream(dctx.get(), &o, &in), "decompress");
+    if (o.pos != 0 && !fn(std::span<const std::uint8_t>(buf, o.pos)))
+      return;
+    if (rc == 0)
+      return;
+    if (o.pos == 0 && in.pos == in.size) {
+      if (partial)
+        return;
+      throw std::runtime_error("zstd stream truncated");
     }
   }
 }
+#endif
+
+[[noreturn]] void no_zstd() {
+  throw std::runtime_error("zstd compression is not available in this build");
+}
 
-std::vector<std::uint8_t> z_compress(std::span<const std::uint8_t> data) {
+} // namespace
+
+bool codec_available(Codec codec) {
+#ifdef GITFLY_HAVE_ZSTD
+  (void)codec;
+  return true;
+#else
+  return codec == Codec::zlib;
+#endif
+}
+
+bool is_zstd(std::span<const std::uint8_t> head) {
+  return head.size() >= sizeof(kZstdMagic) &&
+         std::equal(std::begin(kZstdMagic), std::end(kZstdMagic), head.begin());
+}
+
+std::vector<std::uint8_t> zstd_train_dictionary(const std::vector<std::vector<std::uint8_t>> &samples,
+                                                std::size_t capacity) {
+#ifdef GITFLY_HAVE_ZSTD
+  std::vector<std::uint8_t> flat;
+  std::vector<std::size_t> sizes;
+  for (const auto &s : samples) {
+    flat.insert(flat.end(), s.begin(), s.end());
+    sizes.push_back(s.size());
+  }
+  std::vector<std::uint8_t> dict(capacity);
+  const std::size_t n = ZDICT_trainFromBuffer(dict.data(), dict.size(), flat.data(), sizes.data(),
+                                              static_cast<unsigned>(sizes.size()));
+  if (ZDICT_isError(n))
+    throw std::runtime_error(std::string("zstd dictionary training failed: ") +
+                             ZDICT_getErrorName(n));
+  dict.resize(n);
+  return dict;
+#else
+  (void)samples;
+  (void)capacity;
+  no_zstd();
+#endif
+}
+
+std::uint32_t zstd_dictionary_id(std::span<const std::uint8_t> dict) {
+#ifdef GITFLY_HAVE_ZSTD
+  return ZDICT_getDictID(dict.data(), dict.size());
+#else
+  (void)dict;
+  return 0;
+#endif
+}
+
+struct ZFileWriter::Impl {
+  Codec codec = Codec::zlib;
+  z_stream zs{};
+  bool zs_live = false;
+#ifdef GITFLY_HAVE_ZSTD
+  ZstdCCtx cctx;
+#endif
+  std::filesystem::path tmp;
+  std::ofstream out;
+  std::uint8_t buf[64 * 1024];
+  bool done = false;
+
+  ~Impl() {
+    if (zs_live)
+      deflateEnd(&zs);
+  }
+
+  void emit(std::size_t n) {
+    out.write(reinterpret_cast<const char *>(buf), static_cast<std::streamsize>(n));
+    if (!out)
+      throw std::runtime_error("write failed: " + tmp.string());
+  }
+
+  // Run deflate until it has consumed its input (or, with Z_FINISH, ended the
+  // stream), writing out every full buffer.
+  void pump(int flush) {
+    int rc = Z_OK;
+    do {
+      zs.next_out = buf;
+      zs.avail_out = sizeof(buf);
+      rc = deflate(&zs, flush);
+      if (rc == Z_STREAM_ERROR)
+        throw std::runtime_error("zlib deflate failed");
+      emit(sizeof(buf) - zs.avail_out);
+    } while (flush == Z_FINISH ? rc != Z_STREAM_END : zs.avail_out == 0);
+  }
+
+#ifdef GITFLY_HAVE_ZSTD
+  // The same for zstd; ZSTD_e_end also ends the frame.
+  void pump_zstd(ZSTD_inBuffer &in, ZSTD_EndDirective mode) {
+    for (;;) {
+      ZSTD_outBuffer o{buf, sizeof(buf), 0};
+      const std::size_t left =
+          zstd_check(ZSTD_compressStream2(cctx.get(), &o, &in, mode), "compress");
+      emit(o.pos);
+      if (mode == ZSTD_e_end ? left == 0 : in.pos == in.size)
+        return;
+    }
+  }
+#endif
+};
+
+ZFileWriter::ZFileWriter(const std::filesystem::path &dir, const Compression &compression)
+    : impl_(std::make_unique<Impl>()) {
+  impl_->codec = compression.codec;
+  if (compression.codec == Codec::zstd) {
+#ifdef GITFLY_HAVE_ZSTD
+    impl_->cctx = zstd_cctx(compression);
+#else
+    no_zstd();
+#endif
+  } else {
+    if (deflateInit(&impl_->zs, compression.level) != Z_OK)
+      throw std::runtime_error("zlib deflateInit failed");
+    impl_->zs_live = true;
+  }
+  std::error_code ec;
+  std::filesystem::create_directories(dir, ec);
+  impl_->tmp = temp_name(dir / "incoming");
+  impl_->out.open(impl_->tmp, std::ios::binary | std::ios::trunc);
+  if (!impl_->out)
+    throw std::runtime_error("open temp for write failed: " + impl_->tmp.string());
+}
+
+ZFileWriter::~ZFileWriter() {
+  if (!impl_->done) {
+    impl_->out.close();
+    std::error_code ec;
+    std::filesystem::remove(impl_->tmp, ec);
+  }
+}
+
+void ZFileWriter::write(std::span<const std::uint8_t> data) {
+#ifdef GITFLY_HAVE_ZSTD
+  if (impl_->codec == Codec::zstd) {
+    ZSTD_inBuffer in{data.data(), data.size(), 0};
+    impl_->pump_zstd(in, ZSTD_e_continue);
+    return;
+  }
+#endif
+  while (!data.empty()) {
+    const auto piece = data.first(std::min(data.size(), kZlibMaxIo));
+    impl_->zs.next_in = const_cast<Bytef *>(reinterpret_cast<const Bytef *>(piece.data()));
+    impl_->zs.avail_in = static_cast<uInt>(piece.size());
+    impl_->pump(Z_NO_FLUSH);
+    data = data.subspan(piece.size());
+  }
+}
+
+void ZFileWriter::commit(const std::filesystem::path &dst) {
+#ifdef GITFLY_HAVE_ZSTD
+  if (impl_->codec == Codec::zstd) {
+    ZSTD_inBuffer none{nullptr, 0, 0};
+    impl_->pump_zstd(none, ZSTD_e_end);
+  } else
+#endif
+    impl_->pump(Z_FINISH);
+  impl_->out.close();
+  if (!impl_->out)
+    throw std::runtime_error("flush temp failed: " + impl_->tmp.string());
+  ensure_parent_dir(dst);
+  impl_->done = true;
+  rename_into_place(impl_->tmp, dst);
+}
+
+struct ZFileReader::Impl {
+  ZstdDictFn dict;
+  bool started = false; // codec known, decoder set up
+  bool zstd = false;
+  z_stream zs{};
+  bool zs_live = false;
+#ifdef GITFLY_HAVE_ZSTD
+  ZstdDCtx dctx;
+#endif
+  std::ifstream in;
+  std::filesystem::path file;
+  std::uint8_t buf[64 * 1024];
+  std::size_t in_pos = 0; // unread input is buf[in_pos, in_len)
+  std::size_t in_len = 0;
+  bool ended = false;
+
+  ~Impl() {
+    if (zs_live)
+      inflateEnd(&zs);
+  }
+
+  // Read the next chunk of the file into `buf`; false at its end.
+  bool refill() {
+    in.read(reinterpret_cast<char *>(buf), sizeof(buf));
+    in_pos = 0;
+    in_len = static_cast<std::size_t>(in.gcount());
+    return in_len != 0;
+  }
+
+  [[noreturn]] void truncated() const {
+    throw std::runtime_error("compressed stream truncated: " + file.string());
+  }
+
+  // Look at the first chunk to pick the decoder.
+  void start() {
+    if (!refill())
+      truncated();
+    zstd = is_zstd(std::span(buf, in_len));
+    if (zstd) {
+#ifdef GITFLY_HAVE_ZSTD
+      dctx = zstd_dctx(std::span(buf, in_len), dict);
+#else
+      no_zstd();
+#endif
+    } else {
+      if (inflateInit(&zs) != Z_OK)
+        throw std::runtime_error("zlib inflateInit failed");
+      zs_live = true;
+    }
+    started = true;
+  }
+
+  std::size_t read_zlib(std::span<std::uint8_t> out) {
+    // The z_stream points into `buf`, which lives on the heap with Impl, so a
+    // moved reader keeps working.
+    zs.next_out = out.data();
+    zs.avail_out = static_cast<uInt>(std::min(out.size(), kZlibMaxIo));
+    const uInt want = zs.avail_out;
+    while (zs.avail_out == want) {
+      if (in_pos == in_len && !refill())
+        truncated();
+      zs.next_in = buf + in_pos;
+      zs.avail_in = static_cast<uInt>(in_len - in_pos);
+      const int rc = inflate(&zs, Z_NO_FLUSH);
+      in_pos = in_len - zs.avail_in;
+      if (rc == Z_STREAM_END) {
+        ended = true;
+        break;
+      }
+      if (rc != Z_OK && (rc != Z_BUF_ERROR || zs.avail_in != 0))
+        throw std::runtime_error("zlib inflate failed: " + file.string());
+    }
+    return want - zs.avail_out;
+  }
+
+#ifdef GITFLY_HAVE_ZSTD
+  std::size_t read_zstd(std::span<std::uint8_t> out) {
+    ZSTD_outBuffer o{out.data(), out.size(), 0};
+    for (;;) {
+      ZSTD_inBuffer i{buf, in_len, in_pos};
+      const std::size_t rc = zstd_check(ZSTD_decompressStream(dctx.get(), &o, &i), "decompress");
+      in_pos = i.pos;
+      if (rc == 0) {
+        ended = true;
+        break;
+      }
+      if (o.pos != 0)
+        break;
+      if (in_pos == in_len && !refill())
+        truncated();
+    }
+    return o.pos;
+  }
+#endif
+};
+
+ZFileReader::ZFileReader(const std::filesystem::path &file, ZstdDictFn dict)
+    : impl_(std::make_unique<Impl>()) {
+  impl_->dict = std::move(dict);
+  impl_->file = file;
+  impl_->in.open(file, std::ios::binary);
+  if (!impl_->in)
+    throw std::runtime_error("open for read failed: " + file.string());
+}
+
+ZFileReader::~ZFileReader() = default;
+ZFileReader::ZFileReader(ZFileReader &&) noexcept = default;
+ZFileReader &ZFileReader::operator=(ZFileReader &&) noexcept = default;
+
+std::size_t ZFileReader::read(std::span<std::uint8_t> out) {
+  Impl &im = *impl_;
+  if (im.ended || out.empty())
+    return 0;
+  if (!im.started)
+    im.start();
+#ifdef GITFLY_HAVE_ZSTD
+  if (im.zstd)
+    return im.read_zstd(out);
+#endif
+  return im.read_zlib(out);
+}
+
+std::vector<std::uint8_t> z_compress(std::span<const std::uint8_t> data,
+                                     const Compression &compression) {
+  if (compression.codec == Codec::zstd) {
+#ifdef GITFLY_HAVE_ZSTD
+    return zstd_compress({}, data, compression);
+#else
+    no_zstd();
+#endif
+  }
   uLongf bound = compressBound(static_cast<uLong>(data.size()));
   std::vector<std::uint8_t> out(bound);
   const int rc = compress2(out.data(), &bound, reinterpret_cast<const Bytef *>(data.data()),
-                           static_cast<uLong>(data.size()), Z_BEST_SPEED);
+                           static_cast<uLong>(data.size()), compression.level);
   if (rc != Z_OK)
     throw std::runtime_error("zlib compress failed");
   out.resize(bound);
   return out;
 }
 
-std::vector<std::uint8_t> z_decompress(std::span<const std::uint8_t> data) {
+std::vector<std::uint8_t> z_compress(std::span<const std::uint8_t> head,
+                                     std::span<const std::uint8_t> body,
+                                     const Compression &compression) {
+  if (compression.codec == Codec::zstd) {
+#ifdef GITFLY_HAVE_ZSTD
+    return zstd_compress(head, body, compression);
+#else
+    no_zstd();
+#endif
+  }
+  z_stream zs{};
+  if (deflateInit(&zs, compression.level) != Z_OK)
+    throw std::runtime_error("zlib deflateInit failed");
+  std::vector<std::uint8_t> out(deflateBound(&zs, static_cast<uLong>(head.size() + body.size())));
+  // Head, then body, in pieces; the output is drained in pieces too, as
+  // deflateBound of a big input exceeds avail_out as well.
+  std::span<const std::uint8_t> in = head;
+  bool in_body = false;
+  int rc = Z_OK;
+  while (rc == Z_OK) {
+    if (in.empty() && !in_body) {
+      in = body;
+      in_body = true;
+    }
+    const auto piece = in.first(std::min(in.size(), kZlibMaxIo));
+    zs.next_in = const_cast<Bytef *>(reinterpret_cast<const Bytef *>(piece.data()));
+    zs.avail_in = static_cast<uInt>(piece.size());
+    zs.next_out = out.data() + zs.total_out;
+    zs.avail_out = static_cast<uInt>(std::min(out.size() - zs.total_out, kZlibMaxIo));
+    rc = deflate(&zs, in_body && piece.size() == in.size() ? Z_FINISH : Z_NO_FLUSH);
+    in = in.subspan(piece.size() - zs.avail_in);
+  }
+  const auto produced = zs.total_out;
+  deflateEnd(&zs);
+  if (rc != Z_STREAM_END)
+    throw std::runtime_error("zlib compress failed");
+  out.resize(produced);
+  return out;
+}
+
+void z_inflate_each(std::span<const std::uint8_t> data,
+                    const std::function<void(std::span<const std::uint8_t>)> &fn,
+                    const ZstdDictFn &dict) {
+  if (is_zstd(data)) {
+#ifdef GITFLY_HAVE_ZSTD
+    zstd_each(
+        data,
+        [&fn](std::span<const std::uint8_t> chunk) {
+          fn(chunk);
+          return true;
+        },
+        dict, false);
+    return;
+#else
+    (void)dict;
+    no_zstd();
+#endif
+  }
+  z_stream zs{};
+  if (inflateInit(&zs) != Z_OK)
+    throw std::runtime_error("zlib inflateInit failed");
+  std::uint8_t buf[64 * 1024];
+  int rc = Z_OK;
+  try {
+    while (rc != Z_STREAM_END) {
+      if (zs.avail_in == 0 && !data.empty()) {
+        const auto piece = data.first(std::min(data.size(), kZlibMaxIo));
+        zs.next_in = const_cast<Bytef *>(reinterpret_cast<const Bytef *>(piece.data()));
+        zs.avail_in = static_cast<uInt>(piece.size());
+        data = data.subspan(piece.size());
+      }
+      zs.next_out = buf;
+      zs.avail_out = sizeof(buf);
+      rc = inflate(&zs, Z_NO_FLUSH);
+      if (rc != Z_OK && rc != Z_STREAM_END)
+        throw std::runtime_error("zlib inflate failed");
+      const std::size_t produced = sizeof(buf) - zs.avail_out;
+      if (produced == 0 && rc != Z_STREAM_END && zs.avail_in == 0 && data.empty())
+        throw std::runtime_error("zlib stream truncated");
+      if (produced != 0)
+        fn(std::span<const std::uint8_t>(buf, produced));
+    }
+  } catch (...) {
+    inflateEnd(&zs);
+    throw;
+  }
+  inflateEnd(&zs);
+}
+
+std::vector<std::uint8_t> z_decompress(std::span<const std::uint8_t> data,
+                                       const ZstdDictFn &dict) {
+  if (is_zstd(data)) {
+    std::vector<std::uint8_t> out;
+    z_inflate_each(
+        data, [&out](std::span<const std::uint8_t> chunk) { out.insert(out.end(), chunk.begin(), chunk.end()); },
+        dict);
+    return out;
+  }
   std::size_t cap = data.size() * 3;
   cap = std::max<size_t>(cap, 64);
   for (int i = 0; i < 6; ++i) {
@@ -94,4 +718,40 @@ std::vector<std::uint8_t> z_decompress(std::span<const std::uint8_t> data) {
   throw std::runtime_error("zlib uncompress overflow");
 }
 
+std::vector<std::uint8_t> z_decompress_prefix(std::span<const std::uint8_t> data,
+                                              std::size_t limit, const ZstdDictFn &dict) {
+  if (is_zstd(data)) {
+    std::vector<std::uint8_t> out;
+#ifdef GITFLY_HAVE_ZSTD
+    zstd_each(
+        data,
+        [&out, limit](std::span<const std::uint8_t> chunk) {
+          out.insert(out.end(), chunk.begin(),
+                     chunk.begin() + static_cast<std::ptrdiff_t>(std::min(chunk.size(), limit - out.size())));
+          return out.size() < limit;
+        },
+        dict, true);
+#else
+    (void)dict;
+    no_zstd();
+#endif
+    return out;
+  }
+  std::vector<std::uint8_t> out(limit);
+  z_stream zs{};
+  if (inflateInit(&zs) != Z_OK)
+    throw std::runtime_error("zlib inflateInit failed");
+  // Only the start is wanted, so one piece of input is plenty.
+  zs.next_in = const_cast<Bytef *>(reinterpret_cast<const Bytef *>(data.data()));
+  zs.avail_in = static_cast<uInt>(std::min(data.size(), kZlibMaxIo));
+  zs.next_out = out.data();
+  zs.avail_out = static_cast<uInt>(std::min(out.size(), kZlibMaxIo));
+  const int rc = inflate(&zs, Z_SYNC_FLUSH);
+  inflateEnd(&zs);
+  if (rc != Z_OK && rc != Z_STREAM_END && rc != Z_BUF_ERROR)
+    throw std::runtime_error("zlib inflate failed");
+  out.resize(zs.total_out);
+  return out;
+}
+
 } // namespace gitfly::fs
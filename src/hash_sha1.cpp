@@ -1,82 +1,207 @@
 #include "gitfly/hash.hpp"
 #include "gitfly/consts.hpp"
 
+#include "sha1_block.hpp"
+#include "sha1dc.hpp"
+
+#include <algorithm>
 #include <cstdint>
+#include <cstring>
 #include <openssl/evp.h> // EVP_* digest API
 #include <span>
 #include <stdexcept>
 #include <string>
 #include <string_view>
+#include <vector>
 
 namespace gitfly {
 
-oid sha1(std::span<const std::uint8_t> data) {
-  oid out{}; // 20 bytes
+namespace {
+
+constexpr std::uint32_t kSha1Iv[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+
+void sha1_blocks(std::uint32_t *h, const std::uint8_t *data, std::size_t nblocks) {
+  static const detail::Sha1BlockFn fn = detail::sha1_block_fn();
+  fn(h, data, nblocks);
+}
 
-  EVP_MD_CTX *ctx = EVP_MD_CTX_new();
-  if (!ctx) {
-    throw std::runtime_error("EVP_MD_CTX_new failed");
+// Block-buffering and padding shared by Hasher and Sha1dcHasher; `blocks`
+// compresses whole blocks.
+template <typename Blocks>
+void sha1_update(detail::Sha1State &st, std::span<const std::uint8_t> data, Blocks blocks) {
+  const std::uint8_t *p = data.data();
+  std::size_t n = data.size();
+  const std::size_t used = st.length % 64;
+  st.length += n;
+  if (used != 0) {
+    const std::size_t take = std::min(64 - used, n);
+    std::memcpy(st.buf + used, p, take);
+    if (used + take < 64) {
+      return;
+    }
+    blocks(st.h, st.buf, 1);
+    p += take;
+    n -= take;
   }
- 
-  if (EVP_DigestInit_ex(ctx, EVP_sha1(), nullptr) != 1) {
-    EVP_MD_CTX_free(ctx);
-    throw std::runtime_error("EVP_DigestInit_ex(EVP_sha1) failed");
+  if (n >= 64) {
+    blocks(st.h, p, n / 64);
+    p += n / 64 * 64;
+    n %= 64;
   }
-  if (!data.empty() && EVP_DigestUpdate(ctx, data.data(), data.size()) != 1) {
-    EVP_MD_CTX_free(ctx);
-    throw std::runtime_error("EVP_DigestUpdate failed");
+  if (n != 0) {
+    std::memcpy(st.buf, p, n);
   }
+}
 
-  unsigned int len = 0;
-  if (EVP_DigestFinal_ex(ctx, out.data(), &len) != 1) {
-    EVP_MD_CTX_free(ctx);
-    throw std::runtime_error("EVP_DigestFinal_ex failed");
+template <typename Blocks> oid sha1_finish(detail::Sha1State &st, Blocks blocks) {
+  std::size_t used = st.length % 64;
+  st.buf[used++] = 0x80;
+  if (used > 56) {
+    std::memset(st.buf + used, 0, 64 - used);
+    blocks(st.h, st.buf, 1);
+    used = 0;
   }
-  EVP_MD_CTX_free(ctx);
-
-  if (len != out.size()) {
-    throw std::runtime_error("SHA-1 produced unexpected length");
+  std::memset(st.buf + used, 0, 56 - used);
+  const std::uint64_t bits = st.length * 8;
+  for (int i = 0; i < 8; ++i) {
+    st.buf[63 - i] = static_cast<std::uint8_t>(bits >> (8 * i));
+  }
+  blocks(st.h, st.buf, 1);
+  oid out{};
+  for (int i = 0; i < 5; ++i) {
+    const std::uint32_t v = __builtin_bswap32(st.h[i]);
+    std::memcpy(out.data() + 4 * i, &v, 4);
   }
   return out;
 }
 
-std::string to_hex(const oid &id) {
-  static constexpr std::array<char, 16> kHex = {'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f'};
-  std::string s;
-  s.resize(gitfly::consts::kOidHexLen);
-  for (int i = 0; i < gitfly::consts::kOidRawLen; ++i) {
-    unsigned b = id[i];
-    s[(2 * i) + 0] = kHex[(b >> 4) & 0xF];
-    s[(2 * i) + 1] = kHex[b & 0xF];
+void sha1dc_checked(std::uint32_t *h, const std::uint8_t *data, std::size_t nblocks) {
+  if (!detail::sha1dc_blocks(h, data, nblocks)) {
+    throw std::runtime_error("sha1: input is part of a SHA-1 collision attack");
   }
-  return s; 
-} 
+}
 
-bool from_hex(std::string_view hex, oid &out) {
-  if (hex.size() != gitfly::consts::kOidHexLen) {
-    return false;
+// Fetched once: EVP_sha256() makes EVP_DigestInit_ex look the algorithm up again
+// on every call, which shows when hashing many small objects.
+const EVP_MD *sha256_md() {
+  static EVP_MD *const md = EVP_MD_fetch(nullptr, "SHA256", nullptr);
+  if (md == nullptr) {
+    throw std::runtime_error("EVP_MD_fetch(SHA256) failed");
   }
-  auto nibble = [](char c) -> int {
-    if (c >= '0' && c <= '9') {
-      return c - '0';
+  return md;
+}
+
+// Contexts of finished EVP-backed hashers, reused by the next ones on the same
+// thread.
+struct ContextPool {
+  static constexpr std::size_t kMax = 8;
+  std::vector<EVP_MD_CTX *> free;
+
+  ContextPool() = default;
+  ContextPool(const ContextPool &) = delete;
+  ContextPool &operator=(const ContextPool &) = delete;
+  ~ContextPool() {
+    for (auto *ctx : free) {
+      EVP_MD_CTX_free(ctx);
     }
-    if (c >= 'a' && c <= 'f') {
-      return 10 + (c - 'a');
+  }
+};
+
+thread_local ContextPool t_pool;
+
+} // namespace
+
+template <ObjectFormat F> BasicHasher<F>::BasicHasher() {
+  if constexpr (F == ObjectFormat::sha1) {
+    std::memcpy(state_.h, kSha1Iv, sizeof(kSha1Iv));
+    state_.length = 0;
+    return;
+  } else {
+    if (t_pool.free.empty()) {
+      state_ = EVP_MD_CTX_new();
+      if (state_ == nullptr) {
+        throw std::runtime_error("EVP_MD_CTX_new failed");
+      }
+    } else {
+      state_ = t_pool.free.back();
+      t_pool.free.pop_back();
     }
-    if (c >= 'A' && c <= 'F') {
-      return 10 + (c - 'A');
+    if (EVP_DigestInit_ex(state_, sha256_md(), nullptr) != 1) {
+      EVP_MD_CTX_free(state_);
+      throw std::runtime_error("EVP_DigestInit_ex failed");
     }
-    return -1;
-  };
-  for (int i = 0; i < 20; ++i) {
-    int hi = nibble(hex[2 * i]);
-    int lo = nibble(hex[(2 * i) + 1]);
-    if (hi < 0 || lo < 0) {
-      return false;
+  }
+}
+
+template <ObjectFormat F> BasicHasher<F>::~BasicHasher() {
+  if constexpr (F != ObjectFormat::sha1) {
+    if (t_pool.free.size() < ContextPool::kMax) {
+      t_pool.free.push_back(state_);
+    } else {
+      EVP_MD_CTX_free(state_);
     }
-    out[i] = static_cast<std::uint8_t>((hi << 4) | lo);
   }
-  return true;
+}
+
+template <ObjectFormat F>
+BasicHasher<F> &BasicHasher<F>::update(std::span<const std::uint8_t> data) {
+  if constexpr (F == ObjectFormat::sha1) {
+    sha1_update(state_, data, sha1_blocks);
+  } else {
+    if (!data.empty() && EVP_DigestUpdate(state_, data.data(), data.size()) != 1) {
+      throw std::runtime_error("EVP_DigestUpdate failed");
+    }
+  }
+  return *this;
+}
+
+template <ObjectFormat F> basic_oid<F> BasicHasher<F>::finish() {
+  basic_oid<F> out{};
+  if constexpr (F == ObjectFormat::sha1) {
+    out = sha1_finish(state_, sha1_blocks);
+  } else {
+    unsigned int len = 0;
+    if (EVP_DigestFinal_ex(state_, out.data(), &len) != 1) {
+      throw std::runtime_error("EVP_DigestFinal_ex failed");
+    }
+    if (len != out.size()) {
+      throw std::runtime_error("digest produced unexpected length");
+    }
+  }
+  return out;
+}
+
+template class BasicHasher<ObjectFormat::sha1>;
+template class BasicHasher<ObjectFormat::sha256>;
+
+Sha1dcHasher::Sha1dcHasher() : state_{} {
+  std::memcpy(state_.h, kSha1Iv, sizeof(kSha1Iv));
+}
+
+Sha1dcHasher &Sha1dcHasher::update(std::span<const std::uint8_t> data) {
+  sha1_update(state_, data, sha1dc_checked);
+  return *this;
+}
+
+oid Sha1dcHasher::finish() { return sha1_finish(state_, sha1dc_checked); }
+
+oid sha1(std::span<const std::uint8_t> data) { return Hasher{}.update(data).finish(); }
+
+oid256 sha256(std::span<const std::uint8_t> data) { return Sha256Hasher{}.update(data).finish(); }
+
+std::string_view format_name(ObjectFormat format) {
+  return format == ObjectFormat::sha256 ? FormatTraits<ObjectFormat::sha256>::kName
+                                        : FormatTraits<ObjectFormat::sha1>::kName;
+}
+
+std::optional<ObjectFormat> parse_object_format(std::string_view name) {
+  if (name == FormatTraits<ObjectFormat::sha1>::kName) {
+    return ObjectFormat::sha1;
+  }
+  if (name == FormatTraits<ObjectFormat::sha256>::kName) {
+    return ObjectFormat::sha256;
+  }
+  return std::nullopt;
 }
 
 } // namespace gitfly
@@ -0,0 +1,147 @@
+// Hex encoding of object ids. With SSE2 (every x86-64) 16 bytes are converted
+// per step and the tail of a 20-byte id is an overlapping step, so there is no
+// per-nibble loop at all; other targets use a lookup table.
+#include "gitfly/hash.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace gitfly {
+
+namespace {
+
+constexpr char kHexDigits[] = "0123456789abcdef";
+
+// Nibble value of each byte, or -1 for a non-hex character.
+constexpr std::array<std::int8_t, 256> kNibble = [] {
+  std::array<std::int8_t, 256> t{};
+  for (auto &v : t) {
+    v = -1;
+  }
+  for (int c = '0'; c <= '9'; ++c) {
+    t[c] = static_cast<std::int8_t>(c - '0');
+  }
+  for (int c = 0; c < 6; ++c) {
+    t['a' + c] = static_cast<std::int8_t>(10 + c);
+    t['A' + c] = static_cast<std::int8_t>(10 + c);
+  }
+  return t;
+}();
+
+void encode_scalar(const std::uint8_t *in, std::size_t n, char *out) {
+  for (std::size_t i = 0; i < n; ++i) {
+    out[2 * i] = kHexDigits[in[i] >> 4];
+    out[(2 * i) + 1] = kHexDigits[in[i] & 0xF];
+  }
+}
+
+bool decode_scalar(const char *in, std::size_t n, std::uint8_t *out) {
+  for (std::size_t i = 0; i < n; ++i) {
+    const int hi = kNibble[static_cast<unsigned char>(in[2 * i])];
+    const int lo = kNibble[static_cast<unsigned char>(in[(2 * i) + 1])];
+    if (hi < 0 || lo < 0) {
+      return false;
+    }
+    out[i] = static_cast<std::uint8_t>((hi << 4) | lo);
+  }
+  return true;
+}
+
+#if defined(__SSE2__)
+
+// Nibbles 0..15 -> '0'..'9', 'a'..'f'.
+inline __m128i nibbles_to_ascii(__m128i d) {
+  const __m128i over9 = _mm_cmpgt_epi8(d, _mm_set1_epi8(9));
+  return _mm_add_epi8(_mm_add_epi8(d, _mm_set1_epi8('0')),
+                      _mm_and_si128(over9, _mm_set1_epi8('a' - '0' - 10)));
+}
+
+// 16 bytes -> 32 hex chars.
+inline void encode16(const std::uint8_t *in, char *out) {
+  const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in));
+  const __m128i mask = _mm_set1_epi8(0x0F);
+  const __m128i hi = _mm_and_si128(_mm_srli_epi16(x, 4), mask);
+  const __m128i lo = _mm_and_si128(x, mask);
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(out), nibbles_to_ascii(_mm_unpacklo_epi8(hi, lo)));
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 16),
+                   nibbles_to_ascii(_mm_unpackhi_epi8(hi, lo)));
+}
+
+// 16 hex chars -> their nibble values; clears lanes of `valid` that are not hex.
+inline __m128i ascii_to_nibbles(__m128i c, __m128i &valid) {
+  const __m128i lower = _mm_or_si128(c, _mm_set1_epi8(0x20)); // 'A'..'F' -> 'a'..'f'
+  const __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)),
+                                      _mm_cmplt_epi8(c, _mm_set1_epi8('9' + 1)));
+  const __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                                      _mm_cmplt_epi8(lower, _mm_set1_epi8('f' + 1)));
+  valid = _mm_and_si128(valid, _mm_or_si128(digit, alpha));
+  return _mm_or_si128(_mm_and_si128(digit, _mm_sub_epi8(c, _mm_set1_epi8('0'))),
+                      _mm_and_si128(alpha, _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10))));
+}
+
+// Pairs of nibbles (first one high) -> bytes, as eight 16-bit lanes.
+inline __m128i join_nibbles(__m128i v) {
+  const __m128i first = _mm_and_si128(v, _mm_set1_epi16(0x00FF));
+  return _mm_or_si128(_mm_slli_epi16(first, 4), _mm_srli_epi16(v, 8));
+}
+
+// 32 hex chars -> 16 bytes. False if any char is not hex.
+inline bool decode16(const char *in, std::uint8_t *out) {
+  __m128i valid = _mm_set1_epi8(-1);
+  const __m128i a =
+      ascii_to_nibbles(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in)), valid);
+  const __m128i b =
+      ascii_to_nibbles(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in + 16)), valid);
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(out),
+                   _mm_packus_epi16(join_nibbles(a), join_nibbles(b)));
+  return _mm_movemask_epi8(valid) == 0xFFFF;
+}
+
+#endif
+
+} // namespace
+
+void hex_encode(std::span<const std::uint8_t> bytes, char *out) {
+  const std::size_t n = bytes.size();
+#if defined(__SSE2__)
+  if (n >= 16) {
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+      encode16(bytes.data() + i, out + (2 * i));
+    }
+    if (i < n) {
+      encode16(bytes.data() + n - 16, out + (2 * (n - 16))); // overlaps the last step
+    }
+    return;
+  }
+#endif
+  encode_scalar(bytes.data(), n, out);
+}
+
+bool hex_decode(std::string_view hex, std::uint8_t *out) {
+  if (hex.size() % 2 != 0) {
+    return false;
+  }
+  const std::size_t n = hex.size() / 2;
+#if defined(__SSE2__)
+  if (n >= 16) {
+    bool ok = true;
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+      ok &= decode16(hex.data() + (2 * i), out + i);
+    }
+    if (i < n) {
+      ok &= decode16(hex.data() + (2 * (n - 16)), out + n - 16);
+    }
+    return ok;
+  }
+#endif
+  return decode_scalar(hex.data(), n, out);
+}
+
+} // namespace gitfly
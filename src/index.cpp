@@ -2,6 +2,8 @@
 
 #include "gitfly/fs.hpp"
 #include "gitfly/hash.hpp"
+#include "gitfly/object_store.hpp"
+#include "gitfly/object_writer.hpp"
 #include "gitfly/repo.hpp"
 
 #include <algorithm>
@@ -10,6 +12,7 @@
 #include <fstream>
 #include <sstream>
 #include <stdexcept>
+#include <unordered_map>
 
 namespace gitfly {
 
@@ -44,12 +47,16 @@ void Index::load() {
       continue;
 
     // format: "<octal> <hex> <path>"
-    std::istringstream is(line);
-    std::string mode_str, hex, path;
-    if (!(is >> mode_str >> hex))
-      continue;             // skip malformed
-    std::getline(is, path); // rest of line
-    path = trim(path);
+    constexpr std::string_view kSpace = " \t\r\f\v";
+    const std::string_view fields(line);
+    const auto mode_end = fields.find_first_of(kSpace);
+    const auto hex_begin = fields.find_first_not_of(kSpace, mode_end);
+    if (mode_end == std::string_view::npos || hex_begin == std::string_view::npos)
+      continue; // skip malformed
+    const auto hex_end = std::min(fields.find_first_of(kSpace, hex_begin), fields.size());
+    const std::string_view mode_str = fields.substr(0, mode_end);
+    const std::string_view hex = fields.substr(hex_begin, hex_end - hex_begin);
+    std::string path = trim(std::string(fields.substr(hex_end))); // rest of line
 
     // parse octal
     std::uint32_t mode = 0;
@@ -92,11 +99,8 @@ void Index::save() const {
 
 void Index::add_path(const std::filesystem::path &wd, std::string_view relpath,
                      const Repository &repo, std::uint32_t mode) {
-  // Read file
-  auto bytes = fs::read_file(wd / std::filesystem::path(relpath));
-
-  // Write blob -> hex oid
-  const auto hex_oid = repo.write_blob(bytes);
+  // Write blob -> hex oid, streamed so the file is never held in memory
+  const auto hex_oid = repo.write_blob_file(wd / std::filesystem::path(relpath));
 
   // Parse hex into Oid (binary)
   oid bin{};
@@ -118,6 +122,59 @@ void Index::add_path(const std::filesystem::path &wd, std::string_view relpath,
   std::ranges::sort(entries_, [](auto &a, auto &b) { return a.path < b.path; });
 }
 
+void Index::add_paths(const std::filesystem::path &wd, const std::vector<std::string> &relpaths,
+                      const Repository &repo, std::uint32_t mode) {
+  // Small files are read a batch at a time so memory stays bounded for large
+  // adds; files above kStreamMin are streamed one by one instead.
+  constexpr std::size_t kBatch = 256;
+  constexpr std::uintmax_t kStreamMin = 1u << 20;
+  const ObjectStore store{repo.git_dir()};
+  if (relpaths.size() >= kBatch) {
+    store.load_index(); // enough objects to repay scanning the store once
+  }
+  ObjectWriter writer{store};
+  std::unordered_map<std::string, std::size_t> pos;
+  for (std::size_t i = 0; i < entries_.size(); ++i) {
+    pos.emplace(entries_[i].path, i);
+  }
+  auto set_entry = [&](const std::string &relpath, const oid &id) {
+    if (auto it = pos.find(relpath); it != pos.end()) {
+      entries_[it->second].mode = mode;
+      entries_[it->second].oid = id;
+    } else {
+      pos.emplace(relpath, entries_.size());
+      entries_.push_back(IndexEntry{.mode = mode, .oid = id, .path = relpath});
+    }
+  };
+  std::vector<std::size_t> batched;
+  std::vector<std::vector<std::uint8_t>> contents;
+  std::vector<std::span<const std::uint8_t>> payloads;
+  for (std::size_t first = 0; first < relpaths.size(); first += kBatch) {
+    const std::size_t last = std::min(relpaths.size(), first + kBatch);
+    batched.clear();
+    contents.clear();
+    for (std::size_t i = first; i < last; ++i) {
+      const auto file = wd / std::filesystem::path(relpaths[i]);
+      if (std::filesystem::file_size(file) > kStreamMin) {
+        oid id{};
+        from_hex(repo.write_blob_file(file), id);
+        set_entry(relpaths[i], id);
+        continue;
+      }
+      batched.push_back(i);
+      contents.push_back(fs::read_file(file));
+    }
+    payloads.assign(contents.begin(), contents.end());
+    const auto ids = hash_objects(consts::kTypeBlob, payloads);
+    for (std::size_t k = 0; k < batched.size(); ++k) {
+      writer.write_hashed(ids[k], consts::kTypeBlob, std::move(contents[k]));
+      set_entry(relpaths[batched[k]], ids[k]);
+    }
+  }
+  writer.flush(); // the index about to be saved names these blobs
+  std::ranges::sort(entries_, [](auto &a, auto &b) { return a.path < b.path; });
+}
+
 void Index::remove_path(std::string_view relpath) {
   const std::string key(relpath);
   std::erase_if(entries_, [&](const IndexEntry &e) { return e.path == key; });
@@ -126,7 +183,7 @@ void Index::remove_path(std::string_view relpath) {
 std::map<std::string, std::string> Index::as_path_oid_map() const {
   std::map<std::string, std::string> m;
   for (const auto &e : entries_) {
-    m[e.path] = to_hex(e.oid);
+    m.emplace_hint(m.end(), e.path, to_hex(e.oid)); // entries_ is sorted by path
   }
   return m;
 }
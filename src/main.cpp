@@ -1,5 +1,7 @@
 #include "cli/registry.hpp"
+#include "gitfly/repo.hpp"
 
+#include <filesystem>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -0,0 +1,295 @@
+#include "gitfly/object_index.hpp"
+
+#include "gitfly/consts.hpp"
+#include "gitfly/fs.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <string_view>
+
+namespace stdfs = std::filesystem;
+
+namespace gitfly {
+
+namespace {
+
+constexpr std::string_view kMagic = "GFOI";
+constexpr std::uint32_t kVersion = 1;
+
+// Bloom filter shape: ~10 bits and 7 probes per id give about 1% false
+// positives. Ids are hash output already, so the probes are taken from their
+// bytes instead of hashing them again.
+constexpr std::size_t kBitsPerId = 10;
+constexpr std::size_t kMinBits = 1U << 14U;
+constexpr int kProbes = 7;
+
+// Stand-ins for a fan-out directory's mtime: not known to be settled (always
+// re-read), and absent.
+constexpr std::int64_t kUnknown = std::numeric_limits<std::int64_t>::min();
+constexpr std::int64_t kMissing = kUnknown + 1;
+
+// A directory modified this recently may change again within the same mtime
+// tick, which a later open could not tell apart; such directories are re-read.
+constexpr auto kRacyWindow = std::chrono::seconds(2);
+
+void put_u32(std::string &out, std::uint32_t v) {
+  for (int i = 0; i < 4; ++i)
+    out.push_back(static_cast<char>((v >> (8 * i)) & 0xffU));
+}
+
+void put_u64(std::string &out, std::uint64_t v) {
+  for (int i = 0; i < 8; ++i)
+    out.push_back(static_cast<char>((v >> (8 * i)) & 0xffU));
+}
+
+// Reads a little-endian value at `pos`, advancing it; false if truncated.
+bool get_le(std::string_view in, std::size_t &pos, int bytes, std::uint64_t &v) {
+  if (pos > in.size() || in.size() - pos < static_cast<std::size_t>(bytes))
+    return false;
+  v = 0;
+  for (int i = 0; i < bytes; ++i)
+    v |= std::uint64_t{static_cast<unsigned char>(in[pos + i])} << (8 * i);
+  pos += static_cast<std::size_t>(bytes);
+  return true;
+}
+
+std::int64_t dir_mtime(const stdfs::path &dir) {
+  std::error_code ec;
+  const auto t = stdfs::last_write_time(dir, ec);
+  return ec ? kMissing : static_cast<std::int64_t>(t.time_since_epoch().count());
+}
+
+std::string fan_name(std::size_t b) {
+  static constexpr char kDigits[] = "0123456789abcdef";
+  return {kDigits[b >> 4U], kDigits[b & 15U]};
+}
+
+} // namespace
+
+ObjectIndex::ObjectIndex(stdfs::path objects_dir, ObjectFormat format, stdfs::path file)
+    : dir_(std::move(objects_dir)),
+      file_(file.empty() ? dir_ / consts::kObjectIndexFile : std::move(file)),
+      width_(format == ObjectFormat::sha256 ? std::tuple_size_v<oid256> : std::tuple_size_v<oid>) {
+  std::array<std::int64_t, 256> saved{};
+  saved.fill(kUnknown);
+  const bool loaded = load(saved);
+
+  // Keep the ids of directories whose mtime has not moved; re-read the rest.
+  const auto racy = static_cast<std::int64_t>(
+      (stdfs::file_time_type::clock::now() - kRacyWindow).time_since_epoch().count());
+  std::array<std::int64_t, 256> mtimes{};
+  std::vector<std::uint8_t> ids;
+  ids.reserve(ids_.size());
+  Fanout fan{};
+  std::vector<std::uint8_t> found;
+  for (std::size_t b = 0; b < 256; ++b) {
+    fan[b] = static_cast<std::uint32_t>(ids.size() / width_);
+    const auto sub = dir_ / fan_name(b);
+    const std::int64_t m = dir_mtime(sub);
+    if (m == saved[b]) {
+      ids.insert(ids.end(), ids_.begin() + static_cast<std::ptrdiff_t>(fan_[b] * width_),
+                 ids_.begin() + static_cast<std::ptrdiff_t>(fan_[b + 1] * width_));
+      mtimes[b] = m;
+      continue;
+    }
+    ++rescanned_;
+    mtimes[b] = m > racy ? kUnknown : m;
+    if (m == kMissing)
+      continue;
+    found.clear();
+    std::error_code ec;
+    std::uint8_t raw[32];
+    raw[0] = static_cast<std::uint8_t>(b);
+    for (const auto &f : stdfs::directory_iterator(sub, ec)) {
+      const std::string name = f.path().filename().string();
+      // Skips the temporaries of writes in progress
+      if (name.size() == 2 * (width_ - 1) && hex_decode(name, raw + 1) && f.is_regular_file(ec))
+        found.insert(found.end(), raw, raw + width_);
+    }
+    // Sort this directory's ids as fixed-width records
+    std::vector<std::size_t> order(found.size() / width_);
+    for (std::size_t i = 0; i < order.size(); ++i)
+      order[i] = i * width_;
+    std::ranges::sort(order, [&](std::size_t x, std::size_t y) {
+      return std::memcmp(found.data() + x, found.data() + y, width_) < 0;
+    });
+    for (const std::size_t off : order)
+      ids.insert(ids.end(), found.begin() + static_cast<std::ptrdiff_t>(off),
+                 found.begin() + static_cast<std::ptrdiff_t>(off + width_));
+  }
+  fan[256] = static_cast<std::uint32_t>(ids.size() / width_);
+  ids_ = std::move(ids);
+  fan_ = fan;
+
+  if (rescanned_ != 0 || !loaded) {
+    build_bloom();
+    try {
+      save(mtimes);
+    } catch (const std::exception &) {
+      // Only a cache; the next open rebuilds what it lacks
+    }
+  }
+}
+
+bool ObjectIndex::load(std::array<std::int64_t, 256> &mtimes) {
+  if (!fs::exists(file_))
+    return false;
+  std::vector<std::uint8_t> bytes;
+  try {
+    bytes = fs::read_file(file_);
+  } catch (const std::exception &) {
+    return false;
+  }
+  const std::string_view in(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+  if (in.size() < kMagic.size() + consts::kOidRawLen || !in.starts_with(kMagic))
+    return false;
+  const auto body = in.substr(0, in.size() - consts::kOidRawLen);
+  const auto sum = sha1(body);
+  if (std::memcmp(sum.data(), in.data() + body.size(), sum.size()) != 0)
+    return false;
+
+  // A bad or foreign index is rebuilt rather than reported: it is only a cache
+  std::size_t pos = kMagic.size();
+  std::uint64_t version = 0, width = 0, count = 0, words = 0;
+  if (!get_le(body, pos, 4, version) || version != kVersion || !get_le(body, pos, 4, width) ||
+      width != width_ || !get_le(body, pos, 4, count))
+    return false;
+  std::array<std::int64_t, 256> stamps{};
+  for (auto &m : stamps) {
+    std::uint64_t v = 0;
+    if (!get_le(body, pos, 8, v))
+      return false;
+    m = static_cast<std::int64_t>(v);
+  }
+  if (!get_le(body, pos, 4, words) || words == 0 || !std::has_single_bit(words) ||
+      body.size() - pos != words * 8 + count * width_)
+    return false;
+  std::vector<std::uint64_t> bloom(words);
+  for (auto &w : bloom)
+    get_le(body, pos, 8, w);
+  std::vector<std::uint8_t> ids(body.begin() + static_cast<std::ptrdiff_t>(pos), body.end());
+
+  Fanout fan{};
+  for (std::size_t i = 0; i < count; ++i) {
+    if (i != 0 && std::memcmp(ids.data() + (i - 1) * width_, ids.data() + i * width_, width_) >= 0)
+      return false;
+    ++fan[ids[i * width_] + 1U];
+  }
+  for (std::size_t b = 0; b < 256; ++b)
+    fan[b + 1] += fan[b];
+
+  mtimes = stamps;
+  ids_ = std::move(ids);
+  fan_ = fan;
+  bloom_ = std::move(bloom);
+  return true;
+}
+
+void ObjectIndex::save(const std::array<std::int64_t, 256> &mtimes) const {
+  std::string out(kMagic);
+  put_u32(out, kVersion);
+  put_u32(out, static_cast<std::uint32_t>(width_));
+  put_u32(out, static_cast<std::uint32_t>(ids_.size() / width_));
+  for (const std::int64_t m : mtimes)
+    put_u64(out, static_cast<std::uint64_t>(m));
+  put_u32(out, static_cast<std::uint32_t>(bloom_.size()));
+  for (const std::uint64_t w : bloom_)
+    put_u64(out, w);
+  out.append(reinterpret_cast<const char *>(ids_.data()), ids_.size());
+  const auto sum = sha1(out);
+  out.append(reinterpret_cast<const char *>(sum.data()), sum.size());
+  stdfs::create_directories(file_.parent_path());
+  fs::write_file_atomic(file_, std::span<const std::uint8_t>(
+                                  reinterpret_cast<const std::uint8_t *>(out.data()), out.size()));
+}
+
+void ObjectIndex::build_bloom() {
+  const std::size_t n = ids_.size() / width_ + added_.size();
+  bloom_.assign(std::bit_ceil(std::max(kMinBits, n * kBitsPerId)) / 64, 0);
+  for (std::size_t off = 0; off < ids_.size(); off += width_)
+    set_bits(std::span(ids_.data() + off, width_));
+  for (const auto &id : added_)
+    set_bits(std::span(reinterpret_cast<const std::uint8_t *>(id.data()), id.size()));
+}
+
+namespace {
+
+// Probe i of `id` in a filter of `mask` + 1 bits (double hashing).
+template <typename Fn> bool each_probe(std::span<const std::uint8_t> id, std::uint64_t mask, Fn fn) {
+  std::uint64_t h1 = 0, h2 = 0;
+  std::memcpy(&h1, id.data() + 4, 8);
+  std::memcpy(&h2, id.data() + 12, 8);
+  h2 |= 1U;
+  for (int i = 0; i < kProbes; ++i) {
+    if (!fn((h1 + static_cast<std::uint64_t>(i) * h2) & mask))
+      return false;
+  }
+  return true;
+}
+
+} // namespace
+
+bool ObjectIndex::maybe(std::span<const std::uint8_t> id) const {
+  return each_probe(id, bloom_.size() * 64 - 1, [this](std::uint64_t bit) {
+    return (bloom_[bit >> 6U] >> (bit & 63U) & 1U) != 0;
+  });
+}
+
+void ObjectIndex::set_bits(std::span<const std::uint8_t> id) {
+  each_probe(id, bloom_.size() * 64 - 1, [this](std::uint64_t bit) {
+    bloom_[bit >> 6U] |= std::uint64_t{1} << (bit & 63U);
+    return true;
+  });
+}
+
+bool ObjectIndex::in_table(std::span<const std::uint8_t> id) const {
+  std::size_t lo = fan_[id[0]];
+  std::size_t hi = fan_[id[0] + 1U];
+  while (lo < hi) {
+    const std::size_t mid = lo + (hi - lo) / 2;
+    const int c = std::memcmp(ids_.data() + mid * width_, id.data(), width_);
+    if (c == 0)
+      return true;
+    if (c < 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return false;
+}
+
+bool ObjectIndex::contains(std::span<const std::uint8_t> id) const {
+  if (id.size() != width_)
+    return false;
+  const std::lock_guard lk(mu_);
+  if (!maybe(id))
+    return false;
+  return in_table(id) ||
+         added_.contains(std::string(reinterpret_cast<const char *>(id.data()), id.size()));
+}
+
+bool ObjectIndex::add(std::span<const std::uint8_t> id) {
+  if (id.size() != width_)
+    return false;
+  const std::lock_guard lk(mu_);
+  if (maybe(id) && in_table(id))
+    return false;
+  if (!added_.emplace(reinterpret_cast<const char *>(id.data()), id.size()).second)
+    return false;
+  // Keep the false-positive rate down as a bulk import grows the set
+  if ((ids_.size() / width_ + added_.size()) * kBitsPerId > bloom_.size() * 64 * 2)
+    build_bloom();
+  else
+    set_bits(id);
+  return true;
+}
+
+std::size_t ObjectIndex::size() const {
+  const std::lock_guard lk(mu_);
+  return ids_.size() / width_ + added_.size();
+}
+
+} // namespace gitfly
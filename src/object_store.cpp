@@ -1,28 +1,240 @@
 #include "gitfly/object_store.hpp"
 
+#include "gitfly/config.hpp"
 #include "gitfly/consts.hpp"
 #include "gitfly/fs.hpp"
+#include "gitfly/object_index.hpp"
+#include "gitfly/util.hpp"
 
 #include <algorithm>
+#include <charconv>
+#include <fstream>
 #include <stdexcept>
 
 namespace gfs = gitfly::fs;
 
 namespace gitfly {
 
-std::filesystem::path ObjectStore::path_for_oid(const oid &object_id) const {
-  const std::string hex = to_hex(object_id);
+std::filesystem::path ObjectStore::path_for_hex(std::string_view hex) const {
   const std::filesystem::path dir = gitdir_ / consts::kObjectsDir / hex.substr(0, 2);
   std::filesystem::path file = dir / hex.substr(2);
   return file;
 }
 
+namespace {
+
+constexpr int kMaxAlternateDepth = 5;
+
+// Append the alternates listed under `objects_dir` (and theirs) to `out`.
+void load_alternates(const std::filesystem::path &objects_dir, int depth,
+                     std::vector<std::filesystem::path> &out) {
+  if (depth > kMaxAlternateDepth) {
+    return;
+  }
+  std::ifstream in(objects_dir / consts::kAlternatesFile);
+  for (std::string line; std::getline(in, line);) {
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+    if (line.empty() || line.front() == '#') {
+      continue;
+    }
+    std::filesystem::path dir{line};
+    if (dir.is_relative()) {
+      dir = objects_dir / dir;
+    }
+    dir = dir.lexically_normal();
+    if (!gfs::exists(dir) || std::ranges::find(out, dir) != out.end()) {
+      continue;
+    }
+    out.push_back(dir);
+    load_alternates(dir, depth + 1, out);
+  }
+}
+
+} // namespace
+
+namespace {
+
+// Small objects (trees, commits, most source files) compress poorly on their
+// own; those up to this size use the trained zstd dictionary.
+constexpr std::uint64_t kDictMaxPayload = 16 * 1024;
+constexpr std::size_t kDictCapacity = 32 * 1024;
+constexpr std::size_t kDictMinSamples = 64;
+constexpr std::size_t kDictMaxSamples = 20000;
+
+std::optional<int> parse_level(const std::map<std::string, std::string> &cfg, std::string_view key,
+                               gfs::Codec codec) {
+  const auto it = cfg.find(std::string(key));
+  if (it == cfg.end()) {
+    return std::nullopt;
+  }
+  const auto &v = it->second;
+  const auto [lo, hi] = codec == gfs::Codec::zstd ? std::pair{1, 22} : std::pair{0, 9};
+  int level = 0;
+  if (auto [ptr, ec] = std::from_chars(v.data(), v.data() + v.size(), level);
+      ec != std::errc{} || ptr != v.data() + v.size() || level < lo || level > hi) {
+    throw std::runtime_error("object_store: " + std::string(key) + " must be " + std::to_string(lo) +
+                             ".." + std::to_string(hi) + ", not '" + v + "'");
+  }
+  return level;
+}
+
+} // namespace
+
+const ObjectStore::Settings &ObjectStore::settings() const {
+  if (settings_) {
+    return *settings_;
+  }
+  const auto cfg = config_entries(gitdir_.parent_path());
+  Settings s;
+  if (const auto it = cfg.find(std::string(consts::kCfgObjectCodec));
+      it != cfg.end() && it->second != "zlib") {
+    if (it->second != "zstd") {
+      throw std::runtime_error("object_store: unknown object codec '" + it->second + "'");
+    }
+    if (!gfs::codec_available(gfs::Codec::zstd)) {
+      throw std::runtime_error("object_store: objects here are zstd, which this build lacks");
+    }
+    s.codec = gfs::Codec::zstd;
+  }
+  const auto common = parse_level(cfg, consts::kCfgCompression, s.codec);
+  s.loose_level = parse_level(cfg, consts::kCfgLooseCompression, s.codec)
+                      .value_or(common.value_or(s.codec == gfs::Codec::zstd ? 3 : 1));
+  s.pack_level = parse_level(cfg, consts::kCfgPackCompression, gfs::Codec::zlib);
+  if (!s.pack_level) {
+    s.pack_level = common;
+  }
+  if (const auto it = cfg.find(std::string(consts::kCfgZstdDict)); it != cfg.end()) {
+    const auto &v = it->second;
+    if (auto [ptr, ec] = std::from_chars(v.data(), v.data() + v.size(), s.dict_id);
+        ec != std::errc{} || ptr != v.data() + v.size()) {
+      throw std::runtime_error("object_store: bad zstd dictionary id '" + v + "'");
+    }
+  }
+  settings_ = s;
+  return *settings_;
+}
+
+gfs::Codec ObjectStore::codec() const { return settings().codec; }
+
+std::optional<int> ObjectStore::pack_compression() const { return settings().pack_level; }
+
+gfs::Compression ObjectStore::loose_compression(std::uint64_t payload_size) const {
+  const auto &s = settings();
+  gfs::Compression c{.codec = s.codec, .level = s.loose_level, .dict = {}};
+  if (s.codec == gfs::Codec::zstd && s.dict_id != 0 && payload_size <= kDictMaxPayload) {
+    c.dict = dictionaries()(s.dict_id);
+  }
+  return c;
+}
+
+gfs::ZstdDictFn ObjectStore::dictionaries() const {
+  return [dir = gitdir_ / consts::kObjectsDir / consts::kZstdDictDir,
+          cache = dicts_](std::uint32_t id) -> std::span<const std::uint8_t> {
+    auto it = cache->find(id);
+    if (it == cache->end()) {
+      const auto file = dir / (std::to_string(id) + ".dict");
+      if (!gfs::exists(file)) {
+        throw std::runtime_error("object_store: missing zstd dictionary " + file.string());
+      }
+      it = cache->emplace(id, gfs::read_file(file)).first;
+    }
+    return it->second;
+  };
+}
+
+std::uint32_t ObjectStore::train_zstd_dictionary() const {
+  if (codec() != gfs::Codec::zstd) {
+    throw std::runtime_error("object_store: dictionaries are for zstd repositories");
+  }
+  // Train on whole loose images ("<type> <size>\0" included): that is what the
+  // dictionary will compress.
+  std::vector<std::vector<std::uint8_t>> samples;
+  for (const auto &hex : list()) {
+    if (samples.size() == kDictMaxSamples) {
+      break;
+    }
+    if (read_header(hex).size <= kDictMaxPayload) {
+      samples.push_back(gfs::z_decompress(gfs::read_file(locate_hex(hex)), dictionaries()));
+    }
+  }
+  if (samples.size() < kDictMinSamples) {
+    throw std::runtime_error("object_store: too few small objects to train a dictionary on");
+  }
+  const auto dict = gfs::zstd_train_dictionary(samples, kDictCapacity);
+  const std::uint32_t id = gfs::zstd_dictionary_id(dict);
+  gfs::write_file_atomic(
+      gitdir_ / consts::kObjectsDir / consts::kZstdDictDir / (std::to_string(id) + ".dict"), dict);
+  config_set(gitdir_.parent_path(), consts::kCfgZstdDict, std::to_string(id));
+  settings_.reset();
+  return id;
+}
+
+const std::vector<std::filesystem::path> &ObjectStore::alternates() const {
+  if (!alternates_) {
+    alternates_.emplace();
+    load_alternates(gitdir_ / consts::kObjectsDir, 1, *alternates_);
+  }
+  return *alternates_;
+}
+
+void ObjectStore::add_alternate(const std::filesystem::path &objects_dir) const {
+  const auto dir = std::filesystem::absolute(objects_dir).lexically_normal();
+  if (std::ranges::find(alternates(), dir) != alternates().end()) {
+    return;
+  }
+  const auto file = gitdir_ / consts::kObjectsDir / consts::kAlternatesFile;
+  gfs::ensure_parent_dir(file);
+  std::ofstream(file, std::ios::app) << dir.string() << "\n";
+  alternates_.reset();
+}
+
+std::vector<std::string> ObjectStore::list() const {
+  std::vector<std::string> out;
+  auto scan = [&out, this](const std::filesystem::path &objects_dir) {
+    std::error_code ec;
+    for (const auto &fan : std::filesystem::directory_iterator(objects_dir, ec)) {
+      const std::string prefix = fan.path().filename().string();
+      if (prefix.size() != 2 || !fan.is_directory()) {
+        continue; // e.g. info/
+      }
+      for (const auto &f : std::filesystem::directory_iterator(fan.path())) {
+        std::string hex = prefix + f.path().filename().string();
+        if (f.is_regular_file() && looks_hex_oid(hex, format_)) {
+          out.push_back(std::move(hex));
+        }
+      }
+    }
+  };
+  scan(gitdir_ / consts::kObjectsDir);
+  for (const auto &dir : alternates()) {
+    scan(dir);
+  }
+  std::ranges::sort(out);
+  out.erase(std::unique(out.begin(), out.end()), out.end());
+  return out;
+}
+
+std::filesystem::path ObjectStore::locate_hex(std::string_view hex) const {
+  auto local = path_for_hex(hex);
+  if (gfs::exists(local)) {
+    return local;
+  }
+  for (const auto &dir : alternates()) {
+    auto alt = dir / hex.substr(0, 2) / hex.substr(2);
+    if (gfs::exists(alt)) {
+      return alt;
+    }
+  }
+  return local;
+}
+
 Object ObjectStore::read(std::string_view hex_oid) const {
-  oid oid{};
-  if (!from_hex(hex_oid, oid)) {
+  if (!looks_hex_oid(hex_oid, format_)) {
     throw std::runtime_error("object_store: bad oid hex");
   }
-  auto store = gfs::z_decompress(gfs::read_file(path_for_oid(oid)));
+  auto store = gfs::z_decompress(gfs::read_file(locate_hex(hex_oid)), dictionaries());
 
   auto it_space = std::ranges::find(store, static_cast<std::uint8_t>(' '));
   auto it_nul = std::find(it_space + 1, store.end(), static_cast<std::uint8_t>('\0'));
@@ -35,20 +247,336 @@ Object ObjectStore::read(std::string_view hex_oid) const {
 }
 
 std::string ObjectStore::write(std::string_view type, std::span<const std::uint8_t> payload) const {
+  return format_ == ObjectFormat::sha256 ? write_as<ObjectFormat::sha256>(type, payload)
+                                         : write_as<ObjectFormat::sha1>(type, payload);
+}
+
+template <ObjectFormat F>
+std::string ObjectStore::write_as(std::string_view type,
+                                  std::span<const std::uint8_t> payload) const {
   const std::string hdr = object_header(type, payload.size());
-  std::vector<std::uint8_t> store;
-  store.reserve(hdr.size() + payload.size());
-  store.insert(store.end(), reinterpret_cast<const std::uint8_t *>(hdr.data()),
-               reinterpret_cast<const std::uint8_t *>(hdr.data()) + hdr.size());
-  store.insert(store.end(), payload.begin(), payload.end());
+  const std::span<const std::uint8_t> hdr_bytes(reinterpret_cast<const std::uint8_t *>(hdr.data()),
+                                                hdr.size());
+  const auto store_id = BasicHasher<F>{}.update(hdr_bytes).update(payload).finish();
+  std::string hex = to_hex(store_id);
+  // An object an alternate already holds is not duplicated here.
+  if (!stored(hex)) {
+    auto compressed = gfs::z_compress(hdr_bytes, payload, loose_compression(payload.size()));
+    gfs::write_file_atomic(path_for_hex(hex), compressed);
+    (void)remember(hex);
+  }
+  return hex;
+}
+
+std::string ObjectStore::write_stream(std::string_view type, std::uint64_t size,
+                                      const Reader &read) const {
+  return format_ == ObjectFormat::sha256 ? write_stream_as<ObjectFormat::sha256>(type, size, read)
+                                         : write_stream_as<ObjectFormat::sha1>(type, size, read);
+}
+
+template <ObjectFormat F>
+std::string ObjectStore::write_stream_as(std::string_view type, std::uint64_t size,
+                                         const Reader &read) const {
+  constexpr std::size_t kChunk = 256 * 1024;
+  const std::string hdr = object_header(type, size);
+  const std::span<const std::uint8_t> hdr_bytes(reinterpret_cast<const std::uint8_t *>(hdr.data()),
+                                                hdr.size());
+  BasicHasher<F> hasher;
+  hasher.update(hdr_bytes);
+  // The id is known only at the end, so deflate into a temporary beside the
+  // fan-out directories and rename it once named.
+  gfs::ZFileWriter out(gitdir_ / consts::kObjectsDir, loose_compression(size));
+  out.write(hdr_bytes);
+
+  std::vector<std::uint8_t> buf(kChunk);
+  std::uint64_t total = 0;
+  while (const std::size_t n = read(buf)) {
+    total += n;
+    if (total > size) {
+      throw std::runtime_error("object_store: stream longer than its declared size");
+    }
+    const std::span<const std::uint8_t> chunk(buf.data(), n);
+    hasher.update(chunk);
+    out.write(chunk);
+  }
+  if (total != size) {
+    throw std::runtime_error("object_store: stream ended after " + std::to_string(total) + " of " +
+                             std::to_string(size) + " bytes");
+  }
+  std::string hex = to_hex(hasher.finish());
+  if (!stored(hex)) {
+    out.commit(path_for_hex(hex));
+    (void)remember(hex);
+  }
+  return hex;
+}
+
+void ObjectStore::write_hashed(const oid &id, std::string_view type,
+                               std::span<const std::uint8_t> payload) const {
+  if (format_ != ObjectFormat::sha1) {
+    throw std::runtime_error("object_store: write_hashed takes SHA-1 ids");
+  }
+  if (const auto hex = to_hex(id); !stored(hex)) {
+    const std::string hdr = object_header(type, payload.size());
+    const std::span<const std::uint8_t> hdr_bytes(
+        reinterpret_cast<const std::uint8_t *>(hdr.data()), hdr.size());
+    gfs::write_file_atomic(path_for_hex(hex),
+                           gfs::z_compress(hdr_bytes, payload, loose_compression(payload.size())));
+    (void)remember(hex);
+  }
+}
 
-  oid store_id = sha1(store);
-  auto path = path_for_oid(store_id);
-  if (!std::filesystem::exists(path)) {
-    auto compressed = gfs::z_compress(store);
-    gfs::write_file_atomic(path, compressed);
+void ObjectStore::check_collision(const oid &id, std::span<const std::uint8_t> compressed) const {
+  const auto stored = gfs::read_file(locate(id));
+  if (std::ranges::equal(stored, compressed)) {
+    return;
   }
-  return to_hex(store_id);
+  // Zlib output may differ for equal content, so compare what they inflate to,
+  // by a second hash that the two sides cannot both have been built to match.
+  if (hash_loose<ObjectFormat::sha256>(stored, dictionaries()) !=
+      hash_loose<ObjectFormat::sha256>(compressed)) {
+    throw std::runtime_error("object_store: SHA-1 collision on " + to_hex(id) +
+                             ": different content under the same id");
+  }
+}
+
+void ObjectStore::check_collision(const oid &id, const std::filesystem::path &file) const {
+  if (hash_loose_file<ObjectFormat::sha256>(locate(id), dictionaries()) !=
+      hash_loose_file<ObjectFormat::sha256>(file)) {
+    throw std::runtime_error("object_store: SHA-1 collision on " + to_hex(id) +
+                             ": different content under the same id");
+  }
+}
+
+ObjectStream ObjectStore::open_stream(std::string_view hex_oid) const {
+  if (!looks_hex_oid(hex_oid, format_)) {
+    throw std::runtime_error("object_store: bad oid hex");
+  }
+  return ObjectStream(locate_hex(hex_oid), dictionaries());
 }
 
+ObjectStream::ObjectStream(const std::filesystem::path &file, gfs::ZstdDictFn dict)
+    : z_(file, std::move(dict)) {
+  // "<type> <size>\0" fits in 64 bytes; whatever follows it is payload.
+  std::uint8_t head[64];
+  std::size_t have = 0;
+  const std::uint8_t *nul = nullptr;
+  while (nul == nullptr && have < sizeof(head)) {
+    const std::size_t n = z_.read(std::span(head + have, sizeof(head) - have));
+    if (n == 0) {
+      break;
+    }
+    nul = std::find(head + have, head + have + n, std::uint8_t{'\0'});
+    nul = nul == head + have + n ? nullptr : nul;
+    have += n;
+  }
+  const std::uint8_t *space = std::find(head, head + have, std::uint8_t{' '});
+  if (nul == nullptr || space > nul) {
+    throw std::runtime_error("object_store: invalid header");
+  }
+  type_.assign(reinterpret_cast<const char *>(head), reinterpret_cast<const char *>(space));
+  const auto *first = reinterpret_cast<const char *>(space + 1);
+  const auto *last = reinterpret_cast<const char *>(nul);
+  if (auto [ptr, ec] = std::from_chars(first, last, size_); ec != std::errc{} || ptr != last) {
+    throw std::runtime_error("object_store: invalid header size");
+  }
+  pending_.assign(nul + 1, static_cast<const std::uint8_t *>(head + have));
+  left_ = size_;
+}
+
+std::size_t ObjectStream::read(std::span<std::uint8_t> buf) {
+  std::size_t n = 0;
+  if (!pending_.empty()) {
+    n = std::min(buf.size(), pending_.size());
+    std::copy_n(pending_.begin(), n, buf.begin());
+    pending_.erase(pending_.begin(), pending_.begin() + static_cast<std::ptrdiff_t>(n));
+  } else {
+    n = z_.read(buf);
+  }
+  if (n > left_ || (n == 0 && !buf.empty() && left_ != 0)) {
+    throw std::runtime_error("object_store: size mismatch");
+  }
+  left_ -= n;
+  return n;
+}
+
+void ObjectStore::sync() const { gfs::sync_filesystem(gitdir_ / consts::kObjectsDir); }
+
+ObjectStore::Header ObjectStore::read_header(std::string_view hex_oid) const {
+  if (!looks_hex_oid(hex_oid, format_)) {
+    throw std::runtime_error("object_store: bad oid hex");
+  }
+  // "<type> <size>\0" fits comfortably in 64 bytes; 512 compressed zlib bytes
+  // always cover it. zstd decodes whole blocks only, so stream those instead.
+  const auto prefix = gfs::read_file_prefix(locate_hex(hex_oid), 512);
+  if (gfs::is_zstd(prefix)) {
+    const auto stream = open_stream(hex_oid);
+    return Header{.type = stream.type(), .size = static_cast<std::size_t>(stream.size())};
+  }
+  const auto head = gfs::z_decompress_prefix(prefix, 64);
+  auto it_space = std::ranges::find(head, static_cast<std::uint8_t>(' '));
+  auto it_nul = std::find(it_space, head.end(), static_cast<std::uint8_t>('\0'));
+  if (it_space == head.end() || it_nul == head.end()) {
+    throw std::runtime_error("object_store: invalid header");
+  }
+  Header out;
+  out.type.assign(head.begin(), it_space);
+  const auto *first = reinterpret_cast<const char *>(head.data()) + (it_space - head.begin()) + 1;
+  const auto *last = reinterpret_cast<const char *>(head.data()) + (it_nul - head.begin());
+  if (auto [ptr, ec] = std::from_chars(first, last, out.size); ec != std::errc{} || ptr != last) {
+    throw std::runtime_error("object_store: invalid header size");
+  }
+  return out;
+}
+
+bool ObjectStore::exists(std::string_view hex_oid) const {
+  if (!looks_hex_oid(hex_oid, format_)) {
+    return false;
+  }
+  return stored(hex_oid);
+}
+
+bool ObjectStore::stored(std::string_view hex) const {
+  if (indexes_.empty()) {
+    return gfs::exists(locate_hex(hex));
+  }
+  std::uint8_t raw[32];
+  if (!hex_decode(hex, raw)) {
+    return false;
+  }
+  const std::span<const std::uint8_t> id(raw, hex.size() / 2);
+  return std::ranges::any_of(indexes_, [id](const auto &index) { return index->contains(id); });
+}
+
+void ObjectStore::load_index() const {
+  if (!indexes_.empty()) {
+    return;
+  }
+  const auto objects = gitdir_ / consts::kObjectsDir;
+  std::vector<std::shared_ptr<ObjectIndex>> out;
+  out.push_back(std::make_shared<ObjectIndex>(objects, format_));
+  for (const auto &dir : alternates()) {
+    // Cached here, keyed by its path: an alternate may be read-only or shared,
+    // and is not this store's to write to
+    out.push_back(std::make_shared<ObjectIndex>(
+        dir, format_, objects / consts::kAlternateIndexDir / to_hex(sha1(dir.string()))));
+  }
+  indexes_ = std::move(out);
+}
+
+bool ObjectStore::record(std::string_view hex_oid) const {
+  if (!looks_hex_oid(hex_oid, format_)) {
+    throw std::runtime_error("object_store: bad oid hex");
+  }
+  return indexes_.empty() ? !gfs::exists(locate_hex(hex_oid)) : remember(hex_oid);
+}
+
+bool ObjectStore::remember(std::string_view hex) const {
+  if (indexes_.empty()) {
+    return true;
+  }
+  std::uint8_t raw[32];
+  if (!hex_decode(hex, raw)) {
+    return false;
+  }
+  const std::span<const std::uint8_t> id(raw, hex.size() / 2);
+  // Alternates are only read from, so what they hold is never new here
+  if (std::any_of(indexes_.begin() + 1, indexes_.end(),
+                  [id](const auto &index) { return index->contains(id); })) {
+    return false;
+  }
+  return indexes_.front()->add(id);
+}
+
+namespace {
+
+// Hashes an inflated loose-object image fed to it piecewise, validating its
+// "<type> <size>\0" header on the way. Only the header is buffered; the
+// payload goes straight into the hash. SHA-1 images come from elsewhere, so
+// they are hashed with collision detection.
+template <ObjectFormat F> class LooseHasher {
+public:
+  void update(std::span<const std::uint8_t> chunk) {
+    hasher_.update(chunk);
+    if (have_header_) {
+      payload_ += chunk.size();
+      return;
+    }
+    const auto nul = std::ranges::find(chunk, static_cast<std::uint8_t>('\0'));
+    header_.append(chunk.begin(), nul);
+    if (nul == chunk.end()) {
+      if (header_.size() > 64) {
+        throw std::runtime_error("object_store: invalid header");
+      }
+      return;
+    }
+    have_header_ = true;
+    payload_ = static_cast<std::size_t>(chunk.end() - nul) - 1;
+
+    const auto sp = header_.find(' ');
+    if (sp == std::string::npos) {
+      throw std::runtime_error("object_store: invalid header");
+    }
+    const std::string_view type(header_.data(), sp);
+    if (type != consts::kTypeBlob && type != consts::kTypeTree && type != consts::kTypeCommit) {
+      throw std::runtime_error("object_store: unknown object type");
+    }
+    const char *first = header_.data() + sp + 1;
+    const char *last = header_.data() + header_.size();
+    if (auto [ptr, ec] = std::from_chars(first, last, declared_); ec != std::errc{} || ptr != last) {
+      throw std::runtime_error("object_store: invalid header size");
+    }
+  }
+
+  basic_oid<F> finish() {
+    if (!have_header_) {
+      throw std::runtime_error("object_store: invalid header");
+    }
+    if (declared_ != payload_) {
+      throw std::runtime_error("object_store: size mismatch");
+    }
+    return hasher_.finish();
+  }
+
+private:
+  std::conditional_t<F == ObjectFormat::sha1, Sha1dcHasher, BasicHasher<F>> hasher_;
+  std::string header_; // "<type> <size>\0" once complete
+  bool have_header_ = false;
+  std::size_t declared_ = 0;
+  std::size_t payload_ = 0;
+};
+
+} // namespace
+
+template <ObjectFormat F>
+basic_oid<F> ObjectStore::hash_loose(std::span<const std::uint8_t> compressed,
+                                      const gfs::ZstdDictFn &dict) {
+  // Inflated piecewise, so large objects are never held decompressed.
+  LooseHasher<F> hasher;
+  gfs::z_inflate_each(compressed, [&](std::span<const std::uint8_t> chunk) { hasher.update(chunk); },
+                      dict);
+  return hasher.finish();
+}
+
+template <ObjectFormat F>
+basic_oid<F> ObjectStore::hash_loose_file(const std::filesystem::path &file,
+                                           const gfs::ZstdDictFn &dict) {
+  LooseHasher<F> hasher;
+  gfs::ZFileReader z(file, dict);
+  std::vector<std::uint8_t> buf(64 * 1024);
+  while (const std::size_t n = z.read(buf)) {
+    hasher.update(std::span(buf.data(), n));
+  }
+  return hasher.finish();
+}
+
+template oid ObjectStore::hash_loose<ObjectFormat::sha1>(std::span<const std::uint8_t>,
+                                                         const gfs::ZstdDictFn &);
+template oid256 ObjectStore::hash_loose<ObjectFormat::sha256>(std::span<const std::uint8_t>,
+                                                              const gfs::ZstdDictFn &);
+template oid ObjectStore::hash_loose_file<ObjectFormat::sha1>(const std::filesystem::path &,
+                                                              const gfs::ZstdDictFn &);
+template oid256 ObjectStore::hash_loose_file<ObjectFormat::sha256>(const std::filesystem::path &,
+                                                                   const gfs::ZstdDictFn &);
+
 } // namespace gitfly
@@ -0,0 +1,193 @@
+#include "gitfly/object_writer.hpp"
+
+#include "gitfly/fs.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+namespace gfs = gitfly::fs;
+
+namespace gitfly {
+
+namespace {
+
+// Producers block once this much payload is waiting, so a fast producer (the
+// network, a directory walk) cannot outrun the disk by more than this.
+constexpr std::size_t kMaxQueuedBytes = std::size_t{64} << 20U;
+constexpr unsigned kMaxThreads = 4;
+
+struct Job {
+  std::filesystem::path path;
+  std::string header; // empty when `data` is already a compressed image
+  std::vector<std::uint8_t> data;
+  gfs::Compression compression;
+};
+
+} // namespace
+
+struct ObjectWriter::Impl {
+  explicit Impl(ObjectStore s) : store(std::move(s)) {}
+
+  ObjectStore store;
+  std::vector<std::thread> workers;
+  std::mutex mu;
+  std::condition_variable has_work; // a job was queued, or stopping
+  std::condition_variable has_room; // a job was taken or finished
+  std::deque<Job> queue;
+  std::size_t queued_bytes = 0;
+  std::size_t busy = 0;       // jobs taken but not finished
+  bool stopping = false;
+  bool dirty = false;         // written since the last sync
+  std::exception_ptr error;   // first failure, reported by flush()
+
+  void run() {
+    for (;;) {
+      Job job;
+      {
+        std::unique_lock lk(mu);
+        has_work.wait(lk, [this] { return stopping || !queue.empty(); });
+        if (queue.empty()) {
+          return;
+        }
+        job = std::move(queue.front());
+        queue.pop_front();
+        queued_bytes -= job.data.size();
+        ++busy;
+      }
+      has_room.notify_all();
+      std::exception_ptr failed;
+      try {
+        if (job.header.empty()) {
+          gfs::write_file_atomic(job.path, job.data);
+        } else {
+          const std::span<const std::uint8_t> hdr(
+              reinterpret_cast<const std::uint8_t *>(job.header.data()), job.header.size());
+          gfs::write_file_atomic(job.path, gfs::z_compress(hdr, job.data, job.compression));
+        }
+      } catch (...) {
+        failed = std::current_exception();
+      }
+      {
+        const std::lock_guard lk(mu);
+        --busy;
+        dirty = true;
+        if (failed && !error) {
+          error = failed;
+        }
+      }
+      has_room.notify_all();
+    }
+  }
+
+  void push(Job job) {
+    {
+      std::unique_lock lk(mu);
+      // A payload larger than the whole budget still goes in once the queue is empty.
+      has_room.wait(lk, [&] {
+        return error || queue.empty() || queued_bytes + job.data.size() <= kMaxQueuedBytes;
+      });
+      if (error) {
+        std::rethrow_exception(error);
+      }
+      queued_bytes += job.data.size();
+      queue.push_back(std::move(job));
+    }
+    has_work.notify_one();
+  }
+
+  void drain() {
+    std::unique_lock lk(mu);
+    has_room.wait(lk, [this] { return queue.empty() && busy == 0; });
+  }
+};
+
+ObjectWriter::ObjectWriter(ObjectStore store, unsigned threads)
+    : impl_(std::make_unique<Impl>(std::move(store))) {
+  // Load the alternates list and compression settings now: the store fills
+  // them in lazily, which is not safe to do from several producer threads.
+  // The object index is the caller's choice (see the header).
+  (void)impl_->store.alternates();
+  (void)impl_->store.loose_compression(0);
+  if (threads == 0) {
+    threads = std::clamp(std::thread::hardware_concurrency(), 1U, kMaxThreads);
+  }
+  for (unsigned i = 0; i < threads; ++i) {
+    impl_->workers.emplace_back([this] { impl_->run(); });
+  }
+}
+
+ObjectWriter::~ObjectWriter() {
+  {
+    const std::lock_guard lk(impl_->mu);
+    impl_->stopping = true;
+  }
+  impl_->has_work.notify_all();
+  for (auto &t : impl_->workers) {
+    t.join();
+  }
+}
+
+std::string ObjectWriter::write(std::string_view type, std::vector<std::uint8_t> payload) {
+  // Hashed here rather than on the pool: the caller needs the id now, and
+  // hashing is cheap next to compressing.
+  auto queue = [&](const auto &id) {
+    std::string hex = to_hex(id);
+    if (impl_->store.record(hex)) {
+      auto compression = impl_->store.loose_compression(payload.size());
+      impl_->push(Job{.path = impl_->store.path_for_oid(id),
+                      .header = object_header(type, payload.size()),
+                      .data = std::move(payload), .compression = compression});
+    }
+    return hex;
+  };
+  return impl_->store.format() == ObjectFormat::sha256
+             ? queue(hash_object<ObjectFormat::sha256>(type, payload))
+             : queue(hash_object<ObjectFormat::sha1>(type, payload));
+}
+
+void ObjectWriter::write_hashed(const oid &id, std::string_view type,
+                                std::vector<std::uint8_t> payload) {
+  if (impl_->store.format() != ObjectFormat::sha1) {
+    throw std::runtime_error("object_writer: write_hashed takes SHA-1 ids");
+  }
+  if (impl_->store.record(to_hex(id))) {
+    auto compression = impl_->store.loose_compression(payload.size());
+    impl_->push(Job{.path = impl_->store.path_for_oid(id),
+                    .header = object_header(type, payload.size()),
+                    .data = std::move(payload), .compression = compression});
+  }
+}
+
+void ObjectWriter::write_loose(const oid &id, std::vector<std::uint8_t> compressed) {
+  if (impl_->store.format() != ObjectFormat::sha1) {
+    throw std::runtime_error("object_writer: write_loose takes SHA-1 ids");
+  }
+  if (impl_->store.record(to_hex(id))) {
+    impl_->push(Job{.path = impl_->store.path_for_oid(id), .header = {},
+                    .data = std::move(compressed), .compression = {}});
+  }
+}
+
+void ObjectWriter::flush() {
+  impl_->drain();
+  bool dirty = false;
+  {
+    const std::lock_guard lk(impl_->mu);
+    if (impl_->error) {
+      std::rethrow_exception(impl_->error);
+    }
+    dirty = std::exchange(impl_->dirty, false);
+  }
+  if (dirty) {
+    impl_->store.sync();
+  }
+}
+
+} // namespace gitfly
@@ -0,0 +1,215 @@
+#include "gitfly/pack_cache.hpp"
+
+#include "gitfly/consts.hpp"
+#include "gitfly/fs.hpp"
+#include "gitfly/hash.hpp"
+#include "gitfly/object_store.hpp"
+
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+namespace gfs = gitfly::fs;
+namespace stdfs = std::filesystem;
+
+namespace gitfly {
+
+ClonePackCache::ClonePackCache(stdfs::path gitdir) : gitdir_(std::move(gitdir)) {}
+
+stdfs::path ClonePackCache::dir() const {
+  return gitdir_ / consts::kObjectsDir / consts::kPackDir;
+}
+
+stdfs::path ClonePackCache::manifest() const { return dir() / consts::kClonePackManifest; }
+
+void ClonePackCache::load() {
+  tip_.clear();
+  packs_.clear();
+  std::ifstream in(manifest());
+  std::string line;
+  if (!std::getline(in, line) || !line.starts_with("tip ")) {
+    return;
+  }
+  tip_ = line.substr(4);
+  while (std::getline(in, line)) {
+    std::istringstream is(line);
+    std::string kw;
+    Pack p;
+    if (!(is >> kw >> p.name >> p.objects >> p.bytes) || kw != "pack") {
+      throw std::runtime_error("corrupt clone pack manifest: " + manifest().string());
+    }
+    packs_.push_back(std::move(p));
+  }
+  // A pack removed behind our back invalidates the whole cache.
+  for (const auto &p : packs_) {
+    std::error_code ec;
+    if (stdfs::file_size(dir() / (p.name + ".pack"), ec) != p.bytes || ec) {
+      tip_.clear();
+      packs_.clear();
+      return;
+    }
+  }
+}
+
+void ClonePackCache::save() const {
+  std::string s = "tip " + tip_ + "\n";
+  for (const auto &p : packs_) {
+    s += "pack " + p.name + " " + std::to_string(p.objects) + " " + std::to_string(p.bytes) + "\n";
+  }
+  gfs::write_file_atomic(
+      manifest(),
+      std::span<const std::uint8_t>(reinterpret_cast<const std::uint8_t *>(s.data()), s.size()));
+}
+
+std::vector<std::pair<std::string, std::uint64_t>>
+ClonePackCache::read_index(const Pack &pack) const {
+  std::vector<std::pair<std::string, std::uint64_t>> out;
+  out.reserve(pack.objects);
+  std::ifstream in(dir() / (pack.name + ".idx"));
+  std::string hex;
+  std::uint64_t off = 0;
+  while (in >> hex >> off) {
+    out.emplace_back(std::move(hex), off);
+  }
+  if (out.size() != pack.objects) {
+    throw std::runtime_error("clone pack index does not match its pack: " + pack.name);
+  }
+  return out;
+}
+
+ClonePackCache::Pack ClonePackCache::write_pack(const ObjectStore &store,
+                                                const std::vector<std::string> &hexes) {
+  stdfs::create_directories(dir());
+  std::size_t seq = 0;
+  while (gfs::exists(dir() / ("clone-" + std::to_string(seq) + ".pack"))) {
+    ++seq;
+  }
+  Pack pack{.name = "clone-" + std::to_string(seq), .objects = hexes.size(), .bytes = 0};
+  const auto pack_path = dir() / (pack.name + ".pack");
+  const auto idx_path = dir() / (pack.name + ".idx");
+  auto pack_tmp = pack_path;
+  pack_tmp += ".tmp";
+  auto idx_tmp = idx_path;
+  idx_tmp += ".tmp";
+  {
+    std::ofstream pout(pack_tmp, std::ios::binary | std::ios::trunc);
+    std::ofstream iout(idx_tmp, std::ios::trunc);
+    if (!pout || !iout) {
+      throw std::runtime_error("cannot create clone pack in " + dir().string());
+    }
+    // Packs are read again on every clone, so they may be worth a higher level
+    // than loose objects get when written.
+    const auto level = store.pack_compression();
+    const bool recompress = level && *level != store.loose_compression(0).level;
+    for (const auto &hex : hexes) {
+      oid id{};
+      if (!from_hex(hex, id)) {
+        throw std::runtime_error("bad object id " + hex);
+      }
+      auto data = gfs::read_file(store.locate(id));
+      if (recompress) {
+        data = gfs::z_compress(gfs::z_decompress(data), {.codec = gfs::Codec::zlib, .level = *level, .dict = {}});
+      }
+      const std::string header =
+          std::string(consts::kTokObj) + hex + " " + std::to_string(data.size()) + "\n";
+      iout << hex << ' ' << pack.bytes << '\n';
+      pout.write(header.data(), static_cast<std::streamsize>(header.size()));
+      pout.write(reinterpret_cast<const char *>(data.data()),
+                 static_cast<std::streamsize>(data.size()));
+      pack.bytes += header.size() + data.size();
+    }
+    pout.flush();
+    iout.flush();
+    if (!pout || !iout) {
+      throw std::runtime_error("writing clone pack failed: " + pack_path.string());
+    }
+  }
+  stdfs::rename(idx_tmp, idx_path);
+  stdfs::rename(pack_tmp, pack_path);
+  return pack;
+}
+
+ClonePackCache::Stream ClonePackCache::prepare(const std::string &tip, const ObjectStore &store,
+                                               std::size_t skip, std::string_view skip_last) {
+  load();
+  if (tip_ != tip) {
+    const auto all = store.list();
+    std::set<std::string> cached;
+    std::size_t layered = 0; // objects in incremental packs
+    for (std::size_t i = 0; i < packs_.size(); ++i) {
+      for (auto &entry : read_index(packs_[i])) {
+        cached.insert(std::move(entry.first));
+      }
+      if (i > 0) {
+        layered += packs_[i].objects;
+      }
+    }
+    std::vector<std::string> fresh;
+    for (const auto &hex : all) {
+      if (!cached.contains(hex)) {
+        fresh.push_back(hex);
+      }
+    }
+    if (packs_.empty() || packs_.size() >= kMaxPacks ||
+        layered + fresh.size() > packs_.front().objects) {
+      const auto stale = packs_;
+      packs_.clear();
+      packs_.push_back(write_pack(store, all));
+      tip_ = tip;
+      save();
+      for (const auto &p : stale) {
+        std::error_code ec;
+        stdfs::remove(dir() / (p.name + ".pack"), ec);
+        stdfs::remove(dir() / (p.name + ".idx"), ec);
+      }
+    } else {
+      if (!fresh.empty()) {
+        packs_.push_back(write_pack(store, fresh));
+      }
+      tip_ = tip;
+      save();
+    }
+  }
+
+  Stream out;
+  std::size_t total = 0;
+  for (const auto &p : packs_) {
+    total += p.objects;
+  }
+
+  // Resume: record skip-1 must be the client's last one, else start over.
+  std::size_t start = 0;
+  if (skip > 0 && skip <= total) {
+    std::size_t base = 0;
+    for (const auto &p : packs_) {
+      if (skip - 1 < base + p.objects) {
+        if (read_index(p)[skip - 1 - base].first == skip_last) {
+          start = skip;
+        }
+        break;
+      }
+      base += p.objects;
+    }
+  }
+
+  std::size_t base = 0;
+  for (const auto &p : packs_) {
+    const auto file = dir() / (p.name + ".pack");
+    if (start >= base + p.objects) {
+      base += p.objects;
+      continue;
+    }
+    std::uint64_t offset = 0;
+    if (start > base) {
+      offset = read_index(p)[start - base].second;
+    }
+    out.segments.push_back(Segment{.file = file, .offset = offset, .length = p.bytes - offset});
+    base += p.objects;
+  }
+  out.objects = total - start;
+  out.skipped = start;
+  return out;
+}
+
+} // namespace gitfly
@@ -0,0 +1,204 @@
+#include "gitfly/reach.hpp"
+
+#include "gitfly/bitmap.hpp"
+#include "gitfly/config.hpp"
+#include "gitfly/consts.hpp"
+#include "gitfly/object_store.hpp"
+#include "gitfly/repo.hpp"
+
+#include <charconv>
+#include <deque>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+
+namespace gitfly::reach {
+
+namespace {
+
+void require(const ObjectStore &store, const std::string &hex) {
+  if (!store.exists(hex)) {
+    throw std::runtime_error("missing object " + hex);
+  }
+}
+
+// Decides, per blob, whether it belongs in the output.
+using BlobPredicate = std::function<bool(const std::string &)>;
+
+void walk_tree(const Repository &repo, const ObjectStore &store, const std::string &tree_hex,
+               std::set<std::string> &seen, std::vector<std::string> &out,
+               const BlobPredicate &want_blob) {
+  if (!seen.insert(tree_hex).second) {
+    return;
+  }
+  require(store, tree_hex);
+  out.push_back(tree_hex);
+  for (const auto &e : repo.read_tree(tree_hex)) {
+    const std::string hex = to_hex(e.id);
+    if (e.mode == consts::kModeTree) {
+      walk_tree(repo, store, hex, seen, out, want_blob);
+    } else if (seen.insert(hex).second && want_blob(hex)) {
+      out.push_back(hex);
+    }
+  }
+}
+
+// Blobs must be present, unless this is a partial clone whose promisor has them.
+auto present_blob_predicate(const Repository &repo, const ObjectStore &store) -> BlobPredicate {
+  const bool partial = config_get(repo.root(), consts::kCfgPromisor).has_value();
+  return [&store, partial](const std::string &hex) {
+    if (store.exists(hex)) {
+      return true;
+    }
+    if (partial) {
+      return false;
+    }
+    throw std::runtime_error("missing object " + hex);
+  };
+}
+
+} // namespace
+
+auto BlobFilter::parse(std::string_view spec) -> BlobFilter {
+  if (spec.empty()) {
+    return {};
+  }
+  if (spec == "blob:none") {
+    return BlobFilter{.limit = 0};
+  }
+  constexpr std::string_view kLimit = "blob:limit=";
+  if (!spec.starts_with(kLimit) || spec.size() == kLimit.size()) {
+    throw std::runtime_error("unsupported filter: " + std::string(spec));
+  }
+  std::string_view num = spec.substr(kLimit.size());
+  std::size_t scale = 1;
+  switch (num.back()) {
+  case 'k': scale = std::size_t{1} << 10U; break;
+  case 'm': scale = std::size_t{1} << 20U; break;
+  case 'g': scale = std::size_t{1} << 30U; break;
+  default: break;
+  }
+  if (scale != 1) {
+    num.remove_suffix(1);
+  }
+  std::size_t value = 0;
+  if (auto [ptr, ec] = std::from_chars(num.data(), num.data() + num.size(), value);
+      ec != std::errc{} || ptr != num.data() + num.size()) {
+    throw std::runtime_error("bad blob:limit value: " + std::string(spec));
+  }
+  return BlobFilter{.limit = value * scale};
+}
+
+auto collect_objects(const Repository &repo, const std::vector<std::string> &tips,
+                     const std::set<std::string> &stop) -> std::vector<std::string> {
+  const ObjectStore store{repo.git_dir()};
+  const auto shallow = repo.shallow_commits();
+  const auto want_blob = present_blob_predicate(repo, store);
+  std::vector<std::string> out;
+  std::set<std::string> seen;
+  std::vector<std::string> stack(tips.rbegin(), tips.rend());
+  while (!stack.empty()) {
+    const auto cur = stack.back();
+    stack.pop_back();
+    if (stop.contains(cur) || !seen.insert(cur).second) {
+      continue;
+    }
+    require(store, cur);
+    out.push_back(cur);
+    const auto info = repo.read_commit(cur);
+    walk_tree(repo, store, info.tree_hex, seen, out, want_blob);
+    if (shallow.contains(cur)) {
+      continue;
+    }
+    for (auto it = info.parents.rbegin(); it != info.parents.rend(); ++it) {
+      stack.push_back(*it);
+    }
+  }
+  return out;
+}
+
+auto plan_transfer(const Repository &repo, const std::vector<std::string> &tips,
+                   const TransferOptions &opts) -> TransferPlan {
+  // A shallow receiver lacks history below its boundary even under its haves,
+  // so only a complete one can be answered by stopping at them.
+  const bool complete_receiver = opts.shallow.empty();
+  if (opts.depth == 0 && !opts.filter.active() && complete_receiver && opts.bitmaps != nullptr) {
+    return TransferPlan{
+        .objects = opts.bitmaps->missing(repo, tips, {opts.have.begin(), opts.have.end()}),
+        .shallow = {}};
+  }
+  if (opts.depth == 0 && !opts.filter.active() && complete_receiver) {
+    TransferPlan plan{.objects = collect_objects(repo, tips, opts.have), .shallow = {}};
+    // A shallow repository passes its own boundary on to the receiver.
+    if (const auto repo_shallow = repo.shallow_commits(); !repo_shallow.empty()) {
+      for (const auto &hex : plan.objects) {
+        if (repo_shallow.contains(hex)) {
+          plan.shallow.push_back(hex);
+        }
+      }
+    }
+    return plan;
+  }
+  const ObjectStore store{repo.git_dir()};
+  const auto repo_shallow = repo.shallow_commits();
+  const auto present = present_blob_predicate(repo, store);
+  const BlobPredicate want_blob = [&](const std::string &hex) {
+    if (!present(hex)) {
+      return false;
+    }
+    if (!opts.filter.active()) {
+      return true;
+    }
+    return *opts.filter.limit != 0 && store.read_header(hex).size < *opts.filter.limit;
+  };
+
+  // Queued commits carry whether the receiver already has them: haves, its
+  // shallow commits and the parents of what it has, down to its boundary.
+  struct Queued {
+    std::string hex;
+    std::size_t gen;
+    bool held;
+  };
+  TransferPlan out;
+  std::set<std::string> seen;
+  std::deque<Queued> queue;
+  for (const auto &t : tips) {
+    queue.push_back({.hex = t, .gen = 1, .held = false});
+  }
+  while (!queue.empty()) {
+    auto [cur, gen, held] = queue.front();
+    queue.pop_front();
+    held = held || opts.have.contains(cur) || opts.shallow.contains(cur);
+    if ((held && complete_receiver) || !seen.insert(cur).second) {
+      continue;
+    }
+    require(store, cur);
+    const auto info = repo.read_commit(cur);
+    if (!held) {
+      out.objects.push_back(cur);
+      walk_tree(repo, store, info.tree_hex, seen, out.objects, want_blob);
+    }
+    if (info.parents.empty()) {
+      continue;
+    }
+    if ((opts.depth != 0 && gen >= opts.depth) || repo_shallow.contains(cur)) {
+      // The receiver keeps its own boundary where it reaches this far
+      if (!held) {
+        out.shallow.push_back(cur);
+      }
+      continue;
+    }
+    const bool parents_held = held && !opts.shallow.contains(cur);
+    for (const auto &p : info.parents) {
+      queue.push_back({.hex = p, .gen = gen + 1, .held = parents_held});
+    }
+  }
+  return out;
+}
+
+void check_connected(const Repository &repo, const std::string &tip,
+                     const std::set<std::string> &stop) {
+  (void)collect_objects(repo, {tip}, stop);
+}
+
+} // namespace gitfly::reach
@@ -2,10 +2,18 @@
 
 #include "gitfly/consts.hpp"
 #include "gitfly/fs.hpp"
+#include "gitfly/util.hpp"
 
+#include <algorithm>
 #include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <stdexcept>
 #include <string>
 #include <string_view>
+#include <unistd.h>
 
 namespace gitfly {
 
@@ -58,12 +66,114 @@ std::optional<std::string> read_ref(const std::filesystem::path &repo_root,
   return s;
 }
 
+namespace {
+
+// "<ref>.lock", created exclusively so concurrent writers of the same ref
+// exclude each other. Holds the new value until commit(); removed if abandoned.
+class RefLock {
+public:
+  RefLock(const std::filesystem::path &root, std::string name)
+      : name_(std::move(name)), ref_(ref_path(root, name_)), lock_(ref_) {
+    lock_ += gitfly::consts::kLockSuffix;
+    fs::ensure_parent_dir(lock_);
+    fd_ = ::open(lock_.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+      if (errno == EEXIST)
+        throw std::runtime_error("ref " + name_ + " is locked by another update");
+      throw std::runtime_error("cannot lock " + lock_.string() + ": " + std::strerror(errno));
+    }
+  }
+  ~RefLock() {
+    if (fd_ >= 0)
+      ::close(fd_);
+    if (!committed_)
+      ::unlink(lock_.c_str());
+  }
+  RefLock(const RefLock &) = delete;
+  RefLock &operator=(const RefLock &) = delete;
+
+  [[nodiscard]] const std::string &name() const { return name_; }
+
+  void write(const std::string &hex_oid) {
+    const std::string s = hex_oid + "\n";
+    for (std::size_t off = 0; off < s.size();) {
+      const auto w = ::write(fd_, s.data() + off, s.size() - off);
+      if (w < 0 && errno == EINTR)
+        continue;
+      if (w < 0)
+        throw std::runtime_error("write " + lock_.string() + ": " + std::strerror(errno));
+      off += static_cast<std::size_t>(w);
+    }
+    if (::fsync(fd_) != 0)
+      throw std::runtime_error("fsync " + lock_.string() + ": " + std::strerror(errno));
+  }
+
+  // Move the new value into place, or delete the ref if nothing was written.
+  void commit(bool remove) {
+    ::close(fd_);
+    fd_ = -1;
+    if (remove) {
+      ::unlink(ref_.c_str());
+      return; // the destructor drops the lock
+    }
+    if (::rename(lock_.c_str(), ref_.c_str()) != 0)
+      throw std::runtime_error("cannot update ref " + name_ + ": " + std::strerror(errno));
+    committed_ = true;
+  }
+
+private:
+  std::string name_;
+  std::filesystem::path ref_;
+  std::filesystem::path lock_;
+  int fd_ = -1;
+  bool committed_ = false;
+};
+
+} // namespace
+
+bool is_valid_ref_name(std::string_view name) {
+  return name.starts_with("refs/") && name.find("..") == std::string_view::npos &&
+         !name.ends_with(gitfly::consts::kLockSuffix) && !name.ends_with("/");
+}
+
+void update_refs(const std::filesystem::path &repo_root, const std::vector<RefUpdate> &updates) {
+  std::vector<const RefUpdate *> order;
+  for (const auto &u : updates) {
+    if (!is_valid_ref_name(u.name))
+      throw std::runtime_error("invalid ref name: " + u.name);
+    order.push_back(&u);
+  }
+  // A fixed lock order keeps two transactions over the same refs from deadlocking.
+  std::ranges::sort(order, {}, &RefUpdate::name);
+  for (std::size_t i = 1; i < order.size(); ++i) {
+    if (order[i]->name == order[i - 1]->name)
+      throw std::runtime_error("ref " + order[i]->name + " updated twice");
+  }
+
+  std::vector<std::unique_ptr<RefLock>> locks;
+  for (const auto *u : order)
+    locks.push_back(std::make_unique<RefLock>(repo_root, u->name));
+  for (const auto *u : order) {
+    if (!u->old_oid)
+      continue;
+    const auto cur = read_ref(repo_root, u->name);
+    if (u->old_oid->empty() ? cur.has_value() : cur != *u->old_oid) {
+      throw std::runtime_error("stale ref " + u->name + ": expected " +
+                               (u->old_oid->empty() ? "none" : *u->old_oid) + ", found " +
+                               cur.value_or("none"));
+    }
+  }
+  for (std::size_t i = 0; i < order.size(); ++i) {
+    if (!order[i]->new_oid.empty())
+      locks[i]->write(order[i]->new_oid);
+  }
+  for (std::size_t i = 0; i < order.size(); ++i)
+    locks[i]->commit(order[i]->new_oid.empty());
+}
+
 void update_ref(const std::filesystem::path &repo_root, const std::string &refname,
                 const std::string &hex_oid) {
-  const auto p = ref_path(repo_root, refname);
-  std::string s = hex_oid + "\n";
-  fs::write_file_atomic(
-      p, std::span<const std::uint8_t>(reinterpret_cast<const std::uint8_t *>(s.data()), s.size()));
+  update_refs(repo_root, {RefUpdate{.name = refname, .old_oid = std::nullopt, .new_oid = hex_oid}});
 }
 
 void set_HEAD_detached(const std::filesystem::path &repo_root, std::string_view hex_oid) {
@@ -73,4 +183,60 @@ void set_HEAD_detached(const std::filesystem::path &repo_root, std::string_view
       std::span<const std::uint8_t>(reinterpret_cast<const std::uint8_t *>(s.data()), s.size()));
 }
 
+std::vector<RefEntry> list_refs(const std::filesystem::path &repo_root, std::string_view prefix) {
+  std::vector<RefEntry> out;
+  const auto refs_root = git_dir(repo_root) / gitfly::consts::kRefsDir;
+  if (!fs::exists(refs_root)) {
+    return out;
+  }
+  for (auto it = std::filesystem::recursive_directory_iterator(refs_root);
+       it != std::filesystem::recursive_directory_iterator(); ++it) {
+    if (!it->is_regular_file()) {
+      continue;
+    }
+    std::string name = std::filesystem::relative(it->path(), git_dir(repo_root)).generic_string();
+    if (!name.starts_with(prefix) || name.ends_with(gitfly::consts::kLockSuffix)) {
+      continue;
+    }
+    auto oid = read_ref(repo_root, name);
+    if (!oid || !looks_hex40(*oid)) {
+      continue;
+    }
+    out.push_back(RefEntry{.name = std::move(name), .oid = std::move(*oid)});
+  }
+  std::ranges::sort(out, {}, &RefEntry::name);
+  return out;
+}
+
+std::optional<std::string> tracking_ref(std::string_view remote_ref, std::string_view remote) {
+  constexpr std::string_view heads = "refs/heads/";
+  constexpr std::string_view tags = "refs/tags/";
+  if (remote_ref.starts_with(heads)) {
+    return "refs/remotes/" + std::string(remote) + "/" +
+           std::string(remote_ref.substr(heads.size()));
+  }
+  if (remote_ref.starts_with(tags)) {
+    return std::string(remote_ref);
+  }
+  return std::nullopt;
+}
+
+std::size_t update_tracking_refs(const std::filesystem::path &repo_root, std::string_view remote,
+                                 const std::vector<RefEntry> &remote_refs) {
+  std::size_t written = 0;
+  for (const auto &ref : remote_refs) {
+    const auto local = tracking_ref(ref.name, remote);
+    if (!local) {
+      continue;
+    }
+    const auto cur = read_ref(repo_root, *local);
+    if (cur == ref.oid || (cur && local->starts_with("refs/tags/"))) {
+      continue;
+    }
+    update_ref(repo_root, *local, ref.oid);
+    ++written;
+  }
+  return written;
+}
+
 } // namespace gitfly
@@ -1,6 +1,10 @@
 #include "gitfly/remote.hpp"
 
+#include "gitfly/config.hpp"
 #include "gitfly/consts.hpp"
+#include "gitfly/fs.hpp"
+#include "gitfly/object_store.hpp"
+#include "gitfly/reach.hpp"
 #include "gitfly/refs.hpp"
 #include "gitfly/repo.hpp"
 #include "gitfly/util.hpp"
@@ -8,10 +12,12 @@
 
 #include <filesystem>
 #include <optional>
+#include <set>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
-namespace fs = std::filesystem;
+namespace stdfs = std::filesystem;
 
 namespace {
 
@@ -22,7 +28,7 @@ inline std::string rstrip_newlines(std::string s) {
 }
 
 // If HEAD is symbolic ("ref: <name>"), return that ref name; otherwise std::nullopt.
-inline std::optional<std::string> head_symbolic_ref(const fs::path &repo_root) {
+inline std::optional<std::string> head_symbolic_ref(const stdfs::path &repo_root) {
   const auto head_txt = gitfly::read_HEAD(repo_root);
   if (!head_txt) {
     return std::nullopt;
@@ -35,7 +41,7 @@ inline std::optional<std::string> head_symbolic_ref(const fs::path &repo_root) {
 }
 
 // Return the 40-hex HEAD commit if available (symbolic or detached); else empty string.
-inline std::string head_commit_hex(const fs::path &repo_root) {
+inline std::string head_commit_hex(const stdfs::path &repo_root) {
   const auto head_txt = gitfly::read_HEAD(repo_root);
   if (!head_txt) {
     return {};
@@ -54,36 +60,149 @@ inline std::string head_commit_hex(const fs::path &repo_root) {
 
 // Naive ancestor check moved to Repository::is_commit_ancestor
 
-// Copy all loose objects (files) missing in dst from src.
-// src_obj = <repo>/.gitfly/objects ; dst_obj likewise.
-inline void copy_missing_objects(const fs::path &src_obj, const fs::path &dst_obj) {
-  for (auto it = fs::recursive_directory_iterator(src_obj);
-       it != fs::recursive_directory_iterator(); ++it) {
-    if (!it->is_regular_file()) {
-      continue;
+// Ref tips of `repo_root` whose commits are already in `store`: the other side
+// of a transfer has everything reachable from them, so walks stop there.
+inline std::set<std::string> known_tips(const stdfs::path &repo_root, const gitfly::ObjectStore &store) {
+  std::set<std::string> out;
+  for (const auto &ref : gitfly::list_refs(repo_root)) {
+    if (store.exists(ref.oid)) {
+      out.insert(ref.oid);
     }
-    const fs::path rel = fs::relative(it->path(), src_obj);
-    const fs::path out = dst_obj / rel;
-    fs::create_directories(out.parent_path());
-    if (!fs::exists(out))
-      fs::copy_file(it->path(), out);
   }
+  return out;
+}
+
+// What fetching from `remote` into `local` asks for. A partial clone keeps
+// applying its filter. Local shallow commits are the receiver's boundary rather
+// than haves, since the history below them is missing here.
+inline gitfly::reach::TransferOptions fetch_options(const gitfly::Repository &local,
+                                                    const gitfly::Repository &remote,
+                                                    std::size_t depth) {
+  gitfly::reach::TransferOptions opts{
+      .depth = depth,
+      .filter = gitfly::reach::BlobFilter::parse(
+          gitfly::config_get(local.root(), gitfly::consts::kCfgPartialFilter).value_or("")),
+      .have = known_tips(local.root(), gitfly::ObjectStore{remote.git_dir()}),
+      .shallow = local.shallow_commits(),
+      .bitmaps = nullptr};
+  for (const auto &hex : opts.shallow) {
+    opts.have.erase(hex);
+  }
+  return opts;
+}
+
+// Place the listed objects from src into dst, skipping ones dst already has.
+// Loose objects are immutable, so they are hardlinked (or reflinked) rather than
+// copied when both repositories share a filesystem.
+inline void copy_objects(const gitfly::Repository &src, const gitfly::Repository &dst,
+                         const std::vector<std::string> &hexes) {
+  const gitfly::ObjectStore src_store{src.git_dir()};
+  const gitfly::ObjectStore dst_store{dst.git_dir()};
+  dst_store.load_index(); // most of `hexes` are usually missing from dst
+  bool placed = false;
+  for (const auto &hex : hexes) {
+    gitfly::oid id{};
+    if (!gitfly::from_hex(hex, id)) {
+      throw std::runtime_error("bad object id: " + hex);
+    }
+    if (dst_store.exists(hex)) {
+      continue; // already there, possibly through an alternate
+    }
+    (void)gitfly::fs::link_or_copy_file(src_store.locate(id), dst_store.path_for_oid(id));
+    (void)dst_store.record(hex);
+    placed = true;
+  }
+  if (placed) {
+    dst_store.sync(); // callers update refs next
+  }
+}
+
+// Set up `dst` from `src`: HEAD, config and refs plus the objects reachable from
+// them, selected by `opts` (depth limit and/or blob filter). A full clone takes
+// every branch and tag; a shallow/partial one only HEAD's branch. With `shared`
+// the objects stay in `src` (an alternate of `dst`) and nothing is walked.
+inline void clone_local(const stdfs::path &src, const stdfs::path &dst,
+                        const gitfly::reach::TransferOptions &opts, bool all_refs, bool shared) {
+  const gitfly::Repository rsrc{src};
+  const gitfly::Repository rdst{dst};
+  stdfs::create_directories(rdst.objects_dir());
+  stdfs::create_directories(rdst.heads_dir());
+  stdfs::create_directories(rdst.tags_dir());
+  stdfs::copy_file(rsrc.head_file(), rdst.head_file(), stdfs::copy_options::overwrite_existing);
+  if (stdfs::exists(rsrc.config_file())) {
+    stdfs::copy_file(rsrc.config_file(), rdst.config_file(), stdfs::copy_options::overwrite_existing);
+  }
+  std::vector<std::string> tips;
+  if (all_refs) {
+    for (const auto &ref : gitfly::list_refs(src, "refs/heads/")) {
+      gitfly::update_ref(dst, ref.name, ref.oid);
+      tips.push_back(ref.oid);
+    }
+    for (const auto &ref : gitfly::list_refs(src, "refs/tags/")) {
+      gitfly::update_ref(dst, ref.name, ref.oid);
+      tips.push_back(ref.oid);
+    }
+  }
+  if (const std::string tip = head_commit_hex(src); !tip.empty()) {
+    if (const auto sym = head_symbolic_ref(src)) {
+      gitfly::update_ref(dst, *sym, tip);
+    }
+    tips.insert(tips.begin(), tip);
+  }
+  if (shared) {
+    const auto boundary = rsrc.shallow_commits();
+    rdst.update_shallow_commits({boundary.begin(), boundary.end()});
+    return;
+  }
+  if (tips.empty()) {
+    return;
+  }
+  const auto plan = gitfly::reach::plan_transfer(rsrc, tips, opts);
+  copy_objects(rsrc, rdst, plan.objects);
+  rdst.update_shallow_commits(plan.shallow);
 }
 
 } // namespace
 
 namespace gitfly::remote {
 
-void clone_repo(const fs::path &src, const fs::path &dst) {
+stdfs::path reference_objects_dir(const stdfs::path &reference) {
+  const auto dir = reference / consts::kGitDir / consts::kObjectsDir;
+  if (!stdfs::is_directory(dir)) {
+    throw std::runtime_error("reference is not a gitfly repo: " + reference.string());
+  }
+  return stdfs::absolute(dir);
+}
+
+void clone_repo(const stdfs::path &src, const stdfs::path &dst, std::size_t depth,
+                const std::string &filter, bool shared, const stdfs::path &reference) {
+  const reach::TransferOptions opts{
+      .depth = depth, .filter = reach::BlobFilter::parse(filter), .have = {}, .shallow = {}};
   // Minimal validation
-  if (!fs::exists(src / gitfly::consts::kGitDir)) {
+  if (!stdfs::exists(src / gitfly::consts::kGitDir)) {
     throw std::runtime_error("source is not a gitfly repo");
   }
+  Repository{src}.require_portable_objects();
 
-  // Create destination and copy control dir
-  fs::create_directories(dst);
-  fs::copy(src / gitfly::consts::kGitDir, dst / gitfly::consts::kGitDir,
-           fs::copy_options::recursive | fs::copy_options::skip_existing);
+  if (shared && (depth > 0 || opts.filter.active())) {
+    throw std::runtime_error("--shared cannot be combined with --depth or --filter");
+  }
+
+  // Create destination; objects are linked in by reachability, not copied wholesale
+  stdfs::create_directories(dst);
+  const ObjectStore dst_store{dst / consts::kGitDir};
+  if (shared) {
+    dst_store.add_alternate(src / consts::kGitDir / consts::kObjectsDir);
+  }
+  if (!reference.empty()) {
+    dst_store.add_alternate(reference_objects_dir(reference));
+  }
+  clone_local(src, dst, opts, depth == 0 && !opts.filter.active(), shared);
+  if (opts.filter.active()) {
+    // Omitted blobs are fetched lazily from the source (see Repository::read_blob)
+    config_set(dst, consts::kCfgPromisor, stdfs::absolute(src).string());
+    config_set(dst, consts::kCfgPartialFilter, filter);
+  }
 
   // Materialize working tree at destination (if there’s a commit)
   Repository repo_dst{dst};
@@ -97,12 +216,14 @@ void clone_repo(const fs::path &src, const fs::path &dst) {
   worktree::write_index_snapshot(repo_dst, snapshot);
 }
 
-void push_branch(const fs::path &local, const fs::path &remote, const std::string &branch) {
+void push_branch(const stdfs::path &local, const stdfs::path &remote, const std::string &branch) {
   Repository rlocal{local};
   Repository rremote{remote};
   if (!rlocal.is_initialized() || !rremote.is_initialized()) {
     throw std::runtime_error("both repos must be initialized");
   }
+  rlocal.require_portable_objects();
+  rremote.require_portable_objects();
 
   // Require symbolic HEAD that matches the branch being pushed
   const std::string refname = heads_ref(branch);
@@ -115,31 +236,54 @@ void push_branch(const fs::path &local, const fs::path &remote, const std::strin
     throw std::runtime_error("current branch does not match push branch");
   }
 
-  // Resolve tips
-  const auto local_tip = read_ref(local, refname);
-  if (!local_tip) {
+  if (!read_ref(local, refname)) {
     throw std::runtime_error("local branch has no tip");
   }
-  const auto remote_tip = read_ref(remote, refname);
+  push_refs(local, remote, {refname});
+}
 
-  // Fast-forward check
-  if (remote_tip && !rlocal.is_commit_ancestor(*remote_tip, *local_tip)) {
-    throw std::runtime_error("non-fast-forward");
+void push_refs(const stdfs::path &local, const stdfs::path &remote,
+               const std::vector<std::string> &refnames) {
+  Repository rlocal{local};
+  Repository rremote{remote};
+  if (!rlocal.is_initialized() || !rremote.is_initialized()) {
+    throw std::runtime_error("both repos must be initialized");
+  }
+  rlocal.require_portable_objects();
+  rremote.require_portable_objects();
+  std::vector<RefUpdate> updates;
+  std::vector<std::string> tips;
+  for (const auto &name : refnames) {
+    const auto tip = read_ref(local, name);
+    if (!tip) {
+      throw std::runtime_error("no local ref " + name);
+    }
+    const auto old = read_ref(remote, name);
+    if (old && name.starts_with("refs/heads/") && !rlocal.is_commit_ancestor(*old, *tip)) {
+      throw std::runtime_error("non-fast-forward: " + name);
+    }
+    updates.push_back(RefUpdate{.name = name, .old_oid = old.value_or(""), .new_oid = *tip});
+    tips.push_back(*tip);
   }
 
-  // Copy missing objects
-  copy_missing_objects(rlocal.objects_dir(), rremote.objects_dir());
+  // Link over what the new history needs, stopping at commits the remote has
+  const auto objects =
+      reach::collect_objects(rlocal, tips, known_tips(remote, ObjectStore{rlocal.git_dir()}));
+  copy_objects(rlocal, rremote, objects);
 
-  // Update remote ref
-  update_ref(remote, refname, *local_tip);
+  // Fails without changing anything if a ref moved while the objects were copied
+  update_refs(remote, updates);
 }
 
-FetchResult fetch_head(const fs::path &local, const fs::path &remote, const std::string &name) {
+FetchResult fetch_head(const stdfs::path &local, const stdfs::path &remote, const std::string &name,
+                       std::size_t depth) {
   Repository rlocal{local};
   Repository rremote{remote};
   if (!rlocal.is_initialized() || !rremote.is_initialized()) {
     throw std::runtime_error("both repos must be initialized");
   }
+  rlocal.require_portable_objects();
+  rremote.require_portable_objects();
 
   // Determine remote “HEAD branch” & tip
   std::string branch = "DETACHED";
@@ -162,12 +306,17 @@ FetchResult fetch_head(const fs::path &local, const fs::path &remote, const std:
     }
   }
 
-  // Bring over missing objects
-  copy_missing_objects(rremote.objects_dir(), rlocal.objects_dir());
+  // Bring over missing objects (a partial clone keeps applying its filter)
+  const auto opts = fetch_options(rlocal, rremote, depth);
+  if (!tip.empty()) {
+    const auto plan = reach::plan_transfer(rremote, {tip}, opts);
+    copy_objects(rremote, rlocal, plan.objects);
+    rlocal.update_shallow_commits(plan.shallow);
+  }
 
   // Update remote-tracking ref if we know the branch & tip
   if (!tip.empty() && branch != "DETACHED") {
-    fs::create_directories(rlocal.refs_dir() / "remotes" / name);
+    stdfs::create_directories(rlocal.refs_dir() / "remotes" / name);
     update_ref(local, std::string(gitfly::consts::kRefsDir) + "/remotes/" + name + "/" + branch,
                tip);
   }
@@ -175,4 +324,36 @@ FetchResult fetch_head(const fs::path &local, const fs::path &remote, const std:
   return FetchResult{.branch = branch, .tip = tip};
 }
 
+std::vector<RefEntry> fetch_refs(const stdfs::path &local, const stdfs::path &remote,
+                                 const std::string &name, const std::string &prefix,
+                                 std::size_t depth) {
+  Repository rlocal{local};
+  Repository rremote{remote};
+  if (!rlocal.is_initialized() || !rremote.is_initialized()) {
+    throw std::runtime_error("both repos must be initialized");
+  }
+  rlocal.require_portable_objects();
+  rremote.require_portable_objects();
+
+  auto refs = list_refs(remote, prefix.empty() ? "refs/" : prefix);
+  std::vector<std::string> tips;
+  for (const auto &ref : refs) {
+    tips.push_back(ref.oid);
+  }
+
+  // Local tips the remote also has bound the walk, as HAVE lines do over TCP.
+  const auto opts = fetch_options(rlocal, rremote, depth);
+  const auto plan = reach::plan_transfer(rremote, tips, opts);
+  copy_objects(rremote, rlocal, plan.objects);
+  rlocal.update_shallow_commits(plan.shallow);
+
+  update_tracking_refs(local, name, refs);
+  return refs;
+}
+
+void fetch_objects(const stdfs::path &local, const stdfs::path &remote,
+                   const std::vector<std::string> &hexes) {
+  copy_objects(Repository{remote}, Repository{local}, hexes);
+}
+
 } // namespace gitfly::remote
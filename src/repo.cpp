@@ -5,7 +5,9 @@
 #include "gitfly/index.hpp"
 #include "gitfly/object_store.hpp"
 #include "gitfly/refs.hpp"
+#include "gitfly/remote.hpp"
 #include "gitfly/status.hpp"
+#include "gitfly/tcp_remote.hpp"
 #include "gitfly/time.hpp"
 #include "gitfly/util.hpp"
 #include "gitfly/worktree.hpp"
@@ -15,6 +17,7 @@
 #include <cstdint>
 #include <cstring>
 #include <filesystem>
+#include <fstream>
 #include <map>
 #include <set>
 #include <stdexcept>
@@ -43,10 +46,14 @@ Repository::Repository(stdfs::path root) : root_(std::move(root)) {}
 
 auto Repository::is_initialized() const -> bool { return stdfs::exists(git_dir()); }
 
-void Repository::init(const Identity& identity) const {
+void Repository::init(const Identity& identity, fs::Codec codec) const {
   if (is_initialized()) {
     throw std::runtime_error("A gitfly repository already exists at: " + git_dir().string());
   }
+  // Refuse what this build cannot store before anything is created
+  if (codec == fs::Codec::zstd && !fs::codec_available(codec)) {
+    throw std::runtime_error("zstd objects need a build with GITFLY_WITH_ZSTD");
+  }
 
   std::error_code ec;
   stdfs::create_directories(objects_dir(), ec);
@@ -64,6 +71,15 @@ void Repository::init(const Identity& identity) const {
  
   set_HEAD_symbolic(root_, heads_ref(std::string(consts::kDefaultBranch)));
   save_identity(root_, identity);
+  if (codec == fs::Codec::zstd) {
+    config_set(root_, consts::kCfgObjectCodec, "zstd");
+  }
+}
+
+void Repository::require_portable_objects() const {
+  if (ObjectStore{git_dir()}.codec() != fs::Codec::zlib) {
+    throw std::runtime_error("zstd repositories cannot be transferred: " + root_.string());
+  }
 }
 
 // Paths
@@ -100,8 +116,30 @@ auto Repository::write_blob(std::span<const std::uint8_t> bytes) const -> std::s
   return store.write(consts::kTypeBlob, bytes);
 }
 
+auto Repository::write_blob_file(const std::filesystem::path &file) const -> std::string {
+  const ObjectStore store{git_dir()};
+  // Re-adding an unchanged file is the common case, and hashing alone is far
+  // cheaper than deflating, so look for the blob before writing it.
+  if (std::string hex = compute_file_blob_hex_oid(file); store.exists(hex)) {
+    return hex;
+  }
+  std::ifstream in(file, std::ios::binary);
+  if (!in) {
+    throw std::runtime_error("cannot open " + file.string());
+  }
+  return store.write_stream(consts::kTypeBlob, std::filesystem::file_size(file),
+                            [&in](std::span<std::uint8_t> buf) {
+                              in.read(reinterpret_cast<char *>(buf.data()),
+                                      static_cast<std::streamsize>(buf.size()));
+                              return static_cast<std::size_t>(in.gcount());
+                            });
+}
+
 auto Repository::read_blob(std::string_view hex_oid) const -> std::vector<std::uint8_t> {
   const ObjectStore store{git_dir()};
+  if (!store.exists(hex_oid)) {
+    prefetch_blobs({std::string(hex_oid)});
+  }
   const auto [type, data] = store.read(hex_oid);
   if (type != consts::kTypeBlob) {
     throw std::runtime_error("object is not a blob");
@@ -109,6 +147,38 @@ auto Repository::read_blob(std::string_view hex_oid) const -> std::vector<std::u
   return data;
 }
 
+ObjectStream Repository::open_blob(std::string_view hex_oid) const {
+  const ObjectStore store{git_dir()};
+  if (!store.exists(hex_oid)) {
+    prefetch_blobs({std::string(hex_oid)});
+  }
+  auto stream = store.open_stream(hex_oid);
+  if (stream.type() != consts::kTypeBlob) {
+    throw std::runtime_error("object is not a blob");
+  }
+  return stream;
+}
+
+void Repository::prefetch_blobs(const std::vector<std::string>& hex_oids) const {
+  const auto promisor = config_get(root_, consts::kCfgPromisor);
+  if (!promisor) return;
+  const ObjectStore store{git_dir()};
+  std::set<std::string> unique;
+  std::vector<std::string> missing;
+  for (const auto& hex : hex_oids) {
+    if (unique.insert(hex).second && !store.exists(hex)) missing.push_back(hex);
+  }
+  if (missing.empty()) return;
+
+  if (promisor->starts_with("tcp://")) {
+    const auto ep = tcpremote::parse_url(*promisor);
+    tcpremote::fetch_objects(ep.host, ep.port, root_.string(), missing,
+                             tcpremote::SessionOptions{.repo = ep.repo});
+  } else {
+    remote::fetch_objects(root_, *promisor, missing);
+  }
+}
+
 // Trees (binary)
 
 auto Repository::write_tree(const std::vector<TreeEntry>& entries_in) const -> std::string {
@@ -255,15 +325,63 @@ auto Repository::read_commit(std::string_view commit_hex) const -> CommitInfo {
   return info;
 }
 
+auto Repository::shallow_commits() const -> std::set<std::string> {
+  std::set<std::string> out;
+  if (!stdfs::exists(shallow_file())) return out;
+  const auto bytes = gfs::read_file(shallow_file());
+  const std::string text(bytes.begin(), bytes.end());
+  std::size_t pos = 0;
+  while (pos < text.size()) {
+    std::size_t nl = text.find('\n', pos);
+    if (nl == std::string::npos) nl = text.size();
+    std::string line = text.substr(pos, nl - pos);
+    strutil::rstrip_newlines(line);
+    if (looks_hex40(line)) out.insert(std::move(line));
+    pos = nl + 1;
+  }
+  return out;
+}
+
+void Repository::update_shallow_commits(const std::vector<std::string>& hexes) const {
+  const ObjectStore store{git_dir()};
+  const auto before = shallow_commits();
+  auto candidates = before;
+  candidates.insert(hexes.begin(), hexes.end());
+  std::set<std::string> all;
+  for (const auto& hex : candidates) {
+    const auto info = read_commit(hex);
+    if (std::ranges::any_of(info.parents,
+                            [&](const std::string& p) { return !store.exists(p); })) {
+      all.insert(hex);
+    }
+  }
+  if (all == before) return;
+  if (all.empty()) {
+    stdfs::remove(shallow_file());
+    return;
+  }
+  std::string txt;
+  for (const auto& h : all) {
+    txt += h;
+    txt += '\n';
+  }
+  gfs::write_file_atomic(
+      shallow_file(),
+      std::span<const std::uint8_t>(reinterpret_cast<const std::uint8_t*>(txt.data()),
+                                    txt.size()));
+}
+
 auto Repository::is_commit_ancestor(std::string_view ancestor_hex,
                                     std::string_view descendant_hex) const -> bool {
   if (ancestor_hex == descendant_hex) return true;
+  const auto shallow = shallow_commits();
   std::vector<std::string> stack{std::string(descendant_hex)};
   std::set<std::string> seen;
   while (!stack.empty()) {
     const auto cur = stack.back();
     stack.pop_back();
     if (!seen.insert(cur).second) continue;
+    if (shallow.contains(cur)) continue; // history below is not present
     const auto info = read_commit(cur);
     for (const auto &p : info.parents) {
       if (p == ancestor_hex) return true;
@@ -378,6 +496,7 @@ auto Repository::commit_index(std::string_view message) const -> std::string {
   const std::string sig = timeutil::make_signature(id, now, tz_min);
 
   const std::string commit_hex = write_commit(tree_hex, parents, sig, sig, message);
+  ObjectStore{git_dir()}.sync(); // objects first, then the ref naming them
 
   if (head_txt && head_txt->rfind("ref:", 0) == 0) {
     std::string rn = head_txt->substr(std::string("ref: ").size());
@@ -425,6 +544,7 @@ auto Repository::commit_index_with_parents(std::string_view message,
   const std::string sig = timeutil::make_signature(id, now, tz_min);
 
   const std::string commit_hex = write_commit(tree_hex, parents, sig, sig, message);
+  ObjectStore{git_dir()}.sync(); // objects first, then the ref naming them
 
   if (head_txt && head_txt->rfind("ref:", 0) == 0) {
     std::string rn = head_txt->substr(std::string("ref: ").size());
@@ -504,6 +624,7 @@ namespace {
 [[nodiscard]] auto lca_commit(const Repository& repo,
                               const std::string& a,
                               const std::string& b) -> std::optional<std::string> {
+  const auto shallow = repo.shallow_commits();
   std::set<std::string> ancestors_a;
   {
     std::vector<std::string> stack{a};
@@ -511,6 +632,7 @@ namespace {
       const auto cur = stack.back();
       stack.pop_back();
       if (!ancestors_a.insert(cur).second) continue;
+      if (shallow.contains(cur)) continue;
       const auto info = repo.read_commit(cur);
       for (const auto& p : info.parents) stack.push_back(p);
     }
@@ -522,6 +644,7 @@ namespace {
     stack_b.pop_back();
     if (!seen_b.insert(cur).second) continue;
     if (ancestors_a.count(cur) != 0U) return cur;
+    if (shallow.contains(cur)) continue;
     const auto info = repo.read_commit(cur);
     for (const auto& p : info.parents) stack_b.push_back(p);
   }
@@ -609,8 +732,9 @@ void Repository::merge_branch(const std::string& giver_branch) const {
         result.erase(path);
         stdfs::remove(root_ / path);
       } else {
-        const auto bytes = read_blob(ot);
-        gfs::write_file_atomic(root_ / path, bytes);
+        auto blob = open_blob(ot);
+        gfs::write_file_atomic(root_ / path,
+                               [&blob](std::span<std::uint8_t> buf) { return blob.read(buf); });
         result[path] = ot;
       }
       continue;
@@ -0,0 +1,162 @@
+#include "gitfly/hash.hpp"
+
+#include "sha1_lanes.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace gitfly {
+
+namespace {
+
+using detail::Sha1Message;
+
+// Longer messages keep one lane busy for many blocks while the others finish
+// and idle; Hasher (SHA-NI where present) handles those better.
+constexpr std::size_t kLaneMaxBytes = 16 * 1024;
+
+bool cpu_has(Sha1Engine engine) {
+#if defined(GITFLY_SHA1_LANES_X86)
+  __builtin_cpu_init();
+  switch (engine) {
+  case Sha1Engine::avx512:
+    return __builtin_cpu_supports("avx512f");
+  case Sha1Engine::avx2:
+    return __builtin_cpu_supports("avx2");
+  default:
+    return true;
+  }
+#else
+  return engine == Sha1Engine::scalar || engine == Sha1Engine::automatic;
+#endif
+}
+
+// 16 AVX-512 lanes beat one SHA-NI stream; 8 AVX2 lanes only beat the portable
+// block function, so with SHA-NI present the scalar path wins.
+Sha1Engine best_engine() {
+  static const Sha1Engine best = [] {
+    if (cpu_has(Sha1Engine::avx512)) {
+      return Sha1Engine::avx512;
+    }
+#if defined(GITFLY_SHA1_LANES_X86)
+    if (__builtin_cpu_supports("sha")) {
+      return Sha1Engine::scalar;
+    }
+#endif
+    return cpu_has(Sha1Engine::avx2) ? Sha1Engine::avx2 : Sha1Engine::scalar;
+  }();
+  return best;
+}
+
+void hash_scalar(std::span<const Sha1Message> msgs, oid *out) {
+  for (std::size_t i = 0; i < msgs.size(); ++i) {
+    Hasher h;
+    h.update(msgs[i].head);
+    h.update(msgs[i].body);
+    out[i] = h.finish();
+  }
+}
+
+void hash_with(Sha1Engine engine, std::span<const Sha1Message> msgs, oid *out) {
+  switch (engine) {
+#if defined(GITFLY_SHA1_LANES_X86)
+  case Sha1Engine::avx512:
+    detail::sha1_lanes_avx512(msgs, out);
+    return;
+  case Sha1Engine::avx2:
+    detail::sha1_lanes_avx2(msgs, out);
+    return;
+#endif
+  default:
+    hash_scalar(msgs, out);
+  }
+}
+
+// Short messages go to the lanes, long ones (or everything, if an engine was
+// asked for explicitly) stay where they are.
+void hash_messages(std::span<const Sha1Message> msgs, std::span<oid> out, Sha1Engine engine) {
+  if (msgs.size() != out.size()) {
+    throw std::runtime_error("sha1_many: " + std::to_string(msgs.size()) + " inputs but " +
+                             std::to_string(out.size()) + " outputs");
+  }
+  if (engine != Sha1Engine::automatic) {
+    if (!sha1_engine_available(engine)) {
+      throw std::runtime_error("sha1_many: engine not available on this machine");
+    }
+    hash_with(engine, msgs, out.data());
+    return;
+  }
+  engine = best_engine();
+  std::vector<Sha1Message> small;
+  std::vector<std::size_t> slot;
+  small.reserve(msgs.size());
+  slot.reserve(msgs.size());
+  for (std::size_t i = 0; i < msgs.size(); ++i) {
+    if (engine == Sha1Engine::scalar || msgs[i].head.size() + msgs[i].body.size() > kLaneMaxBytes) {
+      hash_scalar(msgs.subspan(i, 1), &out[i]);
+    } else {
+      small.push_back(msgs[i]);
+      slot.push_back(i);
+    }
+  }
+  if (small.empty()) {
+    return;
+  }
+  std::vector<oid> ids(small.size());
+  hash_with(small.size() == 1 ? Sha1Engine::scalar : engine, small, ids.data());
+  for (std::size_t i = 0; i < small.size(); ++i) {
+    out[slot[i]] = ids[i];
+  }
+}
+
+} // namespace
+
+bool sha1_engine_available(Sha1Engine engine) { return cpu_has(engine); }
+
+std::string_view sha1_engine_name() {
+  switch (best_engine()) {
+  case Sha1Engine::avx512:
+    return "avx512";
+  case Sha1Engine::avx2:
+    return "avx2";
+  default:
+    return "scalar";
+  }
+}
+
+void sha1_many(std::span<const std::span<const std::uint8_t>> inputs, std::span<oid> out,
+               Sha1Engine engine) {
+  std::vector<Sha1Message> msgs;
+  msgs.reserve(inputs.size());
+  for (const auto &in : inputs) {
+    msgs.push_back(Sha1Message{.head = {}, .body = in});
+  }
+  hash_messages(msgs, out, engine);
+}
+
+std::vector<oid> hash_objects(std::string_view type,
+                              std::span<const std::span<const std::uint8_t>> payloads) {
+  std::vector<std::string> headers;
+  std::vector<Sha1Message> msgs;
+  headers.reserve(payloads.size());
+  msgs.reserve(payloads.size());
+  for (const auto &payload : payloads) {
+    headers.push_back(object_header(type, payload.size()));
+  }
+  for (std::size_t i = 0; i < payloads.size(); ++i) {
+    const auto &hdr = headers[i];
+    msgs.push_back(Sha1Message{
+        .head = {reinterpret_cast<const std::uint8_t *>(hdr.data()), hdr.size()},
+        .body = payloads[i]});
+  }
+  std::vector<oid> ids(payloads.size());
+  hash_messages(msgs, ids, Sha1Engine::automatic);
+  return ids;
+}
+
+} // namespace gitfly
@@ -0,0 +1,43 @@
+// Compiled with -mavx2; only called after the CPU has been checked.
+#include "sha1_lanes.hpp"
+
+#include <immintrin.h>
+
+namespace gitfly::detail {
+
+namespace {
+
+struct Avx2 {
+  static constexpr std::size_t kLanes = 8;
+  using reg = __m256i;
+
+  static reg load(const std::uint32_t *p) {
+    return _mm256_load_si256(reinterpret_cast<const __m256i *>(p));
+  }
+  static void store(std::uint32_t *p, reg v) {
+    _mm256_store_si256(reinterpret_cast<__m256i *>(p), v);
+  }
+  static reg set1(std::uint32_t v) { return _mm256_set1_epi32(static_cast<int>(v)); }
+  static reg add(reg a, reg b) { return _mm256_add_epi32(a, b); }
+  template <int N> static reg rotl(reg x) {
+    return _mm256_or_si256(_mm256_slli_epi32(x, N), _mm256_srli_epi32(x, 32 - N));
+  }
+  static reg xor4(reg a, reg b, reg c, reg d) {
+    return _mm256_xor_si256(_mm256_xor_si256(a, b), _mm256_xor_si256(c, d));
+  }
+  static reg ch(reg b, reg c, reg d) {
+    return _mm256_xor_si256(d, _mm256_and_si256(b, _mm256_xor_si256(c, d)));
+  }
+  static reg parity(reg b, reg c, reg d) { return _mm256_xor_si256(_mm256_xor_si256(b, c), d); }
+  static reg maj(reg b, reg c, reg d) {
+    return _mm256_or_si256(_mm256_and_si256(b, c), _mm256_and_si256(d, _mm256_or_si256(b, c)));
+  }
+};
+
+} // namespace
+
+void sha1_lanes_avx2(std::span<const Sha1Message> msgs, oid *out) {
+  sha1_lanes<Avx2>(msgs, out);
+}
+
+} // namespace gitfly::detail
@@ -0,0 +1,35 @@
+// Compiled with -mavx512f; only called after the CPU has been checked.
+#include "sha1_lanes.hpp"
+
+#include <immintrin.h>
+
+namespace gitfly::detail {
+
+namespace {
+
+// vpternlogd folds each round function into one instruction and vprold is a
+// native rotate, which is most of the gain over the AVX2 version.
+struct Avx512 {
+  static constexpr std::size_t kLanes = 16;
+  using reg = __m512i;
+
+  static reg load(const std::uint32_t *p) { return _mm512_load_si512(p); }
+  static void store(std::uint32_t *p, reg v) { _mm512_store_si512(p, v); }
+  static reg set1(std::uint32_t v) { return _mm512_set1_epi32(static_cast<int>(v)); }
+  static reg add(reg a, reg b) { return _mm512_add_epi32(a, b); }
+  template <int N> static reg rotl(reg x) { return _mm512_rol_epi32(x, N); }
+  static reg xor4(reg a, reg b, reg c, reg d) {
+    return _mm512_xor_si512(_mm512_ternarylogic_epi32(a, b, c, 0x96), d);
+  }
+  static reg ch(reg b, reg c, reg d) { return _mm512_ternarylogic_epi32(b, c, d, 0xCA); }
+  static reg parity(reg b, reg c, reg d) { return _mm512_ternarylogic_epi32(b, c, d, 0x96); }
+  static reg maj(reg b, reg c, reg d) { return _mm512_ternarylogic_epi32(b, c, d, 0xE8); }
+};
+
+} // namespace
+
+void sha1_lanes_avx512(std::span<const Sha1Message> msgs, oid *out) {
+  sha1_lanes<Avx512>(msgs, out);
+}
+
+} // namespace gitfly::detail
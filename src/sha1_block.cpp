@@ -0,0 +1,79 @@
+#include "sha1_block.hpp"
+
+#include <cstring>
+#include <utility>
+
+namespace gitfly::detail {
+
+namespace {
+
+constexpr std::uint32_t rotl(std::uint32_t x, int n) { return (x << n) | (x >> (32 - n)); }
+
+// Round T, with the state registers renamed instead of shifted: callers pass
+// them rotated by one position per round.
+template <int T>
+inline void round(std::uint32_t a, std::uint32_t &b, std::uint32_t c, std::uint32_t d,
+                  std::uint32_t &e, std::uint32_t *w) {
+  if constexpr (T >= 16) {
+    w[T & 15] = rotl(w[(T - 3) & 15] ^ w[(T - 8) & 15] ^ w[(T - 14) & 15] ^ w[T & 15], 1);
+  }
+  std::uint32_t f;
+  std::uint32_t k;
+  if constexpr (T < 20) {
+    f = d ^ (b & (c ^ d));
+    k = 0x5A827999;
+  } else if constexpr (T < 40) {
+    f = b ^ c ^ d;
+    k = 0x6ED9EBA1;
+  } else if constexpr (T < 60) {
+    f = (b & c) | (d & (b | c));
+    k = 0x8F1BBCDC;
+  } else {
+    f = b ^ c ^ d;
+    k = 0xCA62C1D6;
+  }
+  e += rotl(a, 5) + f + k + w[T & 15];
+  b = rotl(b, 30);
+}
+
+template <int... T>
+inline void all_rounds(std::uint32_t *v, std::uint32_t *w, std::integer_sequence<int, T...> /*t*/) {
+  // Round T works on (a,b,c,d,e) = v[(5-T%5)%5 ...]: the roles rotate every round.
+  ((round<T>(v[(5 - T % 5) % 5], v[(6 - T % 5) % 5], v[(7 - T % 5) % 5], v[(8 - T % 5) % 5],
+             v[(9 - T % 5) % 5], w)),
+   ...);
+}
+
+} // namespace
+
+void sha1_blocks_portable(std::uint32_t *h, const std::uint8_t *data, std::size_t nblocks) {
+  for (; nblocks != 0; --nblocks, data += 64) {
+    std::uint32_t w[16];
+    for (int t = 0; t < 16; ++t) {
+      std::uint32_t x;
+      std::memcpy(&x, data + 4 * t, 4);
+      w[t] = __builtin_bswap32(x);
+    }
+    std::uint32_t v[5] = {h[0], h[1], h[2], h[3], h[4]};
+    all_rounds(v, w, std::make_integer_sequence<int, 80>{});
+    for (int i = 0; i < 5; ++i) {
+      h[i] += v[i];
+    }
+  }
+}
+
+Sha1BlockFn sha1_block_fn() {
+#if defined(GITFLY_SHA1_LANES_X86)
+  static const Sha1BlockFn fn = [] {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sha") && __builtin_cpu_supports("sse4.1")
+               ? &sha1_blocks_shani
+               : &sha1_blocks_portable;
+  }();
+  return fn;
+#else
+  return &sha1_blocks_portable;
+#endif
+}
+
+} // namespace gitfly::detail
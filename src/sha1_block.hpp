@@ -0,0 +1,23 @@
+#pragma once
+// SHA-1 compression function used by Hasher. The SHA-NI version lives in its
+// own translation unit (built with -msha) and is only called after a CPU check.
+
+#include <cstddef>
+#include <cstdint>
+
+namespace gitfly::detail {
+
+// Run `nblocks` 64-byte blocks from `data` through the state `h`.
+using Sha1BlockFn = void (*)(std::uint32_t *h, const std::uint8_t *data, std::size_t nblocks);
+
+void sha1_blocks_portable(std::uint32_t *h, const std::uint8_t *data, std::size_t nblocks);
+// Defined only when built for x86-64.
+void sha1_blocks_shani(std::uint32_t *h, const std::uint8_t *data, std::size_t nblocks);
+// One block through `h`, storing its 80 expanded message words in `w` (for
+// collision detection). x86-64 only, like sha1_blocks_shani.
+void sha1_block_shani_w(std::uint32_t *h, const std::uint8_t *data, std::uint32_t *w);
+
+// The fastest implementation this CPU runs, picked once.
+Sha1BlockFn sha1_block_fn();
+
+} // namespace gitfly::detail
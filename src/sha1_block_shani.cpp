@@ -0,0 +1,86 @@
+// Compiled with -msha -msse4.1; only called after the CPU has been checked.
+#include "sha1_block.hpp"
+
+#include <immintrin.h>
+
+#include <utility>
+
+namespace gitfly::detail {
+
+namespace {
+
+struct Regs {
+  __m128i abcd;
+  __m128i e0;
+  __m128i e1;
+  __m128i msg[4];
+};
+
+// Rounds 4G..4G+3. Message words are expanded four at a time in msg[], which
+// rotates through the four registers; e0/e1 alternate holding the next E.
+// Unless `w` is null, the words are also stored there in message order.
+template <int G>
+inline void rounds4(Regs &r, const std::uint8_t *data, __m128i bswap, std::uint32_t *w) {
+  constexpr int kFunc = G / 5;
+  __m128i &e = (G % 2 == 0) ? r.e0 : r.e1;
+  __m128i &other = (G % 2 == 0) ? r.e1 : r.e0;
+  __m128i &x = r.msg[G % 4];
+  if constexpr (G < 4) {
+    x = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 16 * G)), bswap);
+  }
+  if (w != nullptr) {
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(w + 4 * G), _mm_shuffle_epi32(x, 0x1B));
+  }
+  e = (G == 0) ? _mm_add_epi32(e, x) : _mm_sha1nexte_epu32(e, x);
+  other = r.abcd;
+  if constexpr (G >= 3 && G < 19) {
+    r.msg[(G + 1) % 4] = _mm_sha1msg2_epu32(r.msg[(G + 1) % 4], x);
+  }
+  r.abcd = _mm_sha1rnds4_epu32(r.abcd, e, kFunc);
+  if constexpr (G >= 1 && G < 17) {
+    r.msg[(G + 3) % 4] = _mm_sha1msg1_epu32(r.msg[(G + 3) % 4], x);
+  }
+  if constexpr (G >= 2 && G < 18) {
+    r.msg[(G + 2) % 4] = _mm_xor_si128(r.msg[(G + 2) % 4], x);
+  }
+}
+
+template <int... G>
+inline void all_rounds(Regs &r, const std::uint8_t *data, __m128i bswap, std::uint32_t *w,
+                       std::integer_sequence<int, G...> /*groups*/) {
+  (rounds4<G>(r, data, bswap, w), ...);
+}
+
+} // namespace
+
+void sha1_blocks_shani(std::uint32_t *h, const std::uint8_t *data, std::size_t nblocks) {
+  const __m128i bswap = _mm_set_epi64x(0x0001020304050607LL, 0x08090a0b0c0d0e0fLL);
+  Regs r{};
+  r.abcd = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(h)), 0x1B);
+  r.e0 = _mm_set_epi32(static_cast<int>(h[4]), 0, 0, 0);
+  for (; nblocks != 0; --nblocks, data += 64) {
+    const __m128i abcd_save = r.abcd;
+    const __m128i e0_save = r.e0;
+    all_rounds(r, data, bswap, nullptr, std::make_integer_sequence<int, 20>{});
+    r.e0 = _mm_sha1nexte_epu32(r.e0, e0_save);
+    r.abcd = _mm_add_epi32(r.abcd, abcd_save);
+  }
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(h), _mm_shuffle_epi32(r.abcd, 0x1B));
+  h[4] = static_cast<std::uint32_t>(_mm_extract_epi32(r.e0, 3));
+}
+
+void sha1_block_shani_w(std::uint32_t *h, const std::uint8_t *data, std::uint32_t *w) {
+  const __m128i bswap = _mm_set_epi64x(0x0001020304050607LL, 0x08090a0b0c0d0e0fLL);
+  Regs r{};
+  r.abcd = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(h)), 0x1B);
+  r.e0 = _mm_set_epi32(static_cast<int>(h[4]), 0, 0, 0);
+  const __m128i abcd_save = r.abcd;
+  const __m128i e0_save = r.e0;
+  all_rounds(r, data, bswap, w, std::make_integer_sequence<int, 20>{});
+  r.e0 = _mm_sha1nexte_epu32(r.e0, e0_save);
+  r.abcd = _mm_add_epi32(r.abcd, abcd_save);
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(h), _mm_shuffle_epi32(r.abcd, 0x1B));
+  h[4] = static_cast<std::uint32_t>(_mm_extract_epi32(r.e0, 3));
+}
+
+} // namespace gitfly::detail
@@ -0,0 +1,181 @@
+#pragma once
+// Multi-buffer SHA-1: independent messages hashed in lockstep, one per SIMD
+// lane. This header is included by one translation unit per instruction set,
+// each compiled with its own -m flags, so everything defined here has internal
+// linkage: differently compiled copies must never be merged by the linker.
+
+#include "gitfly/hash.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+namespace gitfly::detail {
+
+// A message is `head` followed by `body` (e.g. object header + payload).
+struct Sha1Message {
+  std::span<const std::uint8_t> head;
+  std::span<const std::uint8_t> body;
+};
+
+// Defined only when built for x86-64; callers check the CPU first.
+void sha1_lanes_avx2(std::span<const Sha1Message> msgs, oid *out);
+void sha1_lanes_avx512(std::span<const Sha1Message> msgs, oid *out);
+
+namespace {
+
+constexpr std::uint32_t kIv[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+
+inline std::size_t block_count(const Sha1Message &m) {
+  return (m.head.size() + m.body.size() + 8) / 64 + 1;
+}
+
+// Block `k` of the padded message as 16 big-endian words.
+inline void load_block(const Sha1Message &m, std::size_t k, std::uint32_t *w) {
+  const std::size_t hlen = m.head.size();
+  const std::size_t len = hlen + m.body.size();
+  const std::size_t off = k * 64;
+  std::uint8_t scratch[64];
+  const std::uint8_t *p = scratch;
+  if (off >= hlen && off + 64 <= len) {
+    p = m.body.data() + (off - hlen); // whole block inside the body
+  } else {
+    std::size_t n = 0;
+    if (off < hlen) {
+      n = std::min<std::size_t>(hlen - off, 64);
+      std::memcpy(scratch, m.head.data() + off, n);
+    }
+    if (n < 64 && off + n < len) {
+      const std::size_t from = off + n - hlen;
+      const std::size_t take = std::min<std::size_t>(64 - n, m.body.size() - from);
+      std::memcpy(scratch + n, m.body.data() + from, take);
+      n += take;
+    }
+    std::memset(scratch + n, 0, 64 - n);
+    if (off <= len && len < off + 64) {
+      scratch[len - off] = 0x80;
+    }
+    if (k + 1 == block_count(m)) {
+      const std::uint64_t bits = std::uint64_t{len} * 8;
+      for (int i = 0; i < 8; ++i) {
+        scratch[63 - i] = static_cast<std::uint8_t>(bits >> (8 * i));
+      }
+    }
+  }
+  for (int t = 0; t < 16; ++t) {
+    std::uint32_t v;
+    std::memcpy(&v, p + 4 * t, 4);
+    w[t] = __builtin_bswap32(v);
+  }
+}
+
+// One block for every lane. `st` and `w` are lane-major: st[i][lane], w[t][lane].
+template <class V>
+inline void compress(std::uint32_t (*st)[V::kLanes], const std::uint32_t (*w)[V::kLanes]) {
+  using R = typename V::reg;
+  R a = V::load(st[0]);
+  R b = V::load(st[1]);
+  R c = V::load(st[2]);
+  R d = V::load(st[3]);
+  R e = V::load(st[4]);
+  const R a0 = a, b0 = b, c0 = c, d0 = d, e0 = e;
+  R sched[16];
+  for (int t = 0; t < 16; ++t) {
+    sched[t] = V::load(w[t]);
+  }
+  auto round = [&](int t, R f, std::uint32_t k) {
+    R wt = sched[t & 15];
+    if (t >= 16) {
+      wt = V::template rotl<1>(
+          V::xor4(sched[(t - 3) & 15], sched[(t - 8) & 15], sched[(t - 14) & 15], wt));
+      sched[t & 15] = wt;
+    }
+    const R tmp = V::add(V::add(V::template rotl<5>(a), f), V::add(V::add(e, V::set1(k)), wt));
+    e = d;
+    d = c;
+    c = V::template rotl<30>(b);
+    b = a;
+    a = tmp;
+  };
+  for (int t = 0; t < 20; ++t) {
+    round(t, V::ch(b, c, d), 0x5A827999);
+  }
+  for (int t = 20; t < 40; ++t) {
+    round(t, V::parity(b, c, d), 0x6ED9EBA1);
+  }
+  for (int t = 40; t < 60; ++t) {
+    round(t, V::maj(b, c, d), 0x8F1BBCDC);
+  }
+  for (int t = 60; t < 80; ++t) {
+    round(t, V::parity(b, c, d), 0xCA62C1D6);
+  }
+  V::store(st[0], V::add(a, a0));
+  V::store(st[1], V::add(b, b0));
+  V::store(st[2], V::add(c, c0));
+  V::store(st[3], V::add(d, d0));
+  V::store(st[4], V::add(e, e0));
+}
+
+// Hash every message into out[i]. A lane that finishes takes the next message,
+// so lanes stay busy until the queue runs dry.
+template <class V>
+void sha1_lanes(std::span<const Sha1Message> msgs, oid *out) {
+  constexpr std::size_t kLanes = V::kLanes;
+  constexpr std::size_t kIdle = ~std::size_t{0};
+  std::size_t msg[kLanes];
+  std::size_t block[kLanes];
+  std::size_t blocks[kLanes];
+  alignas(64) std::uint32_t st[5][kLanes];
+  alignas(64) std::uint32_t w[16][kLanes] = {};
+  std::size_t next = 0;
+  std::size_t active = 0;
+
+  auto assign = [&](std::size_t lane) {
+    if (next == msgs.size()) {
+      msg[lane] = kIdle;
+      return;
+    }
+    msg[lane] = next;
+    block[lane] = 0;
+    blocks[lane] = block_count(msgs[next]);
+    ++next;
+    ++active;
+    for (int i = 0; i < 5; ++i) {
+      st[i][lane] = kIv[i];
+    }
+  };
+  for (std::size_t lane = 0; lane < kLanes; ++lane) {
+    assign(lane);
+  }
+
+  while (active != 0) {
+    for (std::size_t lane = 0; lane < kLanes; ++lane) {
+      if (msg[lane] == kIdle) {
+        continue; // computes on stale words; the result is never read
+      }
+      std::uint32_t words[16];
+      load_block(msgs[msg[lane]], block[lane], words);
+      for (int t = 0; t < 16; ++t) {
+        w[t][lane] = words[t];
+      }
+    }
+    compress<V>(st, w);
+    for (std::size_t lane = 0; lane < kLanes; ++lane) {
+      if (msg[lane] == kIdle || ++block[lane] != blocks[lane]) {
+        continue;
+      }
+      oid &digest = out[msg[lane]];
+      for (int i = 0; i < 5; ++i) {
+        const std::uint32_t v = __builtin_bswap32(st[i][lane]);
+        std::memcpy(digest.data() + 4 * i, &v, 4);
+      }
+      --active;
+      assign(lane);
+    }
+  }
+}
+
+} // namespace
+
+} // namespace gitfly::detail
@@ -0,0 +1,263 @@
+#include "sha1dc.hpp"
+#include "sha1_block.hpp"
+#include "sha1dc_tables.hpp"
+
+#include <array>
+#include <cstring>
+#include <utility>
+
+// SHA-1 collision detection by counter-cryptanalysis, after Marc Stevens and
+// Dan Shumow, "Speeding up detection of SHA-1 collision attacks using
+// unavoidable attack conditions" (USENIX Security 2017); see sha1dc_tables.hpp
+// for the tables taken from their library.
+//
+// Every known practical SHA-1 collision attack follows one of the disturbance
+// vectors. For a block that could be the second half of such an attack, the
+// block that would pair with it is recomputed from the internal state at a
+// step where the two share it; the block is part of a collision if both end up
+// at the same chaining value.
+//
+// The block itself is compressed by the fastest block function, which also
+// hands back its 80 expanded message words. Only those words decide whether a
+// block could be on an attack path at all, so the portable step function runs
+// again just for the few blocks that could.
+
+namespace gitfly::detail {
+
+namespace {
+
+constexpr std::uint32_t rotl(std::uint32_t x, int n) { return (x << n) | (x >> (32 - n)); }
+
+constexpr auto kDm = [] {
+  std::array<std::array<std::uint32_t, 80>, kDvCount> dm{};
+  for (std::size_t d = 0; d < kDvCount; ++d) {
+    for (int t = 0; t < 16; ++t) {
+      dm[d][t] = kDvs[d].dm[t];
+    }
+    for (int t = 16; t < 80; ++t) {
+      dm[d][t] = rotl(dm[d][t - 3] ^ dm[d][t - 8] ^ dm[d][t - 14] ^ dm[d][t - 16], 1);
+    }
+  }
+  return dm;
+}();
+
+// The steps recompression starts from.
+constexpr int kTestSteps[] = {58, 65};
+
+constexpr std::uint32_t f(int t, std::uint32_t b, std::uint32_t c, std::uint32_t d) {
+  if (t < 20) {
+    return d ^ (b & (c ^ d));
+  }
+  if (t < 40 || t >= 60) {
+    return b ^ c ^ d;
+  }
+  return (b & c) | (d & (b | c));
+}
+
+constexpr std::uint32_t k(int t) {
+  constexpr std::uint32_t kK[4] = {0x5A827999, 0x6ED9EBA1, 0x8F1BBCDC, 0xCA62C1D6};
+  return kK[t / 20];
+}
+
+// s = (a, b, c, d, e) before step t, afterwards the state after it.
+inline void step(std::uint32_t *s, int t, std::uint32_t w) {
+  const std::uint32_t a = rotl(s[0], 5) + f(t, s[1], s[2], s[3]) + s[4] + k(t) + w;
+  s[4] = s[3];
+  s[3] = s[2];
+  s[2] = rotl(s[1], 30);
+  s[1] = s[0];
+  s[0] = a;
+}
+
+// Inverse of step(): s = the state after step t, afterwards the state before it.
+inline void unstep(std::uint32_t *s, int t, std::uint32_t w) {
+  const std::uint32_t a = s[1];
+  const std::uint32_t b = rotl(s[2], 2);
+  const std::uint32_t c = s[3];
+  const std::uint32_t d = s[4];
+  s[4] = s[0] - rotl(a, 5) - f(t, b, c, d) - k(t) - w;
+  s[0] = a;
+  s[1] = b;
+  s[2] = c;
+  s[3] = d;
+}
+
+// kUbc[kUbcBegin[d]..kUbcBegin[d + 1]) are the conditions of vector d.
+constexpr auto kUbcBegin = [] {
+  std::array<std::size_t, kDvCount + 1> begin{};
+  for (const Ubc &u : kUbc) {
+    ++begin[u.dv + 1];
+  }
+  for (std::size_t d = 0; d < kDvCount; ++d) {
+    begin[d + 1] += begin[d];
+  }
+  return begin;
+}();
+
+// Conditions per vector checked up front. Each fails half of all blocks, so
+// after these few most vectors are ruled out; only the rest get their other
+// conditions checked.
+constexpr std::size_t kScreen = 3;
+static_assert([] {
+  for (std::size_t d = 0; d < kDvCount; ++d) {
+    if (kUbcBegin[d + 1] - kUbcBegin[d] < kScreen) {
+      return false;
+    }
+  }
+  return true;
+}());
+
+inline std::uint32_t ubc_fails(const Ubc &u, const std::uint32_t *w) {
+  return ((w[u.a] >> u.i) ^ (w[u.b] >> u.j) ^ u.v) & 1U;
+}
+
+// Vectors ruled out by their first kScreen conditions: screened condition N
+// is condition N % kScreen of vector N / kScreen. Unrolled, so each compiles
+// to a few instructions on constants.
+template <std::size_t... N>
+inline std::uint32_t ubc_screen(const std::uint32_t *w, std::index_sequence<N...> /*n*/) {
+  return ((ubc_fails(kUbc[kUbcBegin[N / kScreen] + N % kScreen], w) << (N / kScreen)) | ...);
+}
+
+// Vectors whose unavoidable conditions the expanded message `w` meets; the
+// same as sha1dc_ubc_avx512().
+std::uint32_t ubc_check_portable(const std::uint32_t *w) {
+  std::uint32_t mask = ~ubc_screen(w, std::make_index_sequence<kDvCount * kScreen>{});
+  for (std::uint32_t left = mask; left != 0; left &= left - 1) {
+    const auto d = static_cast<std::size_t>(__builtin_ctz(left));
+    for (std::size_t r = kUbcBegin[d] + kScreen; r < kUbcBegin[d + 1]; ++r) {
+      if (ubc_fails(kUbc[r], w) != 0) {
+        mask &= ~(std::uint32_t{1} << d);
+        break;
+      }
+    }
+  }
+  return mask;
+}
+
+// Whether `w`, compressed from a state that reached `at_test` before step
+// testt and ended at chaining value `out`, collides with w ^ dm of vector d.
+bool collides(std::size_t d, const std::uint32_t *w, const std::uint32_t *at_test,
+              const std::uint32_t *out) {
+  const int testt = kDvs[d].testt;
+  std::uint32_t w2[80];
+  for (int t = 0; t < 80; ++t) {
+    w2[t] = w[t] ^ kDm[d][t];
+  }
+  std::uint32_t in[5];
+  std::uint32_t s[5];
+  std::memcpy(in, at_test, sizeof(in));
+  std::memcpy(s, at_test, sizeof(s));
+  for (int t = testt - 1; t >= 0; --t) {
+    unstep(in, t, w2[t]);
+  }
+  for (int t = testt; t < 80; ++t) {
+    step(s, t, w2[t]);
+  }
+  for (int i = 0; i < 5; ++i) {
+    if (in[i] + s[i] != out[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Step T with the state registers renamed instead of shifted, as in
+// sha1_block.cpp, expanding the message into all 80 words of `w` on the way.
+// Before the step, the state is kept in `saved` if T is a test step.
+template <int T>
+inline void round(std::uint32_t a, std::uint32_t &b, std::uint32_t c, std::uint32_t d,
+                  std::uint32_t &e, std::uint32_t *w, std::uint32_t (*saved)[5]) {
+  if constexpr (T >= 16) {
+    w[T] = rotl(w[T - 3] ^ w[T - 8] ^ w[T - 14] ^ w[T - 16], 1);
+  }
+  if constexpr (T == kTestSteps[0] || T == kTestSteps[1]) {
+    std::uint32_t *keep = saved[T == kTestSteps[0] ? 0 : 1];
+    keep[0] = a;
+    keep[1] = b;
+    keep[2] = c;
+    keep[3] = d;
+    keep[4] = e;
+  }
+  e += rotl(a, 5) + f(T, b, c, d) + k(T) + w[T];
+  b = rotl(b, 30);
+}
+
+template <int... T>
+inline void steps(std::uint32_t *v, std::uint32_t *w, std::uint32_t (*saved)[5],
+                  std::integer_sequence<int, T...> /*t*/) {
+  ((round<T>(v[(5 - T % 5) % 5], v[(6 - T % 5) % 5], v[(7 - T % 5) % 5], v[(8 - T % 5) % 5],
+             v[(9 - T % 5) % 5], w, saved)),
+   ...);
+}
+
+// Compresses one block into `h`, leaving its expanded message in `w`.
+using ExpandFn = void (*)(std::uint32_t *h, const std::uint8_t *data, std::uint32_t *w);
+// Vectors whose unavoidable conditions an expanded message meets.
+using UbcFn = std::uint32_t (*)(const std::uint32_t *w);
+
+void sha1_block_portable_w(std::uint32_t *h, const std::uint8_t *data, std::uint32_t *w) {
+  for (int t = 0; t < 16; ++t) {
+    std::uint32_t x;
+    std::memcpy(&x, data + 4 * t, 4);
+    w[t] = __builtin_bswap32(x);
+  }
+  std::uint32_t saved[std::size(kTestSteps)][5];
+  std::uint32_t v[5] = {h[0], h[1], h[2], h[3], h[4]};
+  steps(v, w, saved, std::make_integer_sequence<int, 80>{});
+  for (int i = 0; i < 5; ++i) {
+    h[i] += v[i];
+  }
+}
+
+struct Engine {
+  ExpandFn expand;
+  UbcFn ubc;
+};
+
+Engine pick_engine() {
+#if defined(GITFLY_SHA1_LANES_X86)
+  __builtin_cpu_init();
+  Engine e{&sha1_block_portable_w, &ubc_check_portable};
+  if (__builtin_cpu_supports("sha") && __builtin_cpu_supports("sse4.1")) {
+    e.expand = &sha1_block_shani_w;
+  }
+  if (__builtin_cpu_supports("avx512f")) {
+    e.ubc = &sha1dc_ubc_avx512;
+  }
+  return e;
+#else
+  return {&sha1_block_portable_w, &ubc_check_portable};
+#endif
+}
+
+} // namespace
+
+bool sha1dc_blocks(std::uint32_t *h, const std::uint8_t *data, std::size_t nblocks) {
+  static const Engine engine = pick_engine();
+  for (; nblocks != 0; --nblocks, data += 64) {
+    const std::uint32_t in[5] = {h[0], h[1], h[2], h[3], h[4]};
+    std::uint32_t w[80];
+    engine.expand(h, data, w);
+    std::uint32_t mask = engine.ubc(w);
+    if (mask == 0) {
+      continue;
+    }
+
+    // A candidate: step through it again up to the last test step, for the
+    // states recompression starts from.
+    std::uint32_t saved[std::size(kTestSteps)][5];
+    std::uint32_t v[5] = {in[0], in[1], in[2], in[3], in[4]};
+    steps(v, w, saved, std::make_integer_sequence<int, kTestSteps[1] + 1>{});
+    for (; mask != 0; mask &= mask - 1) {
+      const auto d = static_cast<std::size_t>(__builtin_ctz(mask));
+      const std::uint32_t *at_test = saved[kDvs[d].testt == kTestSteps[0] ? 0 : 1];
+      if (collides(d, w, at_test, h)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+} // namespace gitfly::detail
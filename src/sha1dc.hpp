@@ -0,0 +1,22 @@
+#pragma once
+// SHA-1 compression with collision detection (sha1dc), for hashing content
+// received from elsewhere: every block is compressed by the fastest block
+// function and its expanded message checked against the known collision
+// attacks. The AVX-512 check lives in its own translation unit (built with
+// -mavx512f) and is only called after a CPU check.
+
+#include <cstddef>
+#include <cstdint>
+
+namespace gitfly::detail {
+
+// Run `nblocks` 64-byte blocks from `data` through the state `h`, like a
+// Sha1BlockFn. Returns false, with `h` past the offending block, if a block
+// is part of a SHA-1 collision attack.
+bool sha1dc_blocks(std::uint32_t *h, const std::uint8_t *data, std::size_t nblocks);
+
+// Bit d set if the expanded message `w` (80 words) meets every unavoidable
+// condition of disturbance vector d. Defined only when built for x86-64.
+std::uint32_t sha1dc_ubc_avx512(const std::uint32_t *w);
+
+} // namespace gitfly::detail
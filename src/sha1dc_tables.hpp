@@ -0,0 +1,345 @@
+#pragma once
+// Tables of the SHA-1 collision detection (sha1dc), from Marc Stevens and Dan
+// Shumow's MIT-licensed sha1collisiondetection library, which git builds as
+// sha1dc:
+//
+//   Copyright 2017 Marc Stevens <marc@marc-stevens.nl>, Dan Shumow
+//   <danshu@microsoft.com>. Distributed under the MIT Software License.
+//
+// The disturbance vectors are the library's; the unavoidable bit conditions
+// are its ubc_check() written out as a table. This header is included by
+// translation units compiled with different -m flags, so everything here has
+// internal linkage.
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+
+namespace gitfly::detail {
+
+namespace {
+
+// A disturbance vector: the message difference of the attack (only its first
+// 16 words; it expands like a message) and the step at which the two blocks'
+// states agree, where recompression starts.
+struct Dv {
+  int testt;
+  std::uint32_t dm[16];
+};
+
+constexpr Dv kDvs[] = {
+    // I(43,0)
+    {58, {0x08000000, 0x9800000c, 0xd8000010, 0x08000010,
+          0xb8000010, 0x98000000, 0x60000000, 0x00000008,
+          0xc0000000, 0x90000014, 0x10000010, 0xb8000014,
+          0x28000000, 0x20000010, 0x48000000, 0x08000018}},
+    // I(44,0)
+    {58, {0xb4000008, 0x08000000, 0x9800000c, 0xd8000010,
+          0x08000010, 0xb8000010, 0x98000000, 0x60000000,
+          0x00000008, 0xc0000000, 0x90000014, 0x10000010,
+          0xb8000014, 0x28000000, 0x20000010, 0x48000000}},
+    // I(45,0)
+    {58, {0xf4000014, 0xb4000008, 0x08000000, 0x9800000c,
+          0xd8000010, 0x08000010, 0xb8000010, 0x98000000,
+          0x60000000, 0x00000008, 0xc0000000, 0x90000014,
+          0x10000010, 0xb8000014, 0x28000000, 0x20000010}},
+    // I(46,0)
+    {58, {0x2c000010, 0xf4000014, 0xb4000008, 0x08000000,
+          0x9800000c, 0xd8000010, 0x08000010, 0xb8000010,
+          0x98000000, 0x60000000, 0x00000008, 0xc0000000,
+          0x90000014, 0x10000010, 0xb8000014, 0x28000000}},
+    // I(46,2)
+    {58, {0xb0000040, 0xd0000053, 0xd0000022, 0x20000000,
+          0x60000032, 0x60000043, 0x20000040, 0xe0000042,
+          0x60000002, 0x80000001, 0x00000020, 0x00000003,
+          0x40000052, 0x40000040, 0xe0000052, 0xa0000000}},
+    // I(47,0)
+    {58, {0xc8000010, 0x2c000010, 0xf4000014, 0xb4000008,
+          0x08000000, 0x9800000c, 0xd8000010, 0x08000010,
+          0xb8000010, 0x98000000, 0x60000000, 0x00000008,
+          0xc0000000, 0x90000014, 0x10000010, 0xb8000014}},
+    // I(47,2)
+    {58, {0x20000043, 0xb0000040, 0xd0000053, 0xd0000022,
+          0x20000000, 0x60000032, 0x60000043, 0x20000040,
+          0xe0000042, 0x60000002, 0x80000001, 0x00000020,
+          0x00000003, 0x40000052, 0x40000040, 0xe0000052}},
+    // I(48,0)
+    {58, {0xb800000a, 0xc8000010, 0x2c000010, 0xf4000014,
+          0xb4000008, 0x08000000, 0x9800000c, 0xd8000010,
+          0x08000010, 0xb8000010, 0x98000000, 0x60000000,
+          0x00000008, 0xc0000000, 0x90000014, 0x10000010}},
+    // I(48,2)
+    {58, {0xe000002a, 0x20000043, 0xb0000040, 0xd0000053,
+          0xd0000022, 0x20000000, 0x60000032, 0x60000043,
+          0x20000040, 0xe0000042, 0x60000002, 0x80000001,
+          0x00000020, 0x00000003, 0x40000052, 0x40000040}},
+    // I(49,0)
+    {58, {0x18000000, 0xb800000a, 0xc8000010, 0x2c000010,
+          0xf4000014, 0xb4000008, 0x08000000, 0x9800000c,
+          0xd8000010, 0x08000010, 0xb8000010, 0x98000000,
+          0x60000000, 0x00000008, 0xc0000000, 0x90000014}},
+    // I(49,2)
+    {58, {0x60000000, 0xe000002a, 0x20000043, 0xb0000040,
+          0xd0000053, 0xd0000022, 0x20000000, 0x60000032,
+          0x60000043, 0x20000040, 0xe0000042, 0x60000002,
+          0x80000001, 0x00000020, 0x00000003, 0x40000052}},
+    // I(50,0)
+    {65, {0x0800000c, 0x18000000, 0xb800000a, 0xc8000010,
+          0x2c000010, 0xf4000014, 0xb4000008, 0x08000000,
+          0x9800000c, 0xd8000010, 0x08000010, 0xb8000010,
+          0x98000000, 0x60000000, 0x00000008, 0xc0000000}},
+    // I(50,2)
+    {65, {0x20000030, 0x60000000, 0xe000002a, 0x20000043,
+          0xb0000040, 0xd0000053, 0xd0000022, 0x20000000,
+          0x60000032, 0x60000043, 0x20000040, 0xe0000042,
+          0x60000002, 0x80000001, 0x00000020, 0x00000003}},
+    // I(51,0)
+    {65, {0xe8000000, 0x0800000c, 0x18000000, 0xb800000a,
+          0xc8000010, 0x2c000010, 0xf4000014, 0xb4000008,
+          0x08000000, 0x9800000c, 0xd8000010, 0x08000010,
+          0xb8000010, 0x98000000, 0x60000000, 0x00000008}},
+    // I(51,2)
+    {65, {0xa0000003, 0x20000030, 0x60000000, 0xe000002a,
+          0x20000043, 0xb0000040, 0xd0000053, 0xd0000022,
+          0x20000000, 0x60000032, 0x60000043, 0x20000040,
+          0xe0000042, 0x60000002, 0x80000001, 0x00000020}},
+    // I(52,0)
+    {65, {0x04000010, 0xe8000000, 0x0800000c, 0x18000000,
+          0xb800000a, 0xc8000010, 0x2c000010, 0xf4000014,
+          0xb4000008, 0x08000000, 0x9800000c, 0xd8000010,
+          0x08000010, 0xb8000010, 0x98000000, 0x60000000}},
+    // II(45,0)
+    {58, {0xec000014, 0x0c000002, 0xc0000010, 0xb400001c,
+          0x2c000004, 0xbc000018, 0xb0000010, 0x0000000c,
+          0xb8000010, 0x08000018, 0x78000010, 0x08000014,
+          0x70000010, 0xb800001c, 0xe8000000, 0xb0000004}},
+    // II(46,0)
+    {58, {0x2400001c, 0xec000014, 0x0c000002, 0xc0000010,
+          0xb400001c, 0x2c000004, 0xbc000018, 0xb0000010,
+          0x0000000c, 0xb8000010, 0x08000018, 0x78000010,
+          0x08000014, 0x70000010, 0xb800001c, 0xe8000000}},
+    // II(46,2)
+    {58, {0x90000070, 0xb0000053, 0x30000008, 0x00000043,
+          0xd0000072, 0xb0000010, 0xf0000062, 0xc0000042,
+          0x00000030, 0xe0000042, 0x20000060, 0xe0000041,
+          0x20000050, 0xc0000041, 0xe0000072, 0xa0000003}},
+    // II(47,0)
+    {58, {0x20000010, 0x2400001c, 0xec000014, 0x0c000002,
+          0xc0000010, 0xb400001c, 0x2c000004, 0xbc000018,
+          0xb0000010, 0x0000000c, 0xb8000010, 0x08000018,
+          0x78000010, 0x08000014, 0x70000010, 0xb800001c}},
+    // II(48,0)
+    {58, {0xbc00001a, 0x20000010, 0x2400001c, 0xec000014,
+          0x0c000002, 0xc0000010, 0xb400001c, 0x2c000004,
+          0xbc000018, 0xb0000010, 0x0000000c, 0xb8000010,
+          0x08000018, 0x78000010, 0x08000014, 0x70000010}},
+    // II(49,0)
+    {58, {0x3c000004, 0xbc00001a, 0x20000010, 0x2400001c,
+          0xec000014, 0x0c000002, 0xc0000010, 0xb400001c,
+          0x2c000004, 0xbc000018, 0xb0000010, 0x0000000c,
+          0xb8000010, 0x08000018, 0x78000010, 0x08000014}},
+    // II(49,2)
+    {58, {0xf0000010, 0xf000006a, 0x80000040, 0x90000070,
+          0xb0000053, 0x30000008, 0x00000043, 0xd0000072,
+          0xb0000010, 0xf0000062, 0xc0000042, 0x00000030,
+          0xe0000042, 0x20000060, 0xe0000041, 0x20000050}},
+    // II(50,0)
+    {65, {0xb400001c, 0x3c000004, 0xbc00001a, 0x20000010,
+          0x2400001c, 0xec000014, 0x0c000002, 0xc0000010,
+          0xb400001c, 0x2c000004, 0xbc000018, 0xb0000010,
+          0x0000000c, 0xb8000010, 0x08000018, 0x78000010}},
+    // II(50,2)
+    {65, {0xd0000072, 0xf0000010, 0xf000006a, 0x80000040,
+          0x90000070, 0xb0000053, 0x30000008, 0x00000043,
+          0xd0000072, 0xb0000010, 0xf0000062, 0xc0000042,
+          0x00000030, 0xe0000042, 0x20000060, 0xe0000041}},
+    // II(51,0)
+    {65, {0xc0000010, 0xb400001c, 0x3c000004, 0xbc00001a,
+          0x20000010, 0x2400001c, 0xec000014, 0x0c000002,
+          0xc0000010, 0xb400001c, 0x2c000004, 0xbc000018,
+          0xb0000010, 0x0000000c, 0xb8000010, 0x08000018}},
+    // II(51,2)
+    {65, {0x00000043, 0xd0000072, 0xf0000010, 0xf000006a,
+          0x80000040, 0x90000070, 0xb0000053, 0x30000008,
+          0x00000043, 0xd0000072, 0xb0000010, 0xf0000062,
+          0xc0000042, 0x00000030, 0xe0000042, 0x20000060}},
+    // II(52,0)
+    {65, {0x0c000002, 0xc0000010, 0xb400001c, 0x3c000004,
+          0xbc00001a, 0x20000010, 0x2400001c, 0xec000014,
+          0x0c000002, 0xc0000010, 0xb400001c, 0x2c000004,
+          0xbc000018, 0xb0000010, 0x0000000c, 0xb8000010}},
+    // II(53,0)
+    {65, {0xcc000014, 0x0c000002, 0xc0000010, 0xb400001c,
+          0x3c000004, 0xbc00001a, 0x20000010, 0x2400001c,
+          0xec000014, 0x0c000002, 0xc0000010, 0xb400001c,
+          0x2c000004, 0xbc000018, 0xb0000010, 0x0000000c}},
+    // II(54,0)
+    {65, {0x0400001c, 0xcc000014, 0x0c000002, 0xc0000010,
+          0xb400001c, 0x3c000004, 0xbc00001a, 0x20000010,
+          0x2400001c, 0xec000014, 0x0c000002, 0xc0000010,
+          0xb400001c, 0x2c000004, 0xbc000018, 0xb0000010}},
+    // II(55,0)
+    {65, {0x00000010, 0x0400001c, 0xcc000014, 0x0c000002,
+          0xc0000010, 0xb400001c, 0x3c000004, 0xbc00001a,
+          0x20000010, 0x2400001c, 0xec000014, 0x0c000002,
+          0xc0000010, 0xb400001c, 0x2c000004, 0xbc000018}},
+    // II(56,0)
+    {65, {0x2600001a, 0x00000010, 0x0400001c, 0xcc000014,
+          0x0c000002, 0xc0000010, 0xb400001c, 0x3c000004,
+          0xbc00001a, 0x20000010, 0x2400001c, 0xec000014,
+          0x0c000002, 0xc0000010, 0xb400001c, 0x2c000004}},
+};
+
+// Unavoidable conditions: bit i of W[a] xor bit j of W[b] equals v on every
+// attack path of vector `dv`. A block failing any of a vector's conditions
+// cannot be on its path, so is not recompressed for it.
+struct Ubc {
+  std::uint8_t dv, a, i, b, j, v;
+};
+
+constexpr Ubc kUbc[] = {
+    // I(43,0)
+    {0, 61, 1, 62, 6, 1}, {0, 58, 0, 59, 5, 1}, {0, 58, 0, 63, 30, 1}, {0, 37, 4, 39, 4, 1},
+    {0, 37, 4, 40, 29, 0}, {0, 37, 4, 41, 4, 0}, {0, 37, 4, 42, 29, 1}, {0, 37, 4, 43, 4, 1},
+    {0, 37, 4, 44, 29, 0}, {0, 37, 4, 46, 29, 1}, {0, 37, 4, 47, 29, 1},
+    // I(44,0)
+    {1, 59, 0, 60, 5, 1}, {1, 59, 0, 64, 30, 1}, {1, 62, 1, 63, 6, 1}, {1, 38, 4, 40, 4, 1},
+    {1, 38, 4, 40, 29, 0}, {1, 38, 4, 41, 29, 0}, {1, 38, 4, 42, 4, 0}, {1, 38, 4, 43, 29, 1},
+    {1, 38, 4, 44, 4, 1}, {1, 38, 4, 45, 29, 0}, {1, 38, 4, 47, 29, 1}, {1, 38, 4, 48, 29, 1},
+    // I(45,0)
+    {2, 39, 4, 41, 4, 1}, {2, 39, 4, 41, 29, 0}, {2, 39, 4, 42, 29, 0}, {2, 39, 4, 43, 4, 0},
+    {2, 39, 4, 44, 29, 1}, {2, 39, 4, 45, 4, 1}, {2, 39, 4, 46, 29, 0}, {2, 39, 4, 48, 29, 1},
+    {2, 39, 4, 49, 29, 1}, {2, 35, 4, 39, 29, 0}, {2, 60, 0, 61, 5, 1}, {2, 63, 1, 64, 6, 1},
+    // I(46,0)
+    {3, 36, 4, 40, 29, 0}, {3, 61, 0, 62, 5, 1}, {3, 40, 4, 42, 4, 1}, {3, 40, 4, 42, 29, 0},
+    {3, 40, 4, 43, 29, 0}, {3, 40, 4, 44, 4, 0}, {3, 40, 4, 45, 29, 1}, {3, 40, 4, 46, 4, 1},
+    {3, 40, 4, 47, 29, 0}, {3, 40, 4, 49, 29, 1}, {3, 40, 4, 50, 29, 1},
+    // I(46,2)
+    {4, 61, 2, 62, 7, 1}, {4, 35, 1, 36, 6, 1}, {4, 39, 1, 40, 6, 1}, {4, 39, 1, 42, 6, 1},
+    {4, 39, 1, 44, 6, 1}, {4, 39, 1, 46, 6, 1}, {4, 39, 1, 47, 1, 1},
+    // I(47,0)
+    {5, 37, 4, 40, 29, 0}, {5, 37, 4, 41, 29, 0}, {5, 62, 0, 63, 5, 1}, {5, 41, 4, 43, 4, 1},
+    {5, 41, 4, 43, 29, 0}, {5, 41, 4, 44, 29, 0}, {5, 41, 4, 45, 4, 0}, {5, 41, 4, 46, 29, 1},
+    {5, 41, 4, 47, 4, 1}, {5, 41, 4, 48, 29, 0}, {5, 41, 4, 50, 29, 1}, {5, 41, 4, 51, 29, 1},
+    // I(47,2)
+    {6, 36, 1, 37, 6, 1}, {6, 62, 2, 63, 7, 1}, {6, 40, 1, 41, 6, 1}, {6, 40, 1, 43, 6, 1},
+    {6, 40, 1, 45, 6, 1}, {6, 40, 1, 47, 6, 1}, {6, 40, 1, 48, 1, 1},
+    // I(48,0)
+    {7, 63, 0, 64, 5, 1}, {7, 35, 4, 39, 29, 0}, {7, 38, 4, 40, 29, 0}, {7, 38, 4, 41, 29, 0},
+    {7, 38, 4, 42, 29, 0}, {7, 42, 4, 44, 4, 1}, {7, 42, 4, 44, 29, 0}, {7, 42, 4, 45, 29, 0},
+    {7, 42, 4, 46, 4, 0}, {7, 42, 4, 47, 29, 1}, {7, 42, 4, 48, 4, 1}, {7, 42, 4, 49, 29, 0},
+    {7, 42, 4, 51, 29, 1}, {7, 42, 4, 52, 29, 1},
+    // I(48,2)
+    {8, 37, 1, 38, 6, 1}, {8, 63, 2, 64, 7, 1}, {8, 41, 1, 42, 6, 1}, {8, 41, 1, 44, 6, 1},
+    {8, 41, 1, 46, 6, 1}, {8, 41, 1, 48, 6, 1}, {8, 41, 1, 49, 1, 1},
+    // I(49,0)
+    {9, 36, 4, 40, 29, 0}, {9, 39, 4, 41, 29, 0}, {9, 39, 4, 42, 29, 0}, {9, 39, 4, 43, 29, 0},
+    {9, 43, 4, 45, 4, 1}, {9, 43, 4, 45, 29, 0}, {9, 43, 4, 46, 29, 0}, {9, 43, 4, 47, 4, 0},
+    {9, 43, 4, 48, 29, 1}, {9, 43, 4, 49, 4, 1}, {9, 43, 4, 50, 29, 0}, {9, 43, 4, 52, 29, 1},
+    {9, 43, 4, 53, 29, 1},
+    // I(49,2)
+    {10, 35, 1, 36, 6, 1}, {10, 38, 1, 39, 6, 1}, {10, 38, 1, 40, 1, 1}, {10, 42, 1, 43, 6, 1},
+    {10, 42, 1, 45, 6, 1}, {10, 42, 1, 47, 6, 1}, {10, 42, 1, 49, 6, 1}, {10, 42, 1, 50, 1, 1},
+    // I(50,0)
+    {11, 40, 4, 42, 29, 0}, {11, 40, 4, 43, 29, 0}, {11, 40, 4, 44, 29, 0}, {11, 44, 4, 46, 4, 1},
+    {11, 44, 4, 46, 29, 0}, {11, 44, 4, 47, 29, 0}, {11, 44, 4, 48, 4, 0}, {11, 44, 4, 49, 29, 1},
+    {11, 44, 4, 50, 4, 1}, {11, 44, 4, 51, 29, 0}, {11, 44, 4, 53, 29, 1}, {11, 44, 4, 54, 29, 1},
+    {11, 36, 4, 37, 4, 1}, {11, 36, 4, 41, 29, 1},
+    // I(50,2)
+    {12, 36, 1, 37, 6, 1}, {12, 43, 1, 44, 6, 1}, {12, 43, 1, 46, 6, 1}, {12, 43, 1, 48, 6, 1},
+    {12, 43, 1, 50, 6, 1}, {12, 43, 1, 51, 1, 1}, {12, 39, 1, 40, 6, 1}, {12, 39, 1, 41, 1, 1},
+    // I(51,0)
+    {13, 37, 4, 38, 4, 1}, {13, 37, 4, 42, 29, 1}, {13, 45, 4, 47, 4, 1}, {13, 45, 4, 47, 29, 0},
+    {13, 45, 4, 48, 29, 0}, {13, 45, 4, 49, 4, 0}, {13, 45, 4, 50, 29, 1}, {13, 45, 4, 51, 4, 1},
+    {13, 45, 4, 52, 29, 0}, {13, 45, 4, 54, 29, 1}, {13, 45, 4, 55, 29, 1}, {13, 41, 4, 43, 29, 0},
+    {13, 41, 4, 44, 29, 0}, {13, 41, 4, 45, 29, 0}, {13, 35, 3, 39, 28, 0},
+    // I(51,2)
+    {14, 35, 5, 39, 30, 0}, {14, 44, 1, 45, 6, 1}, {14, 44, 1, 47, 6, 1}, {14, 44, 1, 49, 6, 1},
+    {14, 44, 1, 51, 6, 1}, {14, 44, 1, 52, 1, 1}, {14, 37, 1, 37, 6, 0}, {14, 37, 1, 38, 6, 1},
+    {14, 40, 1, 41, 6, 1}, {14, 40, 1, 42, 1, 1},
+    // I(52,0)
+    {15, 46, 4, 48, 4, 1}, {15, 46, 4, 48, 29, 0}, {15, 46, 4, 49, 29, 0}, {15, 46, 4, 50, 4, 0},
+    {15, 46, 4, 51, 29, 1}, {15, 46, 4, 52, 4, 1}, {15, 46, 4, 53, 29, 0}, {15, 46, 4, 55, 29, 1},
+    {15, 46, 4, 56, 29, 1}, {15, 38, 4, 39, 4, 1}, {15, 38, 4, 43, 29, 1}, {15, 42, 4, 44, 29, 0},
+    {15, 42, 4, 45, 29, 0}, {15, 42, 4, 46, 29, 0},
+    // II(45,0)
+    {16, 63, 1, 64, 6, 1}, {16, 41, 4, 43, 29, 0}, {16, 41, 4, 44, 29, 0}, {16, 41, 4, 45, 29, 0},
+    {16, 60, 0, 61, 5, 1}, {16, 47, 4, 49, 4, 1}, {16, 47, 4, 49, 29, 0}, {16, 47, 4, 50, 29, 0},
+    {16, 47, 4, 52, 29, 1}, {16, 47, 4, 53, 29, 1}, {16, 36, 4, 40, 29, 0},
+    // II(46,0)
+    {17, 61, 0, 62, 5, 1}, {17, 48, 4, 50, 4, 1}, {17, 48, 4, 50, 29, 0}, {17, 48, 4, 51, 29, 0},
+    {17, 48, 4, 53, 29, 1}, {17, 48, 4, 54, 29, 1}, {17, 37, 4, 40, 29, 0}, {17, 37, 4, 41, 29, 0},
+    {17, 42, 4, 44, 29, 0}, {17, 42, 4, 45, 29, 0}, {17, 42, 4, 46, 29, 0},
+    // II(46,2)
+    {18, 47, 1, 48, 6, 1}, {18, 47, 1, 50, 6, 1}, {18, 47, 1, 51, 1, 1}, {18, 41, 1, 42, 6, 1},
+    {18, 41, 1, 43, 1, 1}, {18, 61, 2, 62, 7, 1}, {18, 36, 1, 37, 6, 1},
+    // II(47,0)
+    {19, 62, 0, 63, 5, 1}, {19, 38, 4, 40, 29, 0}, {19, 38, 4, 41, 29, 0}, {19, 38, 4, 42, 29, 0},
+    {19, 35, 4, 39, 29, 0}, {19, 35, 3, 39, 28, 0}, {19, 43, 4, 45, 29, 0}, {19, 43, 4, 46, 29, 0},
+    {19, 43, 4, 47, 29, 0}, {19, 49, 4, 51, 4, 1}, {19, 49, 4, 51, 29, 0}, {19, 49, 4, 52, 29, 0},
+    {19, 49, 4, 54, 29, 1}, {19, 49, 4, 55, 29, 1},
+    // II(48,0)
+    {20, 35, 30, 36, 3, 1}, {20, 35, 30, 40, 28, 1}, {20, 63, 0, 64, 5, 1}, {20, 36, 4, 40, 29, 0},
+    {20, 44, 4, 46, 29, 0}, {20, 44, 4, 47, 29, 0}, {20, 44, 4, 48, 29, 0}, {20, 50, 4, 52, 4, 1},
+    {20, 50, 4, 52, 29, 0}, {20, 50, 4, 53, 29, 0}, {20, 50, 4, 55, 29, 1}, {20, 50, 4, 56, 29, 1},
+    {20, 39, 4, 41, 29, 0}, {20, 39, 4, 42, 29, 0}, {20, 39, 4, 43, 29, 0},
+    // II(49,0)
+    {21, 51, 4, 53, 4, 1}, {21, 51, 4, 53, 29, 0}, {21, 51, 4, 54, 29, 0}, {21, 51, 4, 56, 29, 1},
+    {21, 51, 4, 57, 29, 1}, {21, 37, 4, 41, 29, 0}, {21, 36, 30, 37, 3, 1}, {21, 36, 30, 41, 28, 1},
+    {21, 45, 4, 47, 29, 0}, {21, 45, 4, 48, 29, 0}, {21, 45, 4, 49, 29, 0}, {21, 40, 4, 42, 29, 0},
+    {21, 40, 4, 43, 29, 0}, {21, 40, 4, 44, 29, 0},
+    // II(49,2)
+    {22, 39, 1, 40, 6, 1}, {22, 39, 1, 41, 1, 1}, {22, 44, 1, 45, 6, 1}, {22, 44, 1, 46, 1, 1},
+    {22, 50, 1, 51, 6, 1}, {22, 50, 1, 53, 6, 1}, {22, 50, 1, 54, 1, 1}, {22, 36, 0, 37, 5, 1},
+    {22, 36, 0, 41, 30, 1},
+    // II(50,0)
+    {23, 41, 4, 43, 29, 0}, {23, 41, 4, 44, 29, 0}, {23, 41, 4, 45, 29, 0}, {23, 52, 4, 54, 4, 1},
+    {23, 52, 4, 54, 29, 0}, {23, 52, 4, 55, 29, 0}, {23, 52, 4, 57, 29, 1}, {23, 52, 4, 58, 29, 1},
+    {23, 46, 4, 48, 29, 0}, {23, 46, 4, 49, 29, 0}, {23, 46, 4, 50, 29, 0}, {23, 38, 4, 42, 29, 0},
+    {23, 37, 30, 38, 3, 1}, {23, 37, 30, 42, 28, 1},
+    // II(50,2)
+    {24, 51, 1, 52, 6, 1}, {24, 51, 1, 54, 6, 1}, {24, 51, 1, 55, 1, 1}, {24, 40, 1, 41, 6, 1},
+    {24, 40, 1, 42, 1, 1}, {24, 37, 0, 38, 5, 1}, {24, 37, 0, 42, 30, 1}, {24, 45, 1, 46, 6, 1},
+    {24, 45, 1, 47, 1, 1},
+    // II(51,0)
+    {25, 39, 4, 43, 29, 0}, {25, 47, 4, 49, 29, 0}, {25, 47, 4, 50, 29, 0}, {25, 47, 4, 51, 29, 0},
+    {25, 38, 30, 39, 3, 1}, {25, 38, 30, 43, 28, 1}, {25, 42, 4, 44, 29, 0}, {25, 42, 4, 45, 29, 0},
+    {25, 42, 4, 46, 29, 0}, {25, 53, 4, 55, 4, 1}, {25, 53, 4, 55, 29, 0}, {25, 53, 4, 56, 29, 0},
+    {25, 53, 4, 58, 29, 1}, {25, 53, 4, 59, 29, 1},
+    // II(51,2)
+    {26, 52, 1, 53, 6, 1}, {26, 52, 1, 55, 6, 1}, {26, 52, 1, 56, 1, 1}, {26, 41, 1, 42, 6, 1},
+    {26, 41, 1, 43, 1, 1}, {26, 38, 0, 39, 5, 1}, {26, 38, 0, 43, 30, 1}, {26, 46, 1, 47, 6, 1},
+    {26, 46, 1, 48, 1, 1},
+    // II(52,0)
+    {27, 40, 4, 44, 29, 0}, {27, 54, 4, 56, 4, 1}, {27, 54, 4, 56, 29, 0}, {27, 54, 4, 57, 29, 0},
+    {27, 54, 4, 59, 29, 1}, {27, 54, 4, 60, 29, 1}, {27, 43, 4, 45, 29, 0}, {27, 43, 4, 46, 29, 0},
+    {27, 43, 4, 47, 29, 0}, {27, 48, 4, 50, 29, 0}, {27, 48, 4, 51, 29, 0}, {27, 48, 4, 52, 29, 0},
+    {27, 36, 4, 38, 4, 1}, {27, 39, 30, 40, 3, 1}, {27, 39, 30, 44, 28, 1},
+    // II(53,0)
+    {28, 55, 4, 57, 4, 1}, {28, 55, 4, 57, 29, 0}, {28, 55, 4, 58, 29, 0}, {28, 55, 4, 61, 29, 1},
+    {28, 49, 4, 51, 29, 0}, {28, 49, 4, 52, 29, 0}, {28, 49, 4, 53, 29, 0}, {28, 41, 4, 45, 29, 0},
+    {28, 41, 3, 45, 28, 0}, {28, 44, 4, 46, 29, 0}, {28, 44, 4, 47, 29, 0}, {28, 44, 4, 48, 29, 0},
+    {28, 37, 4, 39, 4, 1}, {28, 37, 4, 40, 29, 0},
+    // II(54,0)
+    {29, 42, 4, 46, 29, 0}, {29, 42, 3, 46, 28, 0}, {29, 36, 4, 38, 4, 1}, {29, 36, 4, 40, 4, 0},
+    {29, 36, 4, 41, 29, 1}, {29, 58, 4, 62, 29, 0}, {29, 50, 4, 52, 29, 0}, {29, 50, 4, 53, 29, 0},
+    {29, 50, 4, 54, 29, 0}, {29, 56, 4, 58, 29, 0}, {29, 56, 4, 59, 29, 0}, {29, 45, 4, 47, 29, 0},
+    {29, 45, 4, 48, 29, 0}, {29, 45, 4, 49, 29, 0},
+    // II(55,0)
+    {30, 57, 4, 59, 29, 0}, {30, 37, 4, 39, 4, 1}, {30, 37, 4, 40, 29, 0}, {30, 37, 4, 41, 4, 0},
+    {30, 37, 4, 42, 29, 1}, {30, 46, 4, 48, 29, 0}, {30, 46, 4, 49, 29, 0}, {30, 46, 4, 50, 29, 0},
+    {30, 59, 4, 63, 29, 0}, {30, 43, 4, 47, 29, 0}, {30, 51, 4, 53, 29, 0}, {30, 51, 4, 54, 29, 0},
+    {30, 51, 4, 55, 29, 0}, {30, 43, 3, 47, 28, 0},
+    // II(56,0)
+    {31, 44, 4, 48, 29, 0}, {31, 60, 4, 64, 29, 0}, {31, 38, 4, 40, 4, 1}, {31, 38, 4, 40, 29, 0},
+    {31, 38, 4, 41, 29, 0}, {31, 38, 4, 42, 4, 0}, {31, 38, 4, 43, 29, 1}, {31, 44, 3, 48, 28, 0},
+    {31, 47, 4, 49, 29, 0}, {31, 47, 4, 50, 29, 0}, {31, 47, 4, 51, 29, 0}, {31, 52, 4, 54, 29, 0},
+    {31, 52, 4, 55, 29, 0}, {31, 52, 4, 56, 29, 0},
+};
+
+constexpr std::size_t kDvCount = std::size(kDvs);
+static_assert(kDvCount == 32, "ubc_check() tracks the vectors in a 32-bit mask");
+
+} // namespace
+
+} // namespace gitfly::detail
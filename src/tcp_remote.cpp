@@ -1,24 +1,36 @@
 #include "gitfly/tcp_remote.hpp"
 
+#include "gitfly/config.hpp"
 #include "gitfly/consts.hpp"
 #include "gitfly/fs.hpp"
+#include "gitfly/object_store.hpp"
+#include "gitfly/reach.hpp"
 #include "gitfly/refs.hpp"
+#include "gitfly/remote.hpp"
 #include "gitfly/repo.hpp"
+#include "gitfly/util.hpp"
+#include "gitfly/wire.hpp"
 #include "gitfly/worktree.hpp"
 
 #include <algorithm>
 #include <arpa/inet.h>
 #include <cerrno>
+#include <chrono>
 #include <cstdint>
+#include <deque>
 #include <filesystem>
+#include <functional>
+#include <memory>
 #include <netdb.h>
 #include <optional>
+#include <set>
 #include <sstream>
 #include <stdexcept>
 #include <string>
 #include <string_view>
 #include <sys/socket.h>
 #include <system_error>
+#include <utility>
 #include <unistd.h>
 #include <vector>
 
@@ -114,84 +126,115 @@ private:
   return sock;
 }
 
-void send_all(int fd, const void *buf, size_t n) {
-  const auto *p = static_cast<const std::uint8_t *>(buf);
-  while (n != 0U) {
-    const ssize_t w = ::send(fd, p, n, 0);
-    if (w <= 0) {
-      throw std::system_error(errno, std::generic_category(), "send");
+// One client connection: socket, framed stream and transfer metrics.
+class Session {
+public:
+  // `multi` asks for a multi-request session; throws if the server lacks it.
+  Session(const std::string &host, int port, const gitfly::tcpremote::SessionOptions &opts,
+          bool multi = false)
+      : opts_(opts), start_(Clock::now()), phase_start_(start_) {
+    stats_.phase = "connect";
+    report();
+    sock_ = connect_tcp(host, port);
+    conn_ = std::make_unique<gitfly::wire::Conn>(sock_.get());
+
+    phase("negotiate");
+    std::vector<std::string_view> want;
+    if (opts_.compress) {
+      want.push_back(gitfly::wire::kCapZlib);
+    }
+    if (multi) {
+      want.push_back(gitfly::wire::kCapMulti);
+    }
+    conn_->write_line(gitfly::wire::hello_line(want));
+    if (!want.empty()) {
+      const auto caps = gitfly::wire::parse_hello(conn_->read_line());
+      if (multi && std::ranges::find(caps, gitfly::wire::kCapMulti) == caps.end()) {
+        throw std::runtime_error("server does not support multi-request sessions");
+      }
+      if (std::ranges::find(caps, gitfly::wire::kCapZlib) != caps.end()) {
+        conn_->enable_compression();
+      }
+    }
+    if (!opts_.repo.empty()) {
+      conn_->write_line(std::string(gitfly::consts::kTokRepo) + opts_.repo);
     }
-    p += static_cast<size_t>(w);
-    n -= static_cast<size_t>(w);
   }
-}
 
-void send_line(int fd, std::string_view s) {
-  std::string t(s);
-  t.push_back('\n');
-  send_all(fd, t.data(), t.size());
-}
+  [[nodiscard]] auto conn() -> gitfly::wire::Conn & { return *conn_; }
 
-void recv_exact(int fd, std::uint8_t *dst, size_t n) {
-  size_t got = 0;
-  while (got < n) {
-    const ssize_t r = ::recv(fd, dst + got, n - got, 0);
-    if (r <= 0) {
-      throw std::system_error(errno, std::generic_category(), "recv");
-    }
-    got += static_cast<size_t>(r);
+  // Close the current phase and start `name`.
+  void phase(std::string_view name) {
+    const auto now = Clock::now();
+    stats_.phases.emplace_back(stats_.phase, seconds(phase_start_, now));
+    stats_.phase = name;
+    phase_start_ = now;
+    report();
   }
-}
 
-[[nodiscard]] auto recv_line(int fd) -> std::string {
-  std::string s;
-  char c = '\0';
-  for (;;) {
-    const ssize_t r = ::recv(fd, &c, 1, 0);
-    if (r <= 0) {
-      throw std::system_error(errno, std::generic_category(), "recv");
-    }
-    if (c == '\n') {
-      break;
+  void objects_announced(std::size_t n) {
+    stats_.objects_total = n;
+    report();
+  }
+
+  void object_done() {
+    ++stats_.objects;
+    if (opts_.progress && Clock::now() - last_report_ >= kReportInterval) {
+      report();
     }
-    s.push_back(c);
   }
-  return s;
-}
 
-[[nodiscard]] auto list_object_files(const stdfs::path &objects_dir) -> std::vector<stdfs::path> {
-  std::vector<stdfs::path> files;
-  if (!stdfs::exists(objects_dir)) {
-    return files;
+  void finish() {
+    conn_->flush();
+    phase("done");
+  }
+
+private:
+  using Clock = std::chrono::steady_clock;
+  static constexpr auto kReportInterval = std::chrono::milliseconds(100);
+
+  static auto seconds(Clock::time_point from, Clock::time_point to) -> double {
+    return std::chrono::duration<double>(to - from).count();
   }
-  for (stdfs::recursive_directory_iterator it(objects_dir), end; it != end; ++it) {
-    if (it->is_regular_file()) {
-      files.push_back(it->path());
+
+  void report() {
+    if (!opts_.progress) {
+      return;
+    }
+    last_report_ = Clock::now();
+    stats_.elapsed = seconds(start_, last_report_);
+    if (conn_) {
+      stats_.bytes = conn_->counters();
     }
+    opts_.progress(stats_);
   }
-  return files;
-}
 
-[[nodiscard]] auto hex_from_objects_rel(std::string rel) -> std::string {
-  // "aa/bbbbb..." -> "aabbbbb..."
-  std::erase(rel, '/');
-  return rel;
-}
+  const gitfly::tcpremote::SessionOptions &opts_;
+  UniqueFd sock_;
+  std::unique_ptr<gitfly::wire::Conn> conn_;
+  gitfly::tcpremote::TransferStats stats_;
+  Clock::time_point start_;
+  Clock::time_point phase_start_;
+  Clock::time_point last_report_{};
+};
 
-void send_all_objects(int fd, const stdfs::path &objects_dir) {
-  const auto files = list_object_files(objects_dir);
-  send_line(fd, "NOBJ " + std::to_string(files.size()));
-
-  for (const auto &p : files) {
-    const auto rel = stdfs::relative(p, objects_dir).generic_string();
-    const std::string hex = hex_from_objects_rel(rel);
-    const auto data = gitfly::fs::read_file(p);
-    send_line(fd, "OBJ " + hex + " " + std::to_string(data.size()));
-    if (!data.empty()) {
-      send_all(fd, data.data(), data.size());
+// NOBJ/OBJ.../DONE stream of the listed objects, read from `store` (or its
+// alternates).
+void send_objects(Session &session, const gitfly::ObjectStore &store,
+                  const std::vector<std::string> &hexes) {
+  auto &conn = session.conn();
+  conn.write_line("NOBJ " + std::to_string(hexes.size()));
+  session.objects_announced(hexes.size());
+
+  for (const auto &hex : hexes) {
+    gitfly::oid id{};
+    if (!gitfly::from_hex(hex, id)) {
+      throw std::runtime_error("bad object id " + hex);
     }
+    conn.write_object(hex, store.locate(id));
+    session.object_done();
   }
-  send_line(fd, "DONE");
+  conn.write_line("DONE");
 }
 
 struct RefInfo {
@@ -201,6 +244,9 @@ struct RefInfo {
 
 // Parses: "REF <branch> <oid>" or "REF DETACHED <oid>"
 [[nodiscard]] auto parse_ref_header(std::string_view line) -> RefInfo {
+  if (line.starts_with("ERR ")) {
+    throw std::runtime_error("server: " + std::string(line.substr(4)));
+  }
   if (!line.starts_with("REF ")) {
     throw std::runtime_error("expected 'REF ' header");
   }
@@ -217,98 +263,402 @@ struct RefInfo {
   return out;
 }
 
-void recv_objects_into(int fd, const stdfs::path &objects_dir) {
-  const std::string nline = recv_line(fd);
-  if (!std::string_view(nline).starts_with("NOBJ ")) {
-    throw std::runtime_error("expected NOBJ <n>");
+// Reads a "REF <name> <oid>"... "DONE" advertisement.
+[[nodiscard]] auto recv_ref_list(gitfly::wire::Conn &conn) -> std::vector<gitfly::RefEntry> {
+  std::vector<gitfly::RefEntry> refs;
+  for (auto line = conn.read_line(); line != gitfly::consts::kTokDone; line = conn.read_line()) {
+    if (line.starts_with("ERR ")) {
+      throw std::runtime_error("server: " + line.substr(4));
+    }
+    const RefInfo ref = parse_ref_header(line);
+    if (!gitfly::looks_hex40(ref.oid)) {
+      throw std::runtime_error("malformed ref advertisement: " + line);
+    }
+    refs.push_back(gitfly::RefEntry{.name = ref.branch, .oid = ref.oid});
   }
-  const size_t n = std::stoull(nline.substr(gitfly::consts::kRefPrefix.size()));
+  return refs;
+}
 
-  stdfs::create_directories(objects_dir);
+// Reads the optional "SHALLOW <hex>" lines a server sends ahead of the object
+// stream for depth-limited requests; returns them plus the NOBJ line that follows.
+[[nodiscard]] auto recv_shallow_list(gitfly::wire::Conn &conn)
+    -> std::pair<std::vector<std::string>, std::string> {
+  std::vector<std::string> shallow;
+  std::string line = conn.read_line();
+  while (std::string_view(line).starts_with(gitfly::consts::kTokShallow)) {
+    shallow.push_back(line.substr(gitfly::consts::kTokShallow.size()));
+    line = conn.read_line();
+  }
+  return {std::move(shallow), std::move(line)};
+}
 
-  for (size_t i = 0; i < n; ++i) {
-    const std::string oline = recv_line(fd);
-    if (!std::string_view(oline).starts_with("OBJ ")) {
-      throw std::runtime_error("expected OBJ <hex> <size>");
-    }
+// "OP CLONE" / "OP FETCH", plus " DEPTH <n>" for a shallow transfer and
+// " FILTER <spec>" for a partial one.
+[[nodiscard]] auto op_line(std::string_view op, std::size_t depth, std::string_view filter)
+    -> std::string {
+  std::string line(op);
+  if (depth > 0) {
+    line += ' ';
+    line += gitfly::consts::kTokDepth;
+    line += std::to_string(depth);
+  }
+  if (!filter.empty()) {
+    line += ' ';
+    line += gitfly::consts::kTokFilter;
+    line += filter;
+  }
+  return line;
+}
 
-    std::istringstream is(oline.substr(4));
-    std::string hex;
-    size_t sz = 0;
-    is >> hex >> sz;
-    if (hex.size() < 3U) {
-      throw std::runtime_error("malformed object hex in OBJ header");
-    }
+// Called after each object has been written; used to checkpoint clone progress.
+using ObjectWrittenFn = std::function<void(const std::string &hex, std::size_t bytes)>;
 
-    std::vector<std::uint8_t> buf(sz);
-    if (sz != 0U) {
-      recv_exact(fd, buf.data(), sz);
-    }
+void recv_objects_into(Session &session, const stdfs::path &objects_dir, const std::string &nline,
+                       const ObjectWrittenFn &on_written = {}) {
+  auto &conn = session.conn();
+  const auto n = gitfly::wire::parse_nobj(nline, conn.limits());
+  session.objects_announced(n);
 
-    const stdfs::path dir = objects_dir / hex.substr(0, 2);
-    stdfs::create_directories(dir);
-    const stdfs::path file = dir / hex.substr(2);
-    gitfly::fs::write_file_atomic(file, buf);
+  stdfs::create_directories(objects_dir);
+  const gitfly::ObjectStore store{objects_dir.parent_path()};
+  store.load_index(); // what is received is mostly missing here
+
+  std::vector<std::uint8_t> buf;
+  for (std::uint64_t i = 0; i < n; ++i) {
+    const auto [hex, sz] = gitfly::wire::parse_obj(conn.read_line(), conn.limits());
+    const bool have = store.exists(hex);
+    const auto path = objects_dir / hex.substr(0, 2) / hex.substr(2);
+
+    if (sz > gitfly::wire::kSpoolObjectBytes) {
+      // Streamed into a temporary beside `path` and renamed into place, so the
+      // object is never held whole; one already here is read and dropped.
+      std::uint64_t left = sz;
+      const auto read = [&](std::span<std::uint8_t> chunk) {
+        const auto take = static_cast<std::size_t>(std::min<std::uint64_t>(left, chunk.size()));
+        conn.read_exact(chunk.data(), take);
+        left -= take;
+        return take;
+      };
+      if (have) {
+        buf.resize(64 * 1024);
+        while (left != 0) {
+          (void)read(buf);
+        }
+      } else {
+        gitfly::fs::write_file_atomic(path, read);
+      }
+    } else {
+      conn.read_payload(buf, sz);
+      if (!have) {
+        gitfly::fs::write_file_atomic(path, buf);
+      }
+    }
+    if (!have) {
+      (void)store.record(hex);
+    }
+    session.object_done();
+    if (on_written) {
+      on_written(hex, sz);
+    }
   }
 
-  const std::string done = recv_line(fd);
+  const std::string done = conn.read_line();
   if (done != "DONE") {
     throw std::runtime_error("expected DONE after objects");
   }
+  store.sync(); // callers update refs next
 }
 
+// Progress of an interrupted clone, persisted as "<tip> <last-hex> <count>\n" in
+// .gitfly/CLONE_RESUME: the first `count` objects of the stream for `tip` are on
+// disk, the last of them being `last`. The server checks `last` against its own
+// stream before skipping anything.
+struct ResumePoint {
+  std::string tip;
+  std::string last;
+  std::size_t count = 0;
+};
+
+[[nodiscard]] auto load_resume_point(const stdfs::path &file) -> std::optional<ResumePoint> {
+  if (!gitfly::fs::exists(file)) {
+    return std::nullopt;
+  }
+  const auto bytes = gitfly::fs::read_file(file);
+  std::istringstream is(std::string(bytes.begin(), bytes.end()));
+  ResumePoint rp;
+  if (!(is >> rp.tip >> rp.last >> rp.count) || !gitfly::looks_hex40(rp.tip) ||
+      !gitfly::looks_hex40(rp.last) || rp.count == 0) {
+    return std::nullopt;
+  }
+  return rp;
+}
+
+void save_resume_point(const stdfs::path &file, const ResumePoint &rp) {
+  const std::string s = rp.tip + " " + rp.last + " " + std::to_string(rp.count) + "\n";
+  gitfly::fs::write_file_atomic(
+      file, std::span<const std::uint8_t>(reinterpret_cast<const std::uint8_t *>(s.data()),
+                                          s.size()));
+}
+
+// Checkpoint at most this often; each checkpoint is a small atomic file write.
+constexpr std::size_t kCheckpointObjects = 256;
+constexpr std::size_t kCheckpointBytes = std::size_t{4} << 20U;
+
 } // namespace
 
 namespace gitfly::tcpremote {
 
-void push_branch(const std::string &host, int port, const std::string &repo_root,
-                 const std::string &branch) {
-  auto sock = connect_tcp(host, port);
+auto parse_url(std::string_view url) -> Endpoint {
+  constexpr std::string_view kScheme = "tcp://";
+  if (!url.starts_with(kScheme)) {
+    throw std::runtime_error("not a tcp:// URL: " + std::string(url));
+  }
+  url.remove_prefix(kScheme.size());
+  Endpoint ep{.host = {}, .port = consts::portNumber, .repo = {}};
+  if (const auto slash = url.find('/'); slash != std::string_view::npos) {
+    ep.repo = std::string(url.substr(slash + 1));
+    url = url.substr(0, slash);
+  }
+  const auto colon = url.find(':');
+  ep.host = std::string(url.substr(0, colon));
+  if (colon != std::string_view::npos) {
+    ep.port = std::stoi(std::string(url.substr(colon + 1)));
+  }
+  return ep;
+}
+
+namespace {
 
-  send_line(sock.get(), "HELLO 1");
-  send_line(sock.get(), "OP PUSH " + branch);
+// Each operation is split into the request it writes and the reader of its
+// response, so a multi-request Client can send several before reading any.
+
+auto resolve_local_refs(const std::string &repo_root, const std::vector<std::string> &refnames)
+    -> std::vector<RefEntry> {
+  std::vector<RefEntry> local;
+  for (const auto &name : refnames) {
+    const auto tip = read_ref(stdfs::path{repo_root}, name);
+    if (!tip) {
+      throw std::runtime_error("no local ref " + name);
+    }
+    local.push_back(RefEntry{.name = name, .oid = *tip});
+  }
+  return local;
+}
 
+// Everything after "OP PUSH": read the advertisement, send the updates and,
+// once accepted, the objects.
+void read_push(Session &session, const std::string &repo_root, const std::vector<RefEntry> &local) {
   Repository repo{stdfs::path{repo_root}};
-  const auto head_txt = read_HEAD(repo.root());
-  if (!head_txt || head_txt->rfind("ref:", 0) != 0) {
-    throw std::runtime_error("push requires symbolic HEAD");
+  const ObjectStore store{repo.git_dir()};
+  auto &conn = session.conn();
+  const auto remote_refs = recv_ref_list(conn);
+
+  // The advertised values are the expected old values. A branch that would not
+  // fast-forward is refused here, before anything is uploaded.
+  std::set<std::string> stop; // history the server already has
+  for (const auto &r : remote_refs) {
+    if (store.exists(r.oid)) {
+      stop.insert(r.oid);
+    }
   }
-  const auto tip = read_ref(repo.root(), heads_ref(branch));
-  if (!tip) {
-    throw std::runtime_error("local branch has no tip");
+  std::vector<std::string> tips;
+  for (const auto &ref : local) {
+    const auto it = std::ranges::find(remote_refs, ref.name, &RefEntry::name);
+    const std::string old = it == remote_refs.end() ? std::string(consts::kZeroOid) : it->oid;
+    if (it != remote_refs.end() && ref.name.starts_with("refs/heads/") &&
+        (!store.exists(old) || !repo.is_commit_ancestor(old, ref.oid))) {
+      throw std::runtime_error("non-fast-forward: " + ref.name + " (fetch first)");
+    }
+    conn.write_line(std::string(consts::kTokUpdate) + old + " " + ref.oid + " " + ref.name);
+    tips.push_back(ref.oid);
   }
+  conn.write_line(consts::kTokDone);
 
-  send_line(sock.get(), "NEW " + *tip);
+  const std::string okgo = conn.read_line();
+  if (okgo != consts::kTokOkGo) {
+    throw std::runtime_error("push rejected: " + (okgo.starts_with("ERR ") ? okgo.substr(4) : okgo));
+  }
+  session.phase("objects");
+  send_objects(session, store, reach::collect_objects(repo, tips, stop));
 
-  const std::string okgo = recv_line(sock.get());
-  if (okgo != "OKGO") {
-    throw std::runtime_error("server refused push (expected OKGO)");
+  const std::string resp = conn.read_line();
+  if (resp != consts::kTokOk) {
+    throw std::runtime_error("push failed: " + resp);
   }
+}
 
-  send_all_objects(sock.get(), repo.objects_dir());
+// Requests are built whole before they are written, so a multi-request
+// Client can tell how much it is about to send.
+auto ls_refs_request(const std::string &prefix) -> std::string {
+  return (prefix.empty() ? std::string(consts::kOpLsRefs)
+                         : std::string(consts::kOpLsRefs) + " " + prefix) +
+         "\n";
+}
 
-  const std::string resp = recv_line(sock.get());
-  if (resp != "OK") {
-    throw std::runtime_error("push failed: " + resp);
+// The HAVEs go out with the request: the server reads them only after sending
+// its advertisement, so they need not wait for it.
+auto fetch_refs_request(const std::string &local_root, const std::string &prefix,
+                        std::size_t depth) -> std::string {
+  const auto filter = config_get(local_root, consts::kCfgPartialFilter).value_or("");
+  std::string req = op_line(consts::kOpFetchRefs, depth, filter);
+  if (!prefix.empty()) {
+    req += ' ';
+    req += consts::kTokPrefix;
+    req += prefix;
+  }
+  req += '\n';
+
+  // Every local tip is a HAVE; the server ignores ones it does not know and
+  // stops its walk at the rest. Shallow commits are sent as such instead: the
+  // history below them is missing, so the server walks down past them.
+  const auto shallow = Repository{stdfs::path{local_root}}.shallow_commits();
+  std::set<std::string> haves;
+  for (const auto &ref : list_refs(local_root)) {
+    if (!shallow.contains(ref.oid)) {
+      haves.insert(ref.oid);
+    }
+  }
+  for (const auto &hex : haves) {
+    req += consts::kTokHave;
+    req += hex;
+    req += '\n';
+  }
+  for (const auto &hex : shallow) {
+    req += consts::kTokShallow;
+    req += hex;
+    req += '\n';
   }
+  req += consts::kTokDone;
+  req += '\n';
+  return req;
 }
 
-void clone_repo(const std::string &host, int port, const std::string &dest_root) {
-  auto sock = connect_tcp(host, port);
+auto read_fetch_refs(Session &session, const std::string &local_root,
+                     const std::string &remote_name) -> std::vector<RefEntry> {
+  auto &conn = session.conn();
+  auto refs = recv_ref_list(conn);
+  const auto [shallow, nline] = recv_shallow_list(conn);
+  const stdfs::path objdir = stdfs::path(local_root) / consts::kGitDir / consts::kObjectsDir;
+  session.phase("objects");
+  recv_objects_into(session, objdir, nline);
 
-  send_line(sock.get(), "HELLO 1");
-  send_line(sock.get(), "OP CLONE");
+  Repository local_repo{stdfs::path{local_root}};
+  local_repo.update_shallow_commits(shallow);
+  update_tracking_refs(local_root, remote_name, refs);
+  return refs;
+}
 
-  const RefInfo ref = parse_ref_header(recv_line(sock.get()));
+auto blobs_request(const std::vector<std::string> &hexes) -> std::string {
+  std::string req(consts::kOpBlobs);
+  req += '\n';
+  for (const auto &hex : hexes) {
+    req += consts::kTokWant;
+    req += hex;
+    req += '\n';
+  }
+  req += consts::kTokDone;
+  req += '\n';
+  return req;
+}
 
-  const stdfs::path objdir = stdfs::path(dest_root) / consts::kGitDir / consts::kObjectsDir;
+void read_blobs(Session &session, const std::string &local_root) {
+  const std::string nline = session.conn().read_line();
+  if (nline.starts_with("ERR ")) {
+    throw std::runtime_error("object fetch failed: " + nline.substr(4));
+  }
+  const stdfs::path objdir = stdfs::path(local_root) / consts::kGitDir / consts::kObjectsDir;
+  session.phase("objects");
+  recv_objects_into(session, objdir, nline);
+}
+
+} // namespace
 
-  recv_objects_into(sock.get(), objdir);
+void push_refs(const std::string &host, int port, const std::string &repo_root,
+               const std::vector<std::string> &refnames, const SessionOptions &session_opts) {
+  const auto local = resolve_local_refs(repo_root, refnames);
+  Session session{host, port, session_opts};
+  session.conn().write_line(consts::kOpPush);
+  read_push(session, repo_root, local);
+  session.finish();
+}
+
+void push_branch(const std::string &host, int port, const std::string &repo_root,
+                 const std::string &branch, const SessionOptions &session_opts) {
+  const auto head_txt = read_HEAD(stdfs::path{repo_root});
+  if (!head_txt || head_txt->rfind("ref:", 0) != 0) {
+    throw std::runtime_error("push requires symbolic HEAD");
+  }
+  push_refs(host, port, repo_root, {heads_ref(branch)}, session_opts);
+}
+
+void clone_repo(const std::string &host, int port, const std::string &dest_root,
+                std::size_t depth, const std::string &filter,
+                const SessionOptions &session_opts, const std::string &reference) {
+  (void)reach::BlobFilter::parse(filter); // reject bad specs before connecting
+  const stdfs::path gitdir = stdfs::path(dest_root) / consts::kGitDir;
+  const stdfs::path objdir = gitdir / consts::kObjectsDir;
+  const stdfs::path resume_file = gitdir / consts::kCloneResume;
+
+  if (!reference.empty()) {
+    ObjectStore{gitdir}.add_alternate(remote::reference_objects_dir(reference));
+  }
+
+  // An earlier attempt into the same destination left a checkpoint: ask the
+  // server to skip everything up to it. The server honours the token (answering
+  // "SKIP <n>") only while its tip and stream are unchanged; otherwise it resends
+  // all objects (existing loose files are not rewritten).
+  std::string op = op_line(consts::kOpClone, depth, filter);
+  const auto resume = load_resume_point(resume_file);
+  if (resume) {
+    op += " ";
+    op += consts::kTokResume;
+    op += resume->tip + " " + resume->last + " " + std::to_string(resume->count);
+  }
+
+  Session session{host, port, session_opts};
+  auto &conn = session.conn();
+  conn.write_line(op);
+
+  const RefInfo ref = parse_ref_header(conn.read_line());
+  auto [shallow, nline] = recv_shallow_list(conn);
+
+  stdfs::create_directories(objdir);
+  ResumePoint progress{.tip = ref.oid, .last = {}, .count = 0};
+  if (nline.starts_with(consts::kTokSkip)) {
+    progress.count = std::stoull(nline.substr(consts::kTokSkip.size()));
+    progress.last = resume ? resume->last : std::string{};
+    nline = conn.read_line();
+  }
+  std::size_t pending_objects = 0;
+  std::size_t pending_bytes = 0;
+  session.phase("objects");
+  recv_objects_into(session, objdir, nline, [&](const std::string &hex, std::size_t bytes) {
+    progress.last = hex;
+    ++progress.count;
+    ++pending_objects;
+    pending_bytes += bytes;
+    if (looks_hex40(progress.tip) &&
+        (pending_objects >= kCheckpointObjects || pending_bytes >= kCheckpointBytes)) {
+      save_resume_point(resume_file, progress);
+      pending_objects = 0;
+      pending_bytes = 0;
+    }
+  });
+  // All objects are in; the checkpoint is no longer needed.
+  std::error_code ec;
+  stdfs::remove(resume_file, ec);
 
   // Init basic repo structure and set HEAD / refs
   Repository repo{stdfs::path{dest_root}};
   stdfs::create_directories(repo.heads_dir());
   stdfs::create_directories(repo.tags_dir());
+  repo.update_shallow_commits(shallow);
+  if (!filter.empty()) {
+    config_set(repo.root(), consts::kCfgPromisor,
+               "tcp://" + host + ":" + std::to_string(port) +
+                   (session_opts.repo.empty() ? "" : "/" + session_opts.repo));
+    config_set(repo.root(), consts::kCfgPartialFilter, filter);
+  }
 
   if (ref.branch != "DETACHED") {
     set_HEAD_symbolic(dest_root, heads_ref(ref.branch));
@@ -320,36 +670,188 @@ void clone_repo(const std::string &host, int port, const std::string &dest_root)
   }
 
   // Materialize working tree and index if we have a tip OID
+  session.phase("checkout");
   if (!ref.oid.empty()) {
     const auto info = repo.read_commit(ref.oid);
     const auto snap = worktree::tree_to_map(repo, info.tree_hex);
     worktree::apply_snapshot(repo, snap);
     worktree::write_index_snapshot(repo, snap);
   }
+  session.finish();
 }
 
 auto fetch_head(const std::string &host, int port, const std::string &local_root,
-                const std::string &remote_name) -> FetchResult {
-  auto sock = connect_tcp(host, port);
+                const std::string &remote_name, std::size_t depth,
+                const SessionOptions &session_opts) -> FetchResult {
+  Session session{host, port, session_opts};
+  auto &conn = session.conn();
+
+  // A partial clone keeps applying the filter it was cloned with.
+  const auto filter = config_get(local_root, consts::kCfgPartialFilter).value_or("");
 
-  send_line(sock.get(), "HELLO 1");
-  send_line(sock.get(), "OP FETCH");
+  conn.write_line(op_line(consts::kOpFetch, depth, filter));
 
-  const RefInfo ref = parse_ref_header(recv_line(sock.get()));
+  const RefInfo ref = parse_ref_header(conn.read_line());
+  const auto [shallow, nline] = recv_shallow_list(conn);
 
   const stdfs::path objdir = stdfs::path(local_root) / consts::kGitDir / consts::kObjectsDir;
 
-  recv_objects_into(sock.get(), objdir);
+  session.phase("objects");
+  recv_objects_into(session, objdir, nline);
+
+  Repository local_repo{stdfs::path{local_root}};
+  local_repo.update_shallow_commits(shallow);
 
   if (!ref.oid.empty() && ref.branch != "DETACHED") {
-    Repository local_repo{stdfs::path{local_root}};
     const auto remdir = local_repo.refs_dir() / "remotes" / remote_name;
     stdfs::create_directories(remdir);
     update_ref(local_repo.root(), std::string("refs/remotes/") + remote_name + "/" + ref.branch,
                ref.oid);
   }
 
+  session.finish();
   return FetchResult{.branch = ref.branch, .tip = ref.oid};
 }
 
+auto ls_refs(const std::string &host, int port, const std::string &prefix,
+             const SessionOptions &session_opts) -> std::vector<RefEntry> {
+  Session session{host, port, session_opts};
+  const auto req = ls_refs_request(prefix);
+  session.conn().write(req.data(), req.size());
+  auto refs = recv_ref_list(session.conn());
+  session.finish();
+  return refs;
+}
+
+auto fetch_refs(const std::string &host, int port, const std::string &local_root,
+                const std::string &remote_name, const std::string &prefix, std::size_t depth,
+                const SessionOptions &session_opts) -> std::vector<RefEntry> {
+  Session session{host, port, session_opts};
+  const auto req = fetch_refs_request(local_root, prefix, depth);
+  session.conn().write(req.data(), req.size());
+  auto refs = read_fetch_refs(session, local_root, remote_name);
+  session.finish();
+  return refs;
+}
+
+void fetch_objects(const std::string &host, int port, const std::string &local_root,
+                   const std::vector<std::string> &hexes, const SessionOptions &session_opts) {
+  Session session{host, port, session_opts};
+  const auto req = blobs_request(hexes);
+  session.conn().write(req.data(), req.size());
+  read_blobs(session, local_root);
+  session.finish();
+}
+
+// Bytes of request a pipelining Client lets the server leave unread. The
+// server reads the next request only after writing the current response, so
+// anything beyond what the socket buffers hold could block this side's writes
+// while the server is blocked writing a response nobody reads. Well below the
+// buffers' usual size.
+constexpr std::size_t kMaxUnreadRequestBytes = 32 * 1024;
+
+struct Client::Impl {
+  Impl(const std::string &host, int port, SessionOptions o)
+      : opts(std::move(o)), session(host, port, opts, /*multi=*/true) {}
+
+  // Write `request` tagged with a new id; its response is read by `handler`.
+  // Responses still outstanding are read first if the request would push the
+  // unread bytes past kMaxUnreadRequestBytes.
+  std::uint64_t send(const std::string &request, std::function<void()> handler) {
+    const auto id = next_id++;
+    const std::string tag = std::string(consts::kTokReq) + std::to_string(id) + "\n";
+    if (unread + tag.size() + request.size() > kMaxUnreadRequestBytes) {
+      drain(std::numeric_limits<std::uint64_t>::max());
+    }
+    auto &conn = session.conn();
+    conn.write(tag.data(), tag.size());
+    conn.write(request.data(), request.size());
+    unread += tag.size() + request.size();
+    pending.emplace_back(id, std::move(handler));
+    return id;
+  }
+
+  // Read responses up to and including request `id`.
+  void drain(std::uint64_t id) {
+    while (!pending.empty() && pending.front().first <= id) {
+      auto [rid, handler] = std::move(pending.front());
+      pending.pop_front();
+      expect(rid);
+      handler();
+    }
+    if (pending.empty()) {
+      unread = 0; // the server has read every request that was answered
+    }
+  }
+
+  void expect(std::uint64_t id) {
+    const auto line = session.conn().read_line();
+    if (line.starts_with("ERR ")) {
+      throw std::runtime_error("server: " + line.substr(4));
+    }
+    if (line != std::string(consts::kTokResp) + std::to_string(id)) {
+      throw std::runtime_error("expected response to request " + std::to_string(id));
+    }
+  }
+
+  SessionOptions opts; // Session keeps a reference
+  Session session;
+  std::uint64_t next_id = 1;
+  std::deque<std::pair<std::uint64_t, std::function<void()>>> pending;
+  std::size_t unread = 0; // request bytes written since responses were last all read
+};
+
+Client::Client(const std::string &host, int port, const SessionOptions &session)
+    : impl_(std::make_unique<Impl>(host, port, session)) {}
+
+Client::~Client() {
+  try {
+    wait();
+    impl_->session.conn().write_line(consts::kTokBye);
+    impl_->session.finish();
+  } catch (const std::exception &) {
+    // the connection is going away regardless
+  }
+}
+
+auto Client::ls_refs(const std::string &prefix, RefsFn on_refs) -> std::uint64_t {
+  return impl_->send(ls_refs_request(prefix), [this, on_refs = std::move(on_refs)] {
+    auto refs = recv_ref_list(impl_->session.conn());
+    if (on_refs) {
+      on_refs(std::move(refs));
+    }
+  });
+}
+
+auto Client::fetch_refs(const std::string &local_root, const std::string &remote_name,
+                        const std::string &prefix, std::size_t depth, RefsFn on_refs)
+    -> std::uint64_t {
+  return impl_->send(fetch_refs_request(local_root, prefix, depth),
+                     [this, local_root, remote_name, on_refs = std::move(on_refs)] {
+                       auto refs = read_fetch_refs(impl_->session, local_root, remote_name);
+                       if (on_refs) {
+                         on_refs(std::move(refs));
+                       }
+                     });
+}
+
+auto Client::fetch_objects(const std::string &local_root, const std::vector<std::string> &hexes)
+    -> std::uint64_t {
+  return impl_->send(blobs_request(hexes),
+                     [this, local_root] { read_blobs(impl_->session, local_root); });
+}
+
+void Client::wait(std::uint64_t id) { impl_->drain(id); }
+
+void Client::push_refs(const std::string &repo_root, const std::vector<std::string> &refnames) {
+  const auto local = resolve_local_refs(repo_root, refnames);
+  wait();
+  const auto id = impl_->next_id++;
+  auto &conn = impl_->session.conn();
+  conn.write_line(std::string(consts::kTokReq) + std::to_string(id));
+  conn.write_line(consts::kOpPush);
+  impl_->expect(id);
+  read_push(impl_->session, repo_root, local);
+}
+
 } // namespace gitfly::tcpremote
@@ -4,28 +4,42 @@
 #include "gitfly/consts.hpp"
 #include "gitfly/hash.hpp"
 
-#include <cctype>
-#include <vector>
+#include <array>
+#include <fstream>
+#include <stdexcept>
 
 namespace gitfly {
 
-bool looks_hex40(std::string_view str) {
-  if (str.size() != consts::kOidHexLen) {
-    return false;
-  }
-  return std::ranges::all_of(str,
-                             [](char c) { return std::isxdigit(static_cast<unsigned char>(c)); });
+bool looks_hex40(std::string_view str) { return looks_hex_oid(str, ObjectFormat::sha1); }
+
+bool looks_hex_oid(std::string_view str, ObjectFormat format) {
+  std::array<std::uint8_t, FormatTraits<ObjectFormat::sha256>::kRawLen> scratch;
+  return str.size() == hex_len(format) && hex_decode(str, scratch.data());
 }
 
 std::string compute_blob_hex_oid(std::span<const std::uint8_t> bytes) {
-  const std::string hdr = object_header("blob", bytes.size());
-  std::vector<std::uint8_t> store;
-  store.reserve(hdr.size() + bytes.size());
-  store.insert(store.end(), reinterpret_cast<const std::uint8_t *>(hdr.data()),
-               reinterpret_cast<const std::uint8_t *>(hdr.data()) + hdr.size());
-  store.insert(store.end(), bytes.begin(), bytes.end());
-  const oid id = sha1(store);
-  return to_hex(id);
+  return to_hex(hash_object(consts::kTypeBlob, bytes));
+}
+
+std::string compute_file_blob_hex_oid(const std::filesystem::path &file) {
+  std::ifstream in(file, std::ios::binary);
+  if (!in) {
+    throw std::runtime_error("cannot open " + file.string());
+  }
+  const auto size = std::filesystem::file_size(file);
+  Hasher hasher;
+  hasher.update(object_header(consts::kTypeBlob, size));
+  char buf[64 * 1024];
+  std::uintmax_t total = 0;
+  while (in.read(buf, sizeof(buf)) || in.gcount() > 0) {
+    const auto n = static_cast<std::size_t>(in.gcount());
+    hasher.update(std::string_view(buf, n));
+    total += n;
+  }
+  if (total != size) {
+    throw std::runtime_error("file changed while hashing: " + file.string());
+  }
+  return to_hex(hasher.finish());
 }
 
 namespace strutil {
@@ -0,0 +1,303 @@
+#include "gitfly/wire.hpp"
+
+#include "gitfly/consts.hpp"
+#include "gitfly/util.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <fcntl.h>
+#include <sstream>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <unistd.h>
+#include <zlib.h>
+
+namespace gitfly::wire {
+
+namespace {
+constexpr std::size_t kChunk = 64 * 1024;
+
+// Strict unsigned decimal: digits only, no sign or trailing text.
+bool parse_uint(std::string_view s, std::uint64_t &out) {
+  const auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), out);
+  return !s.empty() && ec == std::errc{} && ptr == s.data() + s.size();
+}
+} // namespace
+
+struct Conn::Zlib {
+  z_stream def{};
+  z_stream inf{};
+  std::vector<std::uint8_t> raw; // compressed input not yet inflated
+  std::size_t raw_pos = 0;
+  bool def_pending = false; // deflate holds input not yet sync-flushed
+
+  Zlib() {
+    // Objects are already deflated; level 1 catches the protocol text and the
+    // object headers without burning CPU on incompressible payloads.
+    if (deflateInit(&def, Z_BEST_SPEED) != Z_OK)
+      throw std::runtime_error("deflateInit failed");
+    if (inflateInit(&inf) != Z_OK) {
+      deflateEnd(&def);
+      throw std::runtime_error("inflateInit failed");
+    }
+  }
+  ~Zlib() {
+    deflateEnd(&def);
+    inflateEnd(&inf);
+  }
+  Zlib(const Zlib &) = delete;
+  Zlib &operator=(const Zlib &) = delete;
+};
+
+Conn::Conn(int fd) : fd_(fd) {}
+Conn::~Conn() = default;
+
+void Conn::send_raw(const std::uint8_t *p, std::size_t n) {
+  while (n != 0) {
+    const ssize_t w = ::send(fd_, p, n, MSG_NOSIGNAL);
+    if (w < 0 && errno == EINTR)
+      continue;
+    if (w <= 0)
+      throw std::system_error(errno, std::generic_category(), "send");
+    p += w;
+    n -= static_cast<std::size_t>(w);
+    counters_.wire_out += static_cast<std::uint64_t>(w);
+  }
+}
+
+void Conn::drain_out(bool sync) {
+  if (!z_) {
+    send_raw(out_.data(), out_.size());
+    out_.clear();
+    return;
+  }
+  z_stream &zs = z_->def;
+  zs.next_in = out_.data();
+  zs.avail_in = static_cast<uInt>(out_.size());
+  std::uint8_t buf[kChunk];
+  do {
+    zs.next_out = buf;
+    zs.avail_out = sizeof(buf);
+    if (deflate(&zs, sync ? Z_SYNC_FLUSH : Z_NO_FLUSH) == Z_STREAM_ERROR)
+      throw std::runtime_error("deflate failed");
+    send_raw(buf, sizeof(buf) - zs.avail_out);
+  } while (zs.avail_out == 0);
+  out_.clear();
+  z_->def_pending = !sync;
+}
+
+void Conn::write(const void *buf, std::size_t n) {
+  const auto *p = static_cast<const std::uint8_t *>(buf);
+  counters_.payload_out += n;
+  if (!z_ && out_.size() + n >= kChunk) {
+    // Large uncompressed writes go straight to the socket instead of being copied.
+    drain_out(false);
+    send_raw(p, n);
+    return;
+  }
+  out_.insert(out_.end(), p, p + n);
+  if (out_.size() >= kChunk)
+    drain_out(false);
+}
+
+void Conn::write_line(std::string_view s) {
+  write(s.data(), s.size());
+  write("\n", 1);
+}
+
+void Conn::flush() {
+  if (!out_.empty() || (z_ && z_->def_pending))
+    drain_out(true);
+}
+
+bool Conn::fill() {
+  if (in_pos_ == in_.size()) {
+    in_.clear();
+    in_pos_ = 0;
+  } else if (in_pos_ >= kChunk) {
+    in_.erase(in_.begin(), in_.begin() + static_cast<std::ptrdiff_t>(in_pos_));
+    in_pos_ = 0;
+  }
+  std::uint8_t buf[kChunk];
+  auto recv_some = [&](std::uint8_t *dst, std::size_t cap) -> std::size_t {
+    for (;;) {
+      const ssize_t r = ::recv(fd_, dst, cap, 0);
+      if (r < 0 && errno == EINTR)
+        continue;
+      if (r < 0)
+        throw std::system_error(errno, std::generic_category(), "recv");
+      counters_.wire_in += static_cast<std::uint64_t>(r);
+      return static_cast<std::size_t>(r);
+    }
+  };
+
+  if (!z_) {
+    const std::size_t r = recv_some(buf, sizeof(buf));
+    in_.insert(in_.end(), buf, buf + r);
+    return r != 0;
+  }
+
+  z_stream &zs = z_->inf;
+  for (;;) {
+    if (z_->raw_pos == z_->raw.size()) {
+      z_->raw.resize(kChunk);
+      const std::size_t r = recv_some(z_->raw.data(), z_->raw.size());
+      z_->raw.resize(r);
+      z_->raw_pos = 0;
+      if (r == 0)
+        return false;
+    }
+    zs.next_in = z_->raw.data() + z_->raw_pos;
+    zs.avail_in = static_cast<uInt>(z_->raw.size() - z_->raw_pos);
+    zs.next_out = buf;
+    zs.avail_out = sizeof(buf);
+    const int rc = inflate(&zs, Z_SYNC_FLUSH);
+    if (rc != Z_OK && rc != Z_BUF_ERROR)
+      throw std::runtime_error("corrupt compressed stream");
+    z_->raw_pos = z_->raw.size() - zs.avail_in;
+    const std::size_t produced = sizeof(buf) - zs.avail_out;
+    if (produced != 0) {
+      in_.insert(in_.end(), buf, buf + produced);
+      return true;
+    }
+  }
+}
+
+void Conn::read_exact(void *dst, std::size_t n) {
+  flush();
+  auto *p = static_cast<std::uint8_t *>(dst);
+  while (n != 0) {
+    if (in_pos_ == in_.size() && !fill())
+      throw std::runtime_error("connection closed by peer");
+    const std::size_t take = std::min(n, in_.size() - in_pos_);
+    std::copy_n(in_.begin() + static_cast<std::ptrdiff_t>(in_pos_), take, p);
+    in_pos_ += take;
+    p += take;
+    n -= take;
+    charge_in(take);
+  }
+}
+
+void Conn::charge_in(std::size_t n) {
+  counters_.payload_in += n;
+  if (limits_.max_session != 0 && counters_.payload_in > limits_.max_session)
+    throw std::runtime_error("peer exceeded the session byte limit");
+}
+
+void Conn::read_payload(std::vector<std::uint8_t> &out, std::size_t n) {
+  if (n > limits_.max_object)
+    throw std::runtime_error("object of " + std::to_string(n) + " bytes exceeds the limit");
+  out.clear();
+  while (out.size() < n) {
+    const std::size_t at = out.size();
+    out.resize(at + std::min(n - at, kChunk));
+    read_exact(out.data() + at, out.size() - at);
+  }
+}
+
+void Conn::write_object(std::string_view hex, const std::filesystem::path &file) {
+  const int fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    throw std::system_error(errno, std::generic_category(), "open " + file.string());
+  struct Closer {
+    int fd;
+    ~Closer() { ::close(fd); }
+  } closer{fd};
+  struct stat st{};
+  if (::fstat(fd, &st) != 0)
+    throw std::system_error(errno, std::generic_category(), "stat " + file.string());
+  auto left = static_cast<std::uint64_t>(st.st_size);
+  write_line(std::string(consts::kTokObj) + std::string(hex) + " " + std::to_string(left));
+  std::uint8_t buf[kChunk];
+  while (left != 0) {
+    const ssize_t r = ::read(fd, buf, std::min<std::uint64_t>(left, sizeof(buf)));
+    if (r < 0 && errno == EINTR)
+      continue;
+    if (r <= 0)
+      throw std::runtime_error("short read from " + file.string());
+    write(buf, static_cast<std::size_t>(r));
+    left -= static_cast<std::uint64_t>(r);
+  }
+}
+
+std::string Conn::read_line() {
+  flush();
+  std::size_t scanned = 0; // relative to in_pos_, which fill() may move
+  for (;;) {
+    const auto start = in_.begin() + static_cast<std::ptrdiff_t>(in_pos_);
+    if (const auto nl = std::find(start + static_cast<std::ptrdiff_t>(scanned), in_.end(), '\n');
+        nl != in_.end()) {
+      const auto used = static_cast<std::size_t>(nl - start) + 1;
+      if (used > limits_.max_line)
+        throw std::runtime_error("protocol line too long");
+      std::string line(start, nl);
+      in_pos_ += used;
+      charge_in(used);
+      return line;
+    }
+    scanned = in_.size() - in_pos_;
+    if (scanned >= limits_.max_line)
+      throw std::runtime_error("protocol line too long");
+    if (!fill())
+      throw std::runtime_error("connection closed by peer");
+  }
+}
+
+void Conn::enable_compression() {
+  if (z_)
+    return;
+  flush();
+  z_ = std::make_unique<Zlib>();
+  z_->raw.assign(in_.begin() + static_cast<std::ptrdiff_t>(in_pos_), in_.end());
+  in_.clear();
+  in_pos_ = 0;
+}
+
+std::string hello_line(const std::vector<std::string_view> &caps) {
+  std::string line = "HELLO 1";
+  for (const auto cap : caps) {
+    line += ' ';
+    line += cap;
+  }
+  return line;
+}
+
+std::vector<std::string> parse_hello(std::string_view line) {
+  if (!line.starts_with("HELLO "))
+    throw std::runtime_error("expected HELLO");
+  std::istringstream is{std::string(line.substr(6))};
+  std::string version;
+  is >> version;
+  std::vector<std::string> caps;
+  for (std::string cap; is >> cap;)
+    caps.push_back(cap);
+  return caps;
+}
+
+std::uint64_t parse_nobj(std::string_view line, const Limits &limits) {
+  std::uint64_t n = 0;
+  if (!line.starts_with(consts::kTokNobj) || !parse_uint(line.substr(consts::kTokNobj.size()), n))
+    throw std::runtime_error("expected NOBJ <n>");
+  if (n > limits.max_objects)
+    throw std::runtime_error("NOBJ " + std::to_string(n) + " exceeds the object count limit");
+  return n;
+}
+
+ObjHeader parse_obj(std::string_view line, const Limits &limits) {
+  if (!line.starts_with(consts::kTokObj))
+    throw std::runtime_error("expected OBJ <hex> <size>");
+  line.remove_prefix(consts::kTokObj.size());
+  const auto sp = line.find(' ');
+  std::uint64_t size = 0;
+  if (sp == std::string_view::npos || !looks_hex40(line.substr(0, sp)) ||
+      !parse_uint(line.substr(sp + 1), size))
+    throw std::runtime_error("malformed OBJ header");
+  if (size > limits.max_object)
+    throw std::runtime_error("object of " + std::to_string(size) + " bytes exceeds the limit");
+  return ObjHeader{.hex = std::string(line.substr(0, sp)), .size = static_cast<std::size_t>(size)};
+}
+
+} // namespace gitfly::wire
@@ -1,11 +1,15 @@
 #include "gitfly/worktree.hpp"
 
+#include "gitfly/consts.hpp"
 #include "gitfly/fs.hpp"
+#include "gitfly/hash.hpp"
 #include "gitfly/index.hpp"
 #include "gitfly/repo.hpp"
 #include "gitfly/util.hpp"
 
 #include <filesystem>
+#include <span>
+#include <vector>
 
 namespace gfs = gitfly::fs;
 
@@ -30,10 +34,34 @@ PathOidMap build_working_map(const std::filesystem::path &root) {
   PathOidMap m;
   std::set<std::string> paths;
   enumerate_paths(root, paths);
+  // Small files are read and hashed in batches (see sha1_many); big ones are
+  // streamed so they are never held in memory whole.
+  constexpr std::uintmax_t kBatchFileMax = 64 * 1024;
+  constexpr std::size_t kBatch = 256;
+  std::vector<const std::string *> batch;
+  std::vector<std::vector<std::uint8_t>> contents;
+  auto flush = [&] {
+    const std::vector<std::span<const std::uint8_t>> payloads(contents.begin(), contents.end());
+    const auto ids = hash_objects(consts::kTypeBlob, payloads);
+    for (std::size_t i = 0; i < batch.size(); ++i) {
+      m[*batch[i]] = to_hex(ids[i]);
+    }
+    batch.clear();
+    contents.clear();
+  };
   for (const auto &rel : paths) {
-    auto bytes = gfs::read_file(root / rel);
-    m[rel] = compute_blob_hex_oid(bytes);
+    const auto file = root / rel;
+    if (std::filesystem::file_size(file) > kBatchFileMax) {
+      m[rel] = compute_file_blob_hex_oid(file);
+      continue;
+    }
+    batch.push_back(&rel);
+    contents.push_back(gfs::read_file(file));
+    if (batch.size() == kBatch) {
+      flush();
+    }
   }
+  flush();
   return m;
 }
 
@@ -42,7 +70,7 @@ PathOidMap index_to_map(const std::filesystem::path &root) {
   Index idx{root};
   idx.load();
   for (const auto &e : idx.entries())
-    m[e.path] = to_hex(e.oid);
+    m.emplace_hint(m.end(), e.path, to_hex(e.oid)); // entries are sorted by path
   return m;
 }
 
@@ -70,11 +98,21 @@ void apply_snapshot(const Repository &repo, const PathOidMap &snapshot) {
     if (!snapshot.contains(p))
       std::filesystem::remove(repo.root() / p);
   }
+  // A partial clone fetches every missing blob in one batch up front
+  {
+    std::vector<std::string> blobs;
+    blobs.reserve(snapshot.size());
+    for (const auto &[_, hex] : snapshot)
+      blobs.push_back(hex);
+    repo.prefetch_blobs(blobs);
+  }
   // Write/update listed files
   for (const auto &[path, hex] : snapshot) {
     std::filesystem::create_directories((repo.root() / path).parent_path());
-    auto bytes = repo.read_blob(hex);
-    gfs::write_file_atomic(repo.root() / path, bytes);
+    // Inflated straight into the file, so a large blob never sits in memory
+    auto blob = repo.open_blob(hex);
+    gfs::write_file_atomic(repo.root() / path,
+                           [&blob](std::span<std::uint8_t> buf) { return blob.read(buf); });
   }
 }
 
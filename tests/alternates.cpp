@@ -0,0 +1,99 @@
+#include "gitfly/index.hpp"
+#include "gitfly/object_store.hpp"
+#include "gitfly/remote.hpp"
+#include "gitfly/repo.hpp"
+#include "gitfly/refs.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+namespace fs = std::filesystem;
+
+static void write_file(const fs::path &p, std::string_view s) {
+  fs::create_directories(p.parent_path());
+  std::ofstream(p, std::ios::binary) << s;
+}
+
+static std::size_t count_objects(const fs::path &root) {
+  return gitfly::ObjectStore{root / ".gitfly"}.list().size(); // includes alternates
+}
+
+static std::size_t count_loose_files(const fs::path &root) {
+  std::size_t n = 0;
+  const fs::path objects = root / ".gitfly" / "objects";
+  for (const auto &e : fs::recursive_directory_iterator(objects))
+    if (e.is_regular_file() && *e.path().lexically_relative(objects).begin() != "info")
+      ++n;
+  return n;
+}
+
+int main() {
+  const fs::path base =
+      fs::temp_directory_path() / ("gitfly_alt_" + std::to_string(std::random_device{}()));
+  const fs::path src = base / "src", shared = base / "shared", ref = base / "ref";
+  fs::create_directories(src);
+
+  try {
+    gitfly::Repository repo{src};
+    repo.init(gitfly::Identity{.name = "User", .email = "u@example.com"});
+    write_file(src / "a.txt", "a\n");
+    gitfly::Index idx{src};
+    idx.load(); idx.add_path(src, "a.txt", repo); idx.save();
+    const std::string c1 = repo.commit_index("c1\n");
+
+    // --shared: nothing copied, everything readable through the alternate
+    gitfly::remote::clone_repo(src, shared, 0, {}, /*shared=*/true);
+    if (count_loose_files(shared) != 0) {
+      std::cerr << "shared clone copied objects\n";
+      return 1;
+    }
+    gitfly::Repository rshared{shared};
+    (void)rshared.read_commit(c1);
+    if (count_objects(shared) != 3) {
+      std::cerr << "list() should include alternate objects\n";
+      return 1;
+    }
+
+    // Writing an object an alternate already holds does not duplicate it
+    const gitfly::ObjectStore store{rshared.git_dir()};
+    (void)store.write("blob", std::span<const std::uint8_t>(
+                                  reinterpret_cast<const std::uint8_t *>("a\n"), 2));
+    if (count_loose_files(shared) != 0) {
+      std::cerr << "write duplicated an alternate object\n";
+      return 1;
+    }
+
+    // New history in the shared clone lives there only
+    write_file(shared / "b.txt", "b\n");
+    gitfly::Index sidx{shared};
+    sidx.load(); sidx.add_path(shared, "b.txt", rshared); sidx.save();
+    const std::string c2 = rshared.commit_index("c2\n");
+    if (count_loose_files(shared) != 3) {
+      std::cerr << "expected commit, tree and blob of c2 locally\n";
+      return 1;
+    }
+
+    // --reference: only objects the reference lacks are copied
+    gitfly::remote::clone_repo(shared, ref, 0, {}, false, src);
+    if (count_loose_files(ref) != 3) {
+      std::cerr << "reference clone copied " << count_loose_files(ref) << " objects, want 3\n";
+      return 1;
+    }
+    gitfly::Repository rref{ref};
+    if (!rref.is_commit_ancestor(c1, c2)) {
+      std::cerr << "history not reachable through the reference\n";
+      return 1;
+    }
+
+    std::cout << "alternates OK\n";
+  } catch (const std::exception &e) {
+    std::cerr << "exception: " << e.what() << "\n";
+    fs::remove_all(base);
+    return 1;
+  }
+  std::error_code ec;
+  fs::remove_all(base, ec);
+  return 0;
+}
@@ -0,0 +1,140 @@
+#include "gitfly/bitmap.hpp"
+#include "gitfly/index.hpp"
+#include "gitfly/reach.hpp"
+#include "gitfly/refs.hpp"
+#include "gitfly/repo.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <set>
+
+namespace fs = std::filesystem;
+
+static void write_file(const fs::path &p, std::string_view s) {
+  fs::create_directories(p.parent_path());
+  std::ofstream(p, std::ios::binary) << s;
+}
+
+static std::vector<std::uint64_t> random_words(std::mt19937_64 &rng, std::size_t n) {
+  std::vector<std::uint64_t> w(n);
+  for (auto &x : w) {
+    switch (rng() % 4) { // mix clean runs and literals
+    case 0: x = 0; break;
+    case 1: x = ~std::uint64_t{0}; break;
+    default: x = rng(); break;
+    }
+  }
+  return w;
+}
+
+static std::set<std::size_t> bits_of(const gitfly::EwahBitmap &b) {
+  std::set<std::size_t> s;
+  b.for_each([&](std::size_t i) { s.insert(i); });
+  return s;
+}
+
+static std::set<std::size_t> bits_of(const std::vector<std::uint64_t> &w) {
+  std::set<std::size_t> s;
+  for (std::size_t i = 0; i < w.size() * 64; ++i)
+    if ((w[i / 64] >> (i % 64)) & 1U)
+      s.insert(i);
+  return s;
+}
+
+int main() {
+  // EWAH operations agree with the same operations on plain words.
+  std::mt19937_64 rng{42};
+  for (int round = 0; round < 200; ++round) {
+    const auto a = random_words(rng, rng() % 40), b = random_words(rng, rng() % 40);
+    const auto ea = gitfly::EwahBitmap::from_words(a), eb = gitfly::EwahBitmap::from_words(b);
+    std::vector<std::uint64_t> o(std::max(a.size(), b.size())), d(a.size());
+    for (std::size_t i = 0; i < o.size(); ++i)
+      o[i] = (i < a.size() ? a[i] : 0) | (i < b.size() ? b[i] : 0);
+    for (std::size_t i = 0; i < d.size(); ++i)
+      d[i] = a[i] & ~(i < b.size() ? b[i] : 0);
+    std::vector<std::uint64_t> back;
+    ea.or_into(back);
+    std::string ser;
+    ea.serialize(ser);
+    std::size_t pos = 0;
+    if (bits_of(ea | eb) != bits_of(o) || bits_of(ea.and_not(eb)) != bits_of(d) ||
+        bits_of(back) != bits_of(a) || ea.count() != bits_of(a).size() ||
+        !(gitfly::EwahBitmap::parse(ser, pos) == ea) || pos != ser.size()) {
+      std::cerr << "EWAH mismatch in round " << round << "\n";
+      return 1;
+    }
+  }
+
+  const fs::path root =
+      fs::temp_directory_path() / ("gitfly_bitmap_" + std::to_string(std::random_device{}()));
+  fs::create_directories(root);
+  try {
+    gitfly::Repository repo{root};
+    repo.init(gitfly::Identity{.name = "User", .email = "u@example.com"});
+    gitfly::Index idx{root};
+    std::vector<std::string> commits;
+    for (int i = 0; i < 150; ++i) {
+      write_file(root / ("d" + std::to_string(i % 7)) / "f.txt", std::to_string(i) + "\n");
+      idx.load(); idx.add_path(root, "d" + std::to_string(i % 7) + "/f.txt", repo); idx.save();
+      commits.push_back(repo.commit_index("c" + std::to_string(i) + "\n"));
+    }
+    const std::string tip = commits.back();
+
+    auto bitmaps = gitfly::BitmapIndex::refresh(repo, {tip});
+    if (!bitmaps || !bitmaps->covers(tip) || bitmaps->bitmap_count() < 2) {
+      std::cerr << "index not built\n";
+      return 1;
+    }
+    auto loaded = gitfly::BitmapIndex::load(repo.git_dir());
+    if (!loaded || loaded->object_count() != bitmaps->object_count()) {
+      std::cerr << "index did not round-trip\n";
+      return 1;
+    }
+
+    // want minus have == everything reachable from the tip that is not
+    // reachable from the have.
+    const auto expect_missing = [&](const std::string &want, const std::string &have) {
+      const auto all = gitfly::reach::collect_objects(repo, {want});
+      const auto old = gitfly::reach::collect_objects(repo, {have});
+      std::set<std::string> e(all.begin(), all.end());
+      for (const auto &h : old)
+        e.erase(h);
+      return e;
+    };
+    for (const auto have : {10, 63, 100, 148}) {
+      const auto got = loaded->missing(repo, {tip}, {commits[have]});
+      if (std::set<std::string>(got.begin(), got.end()) != expect_missing(tip, commits[have]) ||
+          got.size() != expect_missing(tip, commits[have]).size()) {
+        std::cerr << "missing() wrong for have " << have << "\n";
+        return 1;
+      }
+    }
+
+    // New history past the index is walked, then folded in on refresh.
+    write_file(root / "new.txt", "new\n");
+    idx.load(); idx.add_path(root, "new.txt", repo); idx.save();
+    const std::string next = repo.commit_index("next\n");
+    const auto got = loaded->missing(repo, {next}, {tip});
+    if (std::set<std::string>(got.begin(), got.end()) != expect_missing(next, tip)) {
+      std::cerr << "missing() wrong past the index\n";
+      return 1;
+    }
+    const auto before = loaded->object_count();
+    auto grown = gitfly::BitmapIndex::refresh(repo, {next});
+    if (!grown || !grown->covers(next) || grown->object_count() != before + got.size()) {
+      std::cerr << "refresh did not extend the index\n";
+      return 1;
+    }
+    std::cout << "bitmap OK\n";
+  } catch (const std::exception &e) {
+    std::cerr << "exception: " << e.what() << "\n";
+    fs::remove_all(root);
+    return 1;
+  }
+  std::error_code ec;
+  fs::remove_all(root, ec);
+  return 0;
+}
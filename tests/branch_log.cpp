@@ -3,6 +3,7 @@
 #include "gitfly/refs.hpp"
 #include "gitfly/repo.hpp"
 
+#include <algorithm>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
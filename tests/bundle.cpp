@@ -0,0 +1,109 @@
+#include "gitfly/bundle.hpp"
+#include "gitfly/fs.hpp"
+#include "gitfly/index.hpp"
+#include "gitfly/object_store.hpp"
+#include "gitfly/refs.hpp"
+#include "gitfly/repo.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+namespace fs = std::filesystem;
+
+static void write_file(const fs::path &p, std::string_view s) {
+  fs::create_directories(p.parent_path());
+  std::ofstream(p, std::ios::binary) << s;
+}
+
+static std::string commit_file(const fs::path &root, const std::string &name, std::string_view body) {
+  gitfly::Repository repo{root};
+  write_file(root / name, body);
+  gitfly::Index idx{root};
+  idx.load(); idx.add_path(root, name, repo); idx.save();
+  return repo.commit_index(name + "\n");
+}
+
+int main() {
+  const fs::path base =
+      fs::temp_directory_path() / ("gitfly_bundle_" + std::to_string(std::random_device{}()));
+  const fs::path src = base / "src", dst = base / "dst";
+  const fs::path full = base / "full.bundle", incr = base / "incr.bundle";
+  fs::create_directories(src);
+
+  try {
+    gitfly::Repository repo{src};
+    repo.init(gitfly::Identity{.name = "User", .email = "u@example.com"});
+    const std::string c1 = commit_file(src, "a.txt", "a\n");
+    gitfly::update_ref(src, "refs/tags/v1", c1);
+
+    // Full bundle: every head and tag, clonable
+    if (gitfly::bundle::create(src, full, {}) != 3) {
+      std::cerr << "full bundle: expected commit, tree and blob\n";
+      return 1;
+    }
+    if (!gitfly::bundle::is_bundle(full) || gitfly::bundle::is_bundle(src / "a.txt")) {
+      std::cerr << "is_bundle misdetects\n";
+      return 1;
+    }
+    gitfly::bundle::clone_repo(full, dst);
+    if (gitfly::read_ref(dst, "refs/heads/master") != c1 || gitfly::read_ref(dst, "refs/tags/v1") != c1) {
+      std::cerr << "clone from bundle: refs\n";
+      return 1;
+    }
+    const auto bytes = gitfly::fs::read_file(dst / "a.txt");
+    if (std::string(bytes.begin(), bytes.end()) != "a\n") {
+      std::cerr << "clone from bundle: working tree\n";
+      return 1;
+    }
+
+    // Incremental bundle: only the new history, with c1 as prerequisite
+    const std::string c2 = commit_file(src, "b.txt", "b\n");
+    if (gitfly::bundle::create(src, incr, {"master"}, {"v1"}) != 3) {
+      std::cerr << "incremental bundle: expected 3 new objects\n";
+      return 1;
+    }
+    const auto h = gitfly::bundle::read_header(incr);
+    if (h.prerequisites != std::vector<std::string>{c1} || h.refs.size() != 1) {
+      std::cerr << "incremental bundle: header\n";
+      return 1;
+    }
+    bool threw = false;
+    try { gitfly::bundle::clone_repo(incr, base / "nope"); } catch (const std::runtime_error &) { threw = true; }
+    if (!threw) {
+      std::cerr << "clone accepted an incremental bundle\n";
+      return 1;
+    }
+    const auto refs = gitfly::bundle::fetch_refs(dst, incr, "origin");
+    if (refs.size() != 1 || gitfly::read_ref(dst, "refs/remotes/origin/master") != c2) {
+      std::cerr << "fetch from bundle: tracking ref\n";
+      return 1;
+    }
+    (void)gitfly::Repository{dst}.read_commit(c2);
+
+    // A corrupted object is rejected before it reaches the store
+    std::string raw;
+    {
+      const auto b = gitfly::fs::read_file(full);
+      raw.assign(b.begin(), b.end());
+    }
+    raw[raw.rfind("\x78\x01") + 3] ^= 0x20; // inside the last object's deflate data
+    write_file(base / "bad.bundle", raw);
+    threw = false;
+    try { gitfly::bundle::clone_repo(base / "bad.bundle", base / "bad"); } catch (const std::exception &) { threw = true; }
+    if (!threw) {
+      std::cerr << "corrupt bundle accepted\n";
+      return 1;
+    }
+
+    std::cout << "bundle OK\n";
+  } catch (const std::exception &e) {
+    std::cerr << "exception: " << e.what() << "\n";
+    fs::remove_all(base);
+    return 1;
+  }
+  std::error_code ec;
+  fs::remove_all(base, ec);
+  return 0;
+}
@@ -1,4 +1,5 @@
 #include "gitfly/config.hpp"
+#include "gitfly/fs.hpp"
 #include "gitfly/repo.hpp"
 
 #include <filesystem>
@@ -96,6 +97,21 @@ int main() {
       return 1;
     }
 
+    // A codec this build lacks is refused before anything is created
+    if (!gitfly::fs::codec_available(gitfly::fs::Codec::zstd)) {
+      const gitfly::Repository bare{repo_root / "zstd"};
+      threw = false;
+      try {
+        bare.init(id, gitfly::fs::Codec::zstd);
+      } catch (const std::runtime_error &) {
+        threw = true;
+      }
+      if (!threw || fs::exists(repo_root / "zstd" / ".gitfly")) {
+        std::cerr << "zstd init on a build without zstd left a repository behind\n";
+        return 1;
+      }
+    }
+
     // Success
     std::cout << "init test OK: " << repo_root << "\n";
   } catch (const std::exception &e) {
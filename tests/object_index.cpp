@@ -0,0 +1,168 @@
+#include "gitfly/consts.hpp"
+#include "gitfly/hash.hpp"
+#include "gitfly/object_index.hpp"
+#include "gitfly/object_store.hpp"
+#include "gitfly/repo.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static std::span<const std::uint8_t> bytes(const std::string &s) {
+  return {reinterpret_cast<const std::uint8_t *>(s.data()), s.size()};
+}
+
+static gitfly::oid raw(const std::string &hex) {
+  gitfly::oid id{};
+  gitfly::from_hex(hex, id);
+  return id;
+}
+
+// Move every fan-out directory's mtime an hour back, so an index built now
+// trusts them on the next open.
+static void settle(const fs::path &objects) {
+  for (const auto &d : fs::directory_iterator(objects))
+    if (d.is_directory() && d.path().filename().string().size() == 2)
+      fs::last_write_time(d.path(), fs::file_time_type::clock::now() - std::chrono::hours(1));
+}
+
+int main() {
+  const fs::path base =
+      fs::temp_directory_path() / ("gitfly_oidx_" + std::to_string(std::random_device{}()));
+  const fs::path root = base / "repo", other = base / "other", root256 = base / "repo256";
+
+  try {
+    const gitfly::Repository repo{root};
+    repo.init();
+    const fs::path objects = repo.objects_dir();
+    const gitfly::ObjectStore plain{repo.git_dir()};
+    std::vector<std::string> ids;
+    for (int i = 0; i < 600; ++i)
+      ids.push_back(plain.write("blob", bytes("object " + std::to_string(i) + "\n")));
+
+    // Built from a scan: every object is in, nothing else is
+    settle(objects);
+    {
+      const gitfly::ObjectIndex index{objects, gitfly::ObjectFormat::sha1};
+      if (index.size() != ids.size() || index.rescanned() != 256 ||
+          !fs::exists(objects / gitfly::consts::kObjectIndexFile)) {
+        std::cerr << "index build: " << index.size() << " ids, " << index.rescanned() << " dirs\n";
+        return 1;
+      }
+      for (const auto &hex : ids) {
+        if (!index.contains(raw(hex))) {
+          std::cerr << "indexed object missing: " << hex << "\n";
+          return 1;
+        }
+      }
+      for (int i = 0; i < 5000; ++i) {
+        if (index.contains(gitfly::sha1("absent " + std::to_string(i)))) {
+          std::cerr << "absent object reported present\n";
+          return 1;
+        }
+      }
+    }
+
+    // Reopened unchanged it reads no directory; a new object rescans only its own
+    {
+      const gitfly::ObjectIndex index{objects, gitfly::ObjectFormat::sha1};
+      if (index.rescanned() != 0 || index.size() != ids.size()) {
+        std::cerr << "unchanged index rescanned " << index.rescanned() << " dirs\n";
+        return 1;
+      }
+    }
+    const std::string late = plain.write("blob", bytes("written behind its back\n"));
+    {
+      const gitfly::ObjectIndex index{objects, gitfly::ObjectFormat::sha1};
+      if (index.rescanned() != 1 || !index.contains(raw(late)) ||
+          index.size() != ids.size() + 1) {
+        std::cerr << "changed fan-out directory not picked up\n";
+        return 1;
+      }
+    }
+
+    // A damaged index is rebuilt, not trusted
+    {
+      const auto file = objects / gitfly::consts::kObjectIndexFile;
+      auto data = gitfly::fs::read_file(file);
+      data[data.size() / 2] ^= 0x40U;
+      gitfly::fs::write_file_atomic(file, data);
+      const gitfly::ObjectIndex index{objects, gitfly::ObjectFormat::sha1};
+      if (index.rescanned() != 256 || !index.contains(raw(ids.front())) ||
+          !index.contains(raw(late))) {
+        std::cerr << "damaged index not rebuilt\n";
+        return 1;
+      }
+    }
+
+    // A store with its index loaded answers from it and keeps it current
+    {
+      const gitfly::ObjectStore store{repo.git_dir()};
+      store.load_index();
+      const std::string fresh = store.write("blob", bytes("fresh\n"));
+      const std::string copied = gitfly::to_hex(gitfly::sha1("placed by hand"));
+      if (!store.exists(ids[7]) || !store.exists(fresh) || store.exists(copied) ||
+          store.record(ids[7]) || store.record(fresh) || !store.record(copied) ||
+          store.record(copied) || !store.exists(copied) ||
+          store.read(fresh).data != std::vector<std::uint8_t>{'f', 'r', 'e', 's', 'h', '\n'}) {
+        std::cerr << "indexed store lookups wrong\n";
+        return 1;
+      }
+      // Copies share the index
+      const gitfly::ObjectStore copy = store;
+      if (!copy.exists(copied)) {
+        std::cerr << "store copy lost the index\n";
+        return 1;
+      }
+    }
+
+    // Alternates get an index of their own; their objects are never new here.
+    // It is cached in the borrowing store, leaving the alternate untouched.
+    {
+      fs::remove(objects / gitfly::consts::kObjectIndexFile);
+      const gitfly::Repository repo2{other};
+      repo2.init();
+      const gitfly::ObjectStore store{repo2.git_dir()};
+      store.add_alternate(objects);
+      store.load_index();
+      if (!store.exists(ids[3]) || store.record(ids[3]) ||
+          store.write("blob", bytes("object 3\n")) != ids[3] ||
+          fs::exists(store.path_for_oid(raw(ids[3])))) {
+        std::cerr << "alternate objects not indexed\n";
+        return 1;
+      }
+      const auto cached = repo2.objects_dir() / gitfly::consts::kAlternateIndexDir;
+      if (fs::exists(objects / gitfly::consts::kObjectIndexFile) || !fs::is_directory(cached) ||
+          fs::directory_iterator(cached) == fs::directory_iterator()) {
+        std::cerr << "alternate's index not cached in the borrowing store\n";
+        return 1;
+      }
+    }
+
+    // SHA-256 ids are indexed at their full width
+    {
+      const gitfly::ObjectStore store{root256, gitfly::ObjectFormat::sha256};
+      const std::string id = store.write("blob", bytes("hello\n"));
+      store.load_index();
+      if (!store.exists(id) || store.exists(id.substr(0, 40)) ||
+          store.exists(gitfly::to_hex(gitfly::sha256("absent")))) {
+        std::cerr << "sha256 index lookups wrong\n";
+        return 1;
+      }
+    }
+
+    std::cout << "object index OK\n";
+  } catch (const std::exception &e) {
+    std::cerr << "exception: " << e.what() << "\n";
+    fs::remove_all(base);
+    return 1;
+  }
+  std::error_code ec;
+  fs::remove_all(base, ec);
+  return 0;
+}
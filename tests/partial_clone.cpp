@@ -0,0 +1,88 @@
+#include "gitfly/config.hpp"
+#include "gitfly/index.hpp"
+#include "gitfly/object_store.hpp"
+#include "gitfly/reach.hpp"
+#include "gitfly/remote.hpp"
+#include "gitfly/repo.hpp"
+#include "gitfly/worktree.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+
+namespace fs = std::filesystem;
+
+static void write_file(const fs::path &p, std::string_view s) {
+  fs::create_directories(p.parent_path());
+  std::ofstream(p, std::ios::binary) << s;
+}
+
+int main() {
+  using gitfly::reach::BlobFilter;
+  if (BlobFilter::parse("").active() || BlobFilter::parse("blob:none").limit != 0U ||
+      BlobFilter::parse("blob:limit=2k").limit != 2048U) {
+    std::cerr << "BlobFilter::parse\n";
+    return 1;
+  }
+
+  const auto suffix = std::to_string(std::random_device{}());
+  const fs::path remote = fs::temp_directory_path() / ("gitfly_partial_remote_" + suffix);
+  const fs::path local = fs::temp_directory_path() / ("gitfly_partial_local_" + suffix);
+  fs::create_directories(remote);
+
+  try {
+    gitfly::Repository rrepo{remote};
+    rrepo.init(gitfly::Identity{"Remote", "r@example.com"});
+    gitfly::Index idx{remote};
+    write_file(remote / "asset.bin", "old asset\n");
+    idx.load(); idx.add_path(remote, "asset.bin", rrepo); idx.save();
+    const std::string c1 = rrepo.commit_index("c1\n");
+    write_file(remote / "asset.bin", "new asset\n");
+    idx.load(); idx.add_path(remote, "asset.bin", rrepo); idx.save();
+    (void)rrepo.commit_index("c2\n");
+    const std::string old_blob =
+        gitfly::worktree::tree_to_map(rrepo, rrepo.read_commit(c1).tree_hex).at("asset.bin");
+
+    gitfly::remote::clone_repo(remote, local, 0, "blob:none");
+    gitfly::Repository lrepo{local};
+    if (gitfly::config_get(local, gitfly::consts::kCfgPromisor) != fs::absolute(remote).string()) {
+      std::cerr << "partial clone did not record promisor\n";
+      return 1;
+    }
+    // Checked-out blob was fetched for the working tree; the historical one was not
+    const gitfly::ObjectStore store{lrepo.git_dir()};
+    if (store.exists(old_blob) || !store.exists(c1)) {
+      std::cerr << "partial clone transferred the wrong objects\n";
+      return 1;
+    }
+    std::ifstream ifs(local / "asset.bin");
+    std::string line;
+    std::getline(ifs, line);
+    if (line != "new asset") {
+      std::cerr << "partial clone working tree missing content\n";
+      return 1;
+    }
+    // Walks tolerate the promised blob being absent
+    gitfly::reach::check_connected(lrepo, c1);
+
+    // Reading the old blob fetches it on demand
+    const auto bytes = lrepo.read_blob(old_blob);
+    if (std::string(bytes.begin(), bytes.end()) != "old asset\n" || !store.exists(old_blob)) {
+      std::cerr << "lazy blob fetch failed\n";
+      return 1;
+    }
+
+    std::cout << "partial_clone OK\n";
+  } catch (const std::exception &e) {
+    std::cerr << "exception: " << e.what() << "\n";
+    fs::remove_all(remote);
+    fs::remove_all(local);
+    return 1;
+  }
+  std::error_code ec;
+  fs::remove_all(remote, ec);
+  fs::remove_all(local, ec);
+  return 0;
+}
@@ -50,6 +50,12 @@ int main() {
       if (std::string(bytes.begin(), bytes.end()).find("two") == std::string::npos) {
         std::cerr << "clone: working tree missing content\n"; return 1;
       }
+      // objects are linked, not duplicated (same filesystem under temp_directory_path)
+      gitfly::oid id{};
+      gitfly::from_hex(*local_tip, id);
+      if (fs::hard_link_count(gitfly::Repository{local}.object_path_from_oid(id)) < 2) {
+        std::cerr << "clone: commit object was copied, not linked\n"; return 1;
+      }
     }
 
     // Create local commit and push to remote
@@ -80,6 +86,40 @@ int main() {
       (void)lrepo.read_commit(new_remote_tip);
     }
 
+    // Fetch all heads and tags, including a branch that is not HEAD
+    {
+      gitfly::update_ref(remote, gitfly::heads_ref("topic"), new_remote_tip);
+      gitfly::update_ref(remote, "refs/tags/v1", new_remote_tip);
+      const auto refs = gitfly::remote::fetch_refs(local, remote, "origin");
+      if (refs.size() != 3) { std::cerr << "fetch_refs: expected 3 refs, got " << refs.size() << "\n"; return 1; }
+      auto topic = gitfly::read_ref(local, "refs/remotes/origin/topic");
+      auto tag = gitfly::read_ref(local, "refs/tags/v1");
+      if (!topic || *topic != new_remote_tip || !tag || *tag != new_remote_tip) { std::cerr << "fetch_refs: tracking refs mismatch\n"; return 1; }
+      const auto heads = gitfly::list_refs(remote, "refs/heads/");
+      if (heads.size() != 2 || heads[0].name != "refs/heads/master") { std::cerr << "list_refs: prefix filter\n"; return 1; }
+    }
+
+    // Ref transactions: compare-and-swap, all or none, refused while locked
+    {
+      const auto master = gitfly::read_ref(remote, gitfly::heads_ref("master"));
+      const std::vector<gitfly::RefUpdate> stale{
+          {.name = "refs/heads/a", .old_oid = "", .new_oid = *master},
+          {.name = "refs/heads/master", .old_oid = new_remote_tip + "x", .new_oid = *master}};
+      bool threw = false;
+      try { gitfly::update_refs(remote, stale); } catch (const std::runtime_error&) { threw = true; }
+      if (!threw || gitfly::read_ref(remote, "refs/heads/a")) { std::cerr << "update_refs: stale update applied\n"; return 1; }
+
+      gitfly::update_refs(remote, {{.name = "refs/heads/a", .old_oid = "", .new_oid = *master},
+                                   {.name = "refs/heads/topic", .old_oid = new_remote_tip, .new_oid = ""}});
+      if (gitfly::read_ref(remote, "refs/heads/a") != master || gitfly::read_ref(remote, "refs/heads/topic")) {
+        std::cerr << "update_refs: transaction not applied\n"; return 1;
+      }
+      write_file(remote / ".gitfly" / "refs" / "heads" / "a.lock", "");
+      threw = false;
+      try { gitfly::update_ref(remote, "refs/heads/a", new_remote_tip); } catch (const std::runtime_error&) { threw = true; }
+      if (!threw || gitfly::list_refs(remote, "refs/heads/a").size() != 1) { std::cerr << "update_ref: ignored lock\n"; return 1; }
+    }
+
     std::cout << "remote_fs OK\n";
   } catch (const std::exception& e) {
     std::cerr << "exception: " << e.what() << "\n";
@@ -1,11 +1,21 @@
 #include "gitfly/repo.hpp"
+#include "gitfly/config.hpp"
+#include "gitfly/fs.hpp"
 #include "gitfly/hash.hpp"
+#include "gitfly/object_store.hpp"
+#include "gitfly/object_writer.hpp"
+#include "gitfly/util.hpp"
 
+#include <algorithm>
+#include <cctype>
 #include <filesystem>
 #include <iostream>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include <zlib.h>
+
 using gitfly::Repository;
 using gitfly::TreeEntry;
 using gitfly::oid;
@@ -33,6 +43,324 @@ int main() {
             << (std::string(back.begin(), back.end()) == content ? " (OK)" : " (DIFF!)")
             << "\n";
 
+  // Same id as `git hash-object`, however the bytes are fed to the hasher
+  gitfly::Hasher pieces;
+  pieces.update("blob 6").update(std::string_view("\0", 1)).update("hello\n");
+  if (blob_oid_hex != "ce013625030ba8dba906f756967f9e9ca394464a" ||
+      gitfly::to_hex(pieces.finish()) != blob_oid_hex) {
+    std::cerr << "blob id mismatch\n"; return 1;
+  }
+
+  // A large, highly compressible object verifies without being inflated whole
+  const std::vector<std::uint8_t> zeros(8u << 20, 0);
+  const std::string big_hex = repo.write_blob(zeros);
+  gitfly::oid big{};
+  gitfly::from_hex(big_hex, big);
+  const gitfly::ObjectStore store{repo.git_dir()};
+  if (gitfly::ObjectStore::hash_loose(gitfly::fs::read_file(store.path_for_oid(big))) != big ||
+      gitfly::ObjectStore::hash_loose_file(store.path_for_oid(big)) != big ||
+      gitfly::compute_blob_hex_oid(zeros) != big_hex) {
+    std::cerr << "hash_loose mismatch\n"; return 1;
+  }
+
+  // Streamed writes name objects like write(), whatever the read sizes
+  {
+    std::size_t fed = 0;
+    const auto odd_reads = [&](std::span<std::uint8_t> buf) {
+      const std::size_t n = std::min({buf.size(), zeros.size() - fed, std::size_t{77777}});
+      std::fill_n(buf.begin(), n, 0);
+      fed += n;
+      return n;
+    };
+    std::vector<std::uint8_t> data(24u << 20);
+    for (std::size_t i = 0; i < data.size(); ++i) {
+      data[i] = static_cast<std::uint8_t>((i * 2654435761u) >> 13);
+    }
+    const fs::path file = repo_root / "asset.bin";
+    gitfly::fs::write_file_atomic(file, data);
+    const std::string file_hex = repo.write_blob_file(file);
+    gitfly::oid file_id{};
+    gitfly::from_hex(file_hex, file_id);
+    if (store.write_stream(gitfly::consts::kTypeBlob, zeros.size(), odd_reads) != big_hex ||
+        file_hex != gitfly::compute_blob_hex_oid(data) ||
+        store.read_header(file_hex).size != data.size() ||
+        gitfly::ObjectStore::hash_loose(gitfly::fs::read_file(store.path_for_oid(file_id))) !=
+            file_id ||
+        repo.write_blob_file(file) != file_hex) {
+      std::cerr << "write_stream mismatch\n"; return 1;
+    }
+    // A source shorter than declared is refused and leaves no temporary behind
+    fed = 0;
+    bool refused = false;
+    try {
+      (void)store.write_stream(gitfly::consts::kTypeBlob, zeros.size() + 1, odd_reads);
+    } catch (const std::runtime_error&) {
+      refused = true;
+    }
+    for (const auto& f : fs::directory_iterator(repo.git_dir() / "objects")) {
+      if (f.is_regular_file() && f.path().filename().string().find(".tmp") != std::string::npos) {
+        refused = false;
+      }
+    }
+    if (!refused) {
+      std::cerr << "short stream accepted\n"; return 1;
+    }
+    // Reading back in chunks yields the payload, and checks out like read_blob
+    auto stream = store.open_stream(file_hex);
+    std::vector<std::uint8_t> chunked;
+    std::uint8_t piece[1000];
+    while (const std::size_t n = stream.read(piece)) {
+      chunked.insert(chunked.end(), piece, piece + n);
+    }
+    fs::remove(file);
+    auto blob = repo.open_blob(file_hex);
+    gitfly::fs::write_file_atomic(file, [&blob](std::span<std::uint8_t> buf) { return blob.read(buf); });
+    if (stream.type() != "blob" || stream.size() != data.size() || chunked != data ||
+        gitfly::fs::read_file(file) != data) {
+      std::cerr << "open_stream mismatch\n"; return 1;
+    }
+    fs::remove(file);
+  }
+
+  // Batched writer: objects from several threads, stored after one flush
+  {
+    // Removed first, so write_loose puts it back
+    gitfly::oid hello_id{};
+    gitfly::from_hex(blob_oid_hex, hello_id);
+    const auto loose = gitfly::fs::read_file(store.path_for_oid(hello_id));
+    fs::remove(store.path_for_oid(hello_id));
+    gitfly::ObjectWriter writer{store, 3};
+    std::vector<std::string> ids(400);
+    std::vector<std::thread> producers;
+    for (std::size_t t = 0; t < 4; ++t) {
+      producers.emplace_back([&, t] {
+        for (std::size_t i = t; i < ids.size(); i += 4) {
+          const std::string text = "queued object " + std::to_string(i) + "\n";
+          ids[i] = writer.write("blob", std::vector<std::uint8_t>(text.begin(), text.end()));
+        }
+      });
+    }
+    for (auto& p : producers) p.join();
+    writer.write_loose(hello_id, loose);
+    writer.flush();
+    for (std::size_t i = 0; i < ids.size(); ++i) {
+      const std::string text = "queued object " + std::to_string(i) + "\n";
+      const auto obj = store.read(ids[i]);
+      if (std::string(obj.data.begin(), obj.data.end()) != text ||
+          ids[i] != gitfly::compute_blob_hex_oid(obj.data)) {
+        std::cerr << "object writer lost " << i << "\n"; return 1;
+      }
+    }
+    // A write that fails (its fan-out directory is a file) surfaces at flush()
+    const std::string doomed = "doomed\n";
+    const auto doomed_hex = gitfly::compute_blob_hex_oid(
+        std::span(reinterpret_cast<const std::uint8_t*>(doomed.data()), doomed.size()));
+    const auto fan = repo.git_dir() / "objects" / doomed_hex.substr(0, 2);
+    fs::remove_all(fan);
+    gitfly::fs::write_file_atomic(fan, loose);
+    (void)writer.write("blob", std::vector<std::uint8_t>(doomed.begin(), doomed.end()));
+    bool refused = false;
+    try { writer.flush(); } catch (const std::exception&) { refused = true; }
+    fs::remove(fan);
+    if (!refused || store.read(blob_oid_hex).data != back) {
+      std::cerr << "object writer error not reported\n"; return 1;
+    }
+  }
+
+  // Hex conversion, every length and every bad character position
+  {
+    static const char digits[] = "0123456789abcdef";
+    std::vector<std::uint8_t> bytes(48), back(48);
+    for (std::size_t i = 0; i < bytes.size(); ++i) bytes[i] = static_cast<std::uint8_t>(i * 37 + 11);
+    for (std::size_t n = 0; n <= bytes.size(); ++n) {
+      std::string want, got(2 * n, '?');
+      for (std::size_t i = 0; i < n; ++i) { want += digits[bytes[i] >> 4]; want += digits[bytes[i] & 15]; }
+      gitfly::hex_encode(std::span<const std::uint8_t>(bytes.data(), n), got.data());
+      std::string upper = want;
+      for (auto& c : upper) c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+      if (got != want || !gitfly::hex_decode(upper, back.data()) ||
+          !std::equal(back.begin(), back.begin() + static_cast<std::ptrdiff_t>(n), bytes.begin())) {
+        std::cerr << "hex round trip failed at " << n << " bytes\n"; return 1;
+      }
+    }
+    const std::string good = gitfly::to_hex(gitfly::sha256("x"));
+    gitfly::oid256 id256{};
+    for (std::size_t pos = 0; pos < good.size(); ++pos) {
+      for (char bad : {'g', 'G', '/', ':', '@', '`', ' ', '\0', '\x80', '\xe6'}) {
+        std::string s = good;
+        s[pos] = bad;
+        if (gitfly::from_hex(s, id256) || gitfly::looks_hex_oid(s, gitfly::ObjectFormat::sha256)) {
+          std::cerr << "bad hex char accepted at " << pos << "\n"; return 1;
+        }
+      }
+    }
+    gitfly::oid id20{};
+    if (!gitfly::from_hex(good, id256) || gitfly::to_hex(id256) != good ||
+        gitfly::from_hex(good, id20) || gitfly::hex_decode("abc", back.data())) {
+      std::cerr << "from_hex length handling\n"; return 1;
+    }
+  }
+
+  // Same content under a stored id passes the collision check whatever the
+  // zlib settings; different content under that id is refused.
+  {
+    const std::string image = std::string("blob 6") + '\0' + "hello\n";
+    std::vector<std::uint8_t> fast(compressBound(image.size()));
+    uLongf fast_len = fast.size();
+    compress2(fast.data(), &fast_len, reinterpret_cast<const Bytef*>(image.data()), image.size(), 1);
+    fast.resize(fast_len);
+    const std::string other = std::string("blob 6") + '\0' + "jello\n";
+    const auto forged = gitfly::fs::z_compress(std::span<const std::uint8_t>(
+        reinterpret_cast<const std::uint8_t*>(other.data()), other.size()));
+    gitfly::oid hello_id{};
+    gitfly::from_hex(blob_oid_hex, hello_id);
+    bool refused = false;
+    store.check_collision(hello_id, fast);
+    try { store.check_collision(hello_id, forged); } catch (const std::runtime_error&) { refused = true; }
+    if (!refused) {
+      std::cerr << "collision not detected\n"; return 1;
+    }
+    // Same for images spooled to a file
+    const fs::path fast_file = repo_root / "fast.obj", forged_file = repo_root / "forged.obj";
+    gitfly::fs::write_file_atomic(fast_file, fast);
+    gitfly::fs::write_file_atomic(forged_file, forged);
+    refused = false;
+    store.check_collision(hello_id, fast_file);
+    try { store.check_collision(hello_id, forged_file); } catch (const std::runtime_error&) { refused = true; }
+    if (!refused) {
+      std::cerr << "collision in a file not detected\n"; return 1;
+    }
+  }
+
+  // SHA-256 object format: same object, 32-byte id (matches git's sha256 repos)
+  const std::string hello_sha256 = "2cf8d83d9ee29543b34a87727421fdecb7e3f3a183d337639025de576db9ebb4";
+  const auto hello = std::span<const std::uint8_t>(
+      reinterpret_cast<const std::uint8_t*>(content.data()), content.size());
+  if (gitfly::to_hex(gitfly::hash_object<gitfly::ObjectFormat::sha256>("blob", hello)) != hello_sha256 ||
+      gitfly::to_hex(gitfly::sha256("abc")) !=
+          "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad") {
+    std::cerr << "sha256 mismatch\n"; return 1;
+  }
+  {
+    const fs::path root256 = repo_root.parent_path() / "sandbox_store_sha256";
+    fs::remove_all(root256);
+    const gitfly::ObjectStore store256{root256, gitfly::ObjectFormat::sha256};
+    const std::string id = store256.write(gitfly::consts::kTypeBlob, hello);
+    gitfly::oid256 raw{};
+    gitfly::from_hex(id, raw);
+    if (id != hello_sha256 ||
+        !store256.exists(id) || store256.read(id).data != back ||
+        gitfly::ObjectStore::hash_loose<gitfly::ObjectFormat::sha256>(
+            gitfly::fs::read_file(store256.path_for_oid(raw))) != raw ||
+        store256.list() != std::vector<std::string>{id} || store256.exists(blob_oid_hex)) {
+      std::cerr << "sha256 object store mismatch\n"; return 1;
+    }
+    fs::remove_all(root256);
+  }
+
+  // Compression levels come from the config; any level reads back the same
+  {
+    const fs::path rootz = repo_root.parent_path() / "sandbox_repo_levels";
+    fs::remove_all(rootz);
+    const Repository repoz{rootz};
+    repoz.init();
+    std::string text;
+    for (int i = 0; i < 400; ++i) text += "line " + std::to_string(i % 7) + " of a compressible blob\n";
+    const auto payload = std::span<const std::uint8_t>(
+        reinterpret_cast<const std::uint8_t*>(text.data()), text.size());
+    auto path_of = [](const gitfly::ObjectStore& st, const std::string& hex) {
+      gitfly::oid raw{};
+      gitfly::from_hex(hex, raw);
+      return st.path_for_oid(raw);
+    };
+    const gitfly::ObjectStore fast{repoz.git_dir()};
+    const std::string id = fast.write(gitfly::consts::kTypeBlob, payload);
+    const auto fast_size = fs::file_size(path_of(fast, id));
+    fs::remove(path_of(fast, id));
+    gitfly::config_set(rootz, gitfly::consts::kCfgLooseCompression, "9");
+    gitfly::config_set(rootz, gitfly::consts::kCfgPackCompression, "0");
+    const gitfly::ObjectStore best{repoz.git_dir()};
+    const bool same_id = best.write(gitfly::consts::kTypeBlob, payload) == id;
+    const auto obj = best.read(id);
+    if (!same_id || best.pack_compression() != 0 || fs::file_size(path_of(best, id)) >= fast_size ||
+        std::string(obj.data.begin(), obj.data.end()) != text) {
+      std::cerr << "compression level not applied\n"; return 1;
+    }
+    gitfly::config_set(rootz, gitfly::consts::kCfgCompression, "12");
+    gitfly::config_set(rootz, gitfly::consts::kCfgObjectCodec, "lz4");
+    bool refused_level = false, refused_codec = false;
+    try { (void)gitfly::ObjectStore{repoz.git_dir()}.pack_compression(); }
+    catch (const std::runtime_error&) { refused_level = true; }
+    try { (void)gitfly::ObjectStore{repoz.git_dir()}.codec(); }
+    catch (const std::runtime_error&) { refused_codec = true; }
+    if (!refused_level || !refused_codec) {
+      std::cerr << "bad compression settings accepted\n"; return 1;
+    }
+    fs::remove_all(rootz);
+  }
+
+  // zstd repositories (when built in): same ids, zstd frames on disk, optional
+  // dictionary for small objects, and no transfers
+  if (gitfly::fs::codec_available(gitfly::fs::Codec::zstd)) {
+    const fs::path rootz = repo_root.parent_path() / "sandbox_repo_zstd";
+    fs::remove_all(rootz);
+    const Repository repoz{rootz};
+    repoz.init(gitfly::Identity{"T", "t@example.com"}, gitfly::fs::Codec::zstd);
+    const gitfly::ObjectStore storez{repoz.git_dir()};
+    const std::string id = storez.write(gitfly::consts::kTypeBlob, hello);
+    gitfly::oid raw{};
+    gitfly::from_hex(id, raw);
+    const auto image = gitfly::fs::read_file(storez.path_for_oid(raw));
+    if (id != blob_oid_hex || storez.codec() != gitfly::fs::Codec::zstd ||
+        !gitfly::fs::is_zstd(image) || storez.read(id).data != back ||
+        storez.read_header(id).size != back.size()) {
+      std::cerr << "zstd object mismatch\n"; return 1;
+    }
+    // Streamed in and out
+    const std::vector<std::uint8_t> big(3u << 20, 'z');
+    std::size_t fed = 0;
+    const std::string big_id = storez.write_stream(
+        gitfly::consts::kTypeBlob, big.size(), [&](std::span<std::uint8_t> buf) {
+          const std::size_t n = std::min(buf.size(), big.size() - fed);
+          std::copy_n(big.begin() + static_cast<std::ptrdiff_t>(fed), n, buf.begin());
+          fed += n;
+          return n;
+        });
+    auto stream = storez.open_stream(big_id);
+    std::vector<std::uint8_t> got;
+    std::uint8_t piece[4096];
+    while (const std::size_t n = stream.read(piece)) got.insert(got.end(), piece, piece + n);
+    if (big_id != gitfly::compute_blob_hex_oid(big) || got != big) {
+      std::cerr << "zstd stream mismatch\n"; return 1;
+    }
+    // A dictionary trained on small objects is used for the next ones, and
+    // objects written before it still read
+    std::vector<std::string> small;
+    for (int i = 0; i < 300; ++i) {
+      const std::string t = "{\"name\": \"item" + std::to_string(i) + "\", \"kind\": \"record\", "
+                            "\"tags\": [\"alpha\", \"beta\"], \"value\": " + std::to_string(i * 31) + "}\n";
+      small.push_back(storez.write(gitfly::consts::kTypeBlob, std::span<const std::uint8_t>(
+          reinterpret_cast<const std::uint8_t*>(t.data()), t.size())));
+    }
+    const std::uint32_t dict_id = storez.train_zstd_dictionary();
+    const gitfly::ObjectStore after{repoz.git_dir()};
+    const std::string t = "{\"name\": \"item900\", \"kind\": \"record\", \"tags\": [\"alpha\"]}\n";
+    const std::string later = after.write(gitfly::consts::kTypeBlob, std::span<const std::uint8_t>(
+        reinterpret_cast<const std::uint8_t*>(t.data()), t.size()));
+    const auto later_obj = after.read(later);
+    if (dict_id == 0 || after.loose_compression(t.size()).dict.empty() ||
+        std::string(later_obj.data.begin(), later_obj.data.end()) != t ||
+        after.read(small.front()).data.empty() || after.read(id).data != back) {
+      std::cerr << "zstd dictionary round trip failed\n"; return 1;
+    }
+    bool refused = false;
+    try { repoz.require_portable_objects(); } catch (const std::runtime_error&) { refused = true; }
+    if (!refused) {
+      std::cerr << "zstd repository offered for transfer\n"; return 1;
+    }
+    fs::remove_all(rootz);
+  }
+
   // ---- 2) Write a tree with one file entry "hello.txt" -> blob
   oid blob_oid{};
   if (!gitfly::from_hex(blob_oid_hex, blob_oid)) {
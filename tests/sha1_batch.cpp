@@ -0,0 +1,242 @@
+#include "gitfly/hash.hpp"
+#include "gitfly/index.hpp"
+#include "gitfly/object_store.hpp"
+#include "gitfly/repo.hpp"
+#include "gitfly/util.hpp"
+#include "gitfly/worktree.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+namespace fs = std::filesystem;
+using gitfly::Sha1Engine;
+
+// Every engine must agree with the one-at-a-time sha1() on every length,
+// including the padding boundaries (55/56 and 63/64 bytes per block).
+static bool check_engine(Sha1Engine engine, const std::vector<std::vector<std::uint8_t>> &msgs,
+                         const char *name) {
+  std::vector<std::span<const std::uint8_t>> in(msgs.begin(), msgs.end());
+  std::vector<gitfly::oid> out(msgs.size());
+  gitfly::sha1_many(in, out, engine);
+  for (std::size_t i = 0; i < msgs.size(); ++i) {
+    if (out[i] != gitfly::sha1(msgs[i])) {
+      std::cerr << name << ": digest mismatch for a " << msgs[i].size() << "-byte input\n";
+      return false;
+    }
+  }
+  return true;
+}
+
+int main() {
+  // sha1() and Hasher against the FIPS 180 vectors, fed whole and in pieces
+  // that straddle block boundaries.
+  const std::string abc_bits = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+  const std::string million_a(1000000, 'a');
+  if (gitfly::to_hex(gitfly::sha1("abc")) != "a9993e364706816aba3e25717850c26c9cd0d89d" ||
+      gitfly::to_hex(gitfly::sha1(abc_bits)) != "84983e441c3bd26ebaae4aa1f95129e5e54670f1" ||
+      gitfly::to_hex(gitfly::sha1(million_a)) != "34aa973cd4c4daa4f61eeb2bdbad27316534016f") {
+    std::cerr << "sha1 test vectors\n";
+    return 1;
+  }
+  for (std::size_t step : {1, 7, 63, 64, 65, 1000}) {
+    gitfly::Hasher h;
+    for (std::size_t pos = 0; pos < million_a.size(); pos += step) {
+      h.update(std::string_view(million_a).substr(pos, step));
+    }
+    if (gitfly::to_hex(h.finish()) != "34aa973cd4c4daa4f61eeb2bdbad27316534016f") {
+      std::cerr << "Hasher with " << step << "-byte pieces\n";
+      return 1;
+    }
+  }
+
+  std::mt19937 rng(42);
+  std::vector<std::vector<std::uint8_t>> msgs;
+  for (std::size_t len = 0; len <= 300; ++len) {
+    msgs.emplace_back(len);
+  }
+  for (std::size_t len : {4095, 4096, 20000, 70000}) {
+    msgs.emplace_back(len);
+  }
+  for (auto &m : msgs) {
+    for (auto &b : m) {
+      b = static_cast<std::uint8_t>(rng());
+    }
+  }
+  // Odd count and mixed lengths: lanes finish at different times and refill.
+  std::shuffle(msgs.begin(), msgs.end(), rng);
+
+  if (!check_engine(Sha1Engine::automatic, msgs, "automatic") ||
+      !check_engine(Sha1Engine::scalar, msgs, "scalar")) {
+    return 1;
+  }
+  if (gitfly::sha1_engine_available(Sha1Engine::avx2) &&
+      !check_engine(Sha1Engine::avx2, msgs, "avx2")) {
+    return 1;
+  }
+  if (gitfly::sha1_engine_available(Sha1Engine::avx512) &&
+      !check_engine(Sha1Engine::avx512, msgs, "avx512")) {
+    return 1;
+  }
+  const auto name = gitfly::sha1_engine_name();
+  if (name != "avx512" && name != "avx2" && name != "scalar") {
+    std::cerr << "unexpected engine name " << name << "\n";
+    return 1;
+  }
+
+  // hash_objects == hash_object, and the empty blob has its well-known id.
+  std::vector<std::span<const std::uint8_t>> payloads(msgs.begin(), msgs.end());
+  payloads.emplace_back();
+  const auto ids = gitfly::hash_objects("blob", payloads);
+  for (std::size_t i = 0; i < payloads.size(); ++i) {
+    if (ids[i] != gitfly::hash_object("blob", payloads[i])) {
+      std::cerr << "hash_objects differs from hash_object\n";
+      return 1;
+    }
+  }
+  if (gitfly::to_hex(ids.back()) != "e69de29bb2d1d6434b8b29ae775ad8c2e48c5391") {
+    std::cerr << "empty blob id wrong: " << gitfly::to_hex(ids.back()) << "\n";
+    return 1;
+  }
+
+  bool threw = false;
+  try {
+    std::vector<gitfly::oid> short_out(1);
+    gitfly::sha1_many(std::span<const std::span<const std::uint8_t>>(payloads), short_out);
+  } catch (const std::runtime_error &) {
+    threw = true;
+  }
+  if (!threw) {
+    std::cerr << "size mismatch not rejected\n";
+    return 1;
+  }
+
+  // Collision detection changes no digest and flags no ordinary input. A few
+  // MiB of random blocks meet some attack's unavoidable conditions hundreds of
+  // times, so the recompression of candidate blocks runs too.
+  {
+    std::vector<std::uint8_t> big(4 << 20);
+    for (auto &b : big) {
+      b = static_cast<std::uint8_t>(rng());
+    }
+    msgs.push_back(big);
+    msgs.emplace_back(million_a.begin(), million_a.end());
+    try {
+      for (const auto &m : msgs) {
+        gitfly::Sha1dcHasher whole;
+        gitfly::Sha1dcHasher pieces;
+        for (std::size_t pos = 0; pos < m.size(); pos += 1000) {
+          pieces.update(std::span(m).subspan(pos, std::min<std::size_t>(1000, m.size() - pos)));
+        }
+        const auto id = gitfly::sha1(m);
+        if (whole.update(m).finish() != id || pieces.finish() != id) {
+          std::cerr << "Sha1dcHasher: digest mismatch for a " << m.size() << "-byte input\n";
+          return 1;
+        }
+      }
+    } catch (const std::runtime_error &e) {
+      std::cerr << "Sha1dcHasher flagged ordinary input: " << e.what() << "\n";
+      return 1;
+    }
+  }
+
+  // The first 320 bytes of the two SHAttered PDFs (Stevens et al., 2017): a
+  // common prefix, then the two near-collision blocks of each file. Plain SHA-1
+  // gives both the same digest; the detector must reject either.
+  {
+    const std::string prefix =
+        "255044462d312e330a25e2e3cfd30a0a0a312030206f626a0a3c3c2f57696474682032203020522f"
+        "4865696768742033203020522f547970652034203020522f537562747970652035203020522f4669"
+        "6c7465722036203020522f436f6c6f7253706163652037203020522f4c656e677468203820302052"
+        "2f42697473506572436f6d706f6e656e7420383e3e0a73747265616d0affd8fffe00245348412d31"
+        "20697320646561642121212121852fec092339759c39b1a1c63c4c97e1fffe01";
+    const std::string blocks[2] = {
+        "7f46dc93a6b67e013b029aaa1db2560b45ca67d688c7f84b8c4c791fe02b3df614f86db1690901c5"
+        "6b45c1530afedfb76038e972722fe7ad728f0e4904e046c230570fe9d41398abe12ef5bc942be335"
+        "42a4802d98b5d70f2a332ec37fac3514e74ddc0f2cc1a874cd0c78305a21566461309789606bd0bf"
+        "3f98cda8044629a1",
+        "7346dc9166b67e118f029ab621b2560ff9ca67cca8c7f85ba84c79030c2b3de218f86db3a90901d5"
+        "df45c14f26fedfb3dc38e96ac22fe7bd728f0e45bce046d23c570feb141398bb552ef5a0a82be331"
+        "fea48037b8b5d71f0e332edf93ac3500eb4ddc0decc1a864790c782c76215660dd309791d06bd0af"
+        "3f98cda4bc4629b1",
+    };
+    std::vector<std::uint8_t> pdf[2];
+    for (int k = 0; k < 2; ++k) {
+      const std::string hex = prefix + blocks[k];
+      pdf[k].resize(hex.size() / 2);
+      if (!gitfly::hex_decode(hex, pdf[k].data())) {
+        std::cerr << "bad SHAttered fixture\n";
+        return 1;
+      }
+    }
+    if (pdf[0] == pdf[1] || gitfly::sha1(pdf[0]) != gitfly::sha1(pdf[1]) ||
+        gitfly::to_hex(gitfly::sha1(pdf[0])) != "f92d74e3874587aaf443d1db961d4e26dde13e9c") {
+      std::cerr << "SHAttered fixture is not a collision\n";
+      return 1;
+    }
+    for (const auto &m : pdf) {
+      bool flagged = false;
+      try {
+        gitfly::Sha1dcHasher{}.update(m).finish();
+      } catch (const std::runtime_error &) {
+        flagged = true;
+      }
+      if (!flagged) {
+        std::cerr << "Sha1dcHasher missed a SHAttered block\n";
+        return 1;
+      }
+    }
+  }
+
+  // Index::add_paths and build_working_map agree with file-by-file hashing,
+  // for batches of small files and the big ones that bypass them.
+  const fs::path root = fs::temp_directory_path() / ("gitfly_sha1_batch_" + std::to_string(std::random_device{}()));
+  try {
+    gitfly::Repository repo{root};
+    repo.init(gitfly::Identity{"T", "t@example.com"});
+    std::vector<std::string> rels;
+    for (int i = 0; i < 600; ++i) {
+      rels.push_back("d" + std::to_string(i % 5) + "/f" + std::to_string(i) + ".txt");
+      fs::create_directories((root / rels.back()).parent_path());
+      std::ofstream(root / rels.back(), std::ios::binary) << std::string(static_cast<std::size_t>(i), 'x') << i;
+    }
+    rels.emplace_back("big.bin");
+    std::ofstream(root / "big.bin", std::ios::binary) << std::string(200000, 'b');
+    rels.push_back(rels.front()); // listed twice: still one entry
+
+    gitfly::Index idx{root};
+    idx.load();
+    idx.add_paths(root, rels, repo);
+    idx.save();
+    if (idx.entries().size() != 601) {
+      std::cerr << "add_paths: expected 601 entries, got " << idx.entries().size() << "\n";
+      return 1;
+    }
+    const gitfly::ObjectStore store{repo.git_dir()};
+    for (const auto &e : idx.entries()) {
+      const auto hex = gitfly::compute_file_blob_hex_oid(root / e.path);
+      if (gitfly::to_hex(e.oid) != hex || !store.exists(hex)) {
+        std::cerr << "add_paths: wrong or missing blob for " << e.path << "\n";
+        return 1;
+      }
+    }
+    if (gitfly::worktree::build_working_map(root) != gitfly::worktree::index_to_map(root)) {
+      std::cerr << "build_working_map disagrees with the index\n";
+      return 1;
+    }
+  } catch (const std::exception &e) {
+    std::cerr << "exception: " << e.what() << "\n";
+    fs::remove_all(root);
+    return 1;
+  }
+  fs::remove_all(root);
+
+  std::cout << "sha1_batch OK (" << name << ")\n";
+  return 0;
+}
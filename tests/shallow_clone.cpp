@@ -0,0 +1,114 @@
+#include "gitfly/index.hpp"
+#include "gitfly/object_store.hpp"
+#include "gitfly/refs.hpp"
+#include "gitfly/remote.hpp"
+#include "gitfly/repo.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static void write_file(const fs::path &p, std::string_view s) {
+  fs::create_directories(p.parent_path());
+  std::ofstream(p, std::ios::binary) << s;
+}
+
+int main() {
+  const auto suffix = std::to_string(std::random_device{}());
+  const fs::path remote = fs::temp_directory_path() / ("gitfly_shallow_remote_" + suffix);
+  const fs::path local = fs::temp_directory_path() / ("gitfly_shallow_local_" + suffix);
+  fs::create_directories(remote);
+
+  try {
+    // Remote with four linear commits
+    gitfly::Repository rrepo{remote};
+    rrepo.init(gitfly::Identity{"Remote", "r@example.com"});
+    std::vector<std::string> commits;
+    gitfly::Index idx{remote};
+    for (int i = 0; i < 4; ++i) {
+      write_file(remote / "f.txt", "v" + std::to_string(i) + "\n");
+      idx.load(); idx.add_path(remote, "f.txt", rrepo); idx.save();
+      commits.push_back(rrepo.commit_index("c" + std::to_string(i) + "\n"));
+    }
+
+    // Depth 2 keeps c3 and c2; c2 becomes the shallow boundary
+    gitfly::remote::clone_repo(remote, local, 2);
+    gitfly::Repository lrepo{local};
+    const auto shallow = lrepo.shallow_commits();
+    if (shallow.size() != 1 || !shallow.contains(commits[2])) {
+      std::cerr << "clone --depth 2: unexpected shallow set\n";
+      return 1;
+    }
+    const gitfly::ObjectStore store{lrepo.git_dir()};
+    if (!store.exists(commits[3]) || !store.exists(commits[2]) || store.exists(commits[1])) {
+      std::cerr << "clone --depth 2: wrong commits transferred\n";
+      return 1;
+    }
+    auto tip = gitfly::read_ref(local, gitfly::heads_ref("master"));
+    if (!tip || *tip != commits[3]) {
+      std::cerr << "clone --depth 2: tip mismatch\n";
+      return 1;
+    }
+    // Ancestry walks stop at the boundary instead of failing on missing parents
+    if (!lrepo.is_commit_ancestor(commits[2], commits[3]) ||
+        lrepo.is_commit_ancestor(commits[0], commits[3])) {
+      std::cerr << "is_commit_ancestor ignores shallow boundary\n";
+      return 1;
+    }
+
+    // Advance remote; a depth-limited fetch only needs the new commit and keeps the boundary
+    write_file(remote / "f.txt", "v4\n");
+    idx.load(); idx.add_path(remote, "f.txt", rrepo); idx.save();
+    const std::string c4 = rrepo.commit_index("c4\n");
+    const auto fres = gitfly::remote::fetch_head(local, remote, "origin", 1);
+    if (fres.tip != c4 || !store.exists(c4)) {
+      std::cerr << "fetch --depth 1: tip not fetched\n";
+      return 1;
+    }
+    if (lrepo.shallow_commits() != shallow) {
+      std::cerr << "fetch --depth 1: shallow set changed although parents are present\n";
+      return 1;
+    }
+
+    // A shallow clone deepens: fetch --depth 4 moves the boundary down, and a
+    // plain fetch brings the rest of the history and removes the shallow file
+    const fs::path deep = local.string() + "_deep";
+    gitfly::remote::clone_repo(remote, deep, 1);
+    const gitfly::Repository drepo{deep};
+    const gitfly::ObjectStore dstore{drepo.git_dir()};
+    if (drepo.shallow_commits() != std::set<std::string>{c4} || dstore.exists(commits[3])) {
+      std::cerr << "clone --depth 1: unexpected shallow set\n";
+      return 1;
+    }
+    (void)gitfly::remote::fetch_head(deep, remote, "origin", 4);
+    if (drepo.shallow_commits() != std::set<std::string>{commits[1]} ||
+        !dstore.exists(commits[1]) || dstore.exists(commits[0])) {
+      std::cerr << "fetch --depth 4: boundary not moved down\n";
+      return 1;
+    }
+    (void)gitfly::remote::fetch_refs(deep, remote);
+    if (!drepo.shallow_commits().empty() || fs::exists(drepo.shallow_file()) ||
+        !dstore.exists(commits[0]) || !drepo.is_commit_ancestor(commits[0], c4)) {
+      std::cerr << "full fetch: history still incomplete\n";
+      return 1;
+    }
+    fs::remove_all(deep);
+
+    std::cout << "shallow_clone OK\n";
+  } catch (const std::exception &e) {
+    std::cerr << "exception: " << e.what() << "\n";
+    fs::remove_all(remote);
+    fs::remove_all(local);
+    return 1;
+  }
+  std::error_code ec;
+  fs::remove_all(remote, ec);
+  fs::remove_all(local, ec);
+  return 0;
+}
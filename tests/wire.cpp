@@ -0,0 +1,234 @@
+#include "gitfly/consts.hpp"
+#include "gitfly/repo.hpp"
+#include "gitfly/tcp_remote.hpp"
+#include "gitfly/wire.hpp"
+
+#include <filesystem>
+#include <iostream>
+#include <netinet/in.h>
+#include <random>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+int main() {
+  const auto ep = gitfly::tcpremote::parse_url("tcp://mirror:9000/group/repo");
+  if (ep.host != "mirror" || ep.port != 9000 || ep.repo != "group/repo" ||
+      !gitfly::tcpremote::parse_url("tcp://localhost").repo.empty()) {
+    std::cerr << "parse_url\n";
+    return 1;
+  }
+
+  // Header parsing is strict and bounded
+  {
+    const gitfly::wire::Limits limits{.max_line = 64, .max_object = 1000, .max_objects = 10};
+    const std::string hex(40, 'a');
+    const auto h = gitfly::wire::parse_obj("OBJ " + hex + " 1000", limits);
+    if (h.hex != hex || h.size != 1000 || gitfly::wire::parse_nobj("NOBJ 10", limits) != 10) {
+      std::cerr << "parse_obj/parse_nobj\n";
+      return 1;
+    }
+    const std::vector<std::string> bad_lines{
+        "OBJ " + hex + " 1001", "OBJ " + hex + " -1", "OBJ " + hex + " 5x", "OBJ abc 5",
+        "OBJ " + hex,           "NOBJ 11",            "NOBJ ",              "NOBJ 99999999999999999999"};
+    for (const auto &bad : bad_lines) {
+      bool threw = false;
+      try {
+        if (bad.starts_with("NOBJ"))
+          (void)gitfly::wire::parse_nobj(bad, limits);
+        else
+          (void)gitfly::wire::parse_obj(bad, limits);
+      } catch (const std::runtime_error &) {
+        threw = true;
+      }
+      if (!threw) {
+        std::cerr << "accepted bad header: " << bad << "\n";
+        return 1;
+      }
+    }
+
+    // An overlong line, an oversized payload and a session overrun all stop the reader
+    int sp[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, sp) != 0) {
+      std::cerr << "socketpair failed\n";
+      return 1;
+    }
+    const std::string junk(100, 'x');
+    if (::write(sp[1], junk.data(), junk.size()) != static_cast<ssize_t>(junk.size()))
+      return 1;
+    gitfly::wire::Conn conn{sp[0]};
+    conn.set_limits(limits);
+    int rejected = 0;
+    try { (void)conn.read_line(); } catch (const std::runtime_error &) { ++rejected; }
+    std::vector<std::uint8_t> buf;
+    try { conn.read_payload(buf, 1001); } catch (const std::runtime_error &) { ++rejected; }
+    conn.set_limits(gitfly::wire::Limits{.max_session = 50});
+    try { conn.read_payload(buf, 60); } catch (const std::runtime_error &) { ++rejected; }
+    ::close(sp[0]);
+    ::close(sp[1]);
+    if (rejected != 3 || buf.capacity() > 1000) {
+      std::cerr << "limits not enforced\n";
+      return 1;
+    }
+  }
+
+  // A pipelining client keeps reading while it sends: a large response to one
+  // request must not stall a large request queued behind it. The server, like
+  // serve, reads the next request only after writing the current response.
+  {
+    const int lfd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (lfd < 0 || ::bind(lfd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 ||
+        ::listen(lfd, 1) != 0 || ::getsockname(lfd, reinterpret_cast<sockaddr *>(&addr), &len) != 0) {
+      std::cerr << "listen failed\n";
+      return 1;
+    }
+    const std::string big_hex(40, 'b');
+    std::vector<std::uint8_t> big(8U << 20);
+    for (std::size_t i = 0; i < big.size(); ++i)
+      big[i] = static_cast<std::uint8_t>((i * 2654435761U) >> 13);
+    std::vector<std::string> wants;
+    for (int i = 0; i < 100000; ++i) {
+      std::string hex = std::to_string(i);
+      wants.push_back(std::string(40 - hex.size(), 'c') + hex);
+    }
+
+    std::string server_error;
+    std::size_t wants_seen = 0;
+    std::thread server([&] {
+      try {
+        const int fd = ::accept(lfd, nullptr, nullptr);
+        gitfly::wire::Conn conn{fd};
+        (void)gitfly::wire::parse_hello(conn.read_line());
+        conn.write_line(gitfly::wire::hello_line({gitfly::wire::kCapMulti}));
+        for (auto req = conn.read_line(); req != gitfly::consts::kTokBye; req = conn.read_line()) {
+          conn.write_line(std::string(gitfly::consts::kTokResp) +
+                          req.substr(gitfly::consts::kTokReq.size()));
+          if (conn.read_line() != gitfly::consts::kOpBlobs)
+            throw std::runtime_error("expected OP BLOBS");
+          std::vector<std::string> got;
+          for (auto line = conn.read_line(); line != gitfly::consts::kTokDone; line = conn.read_line())
+            got.push_back(line.substr(gitfly::consts::kTokWant.size()));
+          if (got.size() == 1 && got[0] == big_hex) {
+            conn.write_line("NOBJ 1");
+            conn.write_line("OBJ " + big_hex + " " + std::to_string(big.size()));
+            conn.write(big.data(), big.size());
+          } else {
+            wants_seen = got.size();
+            conn.write_line("NOBJ 0");
+          }
+          conn.write_line(gitfly::consts::kTokDone);
+        }
+        ::close(fd);
+      } catch (const std::exception &e) {
+        server_error = e.what();
+      }
+    });
+
+    const auto root = std::filesystem::temp_directory_path() /
+                      ("gitfly_pipeline_" + std::to_string(std::random_device{}()));
+    int failed = 0;
+    try {
+      gitfly::Repository{root}.init();
+      gitfly::tcpremote::Client client{"127.0.0.1", ntohs(addr.sin_port)};
+      (void)client.fetch_objects(root.string(), {big_hex});
+      (void)client.fetch_objects(root.string(), wants);
+      client.wait();
+      if (std::filesystem::file_size(root / ".gitfly" / "objects" / "bb" / std::string(38, 'b')) !=
+          big.size())
+        failed = 1;
+    } catch (const std::exception &e) {
+      std::cerr << "pipelined client: " << e.what() << "\n";
+      failed = 1;
+    }
+    server.join();
+    ::close(lfd);
+    std::error_code ec;
+    std::filesystem::remove_all(root, ec);
+    if (failed != 0 || !server_error.empty() || wants_seen != wants.size()) {
+      std::cerr << "pipelined requests: " << server_error << "\n";
+      return 1;
+    }
+  }
+
+  int fds[2];
+  if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+    std::cerr << "socketpair failed\n";
+    return 1;
+  }
+
+  // Server side: negotiate, then echo a line and count the bytes it received.
+  std::string server_error;
+  std::size_t server_got = 0;
+  std::thread server([&] {
+    try {
+      gitfly::wire::Conn conn{fds[1]};
+      const auto caps = gitfly::wire::parse_hello(conn.read_line());
+      if (caps.size() != 1 || caps[0] != gitfly::wire::kCapZlib)
+        throw std::runtime_error("bad caps");
+      conn.write_line(gitfly::wire::hello_line({gitfly::wire::kCapZlib}));
+      conn.enable_compression();
+      for (int i = 0; i < 1000; ++i) {
+        if (conn.read_line() != "OBJ " + std::to_string(i))
+          throw std::runtime_error("line " + std::to_string(i) + " garbled");
+      }
+      std::vector<char> blob(200000);
+      conn.read_exact(blob.data(), blob.size());
+      for (std::size_t i = 0; i < blob.size(); ++i) {
+        if (blob[i] != static_cast<char>(i % 251))
+          throw std::runtime_error("blob garbled");
+      }
+      server_got = blob.size();
+      conn.write_line("OK");
+      conn.flush();
+    } catch (const std::exception &e) {
+      server_error = e.what();
+    }
+    ::close(fds[1]);
+  });
+
+  int rc = 0;
+  try {
+    gitfly::wire::Conn conn{fds[0]};
+    conn.write_line(gitfly::wire::hello_line({gitfly::wire::kCapZlib}));
+    const auto caps = gitfly::wire::parse_hello(conn.read_line());
+    if (caps.size() != 1) {
+      std::cerr << "zlib not accepted\n";
+      rc = 1;
+    }
+    conn.enable_compression();
+    for (int i = 0; i < 1000; ++i)
+      conn.write_line("OBJ " + std::to_string(i));
+    std::vector<char> blob(200000);
+    for (std::size_t i = 0; i < blob.size(); ++i)
+      blob[i] = static_cast<char>(i % 251);
+    conn.write(blob.data(), blob.size());
+    if (conn.read_line() != "OK") {
+      std::cerr << "expected OK\n";
+      rc = 1;
+    }
+    const auto &c = conn.counters();
+    if (c.wire_out >= c.payload_out) {
+      std::cerr << "compressed stream not smaller: " << c.wire_out << " >= " << c.payload_out
+                << "\n";
+      rc = 1;
+    }
+  } catch (const std::exception &e) {
+    std::cerr << "exception: " << e.what() << "\n";
+    rc = 1;
+  }
+  server.join();
+  ::close(fds[0]);
+  if (!server_error.empty() || server_got == 0) {
+    std::cerr << "server: " << server_error << "\n";
+    return 1;
+  }
+  if (rc == 0)
+    std::cout << "wire OK\n";
+  return rc;
+}